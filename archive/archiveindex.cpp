@@ -0,0 +1,231 @@
+/*  This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "archiveindex.h"
+#include "cachedirectory.h"
+#include <kio_archive_debug.h>
+
+#include <KArchiveDirectory>
+#include <KArchiveFile>
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <utility>
+
+// Bump when the layout of the stored index changes
+static const quint32 s_indexMagic = 0x4b415249; // "KARI"
+static const quint32 s_indexVersion = 3;
+static const char s_indexSuffix[] = ".index";
+
+ArchiveIndex::ArchiveIndex(const KArchiveDirectory *root)
+{
+    m_entries.append(makeEntry(root));
+    addChildren(0, root);
+    buildPathHash();
+    computeRecursiveSizes();
+}
+
+ArchiveIndex::Entry ArchiveIndex::makeEntry(const KArchiveEntry *archiveEntry)
+{
+    Entry entry;
+    entry.name = archiveEntry->name();
+    entry.user = archiveEntry->user();
+    entry.group = archiveEntry->group();
+    entry.symLinkTarget = archiveEntry->symLinkTarget();
+    if (archiveEntry->isFile()) {
+        const auto fileEntry = static_cast<const KArchiveFile *>(archiveEntry);
+        entry.size = fileEntry->size();
+        entry.position = fileEntry->position();
+    }
+    entry.mtime = archiveEntry->date().toSecsSinceEpoch();
+    entry.permissions = archiveEntry->permissions();
+    entry.isDirectory = archiveEntry->isDirectory();
+    return entry;
+}
+
+void ArchiveIndex::addChildren(int index, const KArchiveDirectory *dir)
+{
+    const QStringList names = dir->entries();
+    QList<int> children;
+    children.reserve(names.count());
+    for (const QString &name : names) {
+        const KArchiveEntry *archiveEntry = dir->entry(name);
+        if (!archiveEntry) {
+            continue;
+        }
+        const int child = m_entries.count();
+        m_entries.append(makeEntry(archiveEntry));
+        children.append(child);
+        if (archiveEntry->isDirectory()) {
+            addChildren(child, static_cast<const KArchiveDirectory *>(archiveEntry));
+        }
+    }
+    // not a reference taken before the loop, appending may move the entries
+    m_entries[index].children = std::move(children);
+}
+
+void ArchiveIndex::buildPathHash()
+{
+    m_paths.clear();
+    m_paths.reserve(m_entries.count());
+
+    QList<std::pair<int, QString>> pending{{0, QString()}};
+    while (!pending.isEmpty()) {
+        const auto [index, path] = pending.takeLast();
+        for (int child : m_entries.at(index).children) {
+            const Entry &entry = m_entries.at(child);
+            const QString childPath = path.isEmpty() ? entry.name : path + QLatin1Char('/') + entry.name;
+            // names like "." resolve to their parent, which comes first
+            if (!m_paths.contains(childPath)) {
+                m_paths.insert(childPath, child);
+            }
+            if (entry.isDirectory) {
+                pending.append({child, childPath});
+            }
+        }
+    }
+}
+
+void ArchiveIndex::computeRecursiveSizes()
+{
+    // children come after their directory, so going backwards every directory
+    // is summed up after all of its subdirectories
+    for (qsizetype i = m_entries.count() - 1; i >= 0; --i) {
+        Entry &entry = m_entries[i];
+        if (!entry.isDirectory) {
+            continue;
+        }
+        qint64 size = 0;
+        for (int child : std::as_const(entry.children)) {
+            const Entry &childEntry = m_entries.at(child);
+            size += childEntry.isDirectory ? childEntry.recursiveSize : childEntry.size;
+        }
+        entry.recursiveSize = size;
+    }
+}
+
+int ArchiveIndex::find(const QString &path) const
+{
+    QString name = QDir::cleanPath(path);
+    while (name.startsWith(QLatin1Char('/'))) {
+        name.remove(0, 1);
+    }
+    if (name.isEmpty() || name == QLatin1String(".")) {
+        return 0;
+    }
+    return m_paths.value(name, -1);
+}
+
+QString ArchiveIndex::cacheFile(const QString &directory, const QString &archiveFile, const QString &protocol, qint64 size, qint64 mtime)
+{
+    return CacheDirectory::cacheFile(directory, archiveFile, {QByteArray::number(size), QByteArray::number(mtime), protocol.toUtf8()}, QLatin1String(s_indexSuffix));
+}
+
+std::unique_ptr<ArchiveIndex> ArchiveIndex::load(const QString &cacheFile)
+{
+    QFile file(cacheFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_5);
+
+    quint32 magic;
+    quint32 version;
+    stream >> magic >> version;
+    if (magic != s_indexMagic || version != s_indexVersion) {
+        return nullptr;
+    }
+
+    std::unique_ptr<ArchiveIndex> index(new ArchiveIndex);
+    qint32 count;
+    stream >> count;
+    for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        Entry entry;
+        stream >> entry.name >> entry.user >> entry.group >> entry.symLinkTarget;
+        stream >> entry.size >> entry.position >> entry.mtime >> entry.permissions >> entry.isDirectory >> entry.children;
+        index->m_entries.append(std::move(entry));
+    }
+
+    bool hasCheckpoints = false;
+    stream >> hasCheckpoints;
+    if (hasCheckpoints) {
+        index->m_checkpoints = std::make_shared<GzipIndex>();
+        stream >> *index->m_checkpoints;
+    }
+
+    // children always come after their directory, which also rules out cycles
+    bool valid = stream.status() == QDataStream::Ok && count > 0 && index->m_entries.first().isDirectory;
+    valid = valid && (!index->m_checkpoints || index->m_checkpoints->isValid());
+    for (qint32 i = 0; valid && i < count; ++i) {
+        for (int child : std::as_const(index->m_entries.at(i).children)) {
+            valid = valid && child > i && child < count;
+        }
+    }
+    if (!valid) {
+        qCDebug(KIO_ARCHIVE_LOG) << "removing corrupt index" << cacheFile;
+        file.remove();
+        return nullptr;
+    }
+
+    index->buildPathHash();
+    index->computeRecursiveSizes();
+    index->m_cacheFile = cacheFile;
+    index->m_savedCheckpoints = index->m_checkpoints ? index->m_checkpoints->checkpoints.count() : 0;
+
+    CacheDirectory::markUsed(file);
+    qCDebug(KIO_ARCHIVE_LOG) << "loaded index" << cacheFile << "with" << count << "entries";
+    return index;
+}
+
+void ArchiveIndex::save(const QString &cacheFile, qint64 maximumSize)
+{
+    const QString directory = QFileInfo(cacheFile).absolutePath();
+    QDir().mkpath(directory);
+
+    QSaveFile file(cacheFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCDebug(KIO_ARCHIVE_LOG) << "cannot write index" << cacheFile;
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_5);
+    stream << s_indexMagic << s_indexVersion;
+    stream << qint32(m_entries.count());
+    for (const Entry &entry : m_entries) {
+        stream << entry.name << entry.user << entry.group << entry.symLinkTarget;
+        stream << entry.size << entry.position << entry.mtime << entry.permissions << entry.isDirectory << entry.children;
+    }
+    stream << bool(m_checkpoints);
+    if (m_checkpoints) {
+        stream << *m_checkpoints;
+    }
+
+    if (!file.commit()) {
+        return;
+    }
+    m_cacheFile = cacheFile;
+    m_savedCheckpoints = m_checkpoints ? m_checkpoints->checkpoints.count() : 0;
+
+    const QStringList evicted = CacheDirectory::evict(directory, QLatin1String(s_indexSuffix), maximumSize);
+    for (const QString &fileName : evicted) {
+        qCDebug(KIO_ARCHIVE_LOG) << "evicted" << fileName;
+    }
+}
+
+void ArchiveIndex::saveIfModified(qint64 maximumSize)
+{
+    if (!m_cacheFile.isEmpty() && m_checkpoints && m_checkpoints->checkpoints.count() > m_savedCheckpoints) {
+        qCDebug(KIO_ARCHIVE_LOG) << "storing" << m_checkpoints->checkpoints.count() << "checkpoints in" << m_cacheFile;
+        save(m_cacheFile, maximumSize);
+    }
+}
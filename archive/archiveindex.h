@@ -0,0 +1,132 @@
+/*  This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+#ifndef ARCHIVEINDEX_H
+#define ARCHIVEINDEX_H
+
+#include "gzipseekdevice.h"
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+#include <memory>
+
+class KArchiveDirectory;
+class KArchiveEntry;
+
+/**
+ * The directory tree of an archive, which can be persisted in the user's cache
+ * directory so that listing an archive again, also after the worker was restarted,
+ * does not need to open and parse it. For a compressed tar that means the whole
+ * archive does not need to be decompressed again.
+ *
+ * The index of an archive is stored in a file named after a hash of the archive's
+ * path, size and modification time and of the protocol, so a changed archive simply
+ * misses the cache.
+ *
+ * For a tar compressed with gzip, the index can also hold checkpoints of the
+ * compressed stream, with which the data of an entry is read straight from the
+ * archive file at the entry's position.
+ */
+class ArchiveIndex
+{
+public:
+    struct Entry {
+        QString name;
+        QString user;
+        QString group;
+        QString symLinkTarget;
+        qint64 size = 0; ///< of the data of a file
+        qint64 recursiveSize = 0; ///< of a directory, the sum of the sizes of everything below it; not stored
+        qint64 position = -1; ///< of the data of a file in the archive, as KArchiveFile::position()
+        qint64 mtime = 0; ///< in seconds since the epoch
+        quint32 permissions = 0; ///< file type and permissions, as in st_mode
+        bool isDirectory = false;
+        QList<int> children; ///< of a directory, in KArchiveDirectory::entries() order
+    };
+
+    /**
+     * Builds the index of the parsed archive with the root directory @p root.
+     */
+    explicit ArchiveIndex(const KArchiveDirectory *root);
+
+    /**
+     * Reads the index stored in @p cacheFile, returns nullptr if there is none
+     * or it cannot be read.
+     */
+    static std::unique_ptr<ArchiveIndex> load(const QString &cacheFile);
+
+    /**
+     * Stores the index in @p cacheFile, evicting the least recently used indexes
+     * beyond @p maximumSize from the directory of @p cacheFile.
+     */
+    void save(const QString &cacheFile, qint64 maximumSize);
+
+    /**
+     * Stores the index again in the file it was loaded from or last stored in,
+     * if checkpoints were added since.
+     */
+    void saveIfModified(qint64 maximumSize);
+
+    /**
+     * Returns the file in @p directory to store the index of @p archiveFile in.
+     * @param protocol the protocol the archive is opened with
+     */
+    static QString cacheFile(const QString &directory, const QString &archiveFile, const QString &protocol, qint64 size, qint64 mtime);
+
+    const Entry &root() const
+    {
+        return m_entries.first();
+    }
+
+    const Entry &at(int index) const
+    {
+        return m_entries.at(index);
+    }
+
+    qsizetype count() const
+    {
+        return m_entries.count();
+    }
+
+    /**
+     * The checkpoints of a tar compressed with gzip, or nullptr. They start out
+     * empty and grow while the entries are read with a GzipSeekDevice.
+     */
+    const std::shared_ptr<GzipIndex> &checkpoints() const
+    {
+        return m_checkpoints;
+    }
+
+    void setCheckpoints(const std::shared_ptr<GzipIndex> &checkpoints)
+    {
+        m_checkpoints = checkpoints;
+    }
+
+    /**
+     * Returns the index of the entry at @p path below the root, or -1 if there is
+     * none. The path is resolved like KArchiveDirectory::entry() does, "/" and an
+     * empty path being the root, which has the index 0.
+     */
+    int find(const QString &path) const;
+
+private:
+    ArchiveIndex() = default;
+
+    void addChildren(int index, const KArchiveDirectory *dir);
+    void buildPathHash();
+    void computeRecursiveSizes();
+
+    static Entry makeEntry(const KArchiveEntry *entry);
+
+    QList<Entry> m_entries; ///< the root first, every directory before its children
+    QHash<QString, int> m_paths; ///< not stored, built from m_entries
+    std::shared_ptr<GzipIndex> m_checkpoints; ///< of the uncompressed tar, in which the positions are
+    QString m_cacheFile; ///< the index was loaded from or last stored in, not stored
+    qsizetype m_savedCheckpoints = 0; ///< when the index was loaded or last stored, not stored
+};
+
+#endif // ARCHIVEINDEX_H
@@ -0,0 +1,135 @@
+/*  This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+// Measures how fast kio_archive streams a file out of zip, tar.gz and 7z
+// archives, e.g.
+// archivebenchmark -s 256 -n 5
+
+#include <K7Zip>
+#include <KIO/TransferJob>
+#include <KTar>
+#include <KZip>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QUrl>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+namespace
+{
+struct Format {
+    const char *name;
+    const char *protocol;
+    const char *fileName;
+    std::unique_ptr<KArchive> (*create)(const QString &path);
+};
+
+const Format s_formats[] = {
+    {"zip",
+     "zip",
+     "bench.zip",
+     [](const QString &path) -> std::unique_ptr<KArchive> {
+         return std::make_unique<KZip>(path);
+     }},
+    {"tar.gz",
+     "tar",
+     "bench.tar.gz",
+     [](const QString &path) -> std::unique_ptr<KArchive> {
+         return std::make_unique<KTar>(path, QStringLiteral("application/x-gzip"));
+     }},
+    {"7z",
+     "sevenz",
+     "bench.7z",
+     [](const QString &path) -> std::unique_ptr<KArchive> {
+         return std::make_unique<K7Zip>(path);
+     }},
+};
+
+// Text-like data that compresses about as well as source code or logs
+QByteArray makeData(qint64 size)
+{
+    QRandomGenerator random(42);
+    QByteArray data;
+    data.reserve(size);
+    while (data.size() < size) {
+        data += "line " + QByteArray::number(random.bounded(100000)) + ": the quick brown fox " + QByteArray::number(random.generate(), 16) + '\n';
+    }
+    data.truncate(size);
+    return data;
+}
+
+// Returns the nanoseconds a get() of @p url took, or -1 on error
+qint64 timeGet(const QUrl &url, qint64 expectedSize)
+{
+    qint64 received = 0;
+    KIO::TransferJob *job = KIO::get(url, KIO::NoReload, KIO::HideProgressInfo);
+    QObject::connect(job, &KIO::TransferJob::data, [&received](KIO::Job *, const QByteArray &data) {
+        received += data.size();
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = job->exec();
+    const qint64 elapsed = timer.nsecsElapsed();
+    if (!ok || received != expectedSize) {
+        fprintf(stderr, "get of %s failed: %s\n", qPrintable(url.toDisplayString()), qPrintable(job->errorString()));
+        return -1;
+    }
+    return elapsed;
+}
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    int iterations = 3;
+    qint64 size = 64;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (qstrcmp(argv[i], "-n") == 0) {
+            iterations = std::max(1, atoi(argv[i + 1]));
+        } else if (qstrcmp(argv[i], "-s") == 0) {
+            size = std::max(1, atoi(argv[i + 1]));
+        }
+    }
+    size *= 1024 * 1024;
+
+    QTemporaryDir dir;
+    const QByteArray data = makeData(size);
+    printf("%lld MiB file, best and first of %d runs\n", size / 1024 / 1024, iterations);
+
+    for (const Format &format : s_formats) {
+        const QString path = dir.filePath(QString::fromLatin1(format.fileName));
+        std::unique_ptr<KArchive> archive = format.create(path);
+        if (!archive->open(QIODevice::WriteOnly) || !archive->writeFile(QStringLiteral("data.txt"), data) || !archive->close()) {
+            fprintf(stderr, "cannot write %s\n", qPrintable(path));
+            return 1;
+        }
+
+        QUrl url;
+        url.setScheme(QString::fromLatin1(format.protocol));
+        url.setPath(path + QStringLiteral("/data.txt"));
+
+        qint64 first = -1;
+        qint64 best = -1;
+        for (int i = 0; i < iterations; ++i) {
+            const qint64 elapsed = timeGet(url, size);
+            if (elapsed < 0) {
+                return 1;
+            }
+            first = first < 0 ? elapsed : first;
+            best = best < 0 ? elapsed : std::min(best, elapsed);
+        }
+        printf("%-8s best %8.1f MB/s, first %8.1f MB/s\n", format.name, size / 1e6 / (best / 1e9), size / 1e6 / (first / 1e9));
+    }
+    return 0;
+}
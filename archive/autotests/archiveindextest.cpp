@@ -0,0 +1,224 @@
+/*  This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "archiveindex.h"
+
+#include <KArchiveDirectory>
+#include <KTar>
+
+#include <QBuffer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+class ArchiveIndexTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void testBuild();
+    void testRoundTrip();
+    void testSaveIfModified();
+    void testCorrupt_data();
+    void testCorrupt();
+
+private:
+    std::unique_ptr<ArchiveIndex> saveAndLoad(ArchiveIndex &index);
+    static std::shared_ptr<GzipIndex> checkpoints(int count);
+
+    QTemporaryDir m_dir;
+    QByteArray m_tar;
+    std::unique_ptr<QBuffer> m_buffer;
+    std::unique_ptr<KTar> m_archive;
+    int m_fileCount = 0;
+};
+
+QTEST_GUILESS_MAIN(ArchiveIndexTest)
+
+void ArchiveIndexTest::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+
+    QBuffer buffer(&m_tar);
+    KTar tar(&buffer);
+    QVERIFY(tar.open(QIODevice::WriteOnly));
+    QVERIFY(tar.writeFile("empty", QByteArray(), 0100644, "weis", "users"));
+    QVERIFY(tar.writeFile("test1", QByteArrayLiteral("Hallo"), 0100644, "weis", "users"));
+    QVERIFY(tar.writeFile("mydir/subfile", QByteArrayLiteral("Bonjour"), 0100600, "dfaure", "users"));
+    QVERIFY(tar.writeFile("mydir/deeper/file", QByteArray(1000, 'x'), 0100755, "dfaure", "staff"));
+    QVERIFY(tar.writeSymLink("mydir/symlink", "subfile", "dfaure", "users"));
+    QVERIFY(tar.close());
+
+    m_buffer = std::make_unique<QBuffer>(&m_tar);
+    m_archive = std::make_unique<KTar>(m_buffer.get());
+    QVERIFY(m_archive->open(QIODevice::ReadOnly));
+}
+
+void ArchiveIndexTest::testBuild()
+{
+    const ArchiveIndex index(m_archive->directory());
+
+    QVERIFY(index.root().isDirectory);
+    QCOMPARE(index.find(QStringLiteral("/")), 0);
+    QCOMPARE(index.find(QString()), 0);
+    QCOMPARE(index.find(QStringLiteral("nothere")), -1);
+
+    const int subfile = index.find(QStringLiteral("mydir/subfile"));
+    QVERIFY(subfile > 0);
+    QCOMPARE(index.find(QStringLiteral("/mydir//subfile")), subfile);
+    QCOMPARE(index.find(QStringLiteral("mydir/deeper/../subfile")), subfile);
+    QCOMPARE(index.at(subfile).name, QStringLiteral("subfile"));
+    QCOMPARE(index.at(subfile).size, qint64(7));
+    QCOMPARE(index.at(subfile).user, QStringLiteral("dfaure"));
+    QCOMPARE(index.at(subfile).permissions & 07777, 0600u);
+    // the position of the data in the tar, as KArchiveFile has it
+    QCOMPARE(m_tar.mid(index.at(subfile).position, 7), QByteArrayLiteral("Bonjour"));
+
+    const int symlink = index.find(QStringLiteral("mydir/symlink"));
+    QVERIFY(symlink > 0);
+    QCOMPARE(index.at(symlink).symLinkTarget, QStringLiteral("subfile"));
+
+    const int mydir = index.find(QStringLiteral("mydir"));
+    QVERIFY(index.at(mydir).isDirectory);
+    QCOMPARE(index.at(mydir).children.count(), qsizetype(3));
+    QCOMPARE(index.at(mydir).recursiveSize, qint64(1007));
+    QCOMPARE(index.root().recursiveSize, qint64(1012));
+}
+
+void ArchiveIndexTest::testRoundTrip()
+{
+    ArchiveIndex index(m_archive->directory());
+    index.setCheckpoints(checkpoints(3));
+
+    const std::unique_ptr<ArchiveIndex> loaded = saveAndLoad(index);
+    QVERIFY(loaded);
+    QCOMPARE(loaded->count(), index.count());
+    for (int i = 0; i < index.count(); ++i) {
+        const ArchiveIndex::Entry &expected = index.at(i);
+        const ArchiveIndex::Entry &entry = loaded->at(i);
+        QCOMPARE(entry.name, expected.name);
+        QCOMPARE(entry.user, expected.user);
+        QCOMPARE(entry.group, expected.group);
+        QCOMPARE(entry.symLinkTarget, expected.symLinkTarget);
+        QCOMPARE(entry.size, expected.size);
+        QCOMPARE(entry.recursiveSize, expected.recursiveSize);
+        QCOMPARE(entry.position, expected.position);
+        QCOMPARE(entry.mtime, expected.mtime);
+        QCOMPARE(entry.permissions, expected.permissions);
+        QCOMPARE(entry.isDirectory, expected.isDirectory);
+        QCOMPARE(entry.children, expected.children);
+    }
+    QCOMPARE(loaded->find(QStringLiteral("mydir/deeper/file")), index.find(QStringLiteral("mydir/deeper/file")));
+
+    QVERIFY(loaded->checkpoints());
+    const GzipIndex &expected = *index.checkpoints();
+    const GzipIndex &stored = *loaded->checkpoints();
+    QCOMPARE(stored.span, expected.span);
+    QCOMPARE(stored.indexed, expected.indexed);
+    QCOMPARE(stored.size, expected.size);
+    QCOMPARE(stored.checkpoints.count(), expected.checkpoints.count());
+    for (int i = 0; i < expected.checkpoints.count(); ++i) {
+        QCOMPARE(stored.checkpoints.at(i).output, expected.checkpoints.at(i).output);
+        QCOMPARE(stored.checkpoints.at(i).input, expected.checkpoints.at(i).input);
+        QCOMPARE(stored.checkpoints.at(i).bits, expected.checkpoints.at(i).bits);
+        QCOMPARE(stored.checkpoints.at(i).window, expected.checkpoints.at(i).window);
+    }
+
+    // without checkpoints, as for any archive but a compressed tar
+    ArchiveIndex plain(m_archive->directory());
+    const std::unique_ptr<ArchiveIndex> loadedPlain = saveAndLoad(plain);
+    QVERIFY(loadedPlain);
+    QVERIFY(!loadedPlain->checkpoints());
+}
+
+void ArchiveIndexTest::testSaveIfModified()
+{
+    ArchiveIndex index(m_archive->directory());
+    index.setCheckpoints(checkpoints(1));
+    const QString cacheFile = m_dir.filePath(QStringLiteral("modified.index"));
+    index.save(cacheFile, 1024 * 1024);
+
+    std::unique_ptr<ArchiveIndex> loaded = ArchiveIndex::load(cacheFile);
+    QVERIFY(loaded);
+    QVERIFY(QFile::remove(cacheFile));
+    // nothing to store while the checkpoints did not grow
+    loaded->saveIfModified(1024 * 1024);
+    QVERIFY(!QFile::exists(cacheFile));
+
+    GzipIndex &grown = *loaded->checkpoints();
+    grown.checkpoints.append(checkpoints(2)->checkpoints.last());
+    grown.indexed = grown.checkpoints.last().output;
+    loaded->saveIfModified(1024 * 1024);
+    QVERIFY(QFile::exists(cacheFile));
+    const std::unique_ptr<ArchiveIndex> reloaded = ArchiveIndex::load(cacheFile);
+    QVERIFY(reloaded);
+    QCOMPARE(reloaded->checkpoints()->checkpoints.count(), qsizetype(2));
+}
+
+void ArchiveIndexTest::testCorrupt_data()
+{
+    QTest::addColumn<int>("size"); // to cut the stored index to, -2 for cutting off its end, -1 for not cutting
+    QTest::addColumn<bool>("badCheckpoints");
+
+    QTest::newRow("cut in the entries") << 100 << false;
+    QTest::newRow("cut in the checkpoints") << -2 << false;
+    QTest::newRow("checkpoints out of order") << -1 << true;
+}
+
+void ArchiveIndexTest::testCorrupt()
+{
+    QFETCH(int, size);
+    QFETCH(bool, badCheckpoints);
+
+    ArchiveIndex index(m_archive->directory());
+    std::shared_ptr<GzipIndex> gzipIndex = checkpoints(3);
+    if (badCheckpoints) {
+        std::swap(gzipIndex->checkpoints[0], gzipIndex->checkpoints[2]);
+    }
+    index.setCheckpoints(gzipIndex);
+
+    const QString cacheFile = m_dir.filePath(QStringLiteral("corrupt.index"));
+    index.save(cacheFile, 1024 * 1024);
+    QFile file(cacheFile);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    if (size == -2) {
+        // within the window of the last checkpoint
+        QVERIFY(file.resize(file.size() - 10));
+    } else if (size >= 0) {
+        QVERIFY(file.resize(size));
+    }
+    file.close();
+
+    // a corrupt index is not used, and removed so it does not come up again
+    QVERIFY(!ArchiveIndex::load(cacheFile));
+    QVERIFY(!QFile::exists(cacheFile));
+}
+
+std::unique_ptr<ArchiveIndex> ArchiveIndexTest::saveAndLoad(ArchiveIndex &index)
+{
+    const QString cacheFile = m_dir.filePath(QStringLiteral("file%1.index").arg(++m_fileCount));
+    index.save(cacheFile, 1024 * 1024);
+    return ArchiveIndex::load(cacheFile);
+}
+
+std::shared_ptr<GzipIndex> ArchiveIndexTest::checkpoints(int count)
+{
+    auto index = std::make_shared<GzipIndex>();
+    index->span = 1000;
+    for (int i = 0; i < count; ++i) {
+        GzipCheckpoint checkpoint;
+        checkpoint.output = 1000 * (i + 1);
+        checkpoint.input = 300 * (i + 1);
+        checkpoint.bits = i % 8;
+        checkpoint.window = qCompress(QByteArray(32768, char('a' + i)));
+        index->checkpoints.append(checkpoint);
+    }
+    index->indexed = 1000 * count + 500;
+    return index;
+}
+
+#include "archiveindextest.moc"
@@ -8,13 +8,17 @@
 
 #include <KIO/CopyJob>
 #include <KIO/DeleteJob>
+#include <KIO/FileJob>
 #include <KIO/ListJob>
+#include <KIO/SimpleJob>
 #include <KIO/StatJob>
 #include <KTar>
 
+#include <QDataStream>
 #include <QDebug>
 #include <QDir>
 #include <QFileInfo>
+#include <QSignalSpy>
 #include <QStandardPaths>
 #include <QTest>
 
@@ -136,6 +140,17 @@ void TestKioArchive::copyFromTar(const QUrl &src, const QString &destPath)
     QVERIFY(QFile::exists(destPath));
 }
 
+void TestKioArchive::testStatRecursiveSize()
+{
+    QUrl u = tarUrl();
+    u = u.adjusted(QUrl::StripTrailingSlash);
+    u.setPath(u.path() + '/' + "mydir");
+
+    KIO::StatJob *job = KIO::stat(u, KIO::StatJob::SourceSide, KIO::StatDefaultDetails | KIO::StatRecursiveSize, KIO::HideProgressInfo);
+    QVERIFY(job->exec());
+    QCOMPARE(job->statResult().numberValue(KIO::UDSEntry::UDS_RECURSIVE_SIZE, -1), 7LL); // subfile, the symlink has no data
+}
+
 void TestKioArchive::testExtractFileFromTar()
 {
     const QString destPath = tmpDir() + "fileFromTar_copied";
@@ -165,4 +180,50 @@ void TestKioArchive::testExtractSymlinkFromTar()
     QVERIFY(QFileInfo(destPath).isSymLink());
 }
 
+void TestKioArchive::testReadSeekFromTar()
+{
+    QUrl u = tarUrl();
+    u = u.adjusted(QUrl::StripTrailingSlash);
+    u.setPath(u.path() + '/' + "mydir/subfile");
+
+    KIO::FileJob *job = KIO::open(u, QIODevice::ReadOnly);
+    QSignalSpy openSpy(job, &KIO::FileJob::open);
+    QVERIFY(openSpy.wait());
+    QCOMPARE(job->size(), 7);
+
+    QSignalSpy positionSpy(job, &KIO::FileJob::position);
+    job->seek(3);
+    QVERIFY(positionSpy.wait());
+    QCOMPARE(positionSpy.first().at(1).value<KIO::filesize_t>(), 3);
+
+    QSignalSpy dataSpy(job, &KIO::FileJob::data);
+    job->read(4);
+    QVERIFY(dataSpy.wait());
+    QCOMPARE(dataSpy.first().at(1).toByteArray(), QByteArrayLiteral("jour"));
+
+    QSignalSpy closedSpy(job, &KIO::FileJob::fileClosed);
+    job->close();
+    QVERIFY(closedSpy.wait());
+}
+
+void TestKioArchive::testExtractDirFromTar()
+{
+    const QString destPath = tmpDir() + "dirFromTar_extracted";
+    QUrl u = tarUrl();
+    u = u.adjusted(QUrl::StripTrailingSlash);
+    u.setPath(u.path() + '/' + "mydir");
+
+    QByteArray packedArgs;
+    QDataStream stream(&packedArgs, QIODevice::WriteOnly);
+    stream << int(1); // Extract
+    stream << u << destPath;
+    KIO::SimpleJob *job = KIO::special(tarUrl(), packedArgs, KIO::HideProgressInfo);
+    QVERIFY(job->exec());
+
+    QFile subfile(destPath + "/subfile");
+    QVERIFY(subfile.open(QIODevice::ReadOnly));
+    QCOMPARE(subfile.readAll(), QByteArrayLiteral("Bonjour"));
+    QCOMPARE(QFileInfo(destPath + "/symlink").symLinkTarget(), QFileInfo(subfile).absoluteFilePath());
+}
+
 #include "moc_testkioarchive.cpp"
@@ -30,8 +30,11 @@ private Q_SLOTS:
     void initTestCase();
     void testListTar();
     void testListRecursive();
+    void testStatRecursiveSize();
     void testExtractFileFromTar();
     void testExtractSymlinkFromTar();
+    void testReadSeekFromTar();
+    void testExtractDirFromTar();
     void cleanupTestCase();
 
 protected Q_SLOTS: // real slots, not tests
@@ -5,6 +5,7 @@
 */
 
 #include "kio_archivebase.h"
+#include "archiveindex.h"
 #include <kio_archive_debug.h>
 
 #include <errno.h>
@@ -19,13 +20,22 @@
 #include <KUser>
 #include <KZip>
 
+#include <QDataStream>
+#include <QDateTime>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QMimeDatabase>
 #include <QMimeType>
+#include <QMutex>
+#include <QStandardPaths>
+#include <QThread>
 #include <QUrl>
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
+#include <vector>
 
 #ifdef Q_OS_WIN
 #define S_ISDIR(m) (((m & S_IFMT) == S_IFDIR))
@@ -33,16 +43,62 @@
 
 using namespace KIO;
 
+// Archives that take less time to open than this are not worth an index on disk
+static const qint64 s_minIndexedOpenTime = 50; // ms
+static const qint64 s_maxIndexCacheSize = 64 * 1024 * 1024;
+// Distance between the checkpoints of a compressed tar, which bounds the
+// decompression needed to reach an offset in it
+static const qint64 s_checkpointSpan = 8 * 1024 * 1024;
+// Bounds for the archives kept open besides the current one: their file
+// descriptors, and their entries for the memory of their directory trees
+static const size_t s_maxRecentArchives = 3;
+static const qsizetype s_maxRecentEntries = 200000;
+// Bulk extraction
+static const int s_maxExtractThreads = 8;
+static const qint64 s_extractBufferSize = 256 * 1024;
+static const unsigned long s_progressInterval = 200; // ms
+
+struct RecentArchive {
+    std::unique_ptr<KArchive> archive; ///< nullptr if only the index was loaded
+    std::unique_ptr<ArchiveIndex> index;
+    QString name;
+    QString protocol;
+    time_t mtime;
+};
+
+class ArchiveProtocolBasePrivate
+{
+public:
+    KArchive *archiveFile = nullptr;
+    std::unique_ptr<ArchiveIndex> index; ///< set whenever m_archiveName is
+    QString archiveProtocol;
+    std::unique_ptr<QIODevice> openDevice; ///< of the file opened with open()
+    std::vector<std::unique_ptr<RecentArchive>> recentArchives; ///< most recently used first, without the current archive
+};
+
 ArchiveProtocolBase::ArchiveProtocolBase(const QByteArray &proto, const QByteArray &pool, const QByteArray &app)
     : WorkerBase(proto, pool, app)
+    , d(std::make_unique<ArchiveProtocolBasePrivate>())
 {
     qCDebug(KIO_ARCHIVE_LOG);
-    m_archiveFile = nullptr;
 }
 
 ArchiveProtocolBase::~ArchiveProtocolBase()
 {
-    delete m_archiveFile;
+    d->openDevice.reset();
+    delete d->archiveFile;
+}
+
+// The result for an error of checkNewFile() or createEntryDevice()
+static KIO::WorkerResult archiveError(KIO::Error errorNum, const QUrl &url)
+{
+    if (errorNum == KIO::ERR_CANNOT_OPEN_FOR_READING) {
+        // If we cannot open, it might be a problem with the archive header (e.g. unsupported format)
+        // Therefore give a more specific error message
+        return KIO::WorkerResult::fail(KIO::ERR_WORKER_DEFINED,
+                                       i18n("Could not open the file, probably due to an unsupported file format.\n%1", url.toDisplayString()));
+    }
+    return KIO::WorkerResult::fail(errorNum, url.toDisplayString());
 }
 
 bool ArchiveProtocolBase::checkNewFile(const QUrl &url, QString &path, KIO::Error &errorNum)
@@ -55,7 +111,7 @@ bool ArchiveProtocolBase::checkNewFile(const QUrl &url, QString &path, KIO::Erro
     qCDebug(KIO_ARCHIVE_LOG) << fullPath;
 
     // Are we already looking at that file ?
-    if (m_archiveFile && m_archiveName == fullPath.left(m_archiveName.length())) {
+    if (d->index && m_archiveName == fullPath.left(m_archiveName.length())) {
         // Has it changed ?
         QT_STATBUF statbuf;
         if (QT_STAT(QFile::encodeName(m_archiveName).constData(), &statbuf) == 0) {
@@ -68,12 +124,8 @@ bool ArchiveProtocolBase::checkNewFile(const QUrl &url, QString &path, KIO::Erro
     }
     qCDebug(KIO_ARCHIVE_LOG) << "Need to open a new file";
 
-    // Close previous file
-    if (m_archiveFile) {
-        m_archiveFile->close();
-        delete m_archiveFile;
-        m_archiveFile = nullptr;
-    }
+    // Keep the previous file open, we may come back to it
+    keepRecentArchive();
 
     // Find where the tar file is in the full path
     int pos = 0;
@@ -86,6 +138,7 @@ bool ArchiveProtocolBase::checkNewFile(const QUrl &url, QString &path, KIO::Erro
     qCDebug(KIO_ARCHIVE_LOG) << "the full path is" << fullPath;
     QT_STATBUF statbuf;
     statbuf.st_mode = 0; // be sure to clear the directory bit
+    qint64 archiveSize = 0;
     while ((pos = fullPath.indexOf(QLatin1Char('/'), pos + 1)) != -1) {
         QString tryPath = fullPath.left(pos);
         qCDebug(KIO_ARCHIVE_LOG) << fullPath << "trying" << tryPath;
@@ -107,6 +160,7 @@ bool ArchiveProtocolBase::checkNewFile(const QUrl &url, QString &path, KIO::Erro
 
         if (!S_ISDIR(statbuf.st_mode)) {
             archiveFile = tryPath;
+            archiveSize = statbuf.st_size;
             m_mtime = statbuf.st_mtime;
 #ifdef Q_OS_WIN // st_uid and st_gid provides no information
             m_user.clear();
@@ -140,43 +194,162 @@ bool ArchiveProtocolBase::checkNewFile(const QUrl &url, QString &path, KIO::Erro
         return false;
     }
 
+    if (restoreRecentArchive(archiveFile, url.scheme())) {
+        qCDebug(KIO_ARCHIVE_LOG) << "Using recently used" << archiveFile;
+        return true;
+    }
+
+    m_archiveName = archiveFile;
+    d->archiveProtocol = url.scheme();
+
+    // Listing the archive only needs its index, if it was stored before
+    const QString indexFile = ArchiveIndex::cacheFile(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1String("/index"),
+                                                      archiveFile,
+                                                      d->archiveProtocol,
+                                                      archiveSize,
+                                                      m_mtime);
+    d->index = ArchiveIndex::load(indexFile);
+    if (d->index) {
+        return true;
+    }
+
     // Open new file
-    m_archiveFile = this->createArchive(url.scheme(), archiveFile);
-    if (!m_archiveFile) {
-        qCWarning(KIO_ARCHIVE_LOG) << "Protocol" << url.scheme() << "not supported by this IOWorker";
+    QElapsedTimer timer;
+    timer.start();
+    if (!openArchive(errorNum)) {
+        closeArchive();
+        return false;
+    }
+
+    d->index = std::make_unique<ArchiveIndex>(d->archiveFile->directory());
+    if (timer.elapsed() >= s_minIndexedOpenTime) {
+        // KTar decompresses the whole archive on every open, checkpoints save that
+        // for reading entries once the index is stored. They are recorded while
+        // entries are read from the stored index, as the archive is open for now.
+        if (d->archiveProtocol == QLatin1String("tar") && GzipSeekDevice::isGzip(archiveFile)) {
+            auto checkpoints = std::make_shared<GzipIndex>();
+            checkpoints->span = s_checkpointSpan;
+            d->index->setCheckpoints(checkpoints);
+        }
+        d->index->save(indexFile, s_maxIndexCacheSize);
+    }
+    return true;
+}
+
+bool ArchiveProtocolBase::openArchive(KIO::Error &errorNum)
+{
+    if (d->archiveFile) {
+        return true;
+    }
+
+    d->archiveFile = this->createArchive(d->archiveProtocol, m_archiveName);
+    if (!d->archiveFile) {
+        qCWarning(KIO_ARCHIVE_LOG) << "Protocol" << d->archiveProtocol << "not supported by this IOWorker";
         errorNum = KIO::ERR_UNSUPPORTED_PROTOCOL;
         return false;
     }
 
-    if (!m_archiveFile->open(QIODevice::ReadOnly)) {
-        qCDebug(KIO_ARCHIVE_LOG) << "Opening" << archiveFile << "failed.";
-        delete m_archiveFile;
-        m_archiveFile = nullptr;
+    if (!d->archiveFile->open(QIODevice::ReadOnly)) {
+        qCDebug(KIO_ARCHIVE_LOG) << "Opening" << m_archiveName << "failed.";
+        delete d->archiveFile;
+        d->archiveFile = nullptr;
         errorNum = KIO::ERR_CANNOT_OPEN_FOR_READING;
         return false;
     }
-
-    m_archiveName = archiveFile;
     return true;
 }
 
-uint ArchiveProtocolBase::computeArchiveDirSize(const KArchiveDirectory *dir)
+void ArchiveProtocolBase::closeArchive()
+{
+    if (d->archiveFile) {
+        d->archiveFile->close();
+        delete d->archiveFile;
+        d->archiveFile = nullptr;
+    }
+    d->index.reset();
+    m_archiveName.clear();
+}
+
+void ArchiveProtocolBase::keepRecentArchive()
 {
-    // compute size of archive content
-    uint totalSize = 0;
-    const auto entries = dir->entries();
-    for (const auto &entryName : entries) {
-        auto entry = dir->entry(entryName);
-        if (entry->isFile()) {
-            auto fileEntry = static_cast<const KArchiveFile *>(entry);
-            totalSize += fileEntry->size();
-        } else if (entry->isDirectory()) {
-            const auto dirEntry = static_cast<const KArchiveDirectory *>(entry);
-            // recurse
-            totalSize += computeArchiveDirSize(dirEntry);
+    if (!d->index) {
+        return;
+    }
+
+    auto recent = std::make_unique<RecentArchive>();
+    recent->archive.reset(d->archiveFile);
+    d->archiveFile = nullptr;
+    recent->index = std::move(d->index);
+    recent->name = m_archiveName;
+    recent->protocol = d->archiveProtocol;
+    recent->mtime = m_mtime;
+    m_archiveName.clear();
+    d->recentArchives.insert(d->recentArchives.begin(), std::move(recent));
+
+    // Close the least recently used archives beyond the bounds
+    qsizetype entries = 0;
+    for (size_t i = 0; i < d->recentArchives.size(); ++i) {
+        entries += d->recentArchives[i]->index->count();
+        if (i >= s_maxRecentArchives || (i > 0 && entries > s_maxRecentEntries)) {
+            qCDebug(KIO_ARCHIVE_LOG) << "Closing" << d->recentArchives[i]->name;
+            d->recentArchives.resize(i);
+            break;
         }
     }
-    return totalSize;
+}
+
+bool ArchiveProtocolBase::restoreRecentArchive(const QString &archiveFile, const QString &protocol)
+{
+    const auto it = std::find_if(d->recentArchives.begin(), d->recentArchives.end(), [&](const std::unique_ptr<RecentArchive> &recent) {
+        return recent->name == archiveFile && recent->protocol == protocol;
+    });
+    if (it == d->recentArchives.end()) {
+        return false;
+    }
+
+    std::unique_ptr<RecentArchive> recent = std::move(*it);
+    d->recentArchives.erase(it);
+    // Has it changed ? m_mtime is the one checkNewFile() just found
+    if (recent->mtime != m_mtime) {
+        return false;
+    }
+
+    d->archiveFile = recent->archive.release();
+    d->index = std::move(recent->index);
+    m_archiveName = recent->name;
+    d->archiveProtocol = recent->protocol;
+    return true;
+}
+
+std::unique_ptr<QIODevice> ArchiveProtocolBase::createEntryDevice(int entryIndex, const QString &path, KIO::Error &errorNum)
+{
+    const ArchiveIndex::Entry &entry = d->index->at(entryIndex);
+    // An open archive reads its entries without decompressing anything again
+    if (!d->archiveFile && d->index->checkpoints() && entry.position >= 0) {
+        return std::make_unique<GzipSeekDevice>(m_archiveName, d->index->checkpoints(), entry.position, entry.size);
+    }
+
+    // The data needs the archive itself, not only its index
+    if (!openArchive(errorNum)) {
+        return nullptr;
+    }
+    const KArchiveEntry *archiveEntry = d->archiveFile->directory()->entry(path);
+    if (!archiveEntry || !archiveEntry->isFile()) {
+        errorNum = KIO::ERR_DOES_NOT_EXIST;
+        return nullptr;
+    }
+
+    /*
+     * The easy way would be to get the data by calling KArchiveFile::data()
+     * However this has drawbacks:
+     * - the complete file must be read into the memory
+     * - errors are skipped, resulting in an empty file
+     */
+    std::unique_ptr<QIODevice> io(static_cast<const KArchiveFile *>(archiveEntry)->createDevice());
+    if (!io) {
+        errorNum = KIO::ERR_CANNOT_OPEN_FOR_READING;
+    }
+    return io;
 }
 
 KIO::StatDetails ArchiveProtocolBase::getStatDetails()
@@ -194,7 +367,7 @@ void ArchiveProtocolBase::createRootUDSEntry(KIO::UDSEntry &entry)
     entry.clear();
     entry.reserve(7);
 
-    auto path = m_archiveFile->fileName();
+    auto path = m_archiveName;
     path = path.mid(path.lastIndexOf(QLatin1Char('/')) + 1);
 
     entry.fastInsert(KIO::UDSEntry::UDS_NAME, QStringLiteral("."));
@@ -206,27 +379,28 @@ void ArchiveProtocolBase::createRootUDSEntry(KIO::UDSEntry &entry)
     entry.fastInsert(KIO::UDSEntry::UDS_GROUP, m_group);
 
     QMimeDatabase db;
-    QMimeType mt = db.mimeTypeForFile(m_archiveFile->fileName());
+    QMimeType mt = db.mimeTypeForFile(m_archiveName);
     if (mt.isValid()) {
         entry.fastInsert(KIO::UDSEntry::UDS_MIME_TYPE, mt.name());
     }
 }
 
-void ArchiveProtocolBase::createUDSEntry(const KArchiveEntry *archiveEntry, UDSEntry &entry)
+void ArchiveProtocolBase::createUDSEntry(int entryIndex, UDSEntry &entry)
 {
+    const ArchiveIndex::Entry &archiveEntry = d->index->at(entryIndex);
     entry.clear();
 
     entry.reserve(8);
-    entry.fastInsert(KIO::UDSEntry::UDS_NAME, archiveEntry->name());
-    entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, archiveEntry->isFile() ? archiveEntry->permissions() & S_IFMT : S_IFDIR); // keep file type only
-    if (archiveEntry->isFile()) {
-        entry.fastInsert(KIO::UDSEntry::UDS_SIZE, ((KArchiveFile *)archiveEntry)->size());
-    }
-    entry.fastInsert(KIO::UDSEntry::UDS_MODIFICATION_TIME, archiveEntry->date().toSecsSinceEpoch());
-    entry.fastInsert(KIO::UDSEntry::UDS_ACCESS, archiveEntry->permissions() & 07777); // keep permissions only
-    entry.fastInsert(KIO::UDSEntry::UDS_USER, archiveEntry->user());
-    entry.fastInsert(KIO::UDSEntry::UDS_GROUP, archiveEntry->group());
-    entry.fastInsert(KIO::UDSEntry::UDS_LINK_DEST, archiveEntry->symLinkTarget());
+    entry.fastInsert(KIO::UDSEntry::UDS_NAME, archiveEntry.name);
+    entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, !archiveEntry.isDirectory ? archiveEntry.permissions & S_IFMT : S_IFDIR); // keep file type only
+    if (!archiveEntry.isDirectory) {
+        entry.fastInsert(KIO::UDSEntry::UDS_SIZE, archiveEntry.size);
+    }
+    entry.fastInsert(KIO::UDSEntry::UDS_MODIFICATION_TIME, archiveEntry.mtime);
+    entry.fastInsert(KIO::UDSEntry::UDS_ACCESS, archiveEntry.permissions & 07777); // keep permissions only
+    entry.fastInsert(KIO::UDSEntry::UDS_USER, archiveEntry.user);
+    entry.fastInsert(KIO::UDSEntry::UDS_GROUP, archiveEntry.group);
+    entry.fastInsert(KIO::UDSEntry::UDS_LINK_DEST, archiveEntry.symLinkTarget);
 }
 
 KIO::WorkerResult ArchiveProtocolBase::listDir(const QUrl &url)
@@ -249,9 +423,9 @@ KIO::WorkerResult ArchiveProtocolBase::listDir(const QUrl &url)
         QUrl redir = QUrl::fromLocalFile(url.path());
         qCDebug(KIO_ARCHIVE_LOG) << "Ok, redirection to" << redir.url();
         redirection(redir);
-        // And let go of the tar file - for people who want to unmount a cdrom after that
-        delete m_archiveFile;
-        m_archiveFile = nullptr;
+        // And let go of the tar files - for people who want to unmount a cdrom after that
+        closeArchive();
+        d->recentArchives.clear();
         return KIO::WorkerResult::pass();
     }
 
@@ -266,37 +440,33 @@ KIO::WorkerResult ArchiveProtocolBase::listDir(const QUrl &url)
     }
 
     qCDebug(KIO_ARCHIVE_LOG) << "checkNewFile done";
-    const KArchiveDirectory *root = m_archiveFile->directory();
-    const KArchiveDirectory *dir;
+    int dir = 0;
     if (!path.isEmpty() && path != QLatin1String("/")) {
         qCDebug(KIO_ARCHIVE_LOG) << "Looking for entry" << path;
-        const KArchiveEntry *e = root->entry(path);
-        if (!e) {
+        dir = d->index->find(path);
+        if (dir < 0) {
             return KIO::WorkerResult::fail(KIO::ERR_DOES_NOT_EXIST, url.toDisplayString());
         }
-        if (!e->isDirectory()) {
+        if (!d->index->at(dir).isDirectory) {
             return KIO::WorkerResult::fail(KIO::ERR_IS_FILE, url.toDisplayString());
         }
-        dir = (KArchiveDirectory *)e;
-    } else {
-        dir = root;
     }
 
-    const QStringList l = dir->entries();
+    const QList<int> &l = d->index->at(dir).children;
     totalSize(l.count());
 
     UDSEntry entry;
-    if (!l.contains(QLatin1String("."))) {
+    const bool hasDot = std::any_of(l.begin(), l.end(), [this](int child) {
+        return d->index->at(child).name == QLatin1String(".");
+    });
+    if (!hasDot) {
         createRootUDSEntry(entry);
         listEntry(entry);
     }
 
-    QStringList::const_iterator it = l.begin();
-    for (; it != l.end(); ++it) {
-        qCDebug(KIO_ARCHIVE_LOG) << (*it);
-        const KArchiveEntry *archiveEntry = dir->entry((*it));
-
-        createUDSEntry(archiveEntry, entry);
+    for (int child : l) {
+        qCDebug(KIO_ARCHIVE_LOG) << d->index->at(child).name;
+        createUDSEntry(child, entry);
 
         listEntry(entry);
     }
@@ -343,35 +513,30 @@ KIO::WorkerResult ArchiveProtocolBase::stat(const QUrl &url)
 
         statEntry(entry);
 
-        // And let go of the tar file - for people who want to unmount a cdrom after that
-        delete m_archiveFile;
-        m_archiveFile = nullptr;
+        // And let go of the tar files - for people who want to unmount a cdrom after that
+        closeArchive();
+        d->recentArchives.clear();
         return KIO::WorkerResult::pass();
     }
 
-    const KArchiveDirectory *root = m_archiveFile->directory();
-    const KArchiveEntry *archiveEntry;
     if (path.isEmpty()) {
         path = QStringLiteral("/");
-        archiveEntry = root;
-    } else {
-        archiveEntry = root->entry(path);
     }
-    if (!archiveEntry) {
+    const int archiveEntry = d->index->find(path);
+    if (archiveEntry < 0) {
         return KIO::WorkerResult::fail(KIO::ERR_DOES_NOT_EXIST, url.toDisplayString());
     }
 
-    if (archiveEntry == root) {
+    if (archiveEntry == 0) {
         createRootUDSEntry(entry);
     } else {
         createUDSEntry(archiveEntry, entry);
     }
 
-    if (archiveEntry->isDirectory()) {
+    if (d->index->at(archiveEntry).isDirectory) {
         auto details = getStatDetails();
         if (details & KIO::StatRecursiveSize) {
-            const auto directoryEntry = static_cast<const KArchiveDirectory *>(archiveEntry);
-            entry.fastInsert(KIO::UDSEntry::UDS_RECURSIVE_SIZE, static_cast<long long>(computeArchiveDirSize(directoryEntry)));
+            entry.fastInsert(KIO::UDSEntry::UDS_RECURSIVE_SIZE, static_cast<long long>(d->index->at(archiveEntry).recursiveSize));
         }
     }
     statEntry(entry);
@@ -386,29 +551,19 @@ KIO::WorkerResult ArchiveProtocolBase::get(const QUrl &url)
     QString path;
     KIO::Error errorNum;
     if (!checkNewFile(url, path, errorNum)) {
-        if (errorNum == KIO::ERR_CANNOT_OPEN_FOR_READING) {
-            // If we cannot open, it might be a problem with the archive header (e.g. unsupported format)
-            // Therefore give a more specific error message
-            return KIO::WorkerResult::fail(KIO::ERR_WORKER_DEFINED,
-                                           i18n("Could not open the file, probably due to an unsupported file format.\n%1", url.toDisplayString()));
-        } else {
-            // We have any other error
-            return KIO::WorkerResult::fail(errorNum, url.toDisplayString());
-        }
+        return archiveError(errorNum, url);
     }
 
-    const KArchiveDirectory *root = m_archiveFile->directory();
-    const KArchiveEntry *archiveEntry = root->entry(path);
-
-    if (!archiveEntry) {
+    const int entryIndex = d->index->find(path);
+    if (entryIndex < 0) {
         return KIO::WorkerResult::fail(KIO::ERR_DOES_NOT_EXIST, url.toDisplayString());
     }
-    if (archiveEntry->isDirectory()) {
+    const ArchiveIndex::Entry &archiveEntry = d->index->at(entryIndex);
+    if (archiveEntry.isDirectory) {
         return KIO::WorkerResult::fail(KIO::ERR_IS_DIRECTORY, url.toDisplayString());
     }
-    const KArchiveFile *archiveFileEntry = static_cast<const KArchiveFile *>(archiveEntry);
-    if (!archiveEntry->symLinkTarget().isEmpty()) {
-        const QString target = archiveEntry->symLinkTarget();
+    if (!archiveEntry.symLinkTarget.isEmpty()) {
+        const QString target = archiveEntry.symLinkTarget;
         qCDebug(KIO_ARCHIVE_LOG) << "Redirection to" << target;
         const QUrl realURL = url.resolved(QUrl(target));
         qCDebug(KIO_ARCHIVE_LOG) << "realURL=" << realURL;
@@ -418,74 +573,391 @@ KIO::WorkerResult ArchiveProtocolBase::get(const QUrl &url)
 
     // qCDebug(KIO_ARCHIVE_LOG) << "Preparing to get the archive data";
 
-    /*
-     * The easy way would be to get the data by calling archiveFileEntry->data()
-     * However this has drawbacks:
-     * - the complete file must be read into the memory
-     * - errors are skipped, resulting in an empty file
-     */
-
-    std::unique_ptr<QIODevice> io(archiveFileEntry->createDevice());
-
+    std::unique_ptr<QIODevice> io = createEntryDevice(entryIndex, path, errorNum);
     if (!io) {
-        return KIO::WorkerResult::fail(KIO::ERR_WORKER_DEFINED,
-                                       i18n("The archive file could not be opened, perhaps because the format is unsupported.\n%1", url.toDisplayString()));
+        return archiveError(errorNum, url);
     }
 
     if (!io->open(QIODevice::ReadOnly)) {
         return KIO::WorkerResult::fail(KIO::ERR_CANNOT_OPEN_FOR_READING, url.toDisplayString());
     }
 
-    totalSize(archiveFileEntry->size());
+    totalSize(archiveEntry.size);
 
     // Size of a QIODevice read. It must be large enough so that the mime type check will not fail
     const qint64 maxSize = 0x100000; // 1MB
 
-    qint64 bufferSize = qMin(maxSize, archiveFileEntry->size());
-    QByteArray buffer;
-    buffer.resize(bufferSize);
+    // One buffer for all reads, data() only gets a view of what was read into it
+    const qint64 bufferSize = qMin(maxSize, archiveEntry.size);
+    QByteArray buffer(bufferSize, Qt::Uninitialized);
     if (buffer.isEmpty() && bufferSize > 0) {
         // Something went wrong
         return KIO::WorkerResult::fail(KIO::ERR_OUT_OF_MEMORY, url.toDisplayString());
     }
 
-    bool firstRead = true;
+    // The job may know the mimetype already, e.g. when copying
+    bool sniffMimeType = metaData(QStringLiteral("no-auto-mimetype")) != QLatin1String("true");
 
     // How much file do we still have to process?
-    qint64 fileSize = archiveFileEntry->size();
+    qint64 fileSize = archiveEntry.size;
     KIO::filesize_t processed = 0;
 
     while (!io->atEnd() && fileSize > 0) {
-        if (!firstRead) {
-            bufferSize = qMin(maxSize, fileSize);
-            buffer.resize(bufferSize);
-        }
-        const qint64 read = io->read(buffer.data(), buffer.size()); // Avoid to use bufferSize here, in case something went wrong.
-        if (read != bufferSize) {
-            qCWarning(KIO_ARCHIVE_LOG) << "Read" << read << "bytes but expected" << bufferSize;
+        const qint64 toRead = qMin(bufferSize, fileSize);
+        const qint64 read = io->read(buffer.data(), toRead);
+        if (read != toRead) {
+            qCWarning(KIO_ARCHIVE_LOG) << "Read" << read << "bytes but expected" << toRead;
             return KIO::WorkerResult::fail(KIO::ERR_CANNOT_READ, url.toDisplayString());
         }
-        if (firstRead) {
+        const QByteArray chunk = QByteArray::fromRawData(buffer.constData(), read);
+        if (sniffMimeType) {
             // We use the magic one the first data read
             // (As magic detection is about fixed positions, we can be sure that it is enough data.)
             QMimeDatabase db;
-            QMimeType mime = db.mimeTypeForFileNameAndData(path, buffer);
+            QMimeType mime = db.mimeTypeForFileNameAndData(path, chunk);
             qCDebug(KIO_ARCHIVE_LOG) << "Emitting mimetype" << mime.name();
             mimeType(mime.name());
-            firstRead = false;
+            sniffMimeType = false;
         }
-        data(buffer);
+        data(chunk);
         processed += read;
         processedSize(processed);
-        fileSize -= bufferSize;
+        fileSize -= read;
     }
     io->close();
+    d->index->saveIfModified(s_maxIndexCacheSize);
 
     data(QByteArray());
 
     return KIO::WorkerResult::pass();
 }
 
+KIO::WorkerResult ArchiveProtocolBase::open(const QUrl &url, QIODevice::OpenMode mode)
+{
+    qCDebug(KIO_ARCHIVE_LOG) << url.url() << mode;
+
+    if (mode & (QIODevice::WriteOnly | QIODevice::Append | QIODevice::Truncate)) {
+        return KIO::WorkerResult::fail(KIO::ERR_CANNOT_OPEN_FOR_WRITING, url.toDisplayString());
+    }
+
+    QString path;
+    KIO::Error errorNum;
+    if (!checkNewFile(url, path, errorNum)) {
+        return archiveError(errorNum, url);
+    }
+
+    const int entryIndex = d->index->find(path);
+    if (entryIndex < 0) {
+        return KIO::WorkerResult::fail(KIO::ERR_DOES_NOT_EXIST, url.toDisplayString());
+    }
+    const ArchiveIndex::Entry &archiveEntry = d->index->at(entryIndex);
+    if (archiveEntry.isDirectory) {
+        return KIO::WorkerResult::fail(KIO::ERR_IS_DIRECTORY, url.toDisplayString());
+    }
+    if (!archiveEntry.symLinkTarget.isEmpty()) {
+        const QUrl realURL = url.resolved(QUrl(archiveEntry.symLinkTarget));
+        qCDebug(KIO_ARCHIVE_LOG) << "Redirection to" << realURL;
+        redirection(realURL);
+        return KIO::WorkerResult::pass();
+    }
+
+    d->openDevice = createEntryDevice(entryIndex, path, errorNum);
+    if (!d->openDevice) {
+        return archiveError(errorNum, url);
+    }
+    if (!d->openDevice->open(QIODevice::ReadOnly)) {
+        d->openDevice.reset();
+        return KIO::WorkerResult::fail(KIO::ERR_CANNOT_OPEN_FOR_READING, url.toDisplayString());
+    }
+
+    // Determine the mimetype from the start of the file, as get() does
+    const QByteArray start = d->openDevice->read(1024);
+    QMimeDatabase db;
+    mimeType(db.mimeTypeForFileNameAndData(path, start).name());
+    if (!d->openDevice->seek(0)) {
+        d->openDevice.reset();
+        return KIO::WorkerResult::fail(KIO::ERR_CANNOT_SEEK, url.toDisplayString());
+    }
+
+    totalSize(archiveEntry.size);
+    position(0);
+    return KIO::WorkerResult::pass();
+}
+
+KIO::WorkerResult ArchiveProtocolBase::read(KIO::filesize_t size)
+{
+    Q_ASSERT(d->openDevice);
+
+    QByteArray buffer(qMin<KIO::filesize_t>(size, 0x100000), Qt::Uninitialized); // 1MB at most, as get() sends
+    const qint64 read = d->openDevice->read(buffer.data(), buffer.size());
+    if (read < 0) {
+        qCWarning(KIO_ARCHIVE_LOG) << "Could not read" << d->openDevice->errorString();
+        d->openDevice.reset();
+        return KIO::WorkerResult::fail(KIO::ERR_CANNOT_READ, m_archiveName);
+    }
+
+    // an empty buffer tells the end of the file
+    buffer.truncate(read);
+    data(buffer);
+    return KIO::WorkerResult::pass();
+}
+
+KIO::WorkerResult ArchiveProtocolBase::seek(KIO::filesize_t offset)
+{
+    Q_ASSERT(d->openDevice);
+
+    if (!d->openDevice->seek(offset)) {
+        d->openDevice.reset();
+        return KIO::WorkerResult::fail(KIO::ERR_CANNOT_SEEK, m_archiveName);
+    }
+    position(offset);
+    return KIO::WorkerResult::pass();
+}
+
+KIO::WorkerResult ArchiveProtocolBase::close()
+{
+    d->openDevice.reset();
+    if (d->index) {
+        d->index->saveIfModified(s_maxIndexCacheSize);
+    }
+    return KIO::WorkerResult::pass();
+}
+
+KIO::WorkerResult ArchiveProtocolBase::special(const QByteArray &data)
+{
+    int command;
+    QDataStream stream(data);
+    stream >> command;
+
+    switch (command) {
+    case 1: { // Extract
+        QUrl url;
+        QString destination;
+        stream >> url >> destination;
+        return extract(url, destination);
+    }
+    default:
+        return KIO::WorkerResult::fail(KIO::ERR_UNSUPPORTED_ACTION, QString::number(command));
+    }
+}
+
+static QFileDevice::Permissions permissionsFromMode(quint32 mode)
+{
+    QFileDevice::Permissions permissions;
+    permissions.setFlag(QFileDevice::ReadOwner, mode & S_IRUSR);
+    permissions.setFlag(QFileDevice::WriteOwner, mode & S_IWUSR);
+    permissions.setFlag(QFileDevice::ExeOwner, mode & S_IXUSR);
+    permissions.setFlag(QFileDevice::ReadGroup, mode & S_IRGRP);
+    permissions.setFlag(QFileDevice::WriteGroup, mode & S_IWGRP);
+    permissions.setFlag(QFileDevice::ExeGroup, mode & S_IXGRP);
+    permissions.setFlag(QFileDevice::ReadOther, mode & S_IROTH);
+    permissions.setFlag(QFileDevice::WriteOther, mode & S_IWOTH);
+    permissions.setFlag(QFileDevice::ExeOther, mode & S_IXOTH);
+    return permissions;
+}
+
+// Copies the data of the archive entry @p entry from @p io to the file @p destination,
+// returns 0 or the KIO error
+static int writeEntry(QIODevice *io,
+                      const ArchiveIndex::Entry &entry,
+                      const QString &destination,
+                      std::atomic<KIO::filesize_t> &processed,
+                      const std::atomic<bool> &stopped)
+{
+    QFile file(destination);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return KIO::ERR_CANNOT_OPEN_FOR_WRITING;
+    }
+
+    QByteArray buffer(qMin(entry.size, s_extractBufferSize), Qt::Uninitialized);
+    qint64 left = entry.size;
+    while (left > 0 && !stopped) {
+        const qint64 read = io->read(buffer.data(), qMin<qint64>(buffer.size(), left));
+        if (read <= 0) {
+            return KIO::ERR_CANNOT_READ;
+        }
+        if (file.write(buffer.constData(), read) != read) {
+            return file.error() == QFileDevice::ResourceError ? KIO::ERR_DISK_FULL : KIO::ERR_CANNOT_WRITE;
+        }
+        left -= read;
+        processed += read;
+    }
+
+    file.setPermissions(permissionsFromMode(entry.permissions));
+    file.setFileTime(QDateTime::fromSecsSinceEpoch(entry.mtime), QFileDevice::FileModificationTime);
+    return 0;
+}
+
+KIO::WorkerResult ArchiveProtocolBase::extract(const QUrl &url, const QString &destination)
+{
+    qCDebug(KIO_ARCHIVE_LOG) << url.url() << "to" << destination;
+
+    QString path;
+    KIO::Error errorNum;
+    if (!checkNewFile(url, path, errorNum)) {
+        return archiveError(errorNum, url);
+    }
+    const int root = d->index->find(path);
+    if (root < 0) {
+        return KIO::WorkerResult::fail(KIO::ERR_DOES_NOT_EXIST, url.toDisplayString());
+    }
+
+    // Create the folders and symlinks right away, and collect the files
+    struct File {
+        int entry;
+        QString path; ///< in the archive
+        QString destination;
+    };
+    QList<File> files;
+    KIO::filesize_t total = 0;
+    QList<File> pending{File{root, path, destination}};
+    while (!pending.isEmpty()) {
+        const File item = pending.takeLast();
+        const ArchiveIndex::Entry &entry = d->index->at(item.entry);
+        if (entry.isDirectory) {
+            if (!QDir().mkpath(item.destination)) {
+                return KIO::WorkerResult::fail(KIO::ERR_CANNOT_MKDIR, item.destination);
+            }
+            for (int child : entry.children) {
+                const QString &name = d->index->at(child).name;
+                // never write outside of the destination
+                if (name.isEmpty() || name == QLatin1String(".") || name == QLatin1String("..") || name.contains(QLatin1Char('/'))) {
+                    continue;
+                }
+                pending.append(File{child, item.path + QLatin1Char('/') + name, item.destination + QLatin1Char('/') + name});
+            }
+        } else if (!entry.symLinkTarget.isEmpty()) {
+            QFile::remove(item.destination);
+            if (!QFile::link(entry.symLinkTarget, item.destination)) {
+                return KIO::WorkerResult::fail(KIO::ERR_CANNOT_SYMLINK, item.destination);
+            }
+        } else {
+            files.append(item);
+            total += entry.size;
+        }
+    }
+    totalSize(total);
+
+    // Every thread reads from an archive of its own. Zip entries are compressed
+    // one by one, other archives are too expensive to open more than once and
+    // are read by a single thread. A compressed tar with checkpoints is read
+    // straight from the archive file instead, going forward through batches of
+    // neighbouring files. Several threads only read it once the checkpoints
+    // cover all of the files, as only one thread can record them.
+    std::shared_ptr<GzipIndex> checkpoints = d->archiveFile ? nullptr : d->index->checkpoints();
+    bool covered = false;
+    if (checkpoints) {
+        std::sort(files.begin(), files.end(), [this](const File &a, const File &b) {
+            return d->index->at(a.entry).position < d->index->at(b.entry).position;
+        });
+        qint64 end = 0;
+        for (const File &file : std::as_const(files)) {
+            const ArchiveIndex::Entry &entry = d->index->at(file.entry);
+            end = std::max(end, entry.position + entry.size);
+        }
+        if (!files.isEmpty() && d->index->at(files.first().entry).position < 0) {
+            checkpoints.reset();
+        }
+        covered = checkpoints && (checkpoints->isComplete() || checkpoints->indexed >= end);
+    }
+
+    // The files of a batch are extracted one after the other by the same thread
+    QList<qsizetype> batches;
+    qint64 batchPosition = 0;
+    for (qsizetype i = 0; i < files.count(); ++i) {
+        const qint64 position = d->index->at(files.at(i).entry).position;
+        if (!checkpoints || batches.isEmpty() || position - batchPosition >= s_checkpointSpan) {
+            batches.append(i);
+            batchPosition = position;
+        }
+    }
+    batches.append(files.count());
+
+    const bool parallel = checkpoints ? covered : d->archiveProtocol == QLatin1String("zip");
+    const int threadCount = parallel ? qBound(1, QThread::idealThreadCount(), s_maxExtractThreads) : 1;
+    if (!checkpoints && !openArchive(errorNum)) {
+        return archiveError(errorNum, url);
+    }
+
+    std::atomic<qsizetype> next = 0;
+    std::atomic<KIO::filesize_t> processed = 0;
+    std::atomic<bool> stopped = false;
+    QMutex errorMutex;
+    int error = 0;
+    QString errorText;
+
+    auto extractFiles = [&](KArchive *archive, const std::shared_ptr<GzipIndex> &tarCheckpoints) {
+        // the whole tar, for reading the files of a batch without restoring a checkpoint for each
+        std::unique_ptr<QIODevice> tar;
+        if (tarCheckpoints) {
+            tar = std::make_unique<GzipSeekDevice>(m_archiveName, tarCheckpoints);
+            tar->open(QIODevice::ReadOnly);
+        }
+
+        for (qsizetype batch = next++; batch < batches.count() - 1 && !stopped; batch = next++) {
+            for (qsizetype i = batches.at(batch); i < batches.at(batch + 1) && !stopped; ++i) {
+                const File &file = files.at(i);
+                const ArchiveIndex::Entry &entry = d->index->at(file.entry);
+
+                std::unique_ptr<QIODevice> entryDevice;
+                QIODevice *io = nullptr;
+                if (tar) {
+                    io = tar->isOpen() && tar->seek(entry.position) ? tar.get() : nullptr;
+                } else if (const KArchiveEntry *archiveEntry = archive->directory()->entry(file.path); archiveEntry && archiveEntry->isFile()) {
+                    entryDevice.reset(static_cast<const KArchiveFile *>(archiveEntry)->createDevice());
+                    io = entryDevice && entryDevice->open(QIODevice::ReadOnly) ? entryDevice.get() : nullptr;
+                }
+
+                const int result = io ? writeEntry(io, entry, file.destination, processed, stopped) : KIO::ERR_CANNOT_OPEN_FOR_READING;
+                if (result != 0) {
+                    QMutexLocker locker(&errorMutex);
+                    if (!stopped.exchange(true)) {
+                        error = result;
+                        errorText = result == KIO::ERR_CANNOT_OPEN_FOR_READING || result == KIO::ERR_CANNOT_READ ? file.path : file.destination;
+                    }
+                    return;
+                }
+            }
+        }
+    };
+
+    std::vector<std::unique_ptr<QThread>> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back(QThread::create([&, i] {
+            if (checkpoints) {
+                // the checkpoints cover the files if there are several threads, which only read them then
+                extractFiles(nullptr, threadCount > 1 ? std::make_shared<GzipIndex>(*checkpoints) : checkpoints);
+                return;
+            }
+            if (i == 0) {
+                extractFiles(d->archiveFile, nullptr);
+                return;
+            }
+            std::unique_ptr<KArchive> archive(createArchive(d->archiveProtocol, m_archiveName));
+            if (archive && archive->open(QIODevice::ReadOnly)) {
+                extractFiles(archive.get(), nullptr);
+            }
+        }));
+        threads.back()->start();
+    }
+
+    for (const auto &thread : threads) {
+        while (!thread->wait(s_progressInterval)) {
+            processedSize(processed);
+            if (wasKilled()) {
+                stopped = true;
+            }
+        }
+    }
+    processedSize(processed);
+    d->index->saveIfModified(s_maxIndexCacheSize);
+
+    if (error != 0) {
+        return KIO::WorkerResult::fail(error, errorText);
+    }
+    return KIO::WorkerResult::pass();
+}
+
 /*
   In case someone wonders how the old filter stuff looked like :    :)
 void TARProtocol::slotData(void *_p, int _len)
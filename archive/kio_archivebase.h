@@ -14,6 +14,9 @@
 
 #include "libkioarchive_export.h"
 
+#include <memory>
+
+class ArchiveProtocolBasePrivate;
 class KArchive;
 class KArchiveEntry;
 class KArchiveDirectory;
@@ -27,15 +30,40 @@ public:
     KIO::WorkerResult listDir(const QUrl &url) override;
     KIO::WorkerResult stat(const QUrl &url) override;
     KIO::WorkerResult get(const QUrl &url) override;
+    KIO::WorkerResult open(const QUrl &url, QIODevice::OpenMode mode) override;
+    KIO::WorkerResult read(KIO::filesize_t size) override;
+    KIO::WorkerResult seek(KIO::filesize_t offset) override;
+    KIO::WorkerResult close() override;
+
+    /**
+     * Extracts a file or a directory with all its contents to a local path,
+     * without a get() for every file. Zip archives, and compressed tars with a
+     * stored index that was used for reading the files before, are extracted
+     * with several threads.
+     *
+     *  Use it like so:
+     *
+     *  QByteArray packedArgs;
+     *  QDataStream stream(&packedArgs, QIODevice::WriteOnly);
+     *  stream << int(1); // Extract
+     *  stream << QUrl("zip:/path/to/archive.zip/folder") << QString("/path/to/destination");
+     *
+     *  auto job = KIO::special(QUrl("zip:/path/to/archive.zip"), packedArgs);
+     *  job->exec();
+     *
+     * The destination is the path of the extracted file or folder itself. Files
+     * that exist there already are replaced.
+     */
+    KIO::WorkerResult special(const QByteArray &data) override;
 
 private:
     void createRootUDSEntry(KIO::UDSEntry &entry);
-    void createUDSEntry(const KArchiveEntry *tarEntry, KIO::UDSEntry &entry);
+    void createUDSEntry(int entryIndex, KIO::UDSEntry &entry);
 
     virtual KArchive *createArchive(const QString &proto, const QString &archiveFile) = 0;
 
     KIO::StatDetails getStatDetails();
-    uint computeArchiveDirSize(const KArchiveDirectory *dir);
+    KIO::WorkerResult extract(const QUrl &url, const QString &destination);
 
     /**
      * \brief find, check and open the archive file
@@ -46,7 +74,39 @@ private:
      */
     bool checkNewFile(const QUrl &url, QString &path, KIO::Error &errorNum);
 
-    KArchive *m_archiveFile;
+    /**
+     * \brief open the archive found by checkNewFile(), if only its index was loaded
+     * \param errNum KIO error number (undefined if the function returns true)
+     * \return true if the archive is open, false if there was an error
+     */
+    bool openArchive(KIO::Error &errorNum);
+
+    void closeArchive();
+
+    /**
+     * \brief create a device for the data of a file in the archive found by checkNewFile()
+     * \param entryIndex Index of the file in the archive index
+     * \param path Path of the file in the archive
+     * \param errNum KIO error number (undefined if the function returns a device)
+     * \return the device, not open yet, or nullptr if there was an error
+     */
+    std::unique_ptr<QIODevice> createEntryDevice(int entryIndex, const QString &path, KIO::Error &errorNum);
+
+    /**
+     * \brief move the current archive to the recently used ones, leaving no current archive
+     */
+    void keepRecentArchive();
+
+    /**
+     * \brief make a recently used archive the current one again
+     * \param archiveFile Path of the archive
+     * \param protocol Protocol the archive is opened with
+     * \return true if the archive was recently used and did not change since
+     */
+    bool restoreRecentArchive(const QString &archiveFile, const QString &protocol);
+
+    // In place of the KArchive pointer of earlier versions, so the exported class keeps its size
+    std::unique_ptr<ArchiveProtocolBasePrivate> d;
     QString m_archiveName;
     QString m_user, m_group;
     time_t m_mtime;
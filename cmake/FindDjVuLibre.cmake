@@ -0,0 +1,73 @@
+# SPDX-FileCopyrightText: 2026 KDE Contributors
+#
+# SPDX-License-Identifier: BSD-3-Clause
+
+#[=======================================================================[.rst:
+FindDjVuLibre
+-------------
+
+Try to find the DjVuLibre decoding library.
+
+This will define the following variables:
+
+``DjVuLibre_FOUND``
+    TRUE if (the requested version of) DjVuLibre is available
+``DjVuLibre_VERSION``
+    The version of DjVuLibre
+``DjVuLibre_LIBRARIES``
+    The libraries of DjVuLibre for use with target_link_libraries()
+``DjVuLibre_INCLUDE_DIRS``
+    The include dirs of DjVuLibre for use with target_include_directories()
+``DjVuLibre_DEFINITIONS``
+    Compiler switches required for using DjVuLibre
+
+If ``DjVuLibre_FOUND`` is TRUE, it will also define the following imported
+target:
+
+``DjVuLibre::DjVuLibre``
+    The DjVuLibre decoding library
+#]=======================================================================]
+
+find_package(PkgConfig QUIET)
+pkg_check_modules(PC_DjVuLibre QUIET ddjvuapi>=${DjVuLibre_FIND_VERSION})
+
+find_library(DjVuLibre_LIBRARIES
+    NAMES djvulibre
+    HINTS ${PC_DjVuLibre_LIBRARY_DIRS}
+)
+
+find_path(DjVuLibre_INCLUDE_DIRS
+    NAMES libdjvu/ddjvuapi.h
+    HINTS ${PC_DjVuLibre_INCLUDE_DIRS}
+)
+
+set(DjVuLibre_VERSION ${PC_DjVuLibre_VERSION})
+set(DjVuLibre_DEFINITIONS ${PC_DjVuLibre_CFLAGS})
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(DjVuLibre
+    FOUND_VAR
+        DjVuLibre_FOUND
+    REQUIRED_VARS
+        DjVuLibre_LIBRARIES
+        DjVuLibre_INCLUDE_DIRS
+    VERSION_VAR
+        DjVuLibre_VERSION
+)
+
+if(DjVuLibre_FOUND AND NOT TARGET DjVuLibre::DjVuLibre)
+    add_library(DjVuLibre::DjVuLibre UNKNOWN IMPORTED)
+    set_target_properties(DjVuLibre::DjVuLibre PROPERTIES
+        IMPORTED_LOCATION "${DjVuLibre_LIBRARIES}"
+        INTERFACE_COMPILE_OPTIONS "${DjVuLibre_DEFINITIONS}"
+        INTERFACE_INCLUDE_DIRECTORIES "${DjVuLibre_INCLUDE_DIRS}"
+    )
+endif()
+
+mark_as_advanced(DjVuLibre_LIBRARIES DjVuLibre_INCLUDE_DIRS DjVuLibre_VERSION DjVuLibre_DEFINITIONS)
+
+include(FeatureSummary)
+set_package_properties(DjVuLibre PROPERTIES
+    DESCRIPTION "DjVuLibre, a library for decoding DjVu documents"
+    URL "https://djvu.sourceforge.net/"
+)
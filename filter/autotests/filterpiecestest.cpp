@@ -0,0 +1,215 @@
+/*
+    SPDX-License-Identifier: MIT
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+*/
+
+#include <KCompressionDevice>
+
+#include <QBuffer>
+#include <QTest>
+
+#include "filterpieces.h"
+
+Q_DECLARE_METATYPE(KCompressionDevice::CompressionType)
+
+static QByteArray compress(KCompressionDevice::CompressionType type, const QByteArray &data)
+{
+    QByteArray compressed;
+    QBuffer buffer(&compressed);
+    buffer.open(QIODevice::WriteOnly);
+    KCompressionDevice device(&buffer, false, type);
+    if (!device.open(QIODevice::WriteOnly) || device.write(data) != data.size()) {
+        return {};
+    }
+    device.close();
+    return compressed;
+}
+
+// A zstd frame of a single raw block, with the size of its content stored
+// in one byte, or in two bytes for at least 256 bytes
+static QByteArray rawZstdFrame(const QByteArray &data)
+{
+    QByteArray frame("\x28\xb5\x2f\xfd", 4);
+    if (data.size() < 256) {
+        frame += char(0x20); // single segment, one byte size
+        frame += char(data.size());
+    } else {
+        frame += char(0x60); // single segment, two byte size
+        frame += char((data.size() - 256) & 0xff);
+        frame += char((data.size() - 256) >> 8);
+    }
+    const quint32 blockHeader = (quint32(data.size()) << 3) | 1; // last raw block
+    frame += char(blockHeader & 0xff);
+    frame += char((blockHeader >> 8) & 0xff);
+    frame += char(blockHeader >> 16);
+    return frame + data;
+}
+
+static QByteArray lines(const QByteArray &prefix, int count)
+{
+    QByteArray data;
+    for (int i = 0; i < count; ++i) {
+        data += prefix + ' ' + QByteArray::number(i) + '\n';
+    }
+    return data;
+}
+
+static QByteArray decompress(KCompressionDevice::CompressionType type, QByteArrayView piece, PieceResult *result = nullptr)
+{
+    QByteArray output;
+    const PieceResult status = decompressPiece(type, piece, [&output](QByteArrayView chunk) {
+        output.append(chunk);
+        return true;
+    });
+    if (result) {
+        *result = status;
+    }
+    return status == PieceResult::Finished ? output : QByteArray();
+}
+
+static QByteArrayView pieceData(const QByteArray &file, const FilterPiece &piece)
+{
+    return QByteArrayView(file).sliced(piece.offset, piece.size);
+}
+
+class FilterPiecesTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testStartsMember_data()
+    {
+        QTest::addColumn<KCompressionDevice::CompressionType>("type");
+        QTest::addColumn<QByteArray>("data");
+        QTest::addColumn<bool>("starts");
+
+        QTest::newRow("gzip") << KCompressionDevice::GZip << QByteArray("\x1f\x8b\x08\x00", 4) << true;
+        QTest::newRow("gzip, cut off") << KCompressionDevice::GZip << QByteArray("\x1f") << false;
+        QTest::newRow("bzip2") << KCompressionDevice::BZip2 << QByteArray("BZh9") << true;
+        QTest::newRow("xz") << KCompressionDevice::Xz << QByteArray("\xfd" "7zXZ\0\0", 7) << true;
+        QTest::newRow("zstd frame") << KCompressionDevice::Zstd << QByteArray("\x28\xb5\x2f\xfd", 4) << true;
+        QTest::newRow("zstd skippable frame") << KCompressionDevice::Zstd << QByteArray("\x5a\x2a\x4d\x18", 4) << true;
+        QTest::newRow("padding") << KCompressionDevice::GZip << QByteArray(512, '\0') << false;
+    }
+
+    void testStartsMember()
+    {
+        QFETCH(KCompressionDevice::CompressionType, type);
+        QFETCH(QByteArray, data);
+        QFETCH(bool, starts);
+
+        QCOMPARE(startsMember(type, data.constData(), data.size()), starts);
+    }
+
+    void testZstdFrames()
+    {
+        const QByteArray first = lines("first", 10000);
+        const QByteArray second = compress(KCompressionDevice::Zstd, lines("second", 10000));
+        if (second.isEmpty()) {
+            QSKIP("KArchive was built without zstd");
+        }
+        const QByteArray small("small");
+        const QByteArray medium = lines("medium", 100);
+        // pzstd writes the size of the next frame in a skippable frame
+        const QByteArray skippable("\x50\x2a\x4d\x18\x04\x00\x00\x00\x01\x02\x03\x04", 12);
+
+        const QByteArray file = compress(KCompressionDevice::Zstd, first) + skippable + second + rawZstdFrame(small) + rawZstdFrame(medium);
+        const QList<FilterPiece> pieces = splitIntoPieces(KCompressionDevice::Zstd, reinterpret_cast<const uchar *>(file.constData()), file.size());
+        QCOMPARE(pieces.count(), 4);
+        QCOMPARE(pieces.at(0).offset, 0);
+        QCOMPARE(pieces.at(1).offset, pieces.at(0).size);
+        QCOMPARE(pieces.at(3).offset + pieces.at(3).size, file.size());
+
+        QCOMPARE(decompress(KCompressionDevice::Zstd, pieceData(file, pieces.at(0))), first);
+        QCOMPARE(decompress(KCompressionDevice::Zstd, pieceData(file, pieces.at(1))), lines("second", 10000));
+        QCOMPARE(decompress(KCompressionDevice::Zstd, pieceData(file, pieces.at(2))), small);
+        QCOMPARE(decompress(KCompressionDevice::Zstd, pieceData(file, pieces.at(3))), medium);
+
+        // Frame_Content_Size, in one and in two bytes
+        QCOMPARE(pieces.at(2).outputSize, small.size());
+        QCOMPARE(pieces.at(3).outputSize, medium.size());
+
+        // anything but frames means the file cannot be split
+        const QByteArray trailing = file + "garbage";
+        QVERIFY(splitIntoPieces(KCompressionDevice::Zstd, reinterpret_cast<const uchar *>(trailing.constData()), trailing.size()).isEmpty());
+        const QByteArray cutOff = file.chopped(1);
+        QVERIFY(splitIntoPieces(KCompressionDevice::Zstd, reinterpret_cast<const uchar *>(cutOff.constData()), cutOff.size()).isEmpty());
+    }
+
+    void testBzip2Streams()
+    {
+        // as pbzip2 writes them, a stream per block
+        QList<QByteArray> parts;
+        QByteArray file;
+        for (int i = 0; i < 3; ++i) {
+            parts.append(lines("part " + QByteArray::number(i), 20000));
+            file += compress(KCompressionDevice::BZip2, parts.last());
+        }
+
+        const QList<FilterPiece> pieces = splitIntoPieces(KCompressionDevice::BZip2, reinterpret_cast<const uchar *>(file.constData()), file.size());
+        QCOMPARE(pieces.count(), 3);
+        QCOMPARE(pieces.at(0).offset, 0);
+        for (int i = 0; i < 3; ++i) {
+            QCOMPARE(pieces.at(i).outputSize, -1);
+            QCOMPARE(decompress(KCompressionDevice::BZip2, pieceData(file, pieces.at(i))), parts.at(i));
+        }
+        QCOMPARE(pieces.at(2).offset + pieces.at(2).size, file.size());
+    }
+
+    void testNotSplit()
+    {
+        // gzip members are only found by decompressing
+        const QByteArray file = compress(KCompressionDevice::GZip, "first") + compress(KCompressionDevice::GZip, "second");
+        QVERIFY(splitIntoPieces(KCompressionDevice::GZip, reinterpret_cast<const uchar *>(file.constData()), file.size()).isEmpty());
+
+        const QByteArray notBzip2("not a bzip2 file");
+        QVERIFY(splitIntoPieces(KCompressionDevice::BZip2, reinterpret_cast<const uchar *>(notBzip2.constData()), notBzip2.size()).isEmpty());
+    }
+
+    void testConcatenated_data()
+    {
+        QTest::addColumn<KCompressionDevice::CompressionType>("type");
+
+        QTest::newRow("gzip") << KCompressionDevice::GZip;
+        QTest::newRow("bzip2") << KCompressionDevice::BZip2;
+        QTest::newRow("xz") << KCompressionDevice::Xz;
+        QTest::newRow("zstd") << KCompressionDevice::Zstd;
+    }
+
+    void testConcatenated()
+    {
+        QFETCH(KCompressionDevice::CompressionType, type);
+
+        // as joined with cat, an empty member included
+        const QByteArray first = lines("first", 50000);
+        const QByteArray second = lines("second", 3);
+        const QByteArray file = compress(type, first) + compress(type, QByteArray()) + compress(type, second);
+        if (file.isEmpty()) {
+            QSKIP("KArchive was built without this compression type");
+        }
+        QCOMPARE(decompress(type, file), first + second);
+
+        // trailing data that does not start a member is ignored, like gzip does
+        QCOMPARE(decompress(type, file + QByteArray(100, '\0')), first + second);
+
+        PieceResult result;
+        QVERIFY(decompress(type, file.chopped(10), &result).isEmpty());
+        QCOMPARE(result, PieceResult::Failed);
+    }
+
+    void testStopped()
+    {
+        const QByteArray file = compress(KCompressionDevice::GZip, QByteArray(10 * 1024 * 1024, 'a'));
+        int chunks = 0;
+        const PieceResult result = decompressPiece(KCompressionDevice::GZip, file, [&chunks](QByteArrayView chunk) {
+            // in chunks of at most 1 MiB
+            return chunk.size() <= 1024 * 1024 && ++chunks < 2;
+        });
+        QCOMPARE(result, PieceResult::Stopped);
+        QCOMPARE(chunks, 2);
+    }
+};
+
+QTEST_GUILESS_MAIN(FilterPiecesTest)
+
+#include "filterpiecestest.moc"
@@ -0,0 +1,229 @@
+/*
+    SPDX-License-Identifier: MIT
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+*/
+
+#include <KCompressionDevice>
+
+#include <QBuffer>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "filterindex.h"
+
+Q_DECLARE_METATYPE(KCompressionDevice::CompressionType)
+
+// Small enough for a gzip file of a few MiB to get many checkpoints
+static const qint64 s_span = 64 * 1024;
+
+static QByteArray compress(KCompressionDevice::CompressionType type, const QByteArray &data)
+{
+    QByteArray compressed;
+    QBuffer buffer(&compressed);
+    buffer.open(QIODevice::WriteOnly);
+    KCompressionDevice device(&buffer, false, type);
+    if (!device.open(QIODevice::WriteOnly) || device.write(data) != data.size()) {
+        return {};
+    }
+    device.close();
+    return compressed;
+}
+
+// Compresses well, into many deflate blocks
+static QByteArray lines(const QByteArray &prefix, int count)
+{
+    QByteArray data;
+    for (int i = 0; i < count; ++i) {
+        data += prefix + ' ' + QByteArray::number(i) + '\n';
+    }
+    return data;
+}
+
+static QByteArray randomData(qsizetype size, quint32 seed)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    QRandomGenerator generator(seed);
+    generator.fillRange(reinterpret_cast<quint32 *>(data.data()), size / sizeof(quint32));
+    return data;
+}
+
+static QByteArray readAt(QIODevice *device, qint64 offset, qint64 size)
+{
+    if (!device->seek(offset)) {
+        return "seek failed";
+    }
+    return device->read(size);
+}
+
+// QIODevice::readAll() relies on size(), which is not known before the end
+static QByteArray readToEnd(QIODevice *device)
+{
+    QByteArray data;
+    QByteArray buffer;
+    while (!(buffer = device->read(64 * 1024)).isEmpty()) {
+        data += buffer;
+    }
+    return data;
+}
+
+class FilterSeekDeviceTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(m_dir.isValid());
+    }
+
+    void testRead_data()
+    {
+        QTest::addColumn<KCompressionDevice::CompressionType>("type");
+        QTest::addColumn<QList<QByteArray>>("members");
+
+        QTest::newRow("gzip") << KCompressionDevice::GZip << QList<QByteArray>{lines("gzip", 300000)};
+        QTest::newRow("cat-joined gzip") << KCompressionDevice::GZip
+                                         << QList<QByteArray>{lines("first", 100000), randomData(200 * 1024, 1), QByteArray(), lines("last", 100000)};
+        QTest::newRow("bzip2 streams") << KCompressionDevice::BZip2
+                                       << QList<QByteArray>{lines("first", 100000), randomData(300 * 1024, 2), lines("last", 100000)};
+        QTest::newRow("zstd frames") << KCompressionDevice::Zstd
+                                     << QList<QByteArray>{lines("first", 100000), QByteArray(), randomData(300 * 1024, 3), lines("last", 100000)};
+        QTest::newRow("xz") << KCompressionDevice::Xz << QList<QByteArray>{lines("xz", 200000)};
+    }
+
+    void testRead()
+    {
+        QFETCH(KCompressionDevice::CompressionType, type);
+        QFETCH(QList<QByteArray>, members);
+
+        QByteArray file;
+        QByteArray expected;
+        for (const QByteArray &member : members) {
+            file += compress(type, member);
+            expected += member;
+        }
+        if (file.isEmpty()) {
+            QSKIP("KArchive was built without this compression type");
+        }
+        // trailing data that does not start a member is ignored
+        const QString path = writeFile(file + QByteArray(4096, '\0'));
+        const qint64 size = expected.size();
+
+        std::unique_ptr<FilterIndex> index = FilterIndex::create(path, type, s_span);
+        QVERIFY(!index->isModified());
+        std::unique_ptr<QIODevice> device = index->createDevice(path, type);
+        QVERIFY(device->open(QIODevice::ReadOnly));
+        QCOMPARE(device->size(), qint64(-1));
+
+        // sequential reads from the start
+        QCOMPARE(device->read(1000), expected.left(1000));
+        QCOMPARE(device->read(100000), expected.mid(1000, 100000));
+
+        // beyond what the index covers, then back within it
+        QCOMPARE(readAt(device.get(), size * 3 / 4, 5000), expected.mid(size * 3 / 4, 5000));
+        QVERIFY(index->isModified());
+        QCOMPARE(readAt(device.get(), size / 4, 5000), expected.mid(size / 4, 5000));
+        QCOMPARE(readAt(device.get(), size / 2, 100000), expected.mid(size / 2, 100000));
+        QCOMPARE(readAt(device.get(), 10, 10), expected.mid(10, 10));
+        QCOMPARE(device->size(), qint64(-1));
+
+        // the size is known once the device read to the end
+        QCOMPARE(readAt(device.get(), size - 100, 1000), expected.right(100));
+        QCOMPARE(device->size(), size);
+        QCOMPARE(index->size(), size);
+        QVERIFY(device->read(1000).isEmpty());
+        QVERIFY(readAt(device.get(), size + 10, 10).isEmpty());
+
+        // another device shares the index
+        std::unique_ptr<QIODevice> other = index->createDevice(path, type);
+        QVERIFY(other->open(QIODevice::ReadOnly));
+        QCOMPARE(other->size(), size);
+        QCOMPARE(other->readAll(), expected);
+        for (int i = 0; i < 50; ++i) {
+            const qint64 offset = QRandomGenerator::global()->bounded(size);
+            const qint64 length = QRandomGenerator::global()->bounded(200000);
+            QCOMPARE(readAt(other.get(), offset, length), expected.mid(offset, length));
+        }
+
+        // the stored index reads the same
+        const QString cacheFile = m_dir.filePath(QStringLiteral("index/file%1.index").arg(m_fileCount));
+        index->save(cacheFile, 1024 * 1024 * 1024);
+        QVERIFY(!index->isModified());
+        std::unique_ptr<FilterIndex> loaded = FilterIndex::load(cacheFile);
+        QVERIFY(loaded);
+        QVERIFY(!loaded->isModified());
+        QCOMPARE(loaded->size(), size);
+        std::unique_ptr<QIODevice> stored = loaded->createDevice(path, type);
+        QVERIFY(stored->open(QIODevice::ReadOnly));
+        QCOMPARE(readAt(stored.get(), size / 3, 100000), expected.mid(size / 3, 100000));
+        QCOMPARE(readAt(stored.get(), size / 5, 100000), expected.mid(size / 5, 100000));
+    }
+
+    void testReadCorrupt_data()
+    {
+        QTest::addColumn<KCompressionDevice::CompressionType>("type");
+
+        QTest::newRow("gzip") << KCompressionDevice::GZip;
+        QTest::newRow("bzip2") << KCompressionDevice::BZip2;
+        QTest::newRow("zstd") << KCompressionDevice::Zstd;
+    }
+
+    void testReadCorrupt()
+    {
+        QFETCH(KCompressionDevice::CompressionType, type);
+
+        const QByteArray file = compress(type, lines("line", 200000));
+        if (file.isEmpty()) {
+            QSKIP("KArchive was built without this compression type");
+        }
+        const QString path = writeFile(file.chopped(1000));
+
+        std::unique_ptr<FilterIndex> index = FilterIndex::create(path, type, s_span);
+        std::unique_ptr<QIODevice> device = index->createDevice(path, type);
+        QVERIFY(device->open(QIODevice::ReadOnly));
+        QVERIFY(!device->read(1000).isEmpty());
+        QVERIFY(device->seek(10 * 1024 * 1024));
+        char buffer[1000];
+        QCOMPARE(device->read(buffer, sizeof(buffer)), qint64(-1));
+        QCOMPARE(index->size(), qint64(-1));
+    }
+
+    void testLoadCorrupt()
+    {
+        const QString path = writeFile(compress(KCompressionDevice::GZip, lines("line", 200000)));
+        std::unique_ptr<FilterIndex> index = FilterIndex::create(path, KCompressionDevice::GZip, s_span);
+        std::unique_ptr<QIODevice> device = index->createDevice(path, KCompressionDevice::GZip);
+        QVERIFY(device->open(QIODevice::ReadOnly));
+        QCOMPARE(readToEnd(device.get()).size(), index->size());
+
+        const QString cacheFile = m_dir.filePath(QStringLiteral("index/corrupt.index"));
+        index->save(cacheFile, 1024 * 1024 * 1024);
+        QFile file(cacheFile);
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QVERIFY(file.resize(file.size() / 2));
+        file.close();
+
+        // a cut off index is not used, and removed
+        QVERIFY(!FilterIndex::load(cacheFile));
+        QVERIFY(!QFile::exists(cacheFile));
+    }
+
+private:
+    QString writeFile(const QByteArray &data)
+    {
+        const QString path = m_dir.filePath(QStringLiteral("file%1").arg(++m_fileCount));
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+            return QString();
+        }
+        return path;
+    }
+
+    QTemporaryDir m_dir;
+    int m_fileCount = 0;
+};
+
+QTEST_GUILESS_MAIN(FilterSeekDeviceTest)
+
+#include "filterseekdevicetest.moc"
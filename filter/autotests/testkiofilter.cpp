@@ -0,0 +1,256 @@
+/*
+    SPDX-License-Identifier: MIT
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+*/
+
+#include <KCompressionDevice>
+#include <KIO/FileJob>
+#include <KIO/StoredTransferJob>
+
+#include <QBuffer>
+#include <QRandomGenerator>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+Q_DECLARE_METATYPE(KCompressionDevice::CompressionType)
+
+static QByteArray compress(KCompressionDevice::CompressionType type, const QByteArray &data)
+{
+    QByteArray compressed;
+    QBuffer buffer(&compressed);
+    buffer.open(QIODevice::WriteOnly);
+    KCompressionDevice device(&buffer, false, type);
+    if (!device.open(QIODevice::WriteOnly) || device.write(data) != data.size()) {
+        return {};
+    }
+    device.close();
+    return compressed;
+}
+
+// Does not compress, so the compressed file is as large as the data
+static QByteArray randomData(qsizetype size, quint32 seed)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    QRandomGenerator generator(seed);
+    generator.fillRange(reinterpret_cast<quint32 *>(data.data()), size / sizeof(quint32));
+    return data;
+}
+
+// Compresses well, into many deflate blocks
+static QByteArray lines(int count)
+{
+    QByteArray data;
+    for (int i = 0; i < count; ++i) {
+        data += "line " + QByteArray::number(i) + '\n';
+    }
+    return data;
+}
+
+static QString protocol(KCompressionDevice::CompressionType type)
+{
+    switch (type) {
+    case KCompressionDevice::GZip:
+        return QStringLiteral("gzip");
+    case KCompressionDevice::BZip2:
+        return QStringLiteral("bzip2");
+    case KCompressionDevice::Xz:
+        return QStringLiteral("xz");
+    case KCompressionDevice::Zstd:
+        return QStringLiteral("zstd");
+    default:
+        return QString();
+    }
+}
+
+class TestKioFilter : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+        QVERIFY(m_dir.isValid());
+    }
+
+    void testGet_data()
+    {
+        QTest::addColumn<KCompressionDevice::CompressionType>("type");
+        QTest::addColumn<QList<QByteArray>>("members");
+
+        // smaller than the input buffer, which get() reads only partly
+        QTest::newRow("small gzip") << KCompressionDevice::GZip << QList<QByteArray>{"Hello world\n"};
+        // joined with cat, the second member starting in the middle of an input buffer
+        QTest::newRow("cat-joined gzip") << KCompressionDevice::GZip << QList<QByteArray>{randomData(300 * 1024, 1), QByteArray(), randomData(1000, 2)};
+        QTest::newRow("cat-joined xz") << KCompressionDevice::Xz << QList<QByteArray>{randomData(300 * 1024, 3), randomData(1000, 4)};
+
+        // as written by pbzip2, a stream per block, large enough to be decompressed in parallel
+        QList<QByteArray> streams;
+        for (int i = 0; i < 6; ++i) {
+            streams.append(randomData(900 * 1024, 10 + i));
+        }
+        QTest::newRow("pbzip2") << KCompressionDevice::BZip2 << streams;
+
+        // as written by pzstd, one frame being too large to be held and sent while decompressing
+        QTest::newRow("multi-frame zstd") << KCompressionDevice::Zstd
+                                          << QList<QByteArray>{randomData(2 * 1024 * 1024, 20),
+                                                               QByteArray(),
+                                                               randomData(9 * 1024 * 1024, 21),
+                                                               randomData(1024 * 1024, 22),
+                                                               randomData(1000, 23)};
+    }
+
+    void testGet()
+    {
+        QFETCH(KCompressionDevice::CompressionType, type);
+        QFETCH(QList<QByteArray>, members);
+
+        QByteArray file;
+        QByteArray expected;
+        for (const QByteArray &member : members) {
+            file += compress(type, member);
+            expected += member;
+        }
+        if (file.isEmpty()) {
+            QSKIP("KArchive was built without this compression type");
+        }
+
+        const QString path = writeFile(file);
+        QCOMPARE(get(type, path), expected);
+
+        // trailing data that does not start a member is ignored
+        const QString padded = writeFile(file + QByteArray(4096, '\0'));
+        QCOMPARE(get(type, padded), expected);
+    }
+
+    void testGetCorrupt_data()
+    {
+        QTest::addColumn<KCompressionDevice::CompressionType>("type");
+
+        QTest::newRow("gzip") << KCompressionDevice::GZip;
+        QTest::newRow("bzip2") << KCompressionDevice::BZip2;
+        QTest::newRow("zstd") << KCompressionDevice::Zstd;
+    }
+
+    void testGetCorrupt()
+    {
+        QFETCH(KCompressionDevice::CompressionType, type);
+
+        QByteArray file;
+        for (int i = 0; i < 5; ++i) {
+            file += compress(type, randomData(1024 * 1024, 30 + i));
+        }
+        if (file.isEmpty()) {
+            QSKIP("KArchive was built without this compression type");
+        }
+
+        // the last piece is cut off
+        const QString path = writeFile(file.chopped(1000));
+        KIO::StoredTransferJob *job = KIO::storedGet(url(type, path), KIO::NoReload, KIO::HideProgressInfo);
+        QVERIFY(!job->exec());
+        QCOMPARE(job->error(), KIO::ERR_CANNOT_READ);
+    }
+
+    void testReadSeek_data()
+    {
+        QTest::addColumn<KCompressionDevice::CompressionType>("type");
+        QTest::addColumn<QList<QByteArray>>("members");
+
+        QTest::newRow("gzip") << KCompressionDevice::GZip << QList<QByteArray>{lines(300000)};
+        QTest::newRow("cat-joined gzip") << KCompressionDevice::GZip << QList<QByteArray>{lines(100000), randomData(300 * 1024, 40), lines(100000)};
+        QTest::newRow("pbzip2") << KCompressionDevice::BZip2 << QList<QByteArray>{randomData(900 * 1024, 41), randomData(900 * 1024, 42), lines(100000)};
+        QTest::newRow("multi-frame zstd") << KCompressionDevice::Zstd << QList<QByteArray>{lines(100000), randomData(1024 * 1024, 43), lines(100000)};
+        QTest::newRow("xz") << KCompressionDevice::Xz << QList<QByteArray>{lines(200000)};
+    }
+
+    void testReadSeek()
+    {
+        QFETCH(KCompressionDevice::CompressionType, type);
+        QFETCH(QList<QByteArray>, members);
+
+        QByteArray file;
+        QByteArray expected;
+        for (const QByteArray &member : members) {
+            file += compress(type, member);
+            expected += member;
+        }
+        if (file.isEmpty()) {
+            QSKIP("KArchive was built without this compression type");
+        }
+        const QString path = writeFile(file);
+        const qint64 size = expected.size();
+
+        KIO::FileJob *job = KIO::open(url(type, path), QIODevice::ReadOnly);
+        QSignalSpy openSpy(job, &KIO::FileJob::open);
+        QVERIFY(openSpy.wait());
+
+        // open() does not decompress the whole file, reads go ahead as far as needed
+        QCOMPARE(readAt(job, 0, 1000), expected.left(1000));
+        QCOMPARE(readAt(job, size / 2, 10000), expected.mid(size / 2, 10000));
+        QCOMPARE(readAt(job, size / 4, 10000), expected.mid(size / 4, 10000));
+        QCOMPARE(readAt(job, size * 3 / 4, 10000), expected.mid(size * 3 / 4, 10000));
+        QCOMPARE(readAt(job, 100, 100), expected.mid(100, 100));
+
+        // the size is sent once the file was read to its end
+        QCOMPARE(readAt(job, size - 100, 1000), expected.right(100));
+        QCOMPARE(job->size(), KIO::filesize_t(size));
+        QCOMPARE(readAt(job, size / 3, 10000), expected.mid(size / 3, 10000));
+
+        QSignalSpy closedSpy(job, &KIO::FileJob::fileClosed);
+        job->close();
+        QVERIFY(closedSpy.wait());
+    }
+
+private:
+    static QByteArray readAt(KIO::FileJob *job, KIO::filesize_t offset, KIO::filesize_t size)
+    {
+        QSignalSpy positionSpy(job, &KIO::FileJob::position);
+        job->seek(offset);
+        if (!positionSpy.wait() || positionSpy.first().at(1).value<KIO::filesize_t>() != offset) {
+            return "seek failed";
+        }
+
+        QSignalSpy dataSpy(job, &KIO::FileJob::data);
+        job->read(size);
+        if (!dataSpy.wait()) {
+            return "read failed";
+        }
+        return dataSpy.first().at(1).toByteArray();
+    }
+
+    QString writeFile(const QByteArray &data)
+    {
+        const QString path = m_dir.filePath(QStringLiteral("file%1").arg(++m_fileCount));
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+            return QString();
+        }
+        return path;
+    }
+
+    static QUrl url(KCompressionDevice::CompressionType type, const QString &path)
+    {
+        QUrl url = QUrl::fromLocalFile(path);
+        url.setScheme(protocol(type));
+        return url;
+    }
+
+    static QByteArray get(KCompressionDevice::CompressionType type, const QString &path)
+    {
+        KIO::StoredTransferJob *job = KIO::storedGet(url(type, path), KIO::NoReload, KIO::HideProgressInfo);
+        if (!job->exec()) {
+            qWarning() << job->errorString();
+            return QByteArray();
+        }
+        return job->data();
+    }
+
+    QTemporaryDir m_dir;
+    int m_fileCount = 0;
+};
+
+QTEST_GUILESS_MAIN(TestKioFilter)
+
+#include "testkiofilter.moc"
@@ -8,20 +8,57 @@ SPDX-License-Identifier: MIT
 */
 
 #include "filter.h"
+#include "filterindex.h"
+#include "filterpieces.h"
 
+#include <QByteArrayView>
 #include <QCoreApplication>
+#include <QDateTime>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
 #include <QMimeDatabase>
 #include <QMimeType>
+#include <QMutex>
+#include <QStandardPaths>
+#include <QThread>
 #include <QUrl>
+#include <QWaitCondition>
 
 #include <KCompressionDevice>
 #include <KFilterBase>
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
 #include "loggingcategory.h"
 
+static const int s_inputBufferSize = 256 * 1024;
+// The output buffer starts small, to sniff the mimetype and show something early,
+// and grows while the data keeps coming
+static const int s_minOutputBufferSize = 8 * 1024;
+static const int s_maxOutputBufferSize = 1024 * 1024;
+
+// Files made of several members or frames are decompressed in parallel
+// if they are at least this large
+static const qint64 s_minParallelSize = 4 * 1024 * 1024;
+static const int s_maxThreads = 8;
+// The output of the pieces decompressed ahead of the one being sent is held
+// in memory, two pieces per thread at most. A piece whose output is larger
+// is given up by its thread and decompressed straight into data() instead.
+static const qint64 s_maxHeldPieceSize = 8 * 1024 * 1024;
+static const unsigned long s_killCheckInterval = 200; // ms
+
+// Distance between the checkpoints of a gzip file read with open(), which
+// bounds the decompression needed to reach an offset in it
+static const qint64 s_checkpointSpan = 8 * 1024 * 1024;
+// Indexes that take less time to build are not stored
+static const qint64 s_minIndexedTime = 50; // ms
+static const qint64 s_maxIndexCacheSize = 64 * 1024 * 1024;
+
 // Pseudo plugin class to embed meta data
 class KIOPluginForMetaData : public QObject
 {
@@ -58,10 +95,173 @@ FilterProtocol::FilterProtocol(const QByteArray &protocol, const QByteArray &poo
 {
     const QString mimetype = (protocol == "zstd") ? QStringLiteral("application/zstd") : QLatin1String("application/x-") + QLatin1String(protocol.constData());
 
-    filter = KCompressionDevice::filterForCompressionType(KCompressionDevice::compressionTypeForMimeType(mimetype));
+    m_compressionType = KCompressionDevice::compressionTypeForMimeType(mimetype);
+    filter = KCompressionDevice::filterForCompressionType(m_compressionType);
     Q_ASSERT(filter);
 }
 
+void FilterProtocol::sendMimeType(const QString &path, const QByteArray &output)
+{
+    // Can we use the "base" filename? E.g. foo.txt.bz2
+    const QString extension = QFileInfo(path).suffix();
+    QMimeDatabase db;
+    QMimeType mime;
+    if (extension == "gz" || extension == "bz" || extension == "bz2" || extension == "zst") {
+        QString baseName = path;
+        baseName.truncate(baseName.length() - extension.length() - 1 /*the dot*/);
+        qDebug(KIO_FILTER_DEBUG) << "baseName=" << baseName;
+        mime = db.mimeTypeForFileNameAndData(baseName, output);
+    } else {
+        mime = db.mimeTypeForData(output);
+    }
+    qDebug(KIO_FILTER_DEBUG) << "Emitting mimetype " << mime.name();
+    mimeType(mime.name());
+}
+
+KIO::WorkerResult FilterProtocol::getParallel(const QUrl &url, const uchar *mapped, const QList<FilterPiece> &pieces)
+{
+    const int threadCount = int(std::min<qsizetype>(pieces.count(), qBound(1, QThread::idealThreadCount(), s_maxThreads)));
+    // the threads stay this many pieces ahead of the one being sent at most
+    const qsizetype window = 2 * threadCount;
+    qDebug(KIO_FILTER_DEBUG) << "Decompressing" << pieces.count() << "pieces with" << threadCount << "threads";
+
+    auto pieceData = [mapped](const FilterPiece &piece) {
+        return QByteArrayView(reinterpret_cast<const char *>(mapped) + piece.offset, piece.size);
+    };
+
+    enum State {
+        Pending,
+        Held, ///< decompressed into outputs
+        TooLarge, ///< to be decompressed while sending
+    };
+
+    QMutex mutex;
+    QWaitCondition condition;
+    QList<QByteArray> outputs(pieces.count());
+    std::vector<State> states(pieces.count(), Pending);
+    qsizetype next = 0;
+    qsizetype sent = 0;
+    bool stopped = false;
+    bool failed = false;
+
+    auto decompressPieces = [&] {
+        while (true) {
+            qsizetype i;
+            {
+                QMutexLocker locker(&mutex);
+                while (!stopped && next < pieces.count() && next >= sent + window) {
+                    condition.wait(&mutex);
+                }
+                if (stopped || next >= pieces.count()) {
+                    return;
+                }
+                i = next++;
+            }
+
+            QByteArray output;
+            PieceResult result = PieceResult::Stopped;
+            if (pieces.at(i).outputSize <= s_maxHeldPieceSize) {
+                result = decompressPiece(m_compressionType, pieceData(pieces.at(i)), [&output](QByteArrayView chunk) {
+                    if (output.size() + chunk.size() > s_maxHeldPieceSize) {
+                        return false;
+                    }
+                    output.append(chunk);
+                    return true;
+                });
+            }
+
+            QMutexLocker locker(&mutex);
+            if (result == PieceResult::Failed) {
+                qCWarning(KIO_FILTER_DEBUG) << "Cannot decompress the piece at" << pieces.at(i).offset;
+                failed = stopped = true;
+            } else if (result == PieceResult::Stopped) {
+                states[i] = TooLarge;
+            } else {
+                outputs[i] = std::move(output);
+                states[i] = Held;
+            }
+            condition.wakeAll();
+        }
+    };
+
+    std::vector<std::unique_ptr<QThread>> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back(QThread::create(decompressPieces));
+        threads.back()->start();
+    }
+
+    bool needMimetype = true;
+    auto send = [&](QByteArrayView chunk) {
+        const QByteArray output = QByteArray::fromRawData(chunk.data(), chunk.size());
+        if (needMimetype) {
+            sendMimeType(url.path(), output);
+            needMimetype = false;
+        }
+        data(output);
+    };
+
+    // the output goes out in the order of the pieces
+    for (qsizetype i = 0; i < pieces.count(); ++i) {
+        QByteArray output;
+        State state;
+        {
+            QMutexLocker locker(&mutex);
+            while (states[i] == Pending && !stopped) {
+                condition.wait(&mutex, s_killCheckInterval);
+                if (wasKilled()) {
+                    stopped = true;
+                }
+            }
+            if (stopped) {
+                break;
+            }
+            state = states[i];
+            output = std::move(outputs[i]);
+            outputs[i] = QByteArray();
+        }
+
+        if (state == TooLarge) {
+            // the threads go on with the pieces after this one meanwhile
+            const PieceResult result = decompressPiece(m_compressionType, pieceData(pieces.at(i)), [&](QByteArrayView chunk) {
+                send(chunk);
+                return !wasKilled();
+            });
+            QMutexLocker locker(&mutex);
+            if (result != PieceResult::Finished) {
+                failed = result == PieceResult::Failed;
+                stopped = true;
+                break;
+            }
+        } else {
+            for (qsizetype offset = 0; offset < output.size(); offset += s_maxOutputBufferSize) {
+                send(QByteArrayView(output).sliced(offset, std::min<qsizetype>(s_maxOutputBufferSize, output.size() - offset)));
+            }
+        }
+
+        QMutexLocker locker(&mutex);
+        sent = i + 1;
+        condition.wakeAll();
+    }
+
+    {
+        QMutexLocker locker(&mutex);
+        stopped = true;
+        condition.wakeAll();
+    }
+    for (const auto &thread : threads) {
+        thread->wait();
+    }
+
+    if (failed) {
+        return KIO::WorkerResult::fail(KIO::ERR_CANNOT_READ, url.url());
+    }
+    if (needMimetype) {
+        sendMimeType(url.path(), QByteArray());
+    }
+    data(QByteArray()); // Send EOF
+    return KIO::WorkerResult::pass();
+}
+
 KIO::WorkerResult FilterProtocol::get(const QUrl &url)
 {
     // In the old solution, subURL would be set by setSubURL.
@@ -83,6 +283,16 @@ KIO::WorkerResult FilterProtocol::get(const QUrl &url)
         return KIO::WorkerResult::fail(KIO::ERR_INTERNAL, m_protocol);
     }
 
+    if ((m_compressionType == KCompressionDevice::Zstd || m_compressionType == KCompressionDevice::BZip2) && localFile.size() >= s_minParallelSize
+        && QThread::idealThreadCount() > 1) {
+        if (const uchar *mapped = localFile.map(0, localFile.size())) {
+            const QList<FilterPiece> pieces = splitIntoPieces(m_compressionType, mapped, localFile.size());
+            if (pieces.count() > 1) {
+                return getParallel(subURL, mapped, pieces);
+            }
+        }
+    }
+
     filter->init(QIODevice::ReadOnly);
 
     bool bNeedHeader = true;
@@ -90,20 +300,19 @@ KIO::WorkerResult FilterProtocol::get(const QUrl &url)
     bool bError = true;
     int result;
 
-    QByteArray inputBuffer;
-    inputBuffer.resize(8 * 1024);
-    QByteArray outputBuffer;
-    outputBuffer.resize(8 * 1024); // Start with a modest buffer
+    QByteArray inputBuffer(s_inputBufferSize, Qt::Uninitialized);
+    qint64 inputSize = 0;
+    QByteArray outputBuffer(s_minOutputBufferSize, Qt::Uninitialized);
     filter->setOutBuffer(outputBuffer.data(), outputBuffer.size());
     while (true) {
         if (filter->inBufferEmpty()) {
-            result = localFile.read(inputBuffer.data(), inputBuffer.size());
-            qDebug(KIO_FILTER_DEBUG) << "requestData: got " << result;
-            if (result <= 0) {
+            inputSize = localFile.read(inputBuffer.data(), inputBuffer.size());
+            qDebug(KIO_FILTER_DEBUG) << "requestData: got " << inputSize;
+            if (inputSize <= 0) {
                 bError = true;
                 break; // Unexpected EOF.
             }
-            filter->setInBuffer(inputBuffer.data(), inputBuffer.size());
+            filter->setInBuffer(inputBuffer.data(), inputSize);
         }
         if (bNeedHeader) {
             bError = !filter->readHeader();
@@ -114,31 +323,40 @@ KIO::WorkerResult FilterProtocol::get(const QUrl &url)
         result = filter->uncompress();
         if ((filter->outBufferAvailable() == 0) || (result == KFilterBase::End)) {
             qDebug(KIO_FILTER_DEBUG) << "avail_out = " << filter->outBufferAvailable();
-            if (filter->outBufferAvailable() != 0) {
-                // Discard unused space :-)
-                outputBuffer.resize(outputBuffer.size() - filter->outBufferAvailable());
-            }
+            const QByteArray output = QByteArray::fromRawData(outputBuffer.constData(), outputBuffer.size() - filter->outBufferAvailable());
             if (bNeedMimetype) {
-                // Can we use the "base" filename? E.g. foo.txt.bz2
-                const QString extension = QFileInfo(subURL.path()).suffix();
-                QMimeDatabase db;
-                QMimeType mime;
-                if (extension == "gz" || extension == "bz" || extension == "bz2" || extension == "zst") {
-                    QString baseName = subURL.path();
-                    baseName.truncate(baseName.length() - extension.length() - 1 /*the dot*/);
-                    qDebug(KIO_FILTER_DEBUG) << "baseName=" << baseName;
-                    mime = db.mimeTypeForFileNameAndData(baseName, outputBuffer);
-                } else {
-                    mime = db.mimeTypeForData(outputBuffer);
-                }
-                qDebug(KIO_FILTER_DEBUG) << "Emitting mimetype " << mime.name();
-                mimeType(mime.name());
+                sendMimeType(subURL.path(), output);
                 bNeedMimetype = false;
             }
-            data(outputBuffer); // Send data
+            if (!output.isEmpty()) {
+                data(output); // Send data
+            }
+            // More is coming, send it in larger chunks
+            if (filter->outBufferAvailable() == 0 && outputBuffer.size() < s_maxOutputBufferSize) {
+                outputBuffer.resize(2 * outputBuffer.size());
+            }
             filter->setOutBuffer(outputBuffer.data(), outputBuffer.size());
-            if (result == KFilterBase::End)
+        }
+        if (result == KFilterBase::End) {
+            // Go on if another member follows, otherwise we are finished
+            int left = filter->inBufferAvailable();
+            if (left < 8 && !localFile.atEnd()) {
+                std::memmove(inputBuffer.data(), inputBuffer.constData() + inputSize - left, left);
+                const qint64 read = localFile.read(inputBuffer.data() + left, inputBuffer.size() - left);
+                inputSize = left + std::max<qint64>(read, 0);
+                left = inputSize;
+            }
+            const char *next = inputBuffer.constData() + inputSize - left;
+            if (!startsMember(m_compressionType, next, left)) {
+                bError = false;
                 break; // Finished.
+            }
+            filter->terminate();
+            filter->init(QIODevice::ReadOnly);
+            filter->setInBuffer(next, left);
+            filter->setOutBuffer(outputBuffer.data(), outputBuffer.size());
+            bNeedHeader = true;
+            continue;
         }
         if (result != KFilterBase::Ok) {
             bError = true;
@@ -147,8 +365,7 @@ KIO::WorkerResult FilterProtocol::get(const QUrl &url)
     }
 
     if (!bError) {
-        result = localFile.read(inputBuffer.data(), inputBuffer.size());
-        qDebug(KIO_FILTER_DEBUG) << "requestData: got" << result << "(expecting 0)";
+        qDebug(KIO_FILTER_DEBUG) << "trailing data:" << filter->inBufferAvailable() + localFile.bytesAvailable() << "bytes (expecting 0)";
         data(QByteArray()); // Send EOF
     }
 
@@ -161,4 +378,114 @@ KIO::WorkerResult FilterProtocol::get(const QUrl &url)
     return KIO::WorkerResult::pass();
 }
 
+KIO::WorkerResult FilterProtocol::open(const QUrl &url, QIODevice::OpenMode mode)
+{
+    qDebug(KIO_FILTER_DEBUG) << url.url() << mode;
+
+    if (mode & (QIODevice::WriteOnly | QIODevice::Append | QIODevice::Truncate)) {
+        return KIO::WorkerResult::fail(KIO::ERR_CANNOT_OPEN_FOR_WRITING, url.toDisplayString());
+    }
+
+    const QString path = url.path();
+    const QFileInfo info(path);
+    if (!info.isFile()) {
+        return KIO::WorkerResult::fail(KIO::ERR_DOES_NOT_EXIST, url.toDisplayString());
+    }
+
+    // Keep the index of the last file, it grows while the file is read
+    const QString indexDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1String("/index");
+    const QString indexFile = FilterIndex::cacheFile(indexDirectory, path, m_protocol, info.size(), info.lastModified().toSecsSinceEpoch());
+    if (!m_index || indexFile != m_indexFile) {
+        storeIndex();
+        m_index = FilterIndex::load(indexFile);
+        if (!m_index) {
+            m_index = FilterIndex::create(path, m_compressionType, s_checkpointSpan);
+        }
+        m_indexFile = indexFile;
+        m_indexingTime = 0;
+    }
+
+    m_openDevice = m_index->createDevice(path, m_compressionType);
+    if (!m_openDevice->open(QIODevice::ReadOnly)) {
+        m_openDevice.reset();
+        return KIO::WorkerResult::fail(KIO::ERR_CANNOT_OPEN_FOR_READING, url.toDisplayString());
+    }
+
+    // Determine the mimetype from the start of the file, as get() does
+    QElapsedTimer timer;
+    timer.start();
+    sendMimeType(path, m_openDevice->read(1024));
+    if (!m_openDevice->seek(0)) {
+        m_openDevice.reset();
+        return KIO::WorkerResult::fail(KIO::ERR_CANNOT_SEEK, url.toDisplayString());
+    }
+
+    // The size is only known once the file was read to its end
+    m_sizeSent = false;
+    indexUpdated(timer.elapsed());
+    position(0);
+    return KIO::WorkerResult::pass();
+}
+
+KIO::WorkerResult FilterProtocol::read(KIO::filesize_t size)
+{
+    Q_ASSERT(m_openDevice);
+
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray buffer(qMin<KIO::filesize_t>(size, s_maxOutputBufferSize), Qt::Uninitialized);
+    const qint64 read = m_openDevice->read(buffer.data(), buffer.size());
+    if (read < 0) {
+        qCWarning(KIO_FILTER_DEBUG) << "Could not read" << m_openDevice->errorString();
+        m_openDevice.reset();
+        return KIO::WorkerResult::fail(KIO::ERR_CANNOT_READ, m_protocol);
+    }
+    indexUpdated(timer.elapsed());
+
+    // an empty buffer tells the end of the file
+    buffer.truncate(read);
+    data(buffer);
+    return KIO::WorkerResult::pass();
+}
+
+KIO::WorkerResult FilterProtocol::seek(KIO::filesize_t offset)
+{
+    Q_ASSERT(m_openDevice);
+
+    // The next read decompresses up to the new position, reading ahead
+    // if it is beyond what the index covers
+    if (!m_openDevice->seek(offset)) {
+        m_openDevice.reset();
+        return KIO::WorkerResult::fail(KIO::ERR_CANNOT_SEEK, m_protocol);
+    }
+    position(offset);
+    return KIO::WorkerResult::pass();
+}
+
+KIO::WorkerResult FilterProtocol::close()
+{
+    m_openDevice.reset();
+    storeIndex();
+    return KIO::WorkerResult::pass();
+}
+
+void FilterProtocol::indexUpdated(qint64 elapsed)
+{
+    m_indexingTime += elapsed;
+    if (!m_sizeSent && m_index->size() >= 0) {
+        totalSize(m_index->size());
+        m_sizeSent = true;
+    }
+}
+
+void FilterProtocol::storeIndex()
+{
+    // Indexes that were quick to build are not worth the disk space
+    if (m_index && m_index->isModified() && m_indexingTime >= s_minIndexedTime) {
+        qDebug(KIO_FILTER_DEBUG) << "Storing the index of" << m_indexFile << "built in" << m_indexingTime << "ms";
+        m_index->save(m_indexFile, s_maxIndexCacheSize);
+        m_indexingTime = 0;
+    }
+}
+
 #include "filter.moc"
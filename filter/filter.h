@@ -10,10 +10,17 @@ SPDX-License-Identifier: MIT
 #ifndef __filter_h__
 #define __filter_h__
 
+#include "filterindex.h"
+#include "filterpieces.h"
+
+#include <KCompressionDevice>
 #include <KIO/WorkerBase>
 
+#include <QList>
 #include <QObject>
 
+#include <memory>
+
 class KFilterBase;
 
 class FilterProtocol : /*public QObject, */ public KIO::WorkerBase
@@ -24,10 +31,26 @@ public:
     FilterProtocol(const QByteArray &protocol, const QByteArray &pool, const QByteArray &app);
 
     KIO::WorkerResult get(const QUrl &url) override;
+    KIO::WorkerResult open(const QUrl &url, QIODevice::OpenMode mode) override;
+    KIO::WorkerResult read(KIO::filesize_t size) override;
+    KIO::WorkerResult seek(KIO::filesize_t offset) override;
+    KIO::WorkerResult close() override;
 
 private:
+    KIO::WorkerResult getParallel(const QUrl &url, const uchar *mapped, const QList<FilterPiece> &pieces);
+    void sendMimeType(const QString &path, const QByteArray &output);
+    void indexUpdated(qint64 elapsed);
+    void storeIndex();
+
     const QString m_protocol;
+    KCompressionDevice::CompressionType m_compressionType;
     KFilterBase *filter;
+
+    std::unique_ptr<FilterIndex> m_index; ///< of the file last opened with open()
+    QString m_indexFile; ///< the cache file for m_index, named after the file it indexes
+    qint64 m_indexingTime = 0; ///< spent reading the file since m_index was loaded or stored, in ms
+    bool m_sizeSent = false; ///< whether totalSize() was sent for the file opened with open()
+    std::unique_ptr<QIODevice> m_openDevice; ///< of the file opened with open()
 };
 
 #endif
@@ -0,0 +1,151 @@
+/*
+This file is part of KDE
+
+ SPDX-FileCopyrightText: 2026 KDE Contributors
+
+SPDX-License-Identifier: MIT
+*/
+
+#include "filterindex.h"
+#include "cachedirectory.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <utility>
+
+// Bump when the layout of the stored index changes
+static const quint32 s_indexMagic = 0x4b465349; // "KFSI"
+static const quint32 s_indexVersion = 2;
+static const char s_indexSuffix[] = ".index";
+
+std::unique_ptr<FilterIndex> FilterIndex::create(const QString &fileName, KCompressionDevice::CompressionType type, qint64 span)
+{
+    std::unique_ptr<FilterIndex> index(new FilterIndex);
+    if (type == KCompressionDevice::GZip && GzipSeekDevice::isGzip(fileName)) {
+        index->m_checkpoints = std::make_shared<GzipIndex>();
+        index->m_checkpoints->span = span;
+    } else {
+        // no checkpoints within the members, restarting at a member is all there is
+        index->m_members = std::make_shared<FilterMembers>();
+    }
+    return index;
+}
+
+std::unique_ptr<QIODevice> FilterIndex::createDevice(const QString &fileName, KCompressionDevice::CompressionType type) const
+{
+    if (m_checkpoints) {
+        return std::make_unique<GzipSeekDevice>(fileName, m_checkpoints);
+    }
+    return std::make_unique<FilterSeekDevice>(fileName, type, m_members);
+}
+
+qint64 FilterIndex::size() const
+{
+    return m_checkpoints ? m_checkpoints->size : m_members->size;
+}
+
+qint64 FilterIndex::indexed() const
+{
+    if (m_checkpoints) {
+        return m_checkpoints->indexed;
+    }
+    return m_members->isComplete() ? m_members->size : m_members->members.last().output;
+}
+
+bool FilterIndex::isModified() const
+{
+    return indexed() > m_saved;
+}
+
+QString FilterIndex::cacheFile(const QString &directory, const QString &fileName, const QString &protocol, qint64 size, qint64 mtime)
+{
+    return CacheDirectory::cacheFile(directory, fileName, {QByteArray::number(size), QByteArray::number(mtime), protocol.toUtf8()}, QLatin1String(s_indexSuffix));
+}
+
+std::unique_ptr<FilterIndex> FilterIndex::load(const QString &cacheFile)
+{
+    QFile file(cacheFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_5);
+
+    quint32 magic;
+    quint32 version;
+    stream >> magic >> version;
+    if (magic != s_indexMagic || version != s_indexVersion) {
+        return nullptr;
+    }
+
+    std::unique_ptr<FilterIndex> index(new FilterIndex);
+    bool gzip = false;
+    stream >> gzip;
+    bool valid = true;
+    if (gzip) {
+        index->m_checkpoints = std::make_shared<GzipIndex>();
+        stream >> *index->m_checkpoints;
+        valid = index->m_checkpoints->isValid();
+    } else {
+        index->m_members = std::make_shared<FilterMembers>();
+        qint32 memberCount = 0;
+        stream >> index->m_members->size >> memberCount;
+        index->m_members->members.clear();
+        for (qint32 i = 0; i < memberCount && stream.status() == QDataStream::Ok; ++i) {
+            FilterMember member;
+            stream >> member.input >> member.output;
+            index->m_members->members.append(member);
+        }
+
+        // the device looks up the members by their offsets, starting with the first one
+        const QList<FilterMember> &members = index->m_members->members;
+        valid = !members.isEmpty() && members.first().input == 0 && members.first().output == 0;
+        for (qsizetype i = 1; valid && i < members.count(); ++i) {
+            valid = members.at(i).output > members.at(i - 1).output;
+        }
+        valid = valid && (index->m_members->size < 0 || index->m_members->size >= members.last().output);
+    }
+    if (stream.status() != QDataStream::Ok || !valid) {
+        file.remove();
+        return nullptr;
+    }
+
+    index->m_saved = index->indexed();
+    CacheDirectory::markUsed(file);
+    return index;
+}
+
+void FilterIndex::save(const QString &cacheFile, qint64 maximumSize)
+{
+    const QString directory = QFileInfo(cacheFile).absolutePath();
+    QDir().mkpath(directory);
+
+    QSaveFile file(cacheFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_5);
+    stream << s_indexMagic << s_indexVersion << bool(m_checkpoints);
+    if (m_checkpoints) {
+        stream << *m_checkpoints;
+    } else {
+        stream << m_members->size << qint32(m_members->members.count());
+        for (const FilterMember &member : std::as_const(m_members->members)) {
+            stream << member.input << member.output;
+        }
+    }
+
+    if (!file.commit()) {
+        return;
+    }
+    m_saved = indexed();
+
+    CacheDirectory::evict(directory, QLatin1String(s_indexSuffix), maximumSize);
+}
@@ -0,0 +1,81 @@
+/*
+This file is part of KDE
+
+ SPDX-FileCopyrightText: 2026 KDE Contributors
+
+SPDX-License-Identifier: MIT
+*/
+
+#ifndef FILTERINDEX_H
+#define FILTERINDEX_H
+
+#include "filterseekdevice.h"
+#include "gzipseekdevice.h"
+
+#include <QString>
+
+#include <memory>
+
+/**
+ * Where decompression of a compressed file can start, for reading it with
+ * random access: the members of the file, and for gzip checkpoints within the
+ * members instead.
+ *
+ * The index starts out empty and grows while the devices from createDevice()
+ * read the file, so only the data up to the furthest position read is ever
+ * decompressed. It can be stored in the user's cache directory, in a file named
+ * after a hash of the path, size and modification time of the compressed file.
+ */
+class FilterIndex
+{
+public:
+    /**
+     * Returns an empty index for @p fileName.
+     * @param span the distance between the checkpoints of a gzip file
+     */
+    static std::unique_ptr<FilterIndex> create(const QString &fileName, KCompressionDevice::CompressionType type, qint64 span);
+
+    /**
+     * Reads the index stored in @p cacheFile, returns nullptr if there is none
+     * or it cannot be read.
+     */
+    static std::unique_ptr<FilterIndex> load(const QString &cacheFile);
+
+    /**
+     * Stores the index in @p cacheFile, evicting the least recently used indexes
+     * beyond @p maximumSize from the directory of @p cacheFile.
+     */
+    void save(const QString &cacheFile, qint64 maximumSize);
+
+    /**
+     * Returns the file in @p directory to store the index of @p fileName in.
+     * @param protocol the protocol the file is read with
+     */
+    static QString cacheFile(const QString &directory, const QString &fileName, const QString &protocol, qint64 size, qint64 mtime);
+
+    /**
+     * Returns a device reading the uncompressed data of @p fileName, not open yet.
+     */
+    std::unique_ptr<QIODevice> createDevice(const QString &fileName, KCompressionDevice::CompressionType type) const;
+
+    /**
+     * Returns the size of the uncompressed data, or -1 if the file was not
+     * read to its end yet.
+     */
+    qint64 size() const;
+
+    /**
+     * Returns whether the index grew since it was created, loaded or saved.
+     */
+    bool isModified() const;
+
+private:
+    FilterIndex() = default;
+    qint64 indexed() const;
+
+    std::shared_ptr<FilterMembers> m_members;
+    std::shared_ptr<GzipIndex> m_checkpoints; ///< for a gzip file, instead of the members
+    qint64 m_saved = 0; ///< what indexed() was when the index was created, loaded or saved
+};
+
+#endif // FILTERINDEX_H
@@ -0,0 +1,202 @@
+/*
+This file is part of KDE
+
+ SPDX-FileCopyrightText: 2026 KDE Contributors
+
+SPDX-License-Identifier: MIT
+*/
+
+#include "filterpieces.h"
+
+#include <KFilterBase>
+
+#include <QByteArray>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+static const int s_outputBufferSize = 1024 * 1024;
+// setInBuffer() takes an uint, a piece of the mapped file is passed in parts
+static const qint64 s_inputPartSize = 1 << 30;
+
+static quint64 readLittleEndian(const uchar *data, int size)
+{
+    quint64 value = 0;
+    for (int i = size - 1; i >= 0; --i) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+bool startsMember(KCompressionDevice::CompressionType type, const char *data, qint64 size)
+{
+    const auto bytes = reinterpret_cast<const uchar *>(data);
+    switch (type) {
+    case KCompressionDevice::GZip:
+        return size >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b;
+    case KCompressionDevice::BZip2:
+        return size >= 3 && std::memcmp(data, "BZh", 3) == 0;
+    case KCompressionDevice::Xz:
+        return size >= 6 && std::memcmp(data, "\xfd" "7zXZ\0", 6) == 0;
+    case KCompressionDevice::Zstd: {
+        if (size < 4) {
+            return false;
+        }
+        // a frame, or a skippable frame
+        const quint64 magic = readLittleEndian(bytes, 4);
+        return magic == 0xfd2fb528 || (magic & 0xfffffff0) == 0x184d2a50;
+    }
+    default:
+        return false;
+    }
+}
+
+// The frames of a zstd file, found by walking the block headers
+static bool zstdFrames(const uchar *data, qint64 size, QList<FilterPiece> &pieces)
+{
+    qint64 pos = 0;
+    while (pos < size) {
+        if (size - pos < 8) {
+            return false;
+        }
+        const quint64 magic = readLittleEndian(data + pos, 4);
+        if ((magic & 0xfffffff0) == 0x184d2a50) {
+            // skippable frame, pzstd stores the size of the next frame in one
+            pos += 8 + qint64(readLittleEndian(data + pos + 4, 4));
+            continue;
+        }
+        if (magic != 0xfd2fb528) {
+            return false;
+        }
+
+        const uchar descriptor = data[pos + 4];
+        const bool singleSegment = descriptor & 0x20;
+        const bool checksum = descriptor & 0x04;
+        const int contentSizeSizes[] = {singleSegment ? 1 : 0, 2, 4, 8};
+        const int contentSizeSize = contentSizeSizes[descriptor >> 6];
+        if ((descriptor & 0x08) || (descriptor & 0x03)) {
+            return false; // reserved bit set, or needs a dictionary
+        }
+
+        FilterPiece piece;
+        piece.offset = pos;
+        pos += 5 + (singleSegment ? 0 : 1);
+        if (contentSizeSize > 0) {
+            if (size - pos < contentSizeSize) {
+                return false;
+            }
+            // the two byte size is stored minus 256
+            const quint64 contentSize = readLittleEndian(data + pos, contentSizeSize) + (contentSizeSize == 2 ? 256 : 0);
+            piece.outputSize = contentSize > quint64(std::numeric_limits<qint64>::max()) ? std::numeric_limits<qint64>::max() : qint64(contentSize);
+        }
+        pos += contentSizeSize;
+        pieces.append(piece);
+
+        bool last = false;
+        while (!last) {
+            if (size - pos < 3) {
+                return false;
+            }
+            const quint64 header = readLittleEndian(data + pos, 3);
+            last = header & 1;
+            const int blockType = (header >> 1) & 3;
+            const qint64 blockSize = header >> 3;
+            if (blockType == 3) {
+                return false; // reserved
+            }
+            // an RLE block holds a single byte, repeated blockSize times
+            pos += 3 + (blockType == 1 ? 1 : blockSize);
+        }
+        pos += checksum ? 4 : 0;
+    }
+    return pos == size;
+}
+
+// The streams of a bzip2 file. Every stream starts with "BZh", the block
+// size and the magic of its first block; pbzip2 and lbzip2 write a stream
+// per block. A false match splits a stream, which then fails to decompress.
+static bool bzip2Streams(const uchar *data, qint64 size, QList<FilterPiece> &pieces)
+{
+    const QByteArrayView view(reinterpret_cast<const char *>(data), size);
+    const QByteArrayView blockMagic("1AY&SY"); // 0x314159265359, the digits of pi
+    for (qsizetype i = view.indexOf(blockMagic); i >= 0; i = view.indexOf(blockMagic, i + 1)) {
+        if (i >= 4 && std::memcmp(data + i - 4, "BZh", 3) == 0 && data[i - 1] >= '1' && data[i - 1] <= '9') {
+            FilterPiece piece;
+            piece.offset = i - 4;
+            pieces.append(piece);
+        }
+    }
+    return !pieces.isEmpty() && pieces.first().offset == 0;
+}
+
+QList<FilterPiece> splitIntoPieces(KCompressionDevice::CompressionType type, const uchar *data, qint64 size)
+{
+    // xz blocks cannot be decompressed by KFilterBase either
+    QList<FilterPiece> pieces;
+    if ((type == KCompressionDevice::Zstd && !zstdFrames(data, size, pieces)) || (type == KCompressionDevice::BZip2 && !bzip2Streams(data, size, pieces))
+        || (type != KCompressionDevice::Zstd && type != KCompressionDevice::BZip2)) {
+        return {};
+    }
+
+    // a piece goes up to the next one, skippable zstd frames included
+    for (qsizetype i = 0; i < pieces.count(); ++i) {
+        const qint64 end = i + 1 < pieces.count() ? pieces.at(i + 1).offset : size;
+        pieces[i].size = end - pieces.at(i).offset;
+    }
+    return pieces;
+}
+
+PieceResult decompressPiece(KCompressionDevice::CompressionType type, QByteArrayView piece, const std::function<bool(QByteArrayView)> &sink)
+{
+    std::unique_ptr<KFilterBase> filter(KCompressionDevice::filterForCompressionType(type));
+    if (!filter) {
+        return PieceResult::Failed;
+    }
+
+    qint64 passed = 0; // the input passed to the filter so far
+    auto passInput = [&](qint64 from) {
+        passed = from + std::min(piece.size() - from, s_inputPartSize);
+        filter->setInBuffer(piece.data() + from, passed - from);
+    };
+    filter->init(QIODevice::ReadOnly);
+    passInput(0);
+    if (!filter->readHeader()) {
+        filter->terminate();
+        return PieceResult::Failed;
+    }
+
+    QByteArray output(s_outputBufferSize, Qt::Uninitialized);
+    PieceResult status = PieceResult::Failed;
+    while (true) {
+        if (filter->inBufferEmpty() && passed < piece.size()) {
+            passInput(passed);
+        }
+        filter->setOutBuffer(output.data(), output.size());
+        const KFilterBase::Result result = filter->uncompress();
+        const qsizetype produced = output.size() - filter->outBufferAvailable();
+        if (produced > 0 && !sink(QByteArrayView(output.constData(), produced))) {
+            status = PieceResult::Stopped;
+            break;
+        }
+
+        if (result == KFilterBase::End) {
+            const qint64 next = passed - filter->inBufferAvailable();
+            if (!startsMember(type, piece.data() + next, piece.size() - next)) {
+                status = PieceResult::Finished;
+                break;
+            }
+            filter->terminate();
+            filter->init(QIODevice::ReadOnly);
+            passInput(next);
+            if (!filter->readHeader()) {
+                break;
+            }
+        } else if (result != KFilterBase::Ok || (filter->inBufferEmpty() && passed == piece.size() && filter->outBufferAvailable() > 0)) {
+            break; // an error, or the piece was cut off
+        }
+    }
+    filter->terminate();
+    return status;
+}
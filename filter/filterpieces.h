@@ -0,0 +1,56 @@
+/*
+This file is part of KDE
+
+ SPDX-FileCopyrightText: 2026 KDE Contributors
+
+SPDX-License-Identifier: MIT
+*/
+
+#ifndef FILTERPIECES_H
+#define FILTERPIECES_H
+
+#include <KCompressionDevice>
+
+#include <QByteArrayView>
+#include <QList>
+
+#include <functional>
+
+/**
+ * Returns whether another member starts at @p data: a gzip member, a bzip2
+ * or xz stream or a zstd frame, as in files written by pigz, pbzip2 or pzstd
+ * or simply concatenated with cat.
+ */
+bool startsMember(KCompressionDevice::CompressionType type, const char *data, qint64 size);
+
+/**
+ * A range of a compressed file that decompresses on its own, like a zstd frame
+ */
+struct FilterPiece {
+    qint64 offset = 0;
+    qint64 size = 0;
+    qint64 outputSize = -1; ///< the size of the uncompressed data, if the format stores it
+};
+
+/**
+ * Splits the compressed file @p data into pieces that can be decompressed in
+ * parallel: the frames of a zstd file and the streams of a bzip2 file. Returns
+ * an empty list if the file cannot be split, gzip members and xz streams
+ * cannot be found without decompressing the ones before.
+ */
+QList<FilterPiece> splitIntoPieces(KCompressionDevice::CompressionType type, const uchar *data, qint64 size);
+
+enum class PieceResult {
+    Finished,
+    Stopped, ///< by the sink
+    Failed,
+};
+
+/**
+ * Decompresses @p piece with a filter of its own, passing the output to @p sink
+ * in chunks of at most 1 MiB until it returns false. A piece can hold more than
+ * one member.
+ */
+PieceResult decompressPiece(KCompressionDevice::CompressionType type, QByteArrayView piece, const std::function<bool(QByteArrayView)> &sink);
+
+#endif // FILTERPIECES_H
@@ -0,0 +1,203 @@
+/*
+This file is part of KDE
+
+ SPDX-FileCopyrightText: 2026 KDE Contributors
+
+SPDX-License-Identifier: MIT
+*/
+
+#include "filterseekdevice.h"
+#include "filterpieces.h"
+
+#include <KFilterBase>
+
+#include <algorithm>
+#include <cstring>
+
+static const int s_inputSize = 256 * 1024;
+// Enough to tell whether another member follows
+static const int s_magicSize = 8;
+
+FilterSeekDevice::FilterSeekDevice(const QString &fileName, KCompressionDevice::CompressionType type, const std::shared_ptr<FilterMembers> &members)
+    : m_file(fileName)
+    , m_type(type)
+    , m_members(members)
+{
+}
+
+FilterSeekDevice::~FilterSeekDevice()
+{
+    if (m_filter) {
+        m_filter->terminate();
+    }
+}
+
+bool FilterSeekDevice::open(OpenMode mode)
+{
+    if ((mode & WriteOnly) || !m_members || m_members->members.isEmpty() || !m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    m_input.resize(s_inputSize);
+    m_output = -1;
+    // readData() relies on pos(), and the data is decompressed into the caller's buffer anyway
+    return QIODevice::open(mode | Unbuffered);
+}
+
+void FilterSeekDevice::close()
+{
+    QIODevice::close();
+    m_file.close();
+    m_output = -1;
+}
+
+qint64 FilterSeekDevice::size() const
+{
+    return m_members->size;
+}
+
+qint64 FilterSeekDevice::readData(char *data, qint64 maxSize)
+{
+    // the size is not known before reading to the end, the filter tells it then
+    const qint64 size = this->size();
+    if (size >= 0) {
+        maxSize = std::min(maxSize, size - pos());
+    }
+    if (maxSize <= 0) {
+        return 0;
+    }
+
+    if (m_output != pos() && !moveTo(pos())) {
+        setErrorString(QStringLiteral("Cannot decompress %1").arg(m_file.fileName()));
+        return -1;
+    }
+
+    const qint64 read = uncompressTo(data, maxSize);
+    if (read < 0 || (read == 0 && size >= 0)) {
+        m_output = -1; // start over on the next read
+        setErrorString(QStringLiteral("Cannot decompress %1").arg(m_file.fileName()));
+        return -1;
+    }
+    return read;
+}
+
+qint64 FilterSeekDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data)
+    Q_UNUSED(maxSize)
+    return -1;
+}
+
+bool FilterSeekDevice::moveTo(qint64 output)
+{
+    // the last member starting at or before output
+    const QList<FilterMember> &members = m_members->members;
+    auto it = std::upper_bound(members.cbegin(), members.cend(), output, [](qint64 value, const FilterMember &member) {
+        return value < member.output;
+    });
+    if (it == members.cbegin()) {
+        return false;
+    }
+    --it;
+
+    // going on from where the filter is saves the restart, unless a member is closer
+    if (m_output < 0 || m_output > output || it->output > m_output) {
+        if (!restart(*it)) {
+            m_output = -1;
+            return false;
+        }
+    }
+
+    char skipped[16384];
+    while (m_output < output) {
+        const qint64 read = uncompressTo(skipped, std::min<qint64>(sizeof(skipped), output - m_output));
+        if (read < 0) {
+            m_output = -1;
+            return false;
+        } else if (read == 0) {
+            break; // beyond the end, readData() returns 0 from here on
+        }
+    }
+    return true;
+}
+
+bool FilterSeekDevice::restart(const FilterMember &member)
+{
+    if (!m_filter) {
+        m_filter.reset(KCompressionDevice::filterForCompressionType(m_type));
+        if (!m_filter) {
+            return false;
+        }
+    } else {
+        m_filter->terminate();
+    }
+    m_filter->init(QIODevice::ReadOnly);
+    m_filter->setInBuffer(m_input.constData(), 0);
+    m_needHeader = true;
+    m_finished = false;
+
+    if (!m_file.seek(member.input)) {
+        return false;
+    }
+    m_inputOffset = member.input;
+    m_inputSize = 0;
+    m_output = member.output;
+    return true;
+}
+
+qint64 FilterSeekDevice::uncompressTo(char *data, qint64 size)
+{
+    qint64 done = 0;
+    while (done < size && !m_finished) {
+        if (m_filter->inBufferEmpty()) {
+            m_inputOffset += m_inputSize;
+            m_inputSize = m_file.read(m_input.data(), m_input.size());
+            if (m_inputSize <= 0) {
+                return -1; // in the middle of a member
+            }
+            m_filter->setInBuffer(m_input.constData(), m_inputSize);
+        }
+        if (m_needHeader) {
+            if (!m_filter->readHeader()) {
+                return -1;
+            }
+            m_needHeader = false;
+        }
+
+        const uint available = std::min<qint64>(size - done, 1 << 30);
+        m_filter->setOutBuffer(data + done, available);
+        const KFilterBase::Result result = m_filter->uncompress();
+        const qint64 produced = available - m_filter->outBufferAvailable();
+        done += produced;
+        m_output += produced;
+
+        if (result == KFilterBase::End) {
+            // as FilterProtocol::get() does, go on with the next member if there is one
+            int left = m_filter->inBufferAvailable();
+            if (left < s_magicSize && !m_file.atEnd()) {
+                m_inputOffset += m_inputSize - left;
+                std::memmove(m_input.data(), m_input.constData() + m_inputSize - left, left);
+                const qint64 read = m_file.read(m_input.data() + left, m_input.size() - left);
+                m_inputSize = left + std::max<qint64>(read, 0);
+                left = m_inputSize;
+            }
+            const char *next = m_input.constData() + m_inputSize - left;
+            if (!startsMember(m_type, next, left)) {
+                m_finished = true;
+                m_members->size = m_output;
+                break;
+            }
+
+            // reading goes on from a member found before, so a member after the last one is the next one
+            if (m_members->members.last().output < m_output) {
+                m_members->members.append({m_inputOffset + m_inputSize - left, m_output});
+            }
+            m_filter->terminate();
+            m_filter->init(QIODevice::ReadOnly);
+            m_filter->setInBuffer(next, left);
+            m_needHeader = true;
+        } else if (result != KFilterBase::Ok) {
+            return -1;
+        }
+    }
+    return done;
+}
@@ -0,0 +1,96 @@
+/*
+This file is part of KDE
+
+ SPDX-FileCopyrightText: 2026 KDE Contributors
+
+SPDX-License-Identifier: MIT
+*/
+
+#ifndef FILTERSEEKDEVICE_H
+#define FILTERSEEKDEVICE_H
+
+#include <KCompressionDevice>
+
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QList>
+
+#include <memory>
+
+class KFilterBase;
+
+/**
+ * Where a member of a compressed file starts: a gzip member, a bzip2 or xz
+ * stream or a zstd frame, which all decompress without the data before them.
+ */
+struct FilterMember {
+    qint64 input = 0; ///< offset in the compressed file
+    qint64 output = 0; ///< offset in the uncompressed data
+};
+
+/**
+ * Where the members of a compressed file start. A FilterSeekDevice records
+ * them while it reads the file, so the list grows as the file is read, and is
+ * complete once the file was read to its end.
+ */
+struct FilterMembers {
+    QList<FilterMember> members = {FilterMember()};
+    qint64 size = -1; ///< of the uncompressed data, -1 until the file was read to its end
+
+    bool isComplete() const
+    {
+        return size >= 0;
+    }
+};
+
+/**
+ * Reads the uncompressed data of a file with random access, using the filters
+ * of KCompressionDevice.
+ *
+ * A seek restarts decompression at the member the new position is in, so for
+ * a file made of many small members, as written by pbzip2 or pzstd, it is cheap.
+ * For a file of a single member it means decompressing from the start, unless
+ * the new position is ahead of the current one. A seek beyond the last member
+ * found so far decompresses up to the new position, recording the members on
+ * the way.
+ */
+class FilterSeekDevice : public QIODevice
+{
+public:
+    /**
+     * @param members the members of the file, which the device extends while reading
+     */
+    FilterSeekDevice(const QString &fileName, KCompressionDevice::CompressionType type, const std::shared_ptr<FilterMembers> &members);
+    ~FilterSeekDevice() override;
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    /**
+     * Returns -1 if the file was not read to its end yet.
+     */
+    qint64 size() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    bool moveTo(qint64 output);
+    bool restart(const FilterMember &member);
+    qint64 uncompressTo(char *data, qint64 size);
+
+    QFile m_file;
+    const KCompressionDevice::CompressionType m_type;
+    const std::shared_ptr<FilterMembers> m_members;
+
+    std::unique_ptr<KFilterBase> m_filter;
+    bool m_needHeader = false;
+    bool m_finished = false; ///< at the end of the last member
+    qint64 m_output = -1; ///< offset in the uncompressed data where the filter is, -1 if not started
+    QByteArray m_input;
+    qint64 m_inputOffset = 0; ///< of m_input in the compressed file
+    qint64 m_inputSize = 0; ///< bytes read into m_input
+};
+
+#endif // FILTERSEEKDEVICE_H
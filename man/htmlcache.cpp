@@ -0,0 +1,99 @@
+/*  This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "htmlcache.h"
+#include "cachedirectory.h"
+#include "kio_man_debug.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+static const char s_cacheSuffix[] = ".html.z";
+
+HtmlCache::HtmlCache(const QString &directory, const QString &locale, int version, qint64 maximumSize)
+    : m_directory(directory)
+    , m_locale(locale)
+    , m_version(version)
+    , m_maximumSize(maximumSize)
+{
+}
+
+QString HtmlCache::cacheFile(const QString &path) const
+{
+    const QFileInfo info(path);
+    if (!info.isFile()) {
+        return QString();
+    }
+
+    return CacheDirectory::cacheFile(m_directory,
+                                     path,
+                                     {QByteArray::number(info.lastModified().toMSecsSinceEpoch()),
+                                      QByteArray::number(info.size()),
+                                      m_locale.toUtf8(),
+                                      QByteArray::number(m_version)},
+                                     QLatin1String(s_cacheSuffix));
+}
+
+QByteArray HtmlCache::find(const QString &path) const
+{
+    const QString fileName = cacheFile(path);
+    if (fileName.isEmpty()) {
+        return QByteArray();
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+
+    const QByteArray html = qUncompress(file.readAll());
+    if (html.isEmpty()) {
+        qCDebug(KIO_MAN_LOG) << "removing corrupt cache file" << fileName;
+        file.remove();
+        return QByteArray();
+    }
+
+    CacheDirectory::markUsed(file);
+    qCDebug(KIO_MAN_LOG) << "cache hit for" << path;
+    return html;
+}
+
+bool HtmlCache::contains(const QString &path) const
+{
+    const QString fileName = cacheFile(path);
+    return !fileName.isEmpty() && QFile::exists(fileName);
+}
+
+void HtmlCache::insert(const QString &path, const QByteArray &html)
+{
+    const QString fileName = cacheFile(path);
+    if (fileName.isEmpty() || html.isEmpty()) {
+        return;
+    }
+
+    QDir().mkpath(m_directory);
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCDebug(KIO_MAN_LOG) << "cannot write cache file" << fileName;
+        return;
+    }
+    file.write(qCompress(html));
+    if (!file.commit()) {
+        return;
+    }
+
+    evict();
+}
+
+void HtmlCache::evict() const
+{
+    const QStringList evicted = CacheDirectory::evict(m_directory, QLatin1String(s_cacheSuffix), m_maximumSize);
+    for (const QString &fileName : evicted) {
+        qCDebug(KIO_MAN_LOG) << "evicted" << fileName;
+    }
+}
@@ -0,0 +1,56 @@
+/*  This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+#ifndef HTMLCACHE_H
+#define HTMLCACHE_H
+
+#include <QByteArray>
+#include <QString>
+
+/**
+ * Cache of man pages converted to HTML, so that opening a page again does not
+ * need to decompress and convert it again.
+ *
+ * Every page is stored compressed in its own file, named after a hash of the page's
+ * path, modification time and size, the locale and the converter version. A changed
+ * page therefore simply misses the cache. Reading an entry refreshes its modification
+ * time, and inserting one evicts the least recently used entries beyond the size limit.
+ */
+class HtmlCache
+{
+public:
+    /**
+     * @param locale the languages used for the translated texts in the output
+     * @param version the version of the converter, to be changed whenever its output changes
+     * @param maximumSize the maximum size of all cache files together, in bytes
+     */
+    HtmlCache(const QString &directory, const QString &locale, int version, qint64 maximumSize);
+
+    /**
+     * Returns the cached HTML for the man page @p path, or a null QByteArray.
+     */
+    QByteArray find(const QString &path) const;
+
+    /**
+     * Returns whether there is HTML for the man page @p path, without marking it as used.
+     */
+    bool contains(const QString &path) const;
+
+    /**
+     * Stores @p html as the output for the man page @p path.
+     */
+    void insert(const QString &path, const QByteArray &html);
+
+private:
+    QString cacheFile(const QString &path) const;
+    void evict() const;
+
+    const QString m_directory;
+    const QString m_locale;
+    const int m_version;
+    const qint64 m_maximumSize;
+};
+
+#endif // HTMLCACHE_H
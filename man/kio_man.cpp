@@ -5,7 +5,9 @@
 */
 
 #include "kio_man.h"
+#include "htmlcache.h"
 #include "kio_man_debug.h"
+#include "manindex.h"
 
 #include <QByteArray>
 #include <QCoreApplication>
@@ -21,7 +23,8 @@
 #include <KLocalizedString>
 
 #include "man2html.h"
-#include <KCompressionDevice>
+
+#include <algorithm>
 
 using namespace KIO;
 
@@ -32,46 +35,23 @@ class KIOPluginForMetaData : public QObject
     Q_PLUGIN_METADATA(IID "org.kde.kio.worker.man" FILE "man.json")
 };
 
-MANProtocol *MANProtocol::s_self = nullptr;
-
 static const char *SGML2ROFF_DIRS = "/usr/lib/sgml";
 static const char *SGML2ROFF_EXECUTABLE = "sgml2roff";
 
-/*
- * Drop trailing compression suffix from name
- */
-static QString stripCompression(const QString &name)
-{
-    int pos = name.length();
-
-    if (name.endsWith(".gz"))
-        pos -= 3;
-    else if (name.endsWith(".z", Qt::CaseInsensitive))
-        pos -= 2;
-    else if (name.endsWith(".bz2"))
-        pos -= 4;
-    else if (name.endsWith(".bz"))
-        pos -= 3;
-    else if (name.endsWith(".lzma"))
-        pos -= 5;
-    else if (name.endsWith(".xz"))
-        pos -= 3;
-    else if (name.endsWith(".zst"))
-        pos -= 4;
-    else if (name.endsWith(".br"))
-        pos -= 3;
-
-    return (pos > 0 ? name.left(pos) : name);
-}
+// Bump whenever a change to man2html changes its output, to invalidate cached pages
+static const int s_converterVersion = 1;
+
+// Upper bound for the compressed pages in the HTML cache
+static const qint64 s_htmlCacheSize = 64 * 1024 * 1024;
+
+// A page is sent in growing chunks: the first one small so that the view can start
+// to render early, later ones large to keep the number of messages to the application low
+static const int s_firstOutputChunkSize = 4 * 1024;
+static const int s_maxOutputChunkSize = 256 * 1024;
 
-/*
- * Drop trailing compression suffix and section from name
- */
-static QString stripExtension(const QString &name)
+static int nextOutputChunkSize(int size)
 {
-    QString wc = stripCompression(name);
-    const int pos = wc.lastIndexOf('.');
-    return (pos > 0 ? wc.left(pos) : wc);
+    return std::min(size * 4, s_maxOutputChunkSize);
 }
 
 static bool parseUrl(const QString &_url, QString &title, QString &section)
@@ -118,10 +98,13 @@ static bool parseUrl(const QString &_url, QString &title, QString &section)
 MANProtocol::MANProtocol(const QByteArray &pool_socket, const QByteArray &app_socket)
     : QObject()
     , WorkerBase("man", pool_socket, app_socket)
+    , m_pageIndex(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1String("/pages.index"))
+    , m_whatisIndex(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1String("/whatis.index"))
+    , m_htmlCache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1String("/html"),
+                  KLocalizedString::languages().join(QLatin1Char(':')),
+                  s_converterVersion,
+                  s_htmlCacheSize)
 {
-    Q_ASSERT(s_self == nullptr);
-    s_self = this;
-
     /* clang-format off */
     m_sectionNames << "0"
                    << "0p"
@@ -142,54 +125,12 @@ MANProtocol::MANProtocol(const QByteArray &pool_socket, const QByteArray &app_so
     /* clang-format on */
 }
 
-MANProtocol *MANProtocol::self()
-{
-    return s_self;
-}
-
-MANProtocol::~MANProtocol()
-{
-    s_self = nullptr;
-}
-
-void MANProtocol::parseWhatIs(QMap<QString, QString> &i, QTextStream &t, const QString &mark)
-{
-    const QRegularExpression re(mark);
-    QString l;
-    while (!t.atEnd()) {
-        l = t.readLine();
-        QRegularExpressionMatch match = re.match(l);
-        int pos = match.capturedStart(0);
-        if (pos != -1) {
-            QString names = l.left(pos);
-            QString descr = l.mid(match.capturedEnd(0));
-            while ((pos = names.indexOf(",")) != -1) {
-                i[names.left(pos++)] = descr;
-                while (names[pos] == ' ')
-                    pos++;
-                names = names.mid(pos);
-            }
-            i[names] = descr;
-        }
-    }
-}
-
-bool MANProtocol::addWhatIs(QMap<QString, QString> &i, const QString &name, const QString &mark)
-{
-    QFile f(name);
-    if (!f.open(QIODevice::ReadOnly))
-        return false;
-
-    QTextStream t(&f);
-    parseWhatIs(i, t, mark);
-    return true;
-}
+MANProtocol::~MANProtocol() = default;
 
 QMap<QString, QString> MANProtocol::buildIndexMap(const QString &section)
 {
     qCDebug(KIO_MAN_LOG) << "for section" << section;
 
-    QMap<QString, QString> i;
     QStringList man_dirs = manDirectories();
     // Supplementary places for whatis databases
     man_dirs += m_mandbpath;
@@ -198,43 +139,8 @@ QMap<QString, QString> MANProtocol::buildIndexMap(const QString &section)
     if (!man_dirs.contains("/var/catman"))
         man_dirs << "/var/catman";
 
-    QStringList names;
-    names << "whatis.db"
-          << "whatis";
-    const QString mark = "\\s+\\(" + section + "[a-z]*\\)\\s+-\\s+";
-
-    int count0;
-    for (const QString &it_dir : qAsConst(man_dirs)) {
-        if (!QFile::exists(it_dir))
-            continue;
-
-        bool added = false;
-        for (const QString &it_name : qAsConst(names)) {
-            count0 = i.count();
-            if (addWhatIs(i, (it_dir + '/' + it_name), mark)) {
-                qCDebug(KIO_MAN_LOG) << "added" << (i.count() - count0) << "from" << it_name << "in" << it_dir;
-                added = true;
-                break;
-            }
-        }
-
-        if (!added) {
-            // Nothing was able to be added by scanning the directory,
-            // so try parsing the output of the whatis(1) command.
-            QProcess proc;
-            proc.setProgram("whatis");
-            proc.setArguments(QStringList() << "-M" << it_dir << "-w"
-                                            << "*");
-            proc.setProcessChannelMode(QProcess::ForwardedErrorChannel);
-            proc.start();
-            proc.waitForFinished();
-            QTextStream t(proc.readAllStandardOutput(), QIODevice::ReadOnly);
-
-            count0 = i.count();
-            parseWhatIs(i, t, mark);
-            qCDebug(KIO_MAN_LOG) << "added" << (i.count() - count0) << "from whatis in" << it_dir;
-        }
-    }
+    m_whatisIndex.update(man_dirs);
+    const QMap<QString, QString> i = m_whatisIndex.entries(section);
 
     qCDebug(KIO_MAN_LOG) << "returning" << i.count() << "index entries";
     return i;
@@ -244,6 +150,10 @@ QMap<QString, QString> MANProtocol::buildIndexMap(const QString &section)
 
 QStringList MANProtocol::manDirectories()
 {
+    // The man path does not change during the lifetime of the worker
+    if (!m_manDirectories.isEmpty())
+        return m_manDirectories;
+
     checkManPaths();
     //
     // Build a list of man directories including translations
@@ -253,19 +163,21 @@ QStringList MANProtocol::manDirectories()
 
     for (const QString &it_dir : qAsConst(m_manpath)) {
         // Translated pages in "<mandir>/<lang>" if the directory
-        // exists
+        // exists. List the subdirectories once instead of probing
+        // for every known locale.
+        QDir md(it_dir);
+        md.setFilter(QDir::Dirs | QDir::NoDotAndDotDot);
+        const QStringList subdirs = md.entryList();
+        const QSet<QString> existing(subdirs.cbegin(), subdirs.cend());
+
         for (const QLocale &it_loc : locales) {
             // TODO: languageToString() is wrong, that returns the readable name
             // of the language.  We want the country code returned by name().
             QString lang = QLocale::languageToString(it_loc.language());
-            if (!lang.isEmpty() && lang != QString("C")) {
-                QString dir = it_dir + '/' + lang;
-                QDir d(dir);
-                if (d.exists()) {
-                    const QString p = d.canonicalPath();
-                    if (!man_dirs.contains(p))
-                        man_dirs += p;
-                }
+            if (!lang.isEmpty() && lang != QString("C") && existing.contains(lang)) {
+                const QString p = QDir(it_dir + '/' + lang).canonicalPath();
+                if (!man_dirs.contains(p))
+                    man_dirs += p;
             }
         }
 
@@ -276,127 +188,15 @@ QStringList MANProtocol::manDirectories()
     }
 
     qCDebug(KIO_MAN_LOG) << "returning" << man_dirs.count() << "man directories";
+    m_manDirectories = man_dirs;
     return man_dirs;
 }
 
-QStringList MANProtocol::findPages(const QString &_section, const QString &title, bool full_path)
-{
-    QStringList list;
-    // qCDebug(KIO_MAN_LOG) << "findPages '" << section << "' '" << title << "'\n";
-    if (title.startsWith('/')) // absolute man page path
-    {
-        list.append(title); // just that and nothing else
-        return list;
-    }
-
-    const QString star("*"); // flag for finding sections
-    const QString man("man"); // prefix for ROFF subdirectories
-    const QString sman("sman"); // prefix for SGML subdirectories
-
-    // Generate a list of applicable sections
-    QStringList sect_list;
-    if (!_section.isEmpty()) // section requested as parameter
-    {
-        sect_list += _section;
-
-        // It's not clear what this code does.  If a section with a letter
-        // suffix is specified, for example "3p", both "3p" and "3" are
-        // added to the section list.  The result is that "man:(3p)" returns
-        // the same entries as "man:(3)"
-        QString section = _section;
-        while ((!section.isEmpty()) && (section.at(section.length() - 1).isLetter())) {
-            section.truncate(section.length() - 1);
-            sect_list += section;
-        }
-    } else {
-        sect_list += star;
-    }
-
-    const QStringList man_dirs = manDirectories();
-    QStringList nameFilters;
-    nameFilters += man + '*';
-    nameFilters += sman + '*';
-
-    // Find man pages in the sections specified above,
-    // or all sections.
-    //
-    // Do not convert this loop to an iterator, or 'it_s' below
-    // to a reference.  The 'sect_list' list can be modified
-    // within the loop.
-    for (int i = 0; i < sect_list.count(); ++i) {
-        const QString it_s = sect_list.at(i);
-        QString it_real = it_s.toLower();
-
-        // Find applicable pages within all man directories.
-        for (const QString &man_dir : man_dirs) {
-            // Find all subdirectories named "man*" and "sman*"
-            // to extend the list of sections and find the correct
-            // case for the section suffix.
-            QDir dp(man_dir);
-            dp.setFilter(QDir::Dirs | QDir::NoDotAndDotDot);
-            dp.setNameFilters(nameFilters);
-            const QStringList entries = dp.entryList();
-            for (const QString &file : entries) {
-                QString sect;
-                if (file.startsWith(man))
-                    sect = file.mid(man.length());
-                else if (file.startsWith(sman))
-                    sect = file.mid(sman.length());
-                // Should never happen, because of the name filter above.
-                if (sect.isEmpty())
-                    continue;
-
-                if (sect.toLower() == it_real)
-                    it_real = sect;
-
-                // Only add sect if not already contained, avoid duplicates
-                if (!sect_list.contains(sect) && _section.isEmpty()) {
-                    // qCDebug(KIO_MAN_LOG) << "another section " << sect;
-                    sect_list += sect;
-                }
-            }
-
-            if (it_s != star) // finding pages, not just sections
-            {
-                const QString dir = man_dir + '/' + man + it_real + '/';
-                list.append(findManPagesInSection(dir, title, full_path));
-
-                const QString sdir = man_dir + '/' + sman + it_real + '/';
-                list.append(findManPagesInSection(sdir, title, full_path));
-            }
-        }
-    }
-
-    // qCDebug(KIO_MAN_LOG) << "finished " << list << " " << sect_list;
-    return list;
-}
-
-QStringList MANProtocol::findManPagesInSection(const QString &dir, const QString &title, bool full_path)
+QStringList MANProtocol::findPages(const QString &section, const QString &title, bool full_path)
 {
-    QStringList list;
-
-    qCDebug(KIO_MAN_LOG) << "in" << dir << "title" << title;
-    const bool title_given = !title.isEmpty();
-
-    QDir dp(dir);
-    dp.setFilter(QDir::Files);
-    const QStringList names = dp.entryList();
-    for (const QString &name : names) {
-        if (title_given) {
-            // check title if we're looking for a specific page
-            if (!name.startsWith(title))
-                continue;
-            // beginning matches, do a more thorough check...
-            const QString tmp_name = stripExtension(name);
-            if (tmp_name != title)
-                continue;
-        }
-
-        list.append(full_path ? dir + name : name);
-    }
-
-    qCDebug(KIO_MAN_LOG) << "returning" << list.count() << "pages";
-    return (list);
+    // Only lists the directories that changed since the last call
+    m_pageIndex.update(manDirectories());
+    return findManPages(m_pageIndex.directories(), section, title, full_path);
 }
 
 //---------------------------------------------------------------------
@@ -404,29 +204,26 @@ QStringList MANProtocol::findManPagesInSection(const QString &dir, const QString
 void MANProtocol::output(const char *insert)
 {
     if (insert) {
-        m_outputBuffer.write(insert, strlen(insert));
+        m_outputData.append(insert);
     }
-    if (!insert || m_outputBuffer.pos() >= 2048) {
-        m_outputBuffer.close();
-        data(m_outputBuffer.buffer());
-        m_outputBuffer.setData(QByteArray());
-        m_outputBuffer.open(QIODevice::WriteOnly);
+    if (!insert || m_outputData.size() >= m_outputChunkSize) {
+        flushOutput();
     }
 }
 
-#ifndef SIMPLE_MAN2HTML
-// called by man2html
-extern char *read_man_page(const char *filename)
-{
-    return MANProtocol::self()->readManPage(filename);
-}
-
-// called by man2html
-extern void output_real(const char *insert)
+void MANProtocol::flushOutput()
 {
-    MANProtocol::self()->output(insert);
+    if (m_outputData.isEmpty()) {
+        return;
+    }
+    if (m_cachingPage) {
+        m_renderedPage.append(m_outputData.constData(), m_outputData.size());
+    }
+    data(m_outputData);
+    // keeps the allocation for the next chunk
+    m_outputData.resize(0);
+    m_outputChunkSize = nextOutputChunkSize(m_outputChunkSize);
 }
-#endif
 
 //---------------------------------------------------------------------
 
@@ -472,49 +269,80 @@ KIO::WorkerResult MANProtocol::get(const QUrl &url)
     // Sort the list of pages now, for display if required and for
     // testing for equivalents below.
     std::sort(foundPages.begin(), foundPages.end());
-    const QString pageFound = foundPages.first();
-
-    if (foundPages.count() > 1) {
-        // See if the multiple pages found refer to the same man page, for example
-        // if 'foo.1' and 'foo.1.gz' were both found.  To make this generic with
-        // regard to compression suffixes, assume that the first page name (after
-        // the list has been sorted above) is the shortest.  Then check that all of
-        // the others are the same with a possible compression suffix added.
-        for (int i = 1; i < foundPages.count(); ++i) {
-            if (!foundPages[i].startsWith(pageFound + '.')) {
-                // There is a page which is not the same as the reference, even
-                // allowing for a compression suffix.  Output the list of multiple
-                // pages only.
-                outputMatchingPages(foundPages);
-                return KIO::WorkerResult::pass();
-            }
+
+    // See if the multiple pages found refer to the same man page, for example
+    // if 'foo.1' and 'foo.1.gz' were both found. Otherwise output the list of
+    // multiple pages only.
+    const QString pageFound = uniqueManPage(foundPages);
+    if (pageFound.isEmpty()) {
+        outputMatchingPages(foundPages);
+        return KIO::WorkerResult::pass();
+    }
+
+    const QByteArray cached = m_htmlCache.find(pageFound);
+    if (!cached.isNull()) {
+        int chunkSize = s_firstOutputChunkSize;
+        for (qsizetype pos = 0; pos < cached.size(); pos += chunkSize, chunkSize = nextOutputChunkSize(chunkSize)) {
+            data(QByteArray::fromRawData(cached.constData() + pos, std::min<qsizetype>(chunkSize, cached.size() - pos)));
         }
+        data(QByteArray());
+        prefetchLinks(pageFound, cached);
+        return KIO::WorkerResult::pass();
     }
 
-    m_outputBuffer.open(QIODevice::WriteOnly);
+    m_outputChunkSize = s_firstOutputChunkSize;
+    m_cachingPage = true;
     const QByteArray filename = QFile::encodeName(pageFound);
     const char *buf = readManPage(filename);
     if (!buf) {
         // readManPage emits an error page instead, so still passing
+        m_cachingPage = false;
         return KIO::WorkerResult::pass();
         ;
     }
 
-    // will call output_real
-    scan_man_page(buf);
+    // will call output()
+    scan_man_page(m_converter, *this, buf);
     delete[] buf;
 
     output(nullptr); // flush
 
-    m_outputBuffer.close();
-    data(m_outputBuffer.buffer());
-    m_outputBuffer.setData(QByteArray());
+    // error pages for included pages must not end up in the cache
+    const bool converted = m_cachingPage;
+    if (converted) {
+        m_htmlCache.insert(pageFound, m_renderedPage);
+    }
+    m_cachingPage = false;
 
     // tell we are done
     data(QByteArray());
+
+    if (converted) {
+        prefetchLinks(pageFound, m_renderedPage);
+    }
+    m_renderedPage.clear();
     return KIO::WorkerResult::pass();
 }
 
+// Converts the pages linked from the page being viewed while the user reads it,
+// if enabled with PrefetchLinkedPages=true in kio_manrc
+void MANProtocol::prefetchLinks(const QString &path, const QByteArray &html)
+{
+    if (!configValue(QStringLiteral("PrefetchLinkedPages"), false)) {
+        m_prefetcher.reset();
+        return;
+    }
+
+    if (!m_prefetcher) {
+        m_prefetcher = std::make_unique<PagePrefetcher>(m_htmlCache);
+    }
+    m_prefetcher->start(path,
+                        html,
+                        m_pageIndex.directories(),
+                        configValue(QStringLiteral("PrefetchDepth"), 1),
+                        configValue(QStringLiteral("PrefetchCpuTime"), 2000));
+}
+
 //---------------------------------------------------------------------
 
 // If this function returns nullptr to indicate a problem,
@@ -546,52 +374,26 @@ char *MANProtocol::readManPage(const char *_filename)
         proc.waitForFinished();
         array = proc.readAllStandardOutput();
     } else {
-        if (QDir::isRelativePath(filename)) {
-            qCDebug(KIO_MAN_LOG) << "relative" << filename;
-            filename = QDir::cleanPath(lastdir + '/' + filename).toUtf8();
-            qCDebug(KIO_MAN_LOG) << "resolved to" << filename;
-        }
+        const ManPageFile file = readManPageFile(filename, lastdir);
+        filename = file.fileName;
+        dirName = file.dirName;
 
-        lastdir = filename.left(filename.lastIndexOf('/'));
-
-        // get the last directory name (which might be a language name, to be able to guess the encoding)
-        QDir dir(lastdir);
-        dir.cdUp();
-        dirName = QFile::encodeName(dir.dirName());
-
-        if (!QFile::exists(QFile::decodeName(filename))) // if given file does not exist, find with suffix
-        {
-            qCDebug(KIO_MAN_LOG) << "not existing " << filename;
-            QDir mandir(lastdir);
+        if (file.status == ManPageFile::NotFound) {
             const QString nameFilter = filename.mid(filename.lastIndexOf('/') + 1) + ".*";
-            mandir.setNameFilters(QStringList(nameFilter));
-
-            const QStringList entries = mandir.entryList();
-            if (entries.isEmpty()) {
-                outputError(xi18nc("@info",
-                                   "The specified man page references "
-                                   "another page <filename>%1</filename>,"
-                                   "<nl/>"
-                                   "but the referenced page <filename>%2</filename> "
-                                   "could not be found.",
-                                   QFile::decodeName(filename),
-                                   QDir::cleanPath(lastdir + '/' + nameFilter)));
-                return nullptr;
-            }
-
-            filename = lastdir + '/' + QFile::encodeName(entries.first());
-            qCDebug(KIO_MAN_LOG) << "resolved to " << filename;
-        }
-
-        KCompressionDevice fd(QFile::encodeName(filename));
-
-        if (!fd.open(QIODevice::ReadOnly)) {
+            outputError(xi18nc("@info",
+                               "The specified man page references "
+                               "another page <filename>%1</filename>,"
+                               "<nl/>"
+                               "but the referenced page <filename>%2</filename> "
+                               "could not be found.",
+                               QFile::decodeName(filename),
+                               QDir::cleanPath(lastdir + '/' + nameFilter)));
+            return nullptr;
+        } else if (file.status == ManPageFile::NotReadable) {
             outputError(xi18nc("@info", "The man page <filename>%1</filename> could not be read.", QFile::decodeName(filename)));
             return nullptr;
         }
-
-        array = fd.readAll();
-        qCDebug(KIO_MAN_LOG) << "read " << array.size();
+        array = file.data;
     }
 
     if (array.isEmpty()) {
@@ -647,6 +449,8 @@ void MANProtocol::outputFooter(QTextStream &os)
 // It is assumed that mimeType() has already been called at the start of get().
 void MANProtocol::outputError(const QString &errmsg)
 {
+    m_cachingPage = false;
+
     QByteArray array;
     QTextStream os(&array, QIODevice::WriteOnly);
 
@@ -781,13 +585,14 @@ static QString sectionName(const QString &section)
     return QString();
 }
 
-QStringList MANProtocol::buildSectionList(const QStringList &dirs) const
+QStringList MANProtocol::buildSectionList(const QStringList &dirs)
 {
+    m_pageIndex.update(dirs);
+
     QStringList l;
     for (const QString &it_sect : qAsConst(m_sectionNames)) {
-        for (const QString &it_dir : dirs) {
-            QDir d(it_dir + "/man" + it_sect);
-            if (d.exists()) {
+        for (const ManPageIndex::ManDirectory &it_dir : m_pageIndex.directories()) {
+            if (it_dir.section("man" + it_sect)) {
                 l << it_sect;
                 break;
             }
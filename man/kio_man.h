@@ -7,12 +7,19 @@
 #ifndef __kio_man_h__
 #define __kio_man_h__
 
-#include <QBuffer>
+#include <QByteArray>
+
+#include "htmlcache.h"
+#include "man2html.h"
+#include "manindex.h"
+#include "pageprefetcher.h"
 
 #include <KIO/Global>
 #include <KIO/WorkerBase>
 
-class MANProtocol : public QObject, public KIO::WorkerBase
+#include <memory>
+
+class MANProtocol : public QObject, public KIO::WorkerBase, public Man2HtmlSink
 {
     Q_OBJECT
 
@@ -27,14 +34,14 @@ public:
     KIO::WorkerResult listDir(const QUrl &url) override;
 
     // the following two functions are the interface to man2html
-    void output(const char *insert);
-    char *readManPage(const char *filename);
-
-    static MANProtocol *self();
+    void output(const char *insert) override;
+    char *readManPage(const char *filename) override;
 
     void showIndex(const QString &section);
 
 private:
+    void flushOutput();
+    void prefetchLinks(const QString &path, const QByteArray &html);
     void outputError(const QString &errmsg);
     void outputMatchingPages(const QStringList &matchingPages);
 
@@ -43,13 +50,10 @@ private:
     void checkManPaths();
     QStringList manDirectories();
     QMap<QString, QString> buildIndexMap(const QString &section);
-    bool addWhatIs(QMap<QString, QString> &i, const QString &f, const QString &mark);
-    void parseWhatIs(QMap<QString, QString> &i, QTextStream &t, const QString &mark);
     QStringList findPages(const QString &section, const QString &title, bool full_path = true);
 
-    QStringList buildSectionList(const QStringList &dirs) const;
+    QStringList buildSectionList(const QStringList &dirs);
     void constructPath(QStringList &constr_path, QStringList constr_catmanpath);
-    QStringList findManPagesInSection(const QString &dir, const QString &title, bool full_path);
 
     void outputHeader(QTextStream &os, const QString &header, const QString &title = QString());
     void outputFooter(QTextStream &os);
@@ -57,16 +61,24 @@ private:
     bool getProgramPath();
 
 private:
-    static MANProtocol *s_self;
     QByteArray lastdir;
 
     QStringList m_manpath; ///< Path of man directories
     QStringList m_mandbpath; ///< Path of catman directories
     QStringList m_sectionNames;
+    QStringList m_manDirectories; ///< Man directories including translations, see manDirectories()
+    ManPageIndex m_pageIndex;
+    WhatisIndex m_whatisIndex;
+    HtmlCache m_htmlCache;
+    std::unique_ptr<PagePrefetcher> m_prefetcher; ///< Only when enabled
 
     QString mySgml2RoffPath;
 
-    QBuffer m_outputBuffer; ///< Buffer for the output
+    Man2HtmlContext m_converter;
+    QByteArray m_outputData; ///< Output not sent yet
+    int m_outputChunkSize = 0; ///< Size of the next chunk of output to send
+    QByteArray m_renderedPage; ///< All output of the page being converted, for the HTML cache
+    bool m_cachingPage = false;
 };
 
 #endif
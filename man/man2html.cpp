@@ -116,6 +116,7 @@
 
 #include <config-runtime.h>
 
+#include <algorithm>
 #include <ctype.h>
 
 #include <string.h>
@@ -126,7 +127,7 @@
 #include <QByteArray>
 #include <QDateTime>
 #include <QDebug>
-#include <QMap>
+#include <QHash>
 #include <QRegularExpression>
 #include <QStack>
 #include <QString>
@@ -164,12 +165,6 @@
 #define BD_LITERAL 1
 #define BD_INDENT 2
 
-static int s_nroff = 1; // NROFF mode by default
-
-static QByteArray mandoc_name; // Nm can store the first used name
-
-static int mandoc_name_count = 0; /* Don't break on the first Nm */
-
 /* below this you should not change anything unless you know a lot
 ** about this program or about troff.
 */
@@ -233,76 +228,266 @@ public:
 };
 
 /**
- * Map of character definitions
+ * Class for the arguments of a request
+ *
+ * The arguments are stored one after the other in a single buffer, each with
+ * a terminating NUL, so that reading the arguments of a line does not need an
+ * allocation per argument. The buffer keeps its capacity when cleared.
  */
-static QMap<QByteArray, StringDefinition> s_characterDefinitionMap;
+class ArgumentList
+{
+public:
+    ArgumentList()
+    {
+        clear();
+    }
 
-/**
- * Map of string variable and macro definitions
- * \note String variables and macros are the same thing!
- */
-static QMap<QByteArray, StringDefinition> s_stringDefinitionMap;
+    qsizetype count() const
+    {
+        return m_offsets.size();
+    }
+
+    /// The argument \p i, which can be modified in place like the page itself
+    char *operator[](qsizetype i)
+    {
+        return m_data.data() + m_offsets.at(i);
+    }
+
+    void clear()
+    {
+        // scan_troff() looks up to two characters back from where it starts
+        m_data.fill('\0', 2);
+        m_offsets.resize(0);
+        m_current = m_data.size();
+    }
+
+    /// Appends \p c to the argument being read
+    void append(char c)
+    {
+        m_data.append(c);
+    }
+
+    /// Ends the argument being read
+    void endArgument()
+    {
+        m_offsets.append(m_current);
+        m_data.append('\0');
+        m_current = m_data.size();
+    }
+
+    /// Drops what was appended since the last argument
+    void discardArgument()
+    {
+        m_data.resize(m_current);
+    }
+
+    void replace(qsizetype i, const char *arg)
+    {
+        m_offsets[i] = m_data.size();
+        m_data.append(arg);
+        m_data.append('\0');
+        m_current = m_data.size();
+    }
+
+private:
+    QByteArray m_data;
+    QList<qsizetype> m_offsets;
+    qsizetype m_current; ///< Start of the argument being read
+};
+
+class TABLEROW;
 
 /**
- * Map of number registers
- * \note Intern number registers (starting with a dot are not handled here)
+ * All state of a conversion, so that pages can be converted by several
+ * contexts at the same time.
  */
-static QMap<QByteArray, NumberDefinition> s_numberDefinitionMap;
+class Man2HtmlContextPrivate
+{
+public:
+    void scan_man_page(const char *man_page);
+
+    Man2HtmlSink *sink = nullptr;
+
+private:
+    void InitCharacterDefinitions();
+    void InitStringDefinitions();
+    void InitNumberDefinitions();
+    void fill_old_character_definitions();
+
+    void add_links(char *c);
+    void out_html(const char *c);
+    void write_html(const char *c, size_t length);
+    void flush_html();
+    void checkListStack();
+    QByteArray set_font(const QByteArray &name);
+    QByteArray change_to_size(int nr);
+
+    QByteArray scan_named_character(char *&c);
+    QByteArray scan_named_string(char *&c);
+    QByteArray scan_dollar_parameter(char *&c);
+    int read_only_number_register(const QByteArray &name);
+    int getNumberRegisterValue(const QByteArray &name, int sign = 0);
+    int scan_number_register(char *&c);
+    QByteArray scan_named_font(char *&c);
+    QByteArray scan_number_code(char *&c);
+    char *scan_escape_direct(char *c, QByteArray &cstr);
+    char *scan_escape(char *c);
+
+    char *scan_format(char *c, TABLEROW **result, int *maxcol);
+    char *scan_table(char *c);
+    char *scan_expression(char *c, int *result, const unsigned int numLoop);
+    char *scan_expression(char *c, int *result);
+    void trans_char(char *c, char s, char t);
+    void getArguments(char *&c, ArgumentList &args, QList<char *> *argPointers = nullptr);
+    char *skip_till_newline(char *c);
+    void request_while(char *&c, int j, bool mdoc);
+    void request_mixed_fonts(char *&c, int j, const char *font1, const char *font2, const bool mode, const bool inFMode);
+    char *process_quote(char *c, int j, const char *open, const char *close);
+    char *scan_request(char *c);
+    char *scan_troff(char *c, bool san, char **result);
+    char *scan_troff_mandoc(char *c, bool san, char **result);
+
+    int nroff = 1; // NROFF mode by default
+
+    QByteArray mandoc_name; // Nm can store the first used name
+
+    int mandoc_name_count = 0; /* Don't break on the first Nm */
+
+    // mdoc(7) stuff
+    bool mandoc_synopsis = false; /* True if we are in the synopsis section */
+    bool mandoc_command = false; /* True if this is mdoc(7) page */
+    int mandoc_bd_options = 0; /* Only copes with non-nested Bd's */
+    int function_argument = 0; // Number of function argument (.Fo, .Fa, .Fc)
+    bool mandoc_line = false; // Signals whether to look for embedded mandoc commands.
+
+    /**
+     * Map of character definitions
+     * \note These are never changed by a page, so they are kept for all pages
+     */
+    QHash<QByteArray, StringDefinition> characterDefinitionMap;
+
+    /**
+     * Map of string variable and macro definitions
+     * \note String variables and macros are the same thing!
+     */
+    QHash<QByteArray, StringDefinition> stringDefinitionMap;
+
+    /**
+     * Map of number registers
+     * \note Intern number registers (starting with a dot are not handled here)
+     */
+    QHash<QByteArray, NumberDefinition> numberDefinitionMap;
+
+    /* char eqndelimopen=0, eqndelimclose=0; */
+    char escapesym = '\\', nobreaksym = '\'', controlsym = '.', fieldsym = 0, padsym = 0;
+
+    char *buffer = nullptr;
+    int buffpos = 0, buffmax = 0;
+    bool scaninbuff = false;
+    int itemdepth = 0;
+    int in_div = 0;
+    int dl_set[20] = {0};
+    QStack<QByteArray> listItemStack;
+    bool still_dd = 0;
+    int tabstops[20] = {8, 16, 24, 32, 40, 48, 56, 64, 72, 80, 88, 96};
+    int maxtstop = 12;
+    int curpos = 0;
+    bool break_the_while_loop = false;
+
+    QList<QByteArray> argumentList;
+
+    QByteArray dollarZero; // Value of $0
+
+    char outbuffer[NULL_TERMINATED(HUGE_STR_MAX)];
+    int obp = 0;
+    int no_newline_output = 0;
+    int newline_for_fun = 0;
+    bool output_possible = false;
+
+    bool ignore_links = false;
+
+    QByteArray current_font;
+    int current_size = 0;
 
-static void fill_old_character_definitions(void);
+    /*
+     "fillout" is the mode of text output:
+     1 = fill mode (line breaks happen when the browser wants them. Normal HTML text)
+     0 = no-fill mode (preformatted text (<pre>..</pre>).
+         Input lines are output as-is, retaining line breaks and ignoring the current line length.
+    */
+    int fillout = 1;
+
+    /* int asint=0; */
+    int intresult = 0;
+
+    bool skip_escape = false;
+    bool single_escape = false;
+
+    // scan_troff() temporarily modifies the text it scans
+    char itemreset[20] = "\\fR\\s0";
+
+    bool whileloop = false;
+
+    // &%(#@ c programs !!!
+    // int ifelseval=0;
+    // If/else can be nested!
+    QStack<int> ifelseStack;
+
+    int contained_tab = 0;
+};
 
 /**
  * Initialize character variables
  */
-static void InitCharacterDefinitions(void)
+void Man2HtmlContextPrivate::InitCharacterDefinitions()
 {
     fill_old_character_definitions();
     // ### HACK: as we are converting to HTML too early, define characters with HTML references
-    s_characterDefinitionMap.insert("&lt;-", StringDefinition(1, "&larr;")); // <-
-    s_characterDefinitionMap.insert("-&gt;", StringDefinition(1, "&rarr;")); // ->
-    s_characterDefinitionMap.insert("&lt;&gt;", StringDefinition(1, "&harr;")); // <>
-    s_characterDefinitionMap.insert("&lt;=", StringDefinition(1, "&le;")); // <=
-    s_characterDefinitionMap.insert("&gt;=", StringDefinition(1, "&ge;")); // >=
+    characterDefinitionMap.insert("&lt;-", StringDefinition(1, "&larr;")); // <-
+    characterDefinitionMap.insert("-&gt;", StringDefinition(1, "&rarr;")); // ->
+    characterDefinitionMap.insert("&lt;&gt;", StringDefinition(1, "&harr;")); // <>
+    characterDefinitionMap.insert("&lt;=", StringDefinition(1, "&le;")); // <=
+    characterDefinitionMap.insert("&gt;=", StringDefinition(1, "&ge;")); // >=
     // End HACK
 }
 
 /**
  * Initialize string variables
  */
-static void InitStringDefinitions(void)
+void Man2HtmlContextPrivate::InitStringDefinitions()
 {
     // mdoc-only, see mdoc.samples(7)
-    s_stringDefinitionMap.insert("<=", StringDefinition(1, "&le;"));
-    s_stringDefinitionMap.insert(">=", StringDefinition(1, "&ge;"));
-    s_stringDefinitionMap.insert("Rq", StringDefinition(1, "&rdquo;"));
-    s_stringDefinitionMap.insert("Lq", StringDefinition(1, "&ldquo;"));
-    s_stringDefinitionMap.insert("ua", StringDefinition(1, "&circ")); // Note this is different from \(ua
-    s_stringDefinitionMap.insert("aa", StringDefinition(1, "&acute;"));
-    s_stringDefinitionMap.insert("ga", StringDefinition(1, "`"));
-    s_stringDefinitionMap.insert("q", StringDefinition(1, "&quot;"));
-    s_stringDefinitionMap.insert("Pi", StringDefinition(1, "&pi;"));
-    s_stringDefinitionMap.insert("Ne", StringDefinition(1, "&ne;"));
-    s_stringDefinitionMap.insert("Le", StringDefinition(1, "&le;"));
-    s_stringDefinitionMap.insert("Ge", StringDefinition(1, "&ge;"));
-    s_stringDefinitionMap.insert("Lt", StringDefinition(1, "&lt;"));
-    s_stringDefinitionMap.insert("Gt", StringDefinition(1, "&gt;"));
-    s_stringDefinitionMap.insert("Pm", StringDefinition(1, "&plusmn;"));
-    s_stringDefinitionMap.insert("If", StringDefinition(1, "&infin;"));
-    s_stringDefinitionMap.insert("Na", StringDefinition(3, "NaN"));
-    s_stringDefinitionMap.insert("Ba", StringDefinition(1, "|"));
+    stringDefinitionMap.insert("<=", StringDefinition(1, "&le;"));
+    stringDefinitionMap.insert(">=", StringDefinition(1, "&ge;"));
+    stringDefinitionMap.insert("Rq", StringDefinition(1, "&rdquo;"));
+    stringDefinitionMap.insert("Lq", StringDefinition(1, "&ldquo;"));
+    stringDefinitionMap.insert("ua", StringDefinition(1, "&circ")); // Note this is different from \(ua
+    stringDefinitionMap.insert("aa", StringDefinition(1, "&acute;"));
+    stringDefinitionMap.insert("ga", StringDefinition(1, "`"));
+    stringDefinitionMap.insert("q", StringDefinition(1, "&quot;"));
+    stringDefinitionMap.insert("Pi", StringDefinition(1, "&pi;"));
+    stringDefinitionMap.insert("Ne", StringDefinition(1, "&ne;"));
+    stringDefinitionMap.insert("Le", StringDefinition(1, "&le;"));
+    stringDefinitionMap.insert("Ge", StringDefinition(1, "&ge;"));
+    stringDefinitionMap.insert("Lt", StringDefinition(1, "&lt;"));
+    stringDefinitionMap.insert("Gt", StringDefinition(1, "&gt;"));
+    stringDefinitionMap.insert("Pm", StringDefinition(1, "&plusmn;"));
+    stringDefinitionMap.insert("If", StringDefinition(1, "&infin;"));
+    stringDefinitionMap.insert("Na", StringDefinition(3, "NaN"));
+    stringDefinitionMap.insert("Ba", StringDefinition(1, "|"));
     // end mdoc-only
     // man(7)
-    s_stringDefinitionMap.insert("Tm", StringDefinition(1, "&trade;")); // \*(TM
-    s_stringDefinitionMap.insert("R", StringDefinition(1, "&reg;")); // \*R
-    s_stringDefinitionMap.insert("lq", StringDefinition(1, "&ldquo;")); // Left angled double quote
-    s_stringDefinitionMap.insert("rq", StringDefinition(1, "&rdquo;")); // Right angled double quote
+    stringDefinitionMap.insert("Tm", StringDefinition(1, "&trade;")); // \*(TM
+    stringDefinitionMap.insert("R", StringDefinition(1, "&reg;")); // \*R
+    stringDefinitionMap.insert("lq", StringDefinition(1, "&ldquo;")); // Left angled double quote
+    stringDefinitionMap.insert("rq", StringDefinition(1, "&rdquo;")); // Right angled double quote
     // end man(7)
     // Missing characters from man(7):
     // \*S "Change to default font size"
 #ifndef SIMPLE_MAN2HTML
     // Special KDE KIO man:
     const QByteArray kdeversion(KDE_VERSION_STRING);
-    s_stringDefinitionMap.insert(".KDE_VERSION_STRING", StringDefinition(kdeversion.length(), kdeversion));
+    stringDefinitionMap.insert(".KDE_VERSION_STRING", StringDefinition(kdeversion.length(), kdeversion));
 #endif
 }
 
@@ -310,16 +495,16 @@ static void InitStringDefinitions(void)
  * Initialize number registers
  * \note Internal read-only registers are not handled here
  */
-static void InitNumberDefinitions(void)
+void Man2HtmlContextPrivate::InitNumberDefinitions()
 {
     // As the date number registers are more for end-users, better choose local time.
     // Groff seems to support Gregorian dates only
     QDate today(QDate::currentDate());
-    s_numberDefinitionMap.insert("year", today.year()); // Y2K-correct year
-    s_numberDefinitionMap.insert("yr", today.year() - 1900); // Y2K-incorrect year
-    s_numberDefinitionMap.insert("mo", today.month());
-    s_numberDefinitionMap.insert("dy", today.day());
-    s_numberDefinitionMap.insert("dw", today.dayOfWeek());
+    numberDefinitionMap.insert("year", today.year()); // Y2K-correct year
+    numberDefinitionMap.insert("yr", today.year() - 1900); // Y2K-incorrect year
+    numberDefinitionMap.insert("mo", today.month());
+    numberDefinitionMap.insert("dy", today.day());
+    numberDefinitionMap.insert("dw", today.dayOfWeek());
 }
 
 #define V(A, B) ((A)*256 + (B))
@@ -646,45 +831,16 @@ static const StandardName STANDARD_NAMES[] = {{"-ansiC", "ANSI X3.159-1989 ('ANS
 
 /* default: print code */
 
-/* static char eqndelimopen=0, eqndelimclose=0; */
-static char escapesym = '\\', nobreaksym = '\'', controlsym = '.', fieldsym = 0, padsym = 0;
-
-static char *buffer = nullptr;
-static int buffpos = 0, buffmax = 0;
-static bool scaninbuff = false;
-static int itemdepth = 0;
-static int in_div = 0;
-static int dl_set[20] = {0};
-static QStack<QByteArray> listItemStack;
-static bool still_dd = 0;
-static int tabstops[20] = {8, 16, 24, 32, 40, 48, 56, 64, 72, 80, 88, 96};
-static int maxtstop = 12;
-static int curpos = 0;
-static bool break_the_while_loop = false;
-
-static char *scan_troff(char *c, bool san, char **result);
-static char *scan_troff_mandoc(char *c, bool san, char **result);
-static int getNumberRegisterValue(const QByteArray &name, int sign = 0);
-
-static QList<QByteArray> s_argumentList;
-
-static QByteArray s_dollarZero; // Value of $0
-
-static void fill_old_character_definitions(void)
+void Man2HtmlContextPrivate::fill_old_character_definitions()
 {
     for (const CSTRDEF &standardchar : standardchars) {
         const int nr = standardchar.nr;
         const char temp[3] = {char(nr / 256), char(nr % 256), 0};
         QByteArray name(temp);
-        s_characterDefinitionMap.insert(name, StringDefinition(standardchar.slen, standardchar.st));
+        characterDefinitionMap.insert(name, StringDefinition(standardchar.slen, standardchar.st));
     }
 }
 
-static char outbuffer[NULL_TERMINATED(HUGE_STR_MAX)];
-static int no_newline_output = 0;
-static int newline_for_fun = 0;
-static bool output_possible = false;
-
 static const char *const includedirs[] = {"/usr/include",
                                           "/usr/include/sys",
                                           "/usr/local/include",
@@ -695,9 +851,7 @@ static const char *const includedirs[] = {"/usr/include",
                                           "/usr/include/g++",
                                           nullptr};
 
-static bool ignore_links = false;
-
-static void add_links(char *c)
+void Man2HtmlContextPrivate::add_links(char *c)
 {
     /*
     ** Add the links to the output.
@@ -716,7 +870,7 @@ static void add_links(char *c)
     */
 
     if (ignore_links) {
-        output_real(c);
+        sink->output(c);
         return;
     }
 
@@ -767,7 +921,7 @@ static void add_links(char *c)
                     char t;
                     t = *g;
                     *g = 0;
-                    output_real(c);
+                    sink->output(c);
                     *g = t;
                     *h = 0;
 
@@ -780,7 +934,7 @@ static void add_links(char *c)
                     str.append(file.data());
                     str.append("</A>&gt;");
 
-                    output_real(str.data());
+                    sink->output(str.data());
                     c = f + 6;
                     wrote_include = true;
                 }
@@ -788,7 +942,7 @@ static void add_links(char *c)
 
             if (!wrote_include) {
                 f[5] = 0;
-                output_real(c);
+                sink->output(c);
                 f[5] = ';';
                 c = f + 5;
             }
@@ -851,7 +1005,7 @@ static void add_links(char *c)
                         h--;
                     t = *h;
                     *h = '\0';
-                    output_real(c);
+                    sink->output(c);
                     *h = t;
                     t = *e;
                     *e = '\0';
@@ -864,13 +1018,13 @@ static void add_links(char *c)
                     str += ")\">";
                     str += h;
                     str += "</a>";
-                    output_real(str.data());
+                    sink->output(str.data());
                     *e = t;
                     c = e;
                 }
             }
             *f = '\0';
-            output_real(c);
+            sink->output(c);
             *f = '(';
             idtest[4] = f - 1;
             c = f;
@@ -886,7 +1040,7 @@ static void add_links(char *c)
                 char t;
                 t = *f;
                 *f = '\0';
-                output_real(c);
+                sink->output(c);
                 *f = t;
                 t = *g;
                 *g = '\0';
@@ -898,12 +1052,12 @@ static void add_links(char *c)
                 str.append("\">");
                 str.append(f);
                 str.append("</A>");
-                output_real(str.data());
+                sink->output(str.data());
                 *g = t;
                 c = g;
             } else {
                 f[3] = '\0';
-                output_real(c);
+                sink->output(c);
                 c = f + 3;
                 f[3] = '.';
             }
@@ -926,7 +1080,7 @@ static void add_links(char *c)
                 char t;
                 t = *g;
                 *g = '\0';
-                output_real(c);
+                sink->output(c);
                 *g = t;
                 t = *h;
                 *h = '\0';
@@ -936,12 +1090,12 @@ static void add_links(char *c)
                 str.append("\">");
                 str.append(g);
                 str.append("</A>");
-                output_real(str.data());
+                sink->output(str.data());
                 *h = t;
                 c = h;
             } else {
                 *f = '\0';
-                output_real(c);
+                sink->output(c);
                 *f = '@';
                 idtest[1] = c;
                 c = f;
@@ -964,7 +1118,7 @@ static void add_links(char *c)
                 char t;
                 t = *g;
                 *g = '\0';
-                output_real(c);
+                sink->output(c);
                 *g = t;
                 t = *h;
                 *h = '\0';
@@ -974,12 +1128,12 @@ static void add_links(char *c)
                 str.append("\">");
                 str.append(g);
                 str.append("</A>");
-                output_real(str.data());
+                sink->output(str.data());
                 *h = t;
                 c = h;
             } else {
                 f[1] = '\0';
-                output_real(c);
+                sink->output(c);
                 f[1] = '/';
                 c = f + 1;
             }
@@ -1003,77 +1157,76 @@ static void add_links(char *c)
         for (i = 0; i < numtests; i++)
             nr += (idtest[i] != nullptr);
     }
-    output_real(c);
+    sink->output(c);
 }
 
 //---------------------------------------------------------------------
 
-static QByteArray current_font;
-static int current_size = 0;
-
-/*
- "fillout" is the mode of text output:
- 1 = fill mode (line breaks happen when the browser wants them. Normal HTML text)
- 0 = no-fill mode (preformatted text (<pre>..</pre>).
-     Input lines are output as-is, retaining line breaks and ignoring the current line length.
-*/
-static int fillout = 1;
-
-//---------------------------------------------------------------------
-
-static void out_html(const char *c)
+void Man2HtmlContextPrivate::out_html(const char *c)
 {
     if (!c || !*c)
         return;
 
-    // Added, probably due to the const?
-    char *c2 = qstrdup(c);
-    char *c3 = c2;
-
-    static int obp = 0;
-
+    const size_t length = strlen(c);
     if (no_newline_output) {
-        int i = 0;
-        no_newline_output = 1;
-        while (c2[i]) {
-            if (!no_newline_output)
-                c2[i - 1] = c2[i];
-            if (c2[i] == '\n')
-                no_newline_output = 0;
-            i++;
+        // drop the first newline
+        const char *newline = static_cast<const char *>(memchr(c, '\n', length));
+        if (newline) {
+            no_newline_output = 0;
+            write_html(c, newline - c);
+            write_html(newline + 1, length - (newline - c) - 1);
+            return;
         }
-        if (!no_newline_output)
-            c2[i - 1] = 0;
+        no_newline_output = 1;
     }
-    if (scaninbuff) {
-        while (*c2) {
-            if (buffpos >= buffmax) {
-                char *h = new char[buffmax * 2];
+    write_html(c, length);
+}
 
-                memcpy(h, buffer, buffmax);
-                delete[] buffer;
-                buffer = h;
-                buffmax = buffmax * 2;
-            }
-            buffer[buffpos++] = *c2++;
+void Man2HtmlContextPrivate::write_html(const char *c, size_t length)
+{
+    if (scaninbuff) {
+        if (buffpos + length > size_t(buffmax)) {
+            // the allocation always has room for the terminating NUL after buffmax
+            const int newmax = std::max<size_t>({size_t(buffmax) * 2, buffpos + length, LARGE_STR_MAX});
+            char *h = new char[newmax + 1];
+
+            memcpy(h, buffer, buffpos);
+            delete[] buffer;
+            buffer = h;
+            buffmax = newmax;
         }
+        memcpy(buffer + buffpos, c, length);
+        buffpos += length;
     } else if (output_possible) {
-        while (*c2) {
-            outbuffer[obp++] = *c2;
-            if (*c2 == '\n' || obp >= HUGE_STR_MAX) {
-                outbuffer[obp] = '\0';
-                add_links(outbuffer);
-                obp = 0;
-            }
-            c2++;
+        // add_links() works on whole lines
+        while (length) {
+            const char *newline = static_cast<const char *>(memchr(c, '\n', length));
+            const size_t lineLength = newline ? newline - c + 1 : length;
+            const size_t n = std::min<size_t>(lineLength, HUGE_STR_MAX - obp);
+            memcpy(outbuffer + obp, c, n);
+            obp += n;
+            c += n;
+            length -= n;
+            if (obp >= HUGE_STR_MAX || outbuffer[obp - 1] == '\n') {
+                flush_html();
+            }
         }
     }
-    delete[] c3;
+}
+
+// Hands the collected line to the sink
+void Man2HtmlContextPrivate::flush_html()
+{
+    if (obp) {
+        outbuffer[obp] = '\0';
+        add_links(outbuffer);
+        obp = 0;
+    }
 }
 
 //---------------------------------------------------------------------
 
-void checkListStack() // see if we need to end a previously begun list item
+void Man2HtmlContextPrivate::checkListStack() // see if we need to end a previously begun list item
 {
     if (!listItemStack.isEmpty() && (listItemStack.size() == itemdepth)) {
         out_html("</");
@@ -1084,7 +1237,7 @@ void checkListStack() // see if we need to end a previously begun list item
 
 //---------------------------------------------------------------------
 
-static QByteArray set_font(const QByteArray &name)
+QByteArray Man2HtmlContextPrivate::set_font(const QByteArray &name)
 {
     // Every font but R (Regular) creates <span> elements
     QByteArray markup;
@@ -1151,7 +1304,7 @@ static QByteArray set_font(const QByteArray &name)
         fontok = false;
 
     if (fontok)
-        current_font = name;
+        current_font = QByteArray(name.constData(), name.size()); // name can point into the page
     else
         current_font = "R"; // Still nothing, then it is 'R' (Regular) // krazy:exclude=doublequote_chars
     return markup;
@@ -1159,7 +1312,7 @@ static QByteArray set_font(const QByteArray &name)
 
 //---------------------------------------------------------------------
 
-static QByteArray change_to_size(int nr)
+QByteArray Man2HtmlContextPrivate::change_to_size(int nr)
 {
     switch (nr) {
     case '0':
@@ -1204,19 +1357,11 @@ static QByteArray change_to_size(int nr)
 
 //---------------------------------------------------------------------
 
-/* static int asint=0; */
-static int intresult = 0;
-
-static bool skip_escape = false;
-static bool single_escape = false;
-
-static char *scan_escape_direct(char *c, QByteArray &cstr);
-
 /**
  * scan a named character
  * param c position
  */
-static QByteArray scan_named_character(char *&c)
+QByteArray Man2HtmlContextPrivate::scan_named_character(char *&c)
 {
     QByteArray name;
     if (*c == '(') {
@@ -1228,8 +1373,7 @@ static QByteArray scan_named_character(char *&c)
             // variable are to be used.
             name = cstr;
         } else {
-            name += c[1];
-            name += c[2];
+            name = QByteArray::fromRawData(c + 1, 2);
             c += 3;
         }
     } else if (*c == '[') {
@@ -1237,6 +1381,11 @@ static QByteArray scan_named_character(char *&c)
         // Named character groff(7)
         // We must find the ] to get a name
         c++;
+        // Names without escapes are looked up in place
+        const char *start = c;
+        while (*c && *c != ']' && *c != '\n' && *c != escapesym)
+            c++;
+        name = QByteArray::fromRawData(start, c - start);
         while (*c && *c != ']' && *c != '\n') {
             if (*c == escapesym) {
                 QByteArray cstr;
@@ -1286,8 +1435,8 @@ static QByteArray scan_named_character(char *&c)
     // Note: characters with a one character length name do not exist, as they would collide with other escapes
 
     // Now we have the name, let us find it between the string names
-    QMap<QByteArray, StringDefinition>::const_iterator it = s_characterDefinitionMap.constFind(name);
-    if (it == s_characterDefinitionMap.constEnd()) {
+    QHash<QByteArray, StringDefinition>::const_iterator it = characterDefinitionMap.constFind(name);
+    if (it == characterDefinitionMap.constEnd()) {
         qCDebug(KIO_MAN_LOG) << "EXCEPTION: cannot find character with name: " << BYTEARRAY(name);
         // No output, as an undefined string is empty by default
         return "";
@@ -1299,7 +1448,7 @@ static QByteArray scan_named_character(char *&c)
 
 //---------------------------------------------------------------------
 
-static QByteArray scan_named_string(char *&c)
+QByteArray Man2HtmlContextPrivate::scan_named_string(char *&c)
 {
     QByteArray name;
     if (*c == '(') {
@@ -1312,8 +1461,7 @@ static QByteArray scan_named_string(char *&c)
             // variable are to be used.
             name = cstr;
         } else {
-            name += c[1];
-            name += c[2];
+            name = QByteArray::fromRawData(c + 1, 2);
             c += 3;
         }
     } else if (*c == '[') {
@@ -1321,6 +1469,11 @@ static QByteArray scan_named_string(char *&c)
         // Named character groff(7)
         // We must find the ] to get a name
         c++;
+        // Names without escapes are looked up in place
+        const char *start = c;
+        while (*c && *c != ']' && *c != '\n' && *c != escapesym)
+            c++;
+        name = QByteArray::fromRawData(start, c - start);
         while (*c && *c != ']' && *c != '\n') {
             if (*c == escapesym) {
                 QByteArray cstr;
@@ -1344,12 +1497,12 @@ static QByteArray scan_named_string(char *&c)
         c++;
     } else {
         // \*a Name of one character
-        name += *c;
+        name = QByteArray::fromRawData(c, 1);
         c++;
     }
     // Now we have the name, let us find it between the string names
-    QMap<QByteArray, StringDefinition>::const_iterator it = s_stringDefinitionMap.constFind(name);
-    if (it == s_stringDefinitionMap.constEnd()) {
+    QHash<QByteArray, StringDefinition>::const_iterator it = stringDefinitionMap.constFind(name);
+    if (it == stringDefinitionMap.constEnd()) {
         // try a number register:
         return QByteArray::number(getNumberRegisterValue(name));
 
@@ -1364,13 +1517,13 @@ static QByteArray scan_named_string(char *&c)
 
 //---------------------------------------------------------------------
 
-static QByteArray scan_dollar_parameter(char *&c)
+QByteArray Man2HtmlContextPrivate::scan_dollar_parameter(char *&c)
 {
     int argno = 0; // No dollar argument number yet!
     if (*c == '0') {
         // qCDebug(KIO_MAN_LOG) << "$0";
         c++;
-        return s_dollarZero;
+        return dollarZero;
     } else if (*c >= '1' && *c <= '9') {
         // qCDebug(KIO_MAN_LOG) << "$ direct";
         argno = (*c - '0');
@@ -1404,10 +1557,10 @@ static QByteArray scan_dollar_parameter(char *&c)
         c++;
     } else if ((*c == '*') || (*c == '@')) {
         const bool quote = (*c == '@');
-        QList<QByteArray>::const_iterator it = s_argumentList.constBegin();
+        QList<QByteArray>::const_iterator it = argumentList.constBegin();
         QByteArray param;
         bool space = false;
-        for (; it != s_argumentList.constEnd(); ++it) {
+        for (; it != argumentList.constEnd(); ++it) {
             if (space)
                 param += ' ';
             if (quote)
@@ -1424,15 +1577,15 @@ static QByteArray scan_dollar_parameter(char *&c)
         return "";
     }
     // qCDebug(KIO_MAN_LOG) << "ARG $" << argno;
-    if (!s_argumentList.isEmpty() && argno > 0) {
+    if (!argumentList.isEmpty() && argno > 0) {
         // qCDebug(KIO_MAN_LOG) << "ARG $" << argno << " OK!";
         argno--;
-        if (argno >= s_argumentList.size()) {
+        if (argno >= argumentList.size()) {
             qCDebug(KIO_MAN_LOG) << "EXCEPTION: cannot find parameter $" << (argno + 1);
             return "";
         }
 
-        return s_argumentList[argno];
+        return argumentList[argno];
     }
     return "";
 }
@@ -1440,12 +1593,12 @@ static QByteArray scan_dollar_parameter(char *&c)
 //---------------------------------------------------------------------
 /// return the value of read-only number registers
 
-static int read_only_number_register(const QByteArray &name)
+int Man2HtmlContextPrivate::read_only_number_register(const QByteArray &name)
 {
     // Internal read-only variables
     if (name == ".$") {
-        qCDebug(KIO_MAN_LOG) << "\\n[.$] == " << s_argumentList.size();
-        return s_argumentList.size();
+        qCDebug(KIO_MAN_LOG) << "\\n[.$] == " << argumentList.size();
+        return argumentList.size();
     } else if (name == ".g")
         return 0; // We are not groff(1)
     else if (name == ".s")
@@ -1458,7 +1611,7 @@ static int read_only_number_register(const QByteArray &name)
     else if (name == ".P")
         return 0; // We are not printing
     else if (name == ".A")
-        return s_nroff;
+        return nroff;
 #ifndef SIMPLE_MAN2HTML
     // Special KDE KIO man:
     const QString version_string(KDE_VERSION_STRING);
@@ -1485,13 +1638,13 @@ static int read_only_number_register(const QByteArray &name)
 
 //---------------------------------------------------------------------
 
-static int getNumberRegisterValue(const QByteArray &name, int sign)
+int Man2HtmlContextPrivate::getNumberRegisterValue(const QByteArray &name, int sign)
 {
     if (name[0] == '.') {
         return read_only_number_register(name);
     } else {
-        QMap<QByteArray, NumberDefinition>::iterator it = s_numberDefinitionMap.find(name);
-        if (it == s_numberDefinitionMap.end()) {
+        QHash<QByteArray, NumberDefinition>::iterator it = numberDefinitionMap.find(name);
+        if (it == numberDefinitionMap.end()) {
             return 0; // Undefined variable
         } else {
             (*it).m_value += sign * (*it).m_increment;
@@ -1503,7 +1656,7 @@ static int getNumberRegisterValue(const QByteArray &name, int sign)
 //---------------------------------------------------------------------
 /// get the value of a number register and auto-increment if asked
 
-static int scan_number_register(char *&c)
+int Man2HtmlContextPrivate::scan_number_register(char *&c)
 {
     int sign = 0; // Sign for auto-increment (if any)
     switch (*c) {
@@ -1528,11 +1681,12 @@ static int scan_number_register(char *&c)
             sign = -1;
             c++;
         }
+        const char *start = c;
         while (*c && *c != ']' && *c != '\n') {
             // ### TODO: a \*[string] could be inside and should be processed
-            name += *c;
             c++;
         }
+        name = QByteArray::fromRawData(start, c - start);
         if (!*c || *c == '\n') {
             qCDebug(KIO_MAN_LOG) << "Found linefeed! Could not parse number register name: " << BYTEARRAY(name);
             return 0;
@@ -1547,11 +1701,10 @@ static int scan_number_register(char *&c)
             sign = -1;
             c++;
         }
-        name += c[0];
-        name += c[1];
+        name = QByteArray::fromRawData(c, 2);
         c += 2;
     } else {
-        name += *c;
+        name = QByteArray::fromRawData(c, 1);
         c++;
     }
 
@@ -1584,7 +1737,7 @@ static QByteArray scan_name(char *&c)
 //---------------------------------------------------------------------
 /// get and set font
 
-static QByteArray scan_named_font(char *&c)
+QByteArray Man2HtmlContextPrivate::scan_named_font(char *&c)
 {
     QByteArray name;
     if (*c == '(') {
@@ -1597,14 +1750,18 @@ static QByteArray scan_named_font(char *&c)
             // variable are to be used.
             name = cstr;
         } else {
-            name += c[1];
-            name += c[2];
+            name = QByteArray::fromRawData(c + 1, 2);
             c += 3;
         }
     } else if (*c == '[') {
         // \f[long_name]  Long name
         // We must find the ] to get a name
         c++;
+        // Names without escapes are looked up in place
+        const char *start = c;
+        while (*c && *c != ']' && *c != '\n' && *c != escapesym)
+            c++;
+        name = QByteArray::fromRawData(start, c - start);
         while (*c && *c != ']' && *c != '\n') {
             if (*c == escapesym) {
                 QByteArray cstr;
@@ -1657,7 +1814,7 @@ static QByteArray scan_named_font(char *&c)
 
 //---------------------------------------------------------------------
 
-static QByteArray scan_number_code(char *&c)
+QByteArray Man2HtmlContextPrivate::scan_number_code(char *&c)
 {
     QByteArray number;
     if (*c != '\'')
@@ -1688,7 +1845,7 @@ static QByteArray scan_number_code(char *&c)
 // ### TODO known missing escapes from groff(7):
 // ### TODO \R
 
-static char *scan_escape_direct(char *c, QByteArray &cstr)
+char *Man2HtmlContextPrivate::scan_escape_direct(char *c, QByteArray &cstr)
 {
     bool exoutputp;
     bool exskipescape;
@@ -1703,17 +1860,17 @@ static char *scan_escape_direct(char *c, QByteArray &cstr)
         curpos++;
         break;
     case '0': // space of digit width
-        cstr = "&#8199;"; // Unicode FIGURE SPACE
+        cstr = QByteArrayLiteral("&#8199;"); // Unicode FIGURE SPACE
         curpos++;
         break;
     case '~': // non-breakable-space (resizeable!)
     case ' ':
-        cstr = "&nbsp;";
+        cstr = QByteArrayLiteral("&nbsp;");
         curpos++;
         break;
     case '|': // half-non-breakable-space
     case '^': // quarter-non-breakable-space
-        cstr = "&#8239;"; // Unicode NARROW NO-BREAK SPACE
+        cstr = QByteArrayLiteral("&#8239;"); // Unicode NARROW NO-BREAK SPACE
         curpos++;
         break;
     case ':':
@@ -1721,7 +1878,7 @@ static char *scan_escape_direct(char *c, QByteArray &cstr)
     case ',':
         break; //  left italic correction, always a zero motion
     case '/':
-        cstr = "&#8201;"; // Unicode THIN SPACE
+        cstr = QByteArrayLiteral("&#8201;"); // Unicode THIN SPACE
         curpos++;
         break; // italic correction, i.e. a small piece of horizontal motion
     case '"': // comment. skip rest of line
@@ -1805,7 +1962,7 @@ static char *scan_escape_direct(char *c, QByteArray &cstr)
         cstr = scan_name(c);
 
         if (cstr.isEmpty())
-            cstr = "</span>";
+            cstr = QByteArrayLiteral("</span>");
         else
             cstr = "<span style='color:" + cstr + "'>";
 
@@ -1869,7 +2026,7 @@ static char *scan_escape_direct(char *c, QByteArray &cstr)
         intresult = j;
         break;
     case 'l':
-        cstr = "<HR>";
+        cstr = QByteArrayLiteral("<HR>");
         curpos = 0;
     case 'b':
     case 'v':
@@ -1903,26 +2060,26 @@ static char *scan_escape_direct(char *c, QByteArray &cstr)
             newline_for_fun--;
         break; // End conditional block
     case 'p':
-        cstr = "<BR>\n";
+        cstr = QByteArrayLiteral("<BR>\n");
         curpos = 0;
         break;
     case 't':
-        cstr = "\t";
+        cstr = QByteArrayLiteral("\t");
         curpos = (curpos + 8) & 0xfff8;
         break;
     case '<':
-        cstr = "&lt;";
+        cstr = QByteArrayLiteral("&lt;");
         curpos++;
         break;
     case '>':
-        cstr = "&gt;";
+        cstr = QByteArrayLiteral("&gt;");
         curpos++;
         break;
     case '\\': {
         if (single_escape)
             c--;
         else
-            cstr = "\\";
+            cstr = QByteArrayLiteral("\\");
         break;
     }
     case 'N': {
@@ -1932,19 +2089,19 @@ static char *scan_escape_direct(char *c, QByteArray &cstr)
         break;
     }
     case '\'':
-        cstr = "&acute;";
+        cstr = QByteArrayLiteral("&acute;");
         curpos++;
         break; // groff(7) ### TODO verify
     case '`':
-        cstr = "`"; // krazy:exclude=doublequote_chars
+        cstr = QByteArrayLiteral("`"); // krazy:exclude=doublequote_chars
         curpos++;
         break; // groff(7)
     case '-':
-        cstr = "-"; // krazy:exclude=doublequote_chars
+        cstr = QByteArrayLiteral("-"); // krazy:exclude=doublequote_chars
         curpos++;
         break; // groff(7)
     case '.':
-        cstr = "."; // krazy:exclude=doublequote_chars
+        cstr = QByteArrayLiteral("."); // krazy:exclude=doublequote_chars
         curpos++;
         break; // groff(7)
     default:
@@ -1959,7 +2116,7 @@ static char *scan_escape_direct(char *c, QByteArray &cstr)
 
 //---------------------------------------------------------------------
 
-static char *scan_escape(char *c)
+char *Man2HtmlContextPrivate::scan_escape(char *c)
 {
     QByteArray cstr;
     char *result = scan_escape_direct(c, cstr);
@@ -2109,11 +2266,7 @@ static void clear_table(TABLEROW *table)
 
 //---------------------------------------------------------------------
 
-static char *scan_expression(char *c, int *result);
-
-//---------------------------------------------------------------------
-
-static char *scan_format(char *c, TABLEROW **result, int *maxcol)
+char *Man2HtmlContextPrivate::scan_format(char *c, TABLEROW **result, int *maxcol)
 {
     TABLEROW *layout, *currow;
     TABLEITEM *curfield;
@@ -2262,14 +2415,12 @@ static TABLEROW *next_row(TABLEROW *tr)
 
 //---------------------------------------------------------------------
 
-static char itemreset[20] = "\\fR\\s0";
-
 #define FORWARDCUR                                                                                                                                             \
     do {                                                                                                                                                       \
         curfield++;                                                                                                                                            \
     } while (currow->has(curfield) && currow->at(curfield).align == 'S');
 
-static char *scan_table(char *c)
+char *Man2HtmlContextPrivate::scan_table(char *c)
 {
     char *h;
     char *g;
@@ -2596,7 +2747,7 @@ static char *scan_table(char *c)
 
 //---------------------------------------------------------------------
 
-static char *scan_expression(char *c, int *result, const unsigned int numLoop)
+char *Man2HtmlContextPrivate::scan_expression(char *c, int *result, const unsigned int numLoop)
 {
     int value = 0, value2, sign = 1, opex = 0;
     char oper = 'c';
@@ -2608,10 +2759,10 @@ static char *scan_expression(char *c, int *result, const unsigned int numLoop)
         value = (!value);
     } else if (*c == 'n') {
         c++;
-        value = s_nroff;
+        value = nroff;
     } else if (*c == 't') {
         c++;
-        value = 1 - s_nroff;
+        value = 1 - nroff;
     } else if (*c == '\'' || *c == '"' || *c < ' ' || (*c == '\\' && c[1] == '(')) {
         /* ?string1?string2?
         ** test if string1 equals string2.
@@ -2798,14 +2949,14 @@ static char *scan_expression(char *c, int *result, const unsigned int numLoop)
 
 //---------------------------------------------------------------------
 
-static char *scan_expression(char *c, int *result)
+char *Man2HtmlContextPrivate::scan_expression(char *c, int *result)
 {
     return scan_expression(c, result, 0);
 }
 
 //---------------------------------------------------------------------
 
-static void trans_char(char *c, char s, char t)
+void Man2HtmlContextPrivate::trans_char(char *c, char s, char t)
 {
     char *sl = c;
     int slash = 0;
@@ -2828,14 +2979,12 @@ static void trans_char(char *c, char s, char t)
 // (which is the char after the ending \n)
 // argPointers .. a list of pointers to the startchars of each arg pointing into the string given with c
 
-void getArguments(/* const */ char *&c, QList<QByteArray> &args, QList<char *> *argPointers = nullptr)
+void Man2HtmlContextPrivate::getArguments(/* const */ char *&c, ArgumentList &args, QList<char *> *argPointers)
 {
     args.clear();
     if (argPointers)
         argPointers->clear();
 
-    QByteArray arg;
-    arg.reserve(30); // reduce num of reallocs
     bool inString = false;
     bool inArgument = false;
 
@@ -2847,19 +2996,18 @@ void getArguments(/* const */ char *&c, QList<QByteArray> &args, QList<char *> *
                 // according to http://heirloom.sourceforge.net/doctools/troff.pdf chapter 7.3
                 // two consecutive quotes inside a string is one quote char
                 if (*(c + 1) == '"') {
-                    arg += '"';
+                    args.append('"');
                     c++;
                 } else // end of quoted argument
                 {
-                    args.append(arg);
-                    arg.clear();
+                    args.endArgument();
                     inString = false;
                     inArgument = false;
                 }
             }
         } else if (*c == ' ') {
             if (inString) {
-                arg += *c;
+                args.append(*c);
                 if (!inArgument) // argument not yet found (leading spaces)
                 {
                     inArgument = true;
@@ -2869,14 +3017,13 @@ void getArguments(/* const */ char *&c, QList<QByteArray> &args, QList<char *> *
                 }
             } else if (inArgument) {
                 // end of previous argument
-                args.append(arg);
-                arg.clear();
+                args.endArgument();
                 inArgument = false;
             }
         } else if ((*c == escapesym) && (*(c + 1) == ' ')) {
             // special handling \<SP> shall be kept as is
-            arg += *c++;
-            arg += *c;
+            args.append(*c++);
+            args.append(*c);
 
             if (!inArgument) // argument not yet found (leading spaces)
             {
@@ -2891,8 +3038,7 @@ void getArguments(/* const */ char *&c, QList<QByteArray> &args, QList<char *> *
         {
             if (inArgument) {
                 // end of previous argument
-                args.append(arg);
-                arg.clear();
+                args.endArgument();
                 inArgument = false;
             }
 
@@ -2901,7 +3047,7 @@ void getArguments(/* const */ char *&c, QList<QByteArray> &args, QList<char *> *
                 c++;
             break;
         } else if (*c != ' ') {
-            arg += *c;
+            args.append(*c);
             if (!inArgument) // argument not yet found (leading spaces)
             {
                 inArgument = true;
@@ -2914,7 +3060,9 @@ void getArguments(/* const */ char *&c, QList<QByteArray> &args, QList<char *> *
 
     if (inArgument) {
         // end of previous argument
-        args.append(arg);
+        args.endArgument();
+    } else {
+        args.discardArgument();
     }
 
     if (*c)
@@ -3232,7 +3380,7 @@ static const char *section_name(char *c)
         return c;
 }
 
-static char *skip_till_newline(char *c)
+char *Man2HtmlContextPrivate::skip_till_newline(char *c)
 {
     int lvl = 0;
 
@@ -3260,10 +3408,8 @@ static char *skip_till_newline(char *c)
 
 //---------------------------------------------------------------------
 
-static bool s_whileloop = false;
-
 /// Processing the .while request
-static void request_while(char *&c, int j, bool mdoc)
+void Man2HtmlContextPrivate::request_while(char *&c, int j, bool mdoc)
 {
     // ### TODO: .continue
     qCDebug(KIO_MAN_LOG) << "Entering .while";
@@ -3278,8 +3424,8 @@ static void request_while(char *&c, int j, bool mdoc)
     *newline = oldchar;
     c = newline;
     // Process -while loop
-    const bool oldwhileloop = s_whileloop;
-    s_whileloop = true;
+    const bool oldwhileloop = whileloop;
+    whileloop = true;
     int result = true; // It must be an int due to the call to scan_expression
     break_the_while_loop = false;
     while (result && !break_the_while_loop) {
@@ -3310,20 +3456,20 @@ static void request_while(char *&c, int j, bool mdoc)
     break_the_while_loop = false;
 
     //
-    s_whileloop = oldwhileloop;
+    whileloop = oldwhileloop;
     qCDebug(KIO_MAN_LOG) << "Ending .while";
 }
 
 //---------------------------------------------------------------------
 // Processing mixed fonts requests like .BI
 
-static void request_mixed_fonts(char *&c, int j, const char *font1, const char *font2, const bool mode, const bool inFMode)
+void Man2HtmlContextPrivate::request_mixed_fonts(char *&c, int j, const char *font1, const char *font2, const bool mode, const bool inFMode)
 {
     c += j;
     if (*c == '\n')
         c++;
 
-    QList<QByteArray> args;
+    ArgumentList args;
     getArguments(c, args);
 
     for (int i = 0; i < args.count(); i++) {
@@ -3332,7 +3478,7 @@ static void request_mixed_fonts(char *&c, int j, const char *font1, const char *
             curpos++;
         }
         out_html(set_font((i & 1) ? font2 : font1));
-        scan_troff(args[i].data(), 1, nullptr);
+        scan_troff(args[i], 1, nullptr);
     }
     out_html(set_font("R"));
     if (mode) {
@@ -3348,15 +3494,8 @@ static void request_mixed_fonts(char *&c, int j, const char *font1, const char *
 
 //---------------------------------------------------------------------
 
-// &%(#@ c programs !!!
-// static int ifelseval=0;
-// If/else can be nested!
-static QStack<int> s_ifelseval;
-
-//---------------------------------------------------------------------
-
 // Process a (mdoc) request involving quotes
-static char *process_quote(char *c, int j, const char *open, const char *close)
+char *Man2HtmlContextPrivate::process_quote(char *c, int j, const char *open, const char *close)
 {
     trans_char(c, '"', '\a');
     c += j;
@@ -3427,19 +3566,13 @@ static QByteArray scan_identifier(char *&c)
 
 //---------------------------------------------------------------------
 
-static char *scan_request(char *c)
+char *Man2HtmlContextPrivate::scan_request(char *c)
 {
-    // mdoc(7) stuff
-    static bool mandoc_synopsis = false; /* True if we are in the synopsis section */
-    static bool mandoc_command = false; /* True if this is mdoc(7) page */
-    static int mandoc_bd_options; /* Only copes with non-nested Bd's */
-    static int function_argument = 0; // Number of function argument (.Fo, .Fa, .Fc)
-
     int i = 0;
     bool mode = false;
     char *h = nullptr;
     char *sl;
-    QList<QByteArray> args;
+    ArgumentList args;
 
     while (*c == ' ' || *c == '\t')
         c++; // Spaces or tabs allowed between control character and request
@@ -3472,14 +3605,14 @@ static char *scan_request(char *c)
         while (c[j] == ' ' || c[j] == '\t')
             j++;
         /* search macro database of self-defined macros */
-        QMap<QByteArray, StringDefinition>::const_iterator it = s_stringDefinitionMap.constFind(macroName);
+        QHash<QByteArray, StringDefinition>::const_iterator it = stringDefinitionMap.constFind(macroName);
 
         // ### HACK: e.g. nmap, smb.conf redefine SH, SS to increase the font, etc. for non-TTY output
         // Ignore those to make the HTML result look better
-        if ((macroName != "SH") && (macroName != "SS") && it != s_stringDefinitionMap.constEnd()) {
+        if ((macroName != "SH") && (macroName != "SS") && it != stringDefinitionMap.constEnd()) {
             qCDebug(KIO_MAN_LOG) << "CALLING MACRO: " << BYTEARRAY(macroName);
-            const QByteArray oldDollarZero = s_dollarZero; // Previous value of $0
-            s_dollarZero = macroName;
+            const QByteArray oldDollarZero = dollarZero; // Previous value of $0
+            dollarZero = macroName;
 
             c += j;
             getArguments(c, args);
@@ -3487,11 +3620,11 @@ static char *scan_request(char *c)
                 char *h = nullptr;
 
                 if (mandoc_command)
-                    scan_troff_mandoc(args[i].data(), 1, &h);
+                    scan_troff_mandoc(args[i], 1, &h);
                 else
-                    scan_troff(args[i].data(), 1, &h);
+                    scan_troff(args[i], 1, &h);
 
-                args[i] = h;
+                args.replace(i, h);
                 delete[] h;
             }
 
@@ -3501,10 +3634,10 @@ static char *scan_request(char *c)
                 char *work = new char[length + 2];
                 work[0] = '\n'; // The macro must start after an end of line to allow a request on first line
                 qstrncpy(work + 1, (*it).m_output.data(), length + 1);
-                const QList<QByteArray> oldArgumentList(s_argumentList);
-                s_argumentList.clear();
+                const QList<QByteArray> oldArgumentList(argumentList);
+                argumentList.clear();
                 for (i = 0; i < args.count(); i++)
-                    s_argumentList.push_back(args[i]);
+                    argumentList.push_back(args[i]);
 
                 const int onff = newline_for_fun;
                 if (mandoc_command)
@@ -3513,9 +3646,9 @@ static char *scan_request(char *c)
                     scan_troff(work + 1, 0, nullptr);
                 delete[] work;
                 newline_for_fun = onff;
-                s_argumentList = oldArgumentList;
+                argumentList = oldArgumentList;
             }
-            s_dollarZero = oldDollarZero;
+            dollarZero = oldDollarZero;
             qCDebug(KIO_MAN_LOG) << "ENDING MACRO: " << BYTEARRAY(macroName);
         } else {
             qCDebug(KIO_MAN_LOG) << "REQUEST: " << BYTEARRAY(macroName);
@@ -3560,12 +3693,12 @@ static char *scan_request(char *c)
                 *c = '\0';
                 char *result = nullptr;
                 scan_troff(h, 0, &result);
-                QMap<QByteArray, StringDefinition>::iterator it = s_stringDefinitionMap.find(name);
-                if (it == s_stringDefinitionMap.end()) {
+                QHash<QByteArray, StringDefinition>::iterator it = stringDefinitionMap.find(name);
+                if (it == stringDefinitionMap.end()) {
                     StringDefinition def;
                     def.m_length = 0;
                     def.m_output = result;
-                    s_stringDefinitionMap.insert(name, def);
+                    stringDefinitionMap.insert(name, def);
                 } else {
                     (*it).m_length = 0;
                     (*it).m_output = result;
@@ -3598,12 +3731,12 @@ static char *scan_request(char *c)
                 curpos = 0;
                 char *result = nullptr;
                 c = scan_troff(c, 1, &result);
-                QMap<QByteArray, StringDefinition>::iterator it = s_stringDefinitionMap.find(name);
-                if (it == s_stringDefinitionMap.end()) {
+                QHash<QByteArray, StringDefinition>::iterator it = stringDefinitionMap.find(name);
+                if (it == stringDefinitionMap.end()) {
                     StringDefinition def;
                     def.m_length = curpos;
                     def.m_output = result;
-                    s_stringDefinitionMap.insert(name, def);
+                    stringDefinitionMap.insert(name, def);
                 } else {
                     if (mode) { // .ds Defining String
                         (*it).m_length = curpos;
@@ -3745,7 +3878,7 @@ static char *scan_request(char *c)
             }
             case REQ_el: // groff(7) "ELse"
             {
-                int ifelseval = s_ifelseval.pop();
+                int ifelseval = ifelseStack.pop();
                 /* .el anything : else part of if else */
                 if (ifelseval) {
                     c = c + j;
@@ -3771,7 +3904,7 @@ static char *scan_request(char *c)
                 c = scan_expression(c, &i);
                 if (request == REQ_ie) {
                     int ifelseval = !i;
-                    s_ifelseval.push(ifelseval);
+                    ifelseStack.push(ifelseval);
                 }
                 if (i) {
                     *c = '\n';
@@ -3821,7 +3954,7 @@ static char *scan_request(char *c)
                 if (args.count() == 0)
                     out_html(change_to_size('0'));
                 else {
-                    char *h = args[0].data();
+                    char *h = args[0];
                     int sign = 0;
                     i = 0;
                     if (*h == '-') {
@@ -3892,7 +4025,7 @@ static char *scan_request(char *c)
                 }
 
                 /* this works alright, except for section 3 */
-                buf = read_man_page(h);
+                buf = sink->readManPage(h);
                 if (!buf) {
                     qCDebug(KIO_MAN_LOG) << "Unable to open or read file: .so " << (h);
                     out_html(
@@ -3961,7 +4094,7 @@ static char *scan_request(char *c)
                 out_html(set_font(mode ? "B" : "I"));
 
                 for (int i = 0; i < args.count(); i++) {
-                    scan_troff(args[i].data(), 1, nullptr);
+                    scan_troff(args[i], 1, nullptr);
                     out_html(" ");
                 }
 
@@ -3989,7 +4122,7 @@ static char *scan_request(char *c)
                         out_html(set_font("R"));
                     else
                         out_html(set_font("B"));
-                    scan_troff(args[i].data(), 1, nullptr);
+                    scan_troff(args[i], 1, nullptr);
                     out_html(" ");
                 }
                 // In the mdoc synopsis, there are automatical line breaks (### TODO: before or after?)
@@ -4017,7 +4150,7 @@ static char *scan_request(char *c)
                             out_html(set_font("I"));
                         else
                             out_html(set_font("B"));
-                        scan_troff(args[i].data(), 1, nullptr);
+                        scan_troff(args[i], 1, nullptr);
                         out_html(set_font("R"));
                         if (i == 0) {
                             out_html(" (");
@@ -4051,7 +4184,7 @@ static char *scan_request(char *c)
                 // Normally a .Fo has only one parameter
                 for (i = 0; i < args.count(); i++) {
                     out_html(set_font(font[i & 1]));
-                    scan_troff(args[i].data(), 1, nullptr);
+                    scan_troff(args[i], 1, nullptr);
                     if (i == 0) {
                         out_html(" (");
                     }
@@ -4104,7 +4237,7 @@ static char *scan_request(char *c)
                     function_argument++;
                 }
                 for (i = 0; i < args.count(); i++)
-                    scan_troff(args[i].data(), 1, nullptr);
+                    scan_troff(args[i], 1, nullptr);
 
                 out_html(set_font("R"));
                 if (!fillout)
@@ -4172,7 +4305,7 @@ static char *scan_request(char *c)
                 out_html("<DT>");
 
                 if (args.count())
-                    scan_troff(args[0].data(), 1, nullptr);
+                    scan_troff(args[0], 1, nullptr);
 
                 out_html("</DT>\n<DD>");
                 listItemStack.push("DD");
@@ -4252,7 +4385,7 @@ static char *scan_request(char *c)
                 getArguments(c, args);
                 j = 1;
                 if (args.count() > 0)
-                    scan_expression(args[0].data(), &j);
+                    scan_expression(args[0], &j);
                 if (j >= 0) {
                     itemdepth++;
                     dl_set[itemdepth] = 0;
@@ -4367,7 +4500,7 @@ static char *scan_request(char *c)
                 if (args.count()) {
                     bool found = false;
                     for (const StandardName &standardName : STANDARD_NAMES) {
-                        if (args[0] == standardName.abbrev) {
+                        if (qstrcmp(args[0], standardName.abbrev) == 0) {
                             found = true;
                             out_html(standardName.formalName);
                             break;
@@ -4400,7 +4533,7 @@ static char *scan_request(char *c)
                         // but args[0] can have formatting escapes, e.g. to switch a font
                         // which results in a HTML tag added to the output
                         char *result = nullptr;
-                        scan_troff(args[0].data(), 0, &result);
+                        scan_troff(args[0], 0, &result);
                         char *p = result;
                         QByteArray title;
                         while (*p) {
@@ -4444,7 +4577,7 @@ static char *scan_request(char *c)
                     out_html("<div id=\"header_left\"><div id=\"header_right\">\n");
                     out_html("<img src=\"help:/kdoctools6-common/top-kde.jpg\" alt=\"top-kde\"> ");
                     if (args.count())
-                        scan_troff(args[0].data(), 0, nullptr);
+                        scan_troff(args[0], 0, nullptr);
                     out_html(" Manual Page");
                     out_html("</div></div></div></div>\n");
 
@@ -4452,16 +4585,16 @@ static char *scan_request(char *c)
                     out_html("<div class=\"book\">\n");
                     out_html("<h1 class=\"title\">");
                     if (args.count())
-                        scan_troff(args[0].data(), 0, nullptr);
+                        scan_troff(args[0], 0, nullptr);
                     out_html("</h1>\n");
                     if (args.count() > 1) {
                         out_html("Section: ");
                         if (!mandoc_command && (args.count() > 4))
-                            scan_troff(args[4].data(), 0, nullptr);
+                            scan_troff(args[4], 0, nullptr);
                         else
-                            out_html(section_name(args[1].data()));
+                            out_html(section_name(args[1]));
                         out_html(" (");
-                        scan_troff(args[1].data(), 0, nullptr);
+                        scan_troff(args[1], 0, nullptr);
                         out_html(")\n");
                     } else {
                         out_html("Section not specified");
@@ -4511,18 +4644,18 @@ static char *scan_request(char *c)
                         }
                     }
                     c = skip_till_newline(c);
-                    QMap<QByteArray, StringDefinition>::iterator it = s_stringDefinitionMap.find(name);
-                    if (it == s_stringDefinitionMap.end()) {
+                    QHash<QByteArray, StringDefinition>::iterator it = stringDefinitionMap.find(name);
+                    if (it == stringDefinitionMap.end()) {
                         qCDebug(KIO_MAN_LOG) << "EXCEPTION: cannot find string to rename or remove: " << BYTEARRAY(name);
                     } else {
                         if (mode) {
                             // .rm ReMove
-                            s_stringDefinitionMap.remove(name); // ### QT4: removeAll
+                            stringDefinitionMap.remove(name); // ### QT4: removeAll
                         } else {
                             // .rn ReName
                             StringDefinition def = (*it);
-                            s_stringDefinitionMap.remove(name); // ### QT4: removeAll
-                            s_stringDefinitionMap.insert(name2, def);
+                            stringDefinitionMap.remove(name); // ### QT4: removeAll
+                            stringDefinitionMap.insert(name2, def);
                         }
                     }
                     qCDebug(KIO_MAN_LOG) << "end .rm/.rn";
@@ -4562,12 +4695,12 @@ static char *scan_request(char *c)
                     c = scan_expression(c, &increment);
                 }
                 c = skip_till_newline(c);
-                QMap<QByteArray, NumberDefinition>::iterator it = s_numberDefinitionMap.find(name);
-                if (it == s_numberDefinitionMap.end()) {
+                QHash<QByteArray, NumberDefinition>::iterator it = numberDefinitionMap.find(name);
+                if (it == numberDefinitionMap.end()) {
                     if (sign < 1)
                         value = -value;
                     NumberDefinition def(value, increment);
-                    s_numberDefinitionMap.insert(name, def);
+                    numberDefinitionMap.insert(name, def);
                 } else {
                     if (sign > 0)
                         (*it).m_value += value;
@@ -4602,7 +4735,7 @@ static char *scan_request(char *c)
                 if (args.count() == 1)
                     endmacro = "..";
                 else
-                    endmacro = "." + args[1]; // krazy:exclude=doublequote_chars
+                    endmacro = QByteArray(".") + args[1]; // krazy:exclude=doublequote_chars
 
                 sl = c;
                 while (*c && qstrncmp(c, endmacro, endmacro.length()))
@@ -4618,12 +4751,12 @@ static char *scan_request(char *c)
                     sl++;
                 }
 
-                QMap<QByteArray, StringDefinition>::iterator it = s_stringDefinitionMap.find(name);
-                if (it == s_stringDefinitionMap.end()) {
+                QHash<QByteArray, StringDefinition>::iterator it = stringDefinitionMap.find(name);
+                if (it == stringDefinitionMap.end()) {
                     StringDefinition def;
                     def.m_length = 0;
                     def.m_output = macro;
-                    s_stringDefinitionMap.insert(name, def);
+                    stringDefinitionMap.insert(name, def);
                 } else if (mode) {
                     // .am Append Macro
                     (*it).m_length = 0; // It could be formerly a string
@@ -5328,17 +5461,17 @@ static char *scan_request(char *c)
                 out_html("<a href=\"");
 
                 if (args.count() > 0)
-                    scan_troff(args[0].data(), 0, nullptr);
+                    scan_troff(args[0], 0, nullptr);
 
                 out_html("\">");
                 if (args.count() > 1)
-                    scan_troff(args[1].data(), 0, nullptr);
+                    scan_troff(args[1], 0, nullptr);
 
                 out_html("</a>\n"); // trailing newline important to make ignore_links work
                 ignore_links = false;
 
                 if (args.count() > 2)
-                    scan_troff(args[2].data(), 1, nullptr);
+                    scan_troff(args[2], 1, nullptr);
 
                 break;
             }
@@ -5352,7 +5485,7 @@ static char *scan_request(char *c)
                 Q_FALLTHROUGH();
             case REQ_troff: // groff(7) "TROFF mode"
             {
-                s_nroff = mode;
+                nroff = mode;
                 c += j;
                 c = skip_till_newline(c);
                 break;
@@ -5385,12 +5518,12 @@ static char *scan_request(char *c)
                     break;
                 }
                 // Second parameter is origin (unlike in .rn)
-                QMap<QByteArray, StringDefinition>::iterator it = s_stringDefinitionMap.find(name2);
-                if (it == s_stringDefinitionMap.end()) {
+                QHash<QByteArray, StringDefinition>::iterator it = stringDefinitionMap.find(name2);
+                if (it == stringDefinitionMap.end()) {
                     qCDebug(KIO_MAN_LOG) << "EXCEPTION: cannot find string to make alias of " << BYTEARRAY(name2);
                 } else {
                     StringDefinition def = (*it);
-                    s_stringDefinitionMap.insert(name, def);
+                    stringDefinitionMap.insert(name, def);
                 }
                 qCDebug(KIO_MAN_LOG) << "end .als";
                 break;
@@ -5405,11 +5538,11 @@ static char *scan_request(char *c)
                     break;
                 }
                 c = skip_till_newline(c);
-                QMap<QByteArray, NumberDefinition>::iterator it = s_numberDefinitionMap.find(name);
-                if (it == s_numberDefinitionMap.end()) {
+                QHash<QByteArray, NumberDefinition>::iterator it = numberDefinitionMap.find(name);
+                if (it == numberDefinitionMap.end()) {
                     qCDebug(KIO_MAN_LOG) << "EXCEPTION: trying to remove inexistant number register: ";
                 } else {
-                    s_numberDefinitionMap.remove(name);
+                    numberDefinitionMap.remove(name);
                 }
                 qCDebug(KIO_MAN_LOG) << "end .rr";
                 break;
@@ -5431,13 +5564,13 @@ static char *scan_request(char *c)
                     break;
                 }
                 c = skip_till_newline(c);
-                QMap<QByteArray, NumberDefinition>::iterator it = s_numberDefinitionMap.find(name);
-                if (it == s_numberDefinitionMap.end()) {
+                QHash<QByteArray, NumberDefinition>::iterator it = numberDefinitionMap.find(name);
+                if (it == numberDefinitionMap.end()) {
                     qCDebug(KIO_MAN_LOG) << "EXCEPTION: cannot find number register to rename" << BYTEARRAY(name);
                 } else {
                     NumberDefinition def = (*it);
-                    s_numberDefinitionMap.remove(name); // ### QT4: removeAll
-                    s_numberDefinitionMap.insert(name2, def);
+                    numberDefinitionMap.remove(name); // ### QT4: removeAll
+                    numberDefinitionMap.insert(name2, def);
                 }
                 qCDebug(KIO_MAN_LOG) << "end .rnn";
                 break;
@@ -5470,12 +5603,12 @@ static char *scan_request(char *c)
                     break;
                 }
                 // Second parameter is origin (unlike in .rnn)
-                QMap<QByteArray, NumberDefinition>::iterator it = s_numberDefinitionMap.find(name2);
-                if (it == s_numberDefinitionMap.end()) {
+                QHash<QByteArray, NumberDefinition>::iterator it = numberDefinitionMap.find(name2);
+                if (it == numberDefinitionMap.end()) {
                     qCDebug(KIO_MAN_LOG) << "EXCEPTION: cannot find string to make alias: " << BYTEARRAY(name2);
                 } else {
                     NumberDefinition def = (*it);
-                    s_numberDefinitionMap.insert(name, def);
+                    numberDefinitionMap.insert(name, def);
                 }
                 qCDebug(KIO_MAN_LOG) << "end .aln";
                 break;
@@ -5499,8 +5632,8 @@ static char *scan_request(char *c)
                         result = 1;
                 }
                 for (unsigned int num = 0; num < result; ++num) {
-                    if (!s_argumentList.isEmpty())
-                        s_argumentList.pop_front();
+                    if (!argumentList.isEmpty())
+                        argumentList.pop_front();
                 }
                 break;
             }
@@ -5564,10 +5697,7 @@ static char *scan_request(char *c)
 
 //---------------------------------------------------------------------
 
-static int contained_tab = 0;
-static bool mandoc_line = false; // Signals whether to look for embedded mandoc commands.
-
-static char *scan_troff(char *c, bool san, char **result)
+char *Man2HtmlContextPrivate::scan_troff(char *c, bool san, char **result)
 { /* san : stop at newline */
     QByteArray intbuff;
     intbuff.reserve(MED_STR_MAX);
@@ -5602,7 +5732,7 @@ static char *scan_troff(char *c, bool san, char **result)
     char *h = c; // ### FIXME below are too many tests that may go before the position of c
     /* start scanning */
 
-    while (h && *h && (!san || newline_for_fun || (*h != '\n')) && !break_the_while_loop) {
+    while (h && *h && (!san || newline_for_fun || (*h != '\n')) && !break_the_while_loop && !(*h == '\n' && sink->isCancelled())) {
         if (*h == escapesym) {
             h++;
             FLUSHIBP;
@@ -5758,7 +5888,7 @@ static char *scan_troff(char *c, bool san, char **result)
 
 //---------------------------------------------------------------------
 
-static char *scan_troff_mandoc(char *c, bool san, char **result)
+char *Man2HtmlContextPrivate::scan_troff_mandoc(char *c, bool san, char **result)
 {
     char *ret;
     char *end = c;
@@ -5788,7 +5918,7 @@ static char *scan_troff_mandoc(char *c, bool san, char **result)
 //---------------------------------------------------------------------
 // Entry point
 
-void scan_man_page(const char *man_page)
+void Man2HtmlContextPrivate::scan_man_page(const char *man_page)
 {
     if (!man_page)
         return;
@@ -5797,24 +5927,24 @@ void scan_man_page(const char *man_page)
 
     // ### Do more init
     // Unlike man2html, we actually call this several times, hence the need to
-    // properly cleanup all those static vars
-    s_ifelseval.clear();
+    // properly cleanup all the state of the context
+    ifelseStack.clear();
 
-    s_characterDefinitionMap.clear();
-    InitCharacterDefinitions();
+    if (characterDefinitionMap.isEmpty())
+        InitCharacterDefinitions();
 
-    s_stringDefinitionMap.clear();
+    stringDefinitionMap.clear();
     InitStringDefinitions();
 
-    s_numberDefinitionMap.clear();
+    numberDefinitionMap.clear();
     InitNumberDefinitions();
 
-    s_argumentList.clear();
+    argumentList.clear();
     listItemStack.clear();
 
     in_div = 0;
 
-    s_dollarZero = ""; // No macro called yet!
+    dollarZero = ""; // No macro called yet!
     mandoc_name = "";
 
     output_possible = false;
@@ -5845,9 +5975,10 @@ void scan_man_page(const char *man_page)
         out_html("</PRE>");
     }
     out_html(NEWLINE);
+    flush_html();
 
     if (in_div) {
-        output_real("</div><div style=\"margin-left: 2cm\">\n");
+        sink->output("</div><div style=\"margin-left: 2cm\">\n");
         in_div = 0;
     }
 
@@ -5855,28 +5986,27 @@ void scan_man_page(const char *man_page)
         // The output is buggy wrt to how divs are handled.  Fixing it would
         // require closing divs before other block-level elements are output,
         // and I do not feel like going to find them all.
-        output_real("</div></div></div></div></div>\n");
+        sink->output("</div></div></div></div></div>\n");
 
-        output_real("<div id=\"footer\"><div id=\"footer_text\">\n");
+        sink->output("<div id=\"footer\"><div id=\"footer_text\">\n");
 #ifdef SIMPLE_MAN2HTML
-        output_real("Generated by kio_man");
+        sink->output("Generated by kio_man");
 #else
-        output_real("Generated by kio_man version ");
-        output_real(QString(KDE_VERSION_STRING).toHtmlEscaped().toLocal8Bit());
+        sink->output("Generated by kio_man version ");
+        sink->output(QString(KDE_VERSION_STRING).toHtmlEscaped().toLocal8Bit());
 #endif
-        output_real("</div></div></div>\n\n");
+        sink->output("</div></div></div>\n\n");
 
-        output_real("</BODY>\n</HTML>\n");
+        sink->output("</BODY>\n</HTML>\n");
     }
     delete[] buf;
 
     // Release memory
-    s_characterDefinitionMap.clear();
-    s_stringDefinitionMap.clear();
-    s_numberDefinitionMap.clear();
-    s_argumentList.clear();
+    stringDefinitionMap.clear();
+    numberDefinitionMap.clear();
+    argumentList.clear();
 
-    // reinit static variables for reuse
+    // reinit the state for reuse
     delete[] buffer;
     buffer = nullptr;
 
@@ -5901,6 +6031,20 @@ void scan_man_page(const char *man_page)
     mandoc_name_count = 0;
 }
 
+Man2HtmlContext::Man2HtmlContext()
+    : d(new Man2HtmlContextPrivate)
+{
+}
+
+Man2HtmlContext::~Man2HtmlContext() = default;
+
+void scan_man_page(Man2HtmlContext &context, Man2HtmlSink &sink, const char *man_page)
+{
+    context.d->sink = &sink;
+    context.d->scan_man_page(man_page);
+    context.d->sink = nullptr;
+}
+
 //---------------------------------------------------------------------
 
 char *manPageToUtf8(const QByteArray &input, const QByteArray &dirName)
@@ -5977,16 +6121,25 @@ char *manPageToUtf8(const QByteArray &input, const QByteArray &dirName)
 //---------------------------------------------------------------------
 
 #ifdef SIMPLE_MAN2HTML
-void output_real(const char *insert)
+class StandardOutputSink : public Man2HtmlSink
 {
-    std::cout << insert;
+public:
+    void output(const char *insert) override;
+    char *readManPage(const char *filename) override;
+};
+
+void StandardOutputSink::output(const char *insert)
+{
+    if (insert) {
+        std::cout << insert;
+    }
 }
 
-char *read_man_page(const char *filename)
+char *StandardOutputSink::readManPage(const char *filename)
 {
     KCompressionDevice fd(QFile::decodeName(filename));
     if (!fd.open(QIODevice::ReadOnly)) {
-        std::cerr << "read_man_page: can not open " << filename << std::endl;
+        std::cerr << "readManPage: can not open " << filename << std::endl;
         return nullptr;
     }
 
@@ -6006,10 +6159,12 @@ int main(int argc, char **argv)
         std::cerr << "call: " << argv[0] << " <filename>\n";
         return 1;
     }
+    Man2HtmlContext context;
+    StandardOutputSink sink;
     if (chdir(argv[1])) {
-        char *buf = read_man_page(argv[1]);
+        char *buf = sink.readManPage(argv[1]);
         if (buf) {
-            scan_man_page(buf);
+            scan_man_page(context, sink, buf);
             delete[] buf;
         }
     } else {
@@ -6017,9 +6172,9 @@ int main(int argc, char **argv)
         struct dirent *ent;
         while ((ent = readdir(dir)) != nullptr) {
             std::cerr << "converting " << ent->d_name << std::endl;
-            char *buf = read_man_page(ent->d_name);
+            char *buf = sink.readManPage(ent->d_name);
             if (buf) {
-                scan_man_page(buf);
+                scan_man_page(context, sink, buf);
                 delete[] buf;
             }
         }
@@ -9,7 +9,10 @@
 #ifndef MAN2HTML_H
 #define MAN2HTML_H
 
+#include <memory>
+
 class QByteArray;
+class Man2HtmlContextPrivate;
 
 /**
   Try to detect the encoding of given man page content
@@ -17,19 +20,58 @@ class QByteArray;
 */
 char *manPageToUtf8(const QByteArray &input, const QByteArray &dirName);
 
-/** call this with the buffer you have */
-void scan_man_page(const char *man_page);
+/**
+ * Receives the output of a conversion and provides the pages it includes.
+ */
+class Man2HtmlSink
+{
+public:
+    virtual ~Man2HtmlSink() = default;
 
-/** implement this somewhere. It will be called
-   with HTML contents
-*/
-extern void output_real(const char *insert);
+    /**
+     * Called with HTML contents
+     */
+    virtual void output(const char *insert) = 0;
+
+    /**
+     * Called for requested man pages. filename can be a
+     * relative path! Return NULL on errors. The returned
+     * char array is freed by man2html
+     */
+    virtual char *readManPage(const char *filename) = 0;
+
+    /**
+     * Polled at the end of every line. Returning true ends the conversion
+     * early, leaving the output incomplete.
+     */
+    virtual bool isCancelled() const
+    {
+        return false;
+    }
+};
 
 /**
- * called for requested man pages. filename can be a
- * relative path! Return NULL on errors. The returned
- * char array is freed by man2html
+ * The state of the conversion of a man page.
+ *
+ * A context converts one page at a time and can be reused for any number of
+ * pages. Pages can be converted in parallel by using one context per thread.
  */
-extern char *read_man_page(const char *filename);
+class Man2HtmlContext
+{
+public:
+    Man2HtmlContext();
+    ~Man2HtmlContext();
+
+    Man2HtmlContext(const Man2HtmlContext &) = delete;
+    Man2HtmlContext &operator=(const Man2HtmlContext &) = delete;
+
+private:
+    friend void scan_man_page(Man2HtmlContext &context, Man2HtmlSink &sink, const char *man_page);
+
+    const std::unique_ptr<Man2HtmlContextPrivate> d;
+};
+
+/** call this with the buffer you have */
+void scan_man_page(Man2HtmlContext &context, Man2HtmlSink &sink, const char *man_page);
 
 #endif // MAN2HTML_H
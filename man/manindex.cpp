@@ -0,0 +1,709 @@
+/*  This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "manindex.h"
+#include "kio_man_debug.h"
+
+#include <KCompressionDevice>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+
+// Bump when the layout of the stored index changes
+static const quint32 s_pageIndexMagic = 0x4d414e49; // "MANI"
+static const quint32 s_pageIndexVersion = 1;
+static const quint32 s_whatisIndexMagic = 0x4d414e57; // "MANW"
+static const quint32 s_whatisIndexVersion = 1;
+
+namespace
+{
+// Layout of the whatis index: the header, the source table, the entry table and
+// then the UTF-8 strings the tables point into. The file is only ever read on the
+// machine that wrote it, so everything is stored in host byte order.
+struct WhatisHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 sourceCount;
+    quint32 entryCount;
+    quint32 stringsSize;
+    quint32 reserved;
+};
+
+struct WhatisSource {
+    qint64 mtime;
+    qint64 size;
+    quint32 path;
+    quint32 pathLength;
+    quint32 command;
+    quint32 reserved;
+};
+
+struct WhatisEntry {
+    quint32 section;
+    quint32 sectionLength;
+    quint32 name;
+    quint32 nameLength;
+    quint32 description;
+    quint32 descriptionLength;
+};
+
+static_assert(sizeof(WhatisHeader) == 24 && sizeof(WhatisSource) == 32 && sizeof(WhatisEntry) == 24,
+              "the whatis index is mapped from disk and must not contain padding");
+}
+
+QString stripCompression(const QString &name)
+{
+    int pos = name.length();
+
+    if (name.endsWith(".gz"))
+        pos -= 3;
+    else if (name.endsWith(".z", Qt::CaseInsensitive))
+        pos -= 2;
+    else if (name.endsWith(".bz2"))
+        pos -= 4;
+    else if (name.endsWith(".bz"))
+        pos -= 3;
+    else if (name.endsWith(".lzma"))
+        pos -= 5;
+    else if (name.endsWith(".xz"))
+        pos -= 3;
+    else if (name.endsWith(".zst"))
+        pos -= 4;
+    else if (name.endsWith(".br"))
+        pos -= 3;
+
+    return (pos > 0 ? name.left(pos) : name);
+}
+
+QString stripExtension(const QString &name)
+{
+    QString wc = stripCompression(name);
+    const int pos = wc.lastIndexOf('.');
+    return (pos > 0 ? wc.left(pos) : wc);
+}
+
+static qint64 modificationTime(const QString &path)
+{
+    const QFileInfo info(path);
+    return info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+QString ManPageIndex::SectionDirectory::section() const
+{
+    return name.mid(name.startsWith(QLatin1String("sman")) ? 4 : 3);
+}
+
+const ManPageIndex::SectionDirectory *ManPageIndex::ManDirectory::section(const QString &name) const
+{
+    for (const SectionDirectory &section : sections) {
+        if (section.name == name) {
+            return &section;
+        }
+    }
+    return nullptr;
+}
+
+ManPageIndex::ManPageIndex(const QString &cacheFile)
+    : m_cacheFile(cacheFile)
+{
+}
+
+void ManPageIndex::update(const QStringList &manDirectories)
+{
+    if (!m_loaded) {
+        m_loaded = true;
+        load();
+    }
+
+    bool changed = manDirectories.count() != m_directories.count();
+    QList<ManDirectory> directories;
+    directories.reserve(manDirectories.count());
+    for (int i = 0; i < manDirectories.count(); ++i) {
+        const QString &path = manDirectories.at(i);
+        auto it = std::find_if(m_directories.begin(), m_directories.end(), [&path](const ManDirectory &dir) {
+            return dir.path == path;
+        });
+
+        ManDirectory dir;
+        if (it != m_directories.end()) {
+            changed |= (it - m_directories.begin()) != i;
+            dir = std::move(*it);
+        } else {
+            dir.path = path;
+            changed = true;
+        }
+        changed |= scanManDirectory(dir);
+        directories.append(std::move(dir));
+    }
+    m_directories = std::move(directories);
+
+    if (changed) {
+        save();
+    }
+}
+
+bool ManPageIndex::scanManDirectory(ManDirectory &dir)
+{
+    bool changed = false;
+
+    // Adding or removing a section directory changes the man directory
+    const qint64 mtime = modificationTime(dir.path);
+    if (mtime != dir.mtime) {
+        dir.mtime = mtime;
+        changed = true;
+
+        QDir dp(dir.path);
+        dp.setFilter(QDir::Dirs | QDir::NoDotAndDotDot);
+        dp.setNameFilters({QStringLiteral("man*"), QStringLiteral("sman*")});
+        const QStringList names = dp.entryList();
+
+        QList<SectionDirectory> sections;
+        sections.reserve(names.count());
+        for (const QString &name : names) {
+            auto it = std::find_if(dir.sections.begin(), dir.sections.end(), [&name](const SectionDirectory &section) {
+                return section.name == name;
+            });
+            SectionDirectory section;
+            if (it != dir.sections.end()) {
+                section = std::move(*it);
+            } else {
+                section.name = name;
+            }
+            if (!section.section().isEmpty()) {
+                sections.append(std::move(section));
+            }
+        }
+        dir.sections = std::move(sections);
+    }
+
+    // Adding or removing a page changes its section directory
+    for (SectionDirectory &section : dir.sections) {
+        changed |= scanSectionDirectory(dir.path, section);
+    }
+    return changed;
+}
+
+bool ManPageIndex::scanSectionDirectory(const QString &manDir, SectionDirectory &section)
+{
+    const QString path = manDir + '/' + section.name;
+    const qint64 mtime = modificationTime(path);
+    if (mtime == section.mtime) {
+        return false;
+    }
+
+    qCDebug(KIO_MAN_LOG) << "indexing" << path;
+    section.mtime = mtime;
+
+    QDir dp(path);
+    dp.setFilter(QDir::Files);
+    section.files = dp.entryList();
+    buildTitleHash(section);
+    return true;
+}
+
+void ManPageIndex::buildTitleHash(SectionDirectory &section)
+{
+    section.filesByTitle.clear();
+    section.filesByTitle.reserve(section.files.count());
+    for (const QString &file : std::as_const(section.files)) {
+        section.filesByTitle[stripExtension(file)].append(file);
+    }
+}
+
+bool ManPageIndex::load()
+{
+    QFile file(m_cacheFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_5);
+
+    quint32 magic;
+    quint32 version;
+    stream >> magic >> version;
+    if (magic != s_pageIndexMagic || version != s_pageIndexVersion) {
+        return false;
+    }
+
+    QList<ManDirectory> directories;
+    qint32 dirCount;
+    stream >> dirCount;
+    for (qint32 i = 0; i < dirCount && stream.status() == QDataStream::Ok; ++i) {
+        ManDirectory dir;
+        qint32 sectionCount;
+        stream >> dir.path >> dir.mtime >> sectionCount;
+        for (qint32 j = 0; j < sectionCount && stream.status() == QDataStream::Ok; ++j) {
+            SectionDirectory section;
+            stream >> section.name >> section.mtime >> section.files;
+            buildTitleHash(section);
+            dir.sections.append(std::move(section));
+        }
+        directories.append(std::move(dir));
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qCDebug(KIO_MAN_LOG) << "ignoring corrupt page index" << m_cacheFile;
+        return false;
+    }
+
+    m_directories = std::move(directories);
+    return true;
+}
+
+void ManPageIndex::save() const
+{
+    QDir().mkpath(QFileInfo(m_cacheFile).absolutePath());
+
+    QSaveFile file(m_cacheFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCDebug(KIO_MAN_LOG) << "cannot write page index" << m_cacheFile;
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_5);
+    stream << s_pageIndexMagic << s_pageIndexVersion;
+    stream << qint32(m_directories.count());
+    for (const ManDirectory &dir : m_directories) {
+        stream << dir.path << dir.mtime << qint32(dir.sections.count());
+        for (const SectionDirectory &section : dir.sections) {
+            stream << section.name << section.mtime << section.files;
+        }
+    }
+
+    file.commit();
+}
+
+WhatisIndex::WhatisIndex(const QString &cacheFile)
+    : m_cacheFile(cacheFile)
+{
+}
+
+WhatisIndex::~WhatisIndex()
+{
+    detach();
+}
+
+// whatis(1) answers from the databases of mandb, which change together with the
+// man directory and its section directories
+static qint64 commandSourceTime(const QString &dir)
+{
+    qint64 mtime = std::max(modificationTime(dir), modificationTime(dir + QLatin1String("/index.db")));
+
+    QDir dp(dir);
+    dp.setFilter(QDir::Dirs | QDir::NoDotAndDotDot);
+    const QStringList names = dp.entryList();
+    for (const QString &name : names) {
+        mtime = std::max(mtime, modificationTime(dir + '/' + name));
+    }
+    return mtime;
+}
+
+QList<WhatisIndex::Source> WhatisIndex::findSources(const QStringList &directories)
+{
+    static const QString names[] = {QStringLiteral("whatis.db"), QStringLiteral("whatis")};
+
+    QList<Source> sources;
+    for (const QString &dir : directories) {
+        if (!QFile::exists(dir)) {
+            continue;
+        }
+
+        Source source;
+        for (const QString &name : names) {
+            const QFileInfo info(dir + '/' + name);
+            if (info.isFile() && info.isReadable()) {
+                source.path = info.filePath();
+                source.mtime = info.lastModified().toMSecsSinceEpoch();
+                source.size = info.size();
+                break;
+            }
+        }
+        if (source.path.isEmpty()) {
+            // no whatis file in the directory, parse the output of the whatis(1) command
+            source.path = dir;
+            source.command = true;
+            source.mtime = commandSourceTime(dir);
+        }
+        sources.append(source);
+    }
+    return sources;
+}
+
+QByteArray WhatisIndex::build(const QList<Source> &sources)
+{
+    // "name1, name2 (section) - description"
+    static const QRegularExpression mark(QStringLiteral("\\s+\\(([^()\\s]+)\\)\\s+-\\s+"));
+
+    QList<WhatisEntry> entries;
+    QByteArray strings;
+    QHash<QByteArray, quint32> sectionOffsets;
+
+    const auto addString = [&strings](const QByteArray &string) {
+        const quint32 offset = strings.size();
+        strings += string;
+        return offset;
+    };
+
+    QList<WhatisSource> sourceRecords;
+    sourceRecords.reserve(sources.count());
+    for (const Source &source : sources) {
+        const QByteArray path = source.path.toUtf8();
+        sourceRecords.append({source.mtime, source.size, addString(path), quint32(path.size()), source.command, 0});
+    }
+
+    for (const Source &source : sources) {
+        QByteArray text;
+        if (source.command) {
+            QProcess proc;
+            proc.setProgram(QStringLiteral("whatis"));
+            proc.setArguments({QStringLiteral("-M"), source.path, QStringLiteral("-w"), QStringLiteral("*")});
+            proc.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+            proc.start();
+            proc.waitForFinished();
+            text = proc.readAllStandardOutput();
+        } else {
+            QFile file(source.path);
+            if (file.open(QIODevice::ReadOnly)) {
+                text = file.readAll();
+            }
+        }
+
+        const int count0 = entries.count();
+        for (qsizetype start = 0, end; start < text.size(); start = end + 1) {
+            end = text.indexOf('\n', start);
+            if (end < 0) {
+                end = text.size();
+            }
+            const QString l = QString::fromUtf8(text.constData() + start, end - start);
+            const QRegularExpressionMatch match = mark.match(l);
+            if (!match.hasMatch()) {
+                continue;
+            }
+
+            const QByteArray section = match.captured(1).toUtf8();
+            auto it = sectionOffsets.constFind(section);
+            if (it == sectionOffsets.constEnd()) {
+                it = sectionOffsets.insert(section, addString(section));
+            }
+            const QByteArray description = QStringView(l).mid(match.capturedEnd(0)).toUtf8();
+            const quint32 descriptionOffset = addString(description);
+
+            const QStringView names = QStringView(l).left(match.capturedStart(0));
+            for (QStringView name : names.tokenize(u',', Qt::SkipEmptyParts)) {
+                const QByteArray n = name.trimmed().toUtf8();
+                if (!n.isEmpty()) {
+                    entries.append({*it, quint32(section.size()), addString(n), quint32(n.size()), descriptionOffset, quint32(description.size())});
+                }
+            }
+        }
+        qCDebug(KIO_MAN_LOG) << "indexed" << (entries.count() - count0) << "whatis entries from" << source.path;
+    }
+
+    const WhatisHeader header = {s_whatisIndexMagic, s_whatisIndexVersion, quint32(sourceRecords.count()), quint32(entries.count()), quint32(strings.size()), 0};
+
+    QByteArray index;
+    index.reserve(sizeof(header) + sourceRecords.count() * sizeof(WhatisSource) + entries.count() * sizeof(WhatisEntry) + strings.size());
+    index.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    index.append(reinterpret_cast<const char *>(sourceRecords.constData()), sourceRecords.count() * sizeof(WhatisSource));
+    index.append(reinterpret_cast<const char *>(entries.constData()), entries.count() * sizeof(WhatisEntry));
+    index.append(strings);
+    return index;
+}
+
+void WhatisIndex::update(const QStringList &directories)
+{
+    const QList<Source> sources = findSources(directories);
+
+    if (!m_loaded) {
+        m_loaded = true;
+        map();
+    }
+    if (m_data && m_sources == sources) {
+        return;
+    }
+
+    qCDebug(KIO_MAN_LOG) << "building whatis index" << m_cacheFile;
+    const QByteArray index = build(sources);
+
+    QDir().mkpath(QFileInfo(m_cacheFile).absolutePath());
+    QSaveFile file(m_cacheFile);
+    bool saved = file.open(QIODevice::WriteOnly) && file.write(index) == index.size() && file.commit();
+
+    detach();
+    if (!saved || !map() || m_sources != sources) {
+        qCDebug(KIO_MAN_LOG) << "cannot write whatis index" << m_cacheFile;
+        detach();
+        m_buffer = index;
+        attach(reinterpret_cast<const uchar *>(m_buffer.constData()), m_buffer.size());
+    }
+}
+
+bool WhatisIndex::map()
+{
+    m_file.setFileName(m_cacheFile);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const qint64 size = m_file.size();
+    const uchar *data = size >= qint64(sizeof(WhatisHeader)) ? m_file.map(0, size) : nullptr;
+    if (!data || !attach(data, size)) {
+        qCDebug(KIO_MAN_LOG) << "ignoring invalid whatis index" << m_cacheFile;
+        detach();
+        return false;
+    }
+    return true;
+}
+
+bool WhatisIndex::attach(const uchar *data, qint64 size)
+{
+    WhatisHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != s_whatisIndexMagic || header.version != s_whatisIndexVersion) {
+        return false;
+    }
+
+    const qint64 expectedSize = sizeof(WhatisHeader) + qint64(header.sourceCount) * sizeof(WhatisSource) + qint64(header.entryCount) * sizeof(WhatisEntry)
+        + header.stringsSize;
+    if (size != expectedSize) {
+        return false;
+    }
+
+    m_data = data;
+    m_size = size;
+
+    const auto *sourceRecords = reinterpret_cast<const WhatisSource *>(m_data + sizeof(WhatisHeader));
+    m_sources.clear();
+    m_sources.reserve(header.sourceCount);
+    for (quint32 i = 0; i < header.sourceCount; ++i) {
+        const WhatisSource &record = sourceRecords[i];
+        m_sources.append({QString::fromUtf8(string(record.path, record.pathLength)), record.command != 0, record.mtime, record.size});
+    }
+    return true;
+}
+
+void WhatisIndex::detach()
+{
+    if (m_file.isOpen()) {
+        if (m_data) {
+            m_file.unmap(const_cast<uchar *>(m_data));
+        }
+        m_file.close();
+    }
+    m_buffer.clear();
+    m_data = nullptr;
+    m_size = 0;
+    m_sources.clear();
+}
+
+QByteArrayView WhatisIndex::string(quint32 offset, quint32 length) const
+{
+    const auto *header = reinterpret_cast<const WhatisHeader *>(m_data);
+    const qint64 stringsOffset = m_size - header->stringsSize;
+    if (qint64(offset) + length > header->stringsSize) {
+        return QByteArrayView();
+    }
+    return QByteArrayView(m_data + stringsOffset + offset, length);
+}
+
+QMap<QString, QString> WhatisIndex::entries(const QString &section) const
+{
+    QMap<QString, QString> entries;
+    if (!m_data) {
+        return entries;
+    }
+
+    const auto *header = reinterpret_cast<const WhatisHeader *>(m_data);
+    const auto *records = reinterpret_cast<const WhatisEntry *>(m_data + sizeof(WhatisHeader) + header->sourceCount * sizeof(WhatisSource));
+    const QByteArray wanted = section.toUtf8();
+
+    // section strings are shared between entries, so each one is only compared once
+    QHash<quint32, bool> sectionMatches;
+    for (quint32 i = 0; i < header->entryCount; ++i) {
+        const WhatisEntry &record = records[i];
+        auto it = sectionMatches.constFind(record.section);
+        if (it == sectionMatches.constEnd()) {
+            const QByteArrayView entrySection = string(record.section, record.sectionLength);
+            // the section itself, optionally followed by a lower case suffix
+            const bool matches = entrySection.startsWith(wanted) && std::all_of(entrySection.begin() + wanted.size(), entrySection.end(), [](char c) {
+                                     return c >= 'a' && c <= 'z';
+                                 });
+            it = sectionMatches.insert(record.section, matches);
+        }
+        if (*it) {
+            entries.insert(QString::fromUtf8(string(record.name, record.nameLength)),
+                           QString::fromUtf8(string(record.description, record.descriptionLength)));
+        }
+    }
+    return entries;
+}
+
+static QStringList findManPagesInSection(const ManPageIndex::ManDirectory &manDir, const QString &subdir, const QString &title, bool full_path)
+{
+    const ManPageIndex::SectionDirectory *section = manDir.section(subdir);
+    if (!section)
+        return QStringList();
+
+    qCDebug(KIO_MAN_LOG) << "in" << manDir.path << subdir << "title" << title;
+
+    // all pages, or the ones whose name without extension matches the title
+    const QStringList names = title.isEmpty() ? section->files : section->filesByTitle.value(title);
+    if (!full_path)
+        return names;
+
+    const QString dir = manDir.path + '/' + subdir + '/';
+    QStringList list;
+    list.reserve(names.count());
+    for (const QString &name : names) {
+        list.append(dir + name);
+    }
+
+    qCDebug(KIO_MAN_LOG) << "returning" << list.count() << "pages";
+    return (list);
+}
+
+QStringList findManPages(const QList<ManPageIndex::ManDirectory> &directories, const QString &_section, const QString &title, bool full_path)
+{
+    QStringList list;
+    // qCDebug(KIO_MAN_LOG) << "findPages '" << section << "' '" << title << "'\n";
+    if (title.startsWith('/')) // absolute man page path
+    {
+        list.append(title); // just that and nothing else
+        return list;
+    }
+
+    const QString star("*"); // flag for finding sections
+    const QString man("man"); // prefix for ROFF subdirectories
+    const QString sman("sman"); // prefix for SGML subdirectories
+
+    // Generate a list of applicable sections
+    QStringList sect_list;
+    if (!_section.isEmpty()) // section requested as parameter
+    {
+        sect_list += _section;
+
+        // It's not clear what this code does.  If a section with a letter
+        // suffix is specified, for example "3p", both "3p" and "3" are
+        // added to the section list.  The result is that "man:(3p)" returns
+        // the same entries as "man:(3)"
+        QString section = _section;
+        while ((!section.isEmpty()) && (section.at(section.length() - 1).isLetter())) {
+            section.truncate(section.length() - 1);
+            sect_list += section;
+        }
+    } else {
+        sect_list += star;
+    }
+
+    // Find man pages in the sections specified above,
+    // or all sections.
+    //
+    // Do not convert this loop to an iterator, or 'it_s' below
+    // to a reference.  The 'sect_list' list can be modified
+    // within the loop.
+    for (int i = 0; i < sect_list.count(); ++i) {
+        const QString it_s = sect_list.at(i);
+        QString it_real = it_s.toLower();
+
+        // Find applicable pages within all man directories.
+        for (const ManPageIndex::ManDirectory &man_dir : directories) {
+            // Use all subdirectories named "man*" and "sman*"
+            // to extend the list of sections and find the correct
+            // case for the section suffix.
+            for (const ManPageIndex::SectionDirectory &section_dir : man_dir.sections) {
+                const QString sect = section_dir.section();
+
+                if (sect.toLower() == it_real)
+                    it_real = sect;
+
+                // Only add sect if not already contained, avoid duplicates
+                if (!sect_list.contains(sect) && _section.isEmpty()) {
+                    // qCDebug(KIO_MAN_LOG) << "another section " << sect;
+                    sect_list += sect;
+                }
+            }
+
+            if (it_s != star) // finding pages, not just sections
+            {
+                list.append(findManPagesInSection(man_dir, man + it_real, title, full_path));
+                list.append(findManPagesInSection(man_dir, sman + it_real, title, full_path));
+            }
+        }
+    }
+
+    // qCDebug(KIO_MAN_LOG) << "finished " << list << " " << sect_list;
+    return list;
+}
+
+QString uniqueManPage(const QStringList &pages)
+{
+    if (pages.isEmpty()) {
+        return QString();
+    }
+
+    // To make this generic with regard to compression suffixes, assume that the
+    // first page name is the shortest. Then check that all of the others are the
+    // same with a possible compression suffix added.
+    const QString &page = pages.first();
+    for (int i = 1; i < pages.count(); ++i) {
+        if (!pages.at(i).startsWith(page + '.')) {
+            return QString();
+        }
+    }
+    return page;
+}
+
+ManPageFile readManPageFile(const QByteArray &fileName, QByteArray &lastDir)
+{
+    ManPageFile file;
+    file.fileName = fileName;
+    if (QDir::isRelativePath(QFile::decodeName(file.fileName))) {
+        qCDebug(KIO_MAN_LOG) << "relative" << file.fileName;
+        file.fileName = QDir::cleanPath(QFile::decodeName(lastDir + '/' + file.fileName)).toUtf8();
+        qCDebug(KIO_MAN_LOG) << "resolved to" << file.fileName;
+    }
+
+    lastDir = file.fileName.left(file.fileName.lastIndexOf('/'));
+
+    // the last directory name might be a language name, to be able to guess the encoding
+    QDir dir(QFile::decodeName(lastDir));
+    dir.cdUp();
+    file.dirName = QFile::encodeName(dir.dirName());
+
+    if (!QFile::exists(QFile::decodeName(file.fileName))) {
+        qCDebug(KIO_MAN_LOG) << "not existing" << file.fileName;
+        QDir manDir(QFile::decodeName(lastDir));
+        manDir.setNameFilters(QStringList(QFile::decodeName(file.fileName.mid(file.fileName.lastIndexOf('/') + 1)) + QLatin1String(".*")));
+        const QStringList entries = manDir.entryList();
+        if (entries.isEmpty()) {
+            return file;
+        }
+        file.fileName = lastDir + '/' + QFile::encodeName(entries.first());
+        qCDebug(KIO_MAN_LOG) << "resolved to" << file.fileName;
+    }
+
+    KCompressionDevice device(QFile::decodeName(file.fileName));
+    if (!device.open(QIODevice::ReadOnly)) {
+        file.status = ManPageFile::NotReadable;
+        return file;
+    }
+    file.data = device.readAll();
+    file.status = ManPageFile::Read;
+    qCDebug(KIO_MAN_LOG) << "read" << file.data.size();
+    return file;
+}
@@ -0,0 +1,178 @@
+/*  This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+#ifndef MANINDEX_H
+#define MANINDEX_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+/**
+ * Drop trailing compression suffix from name
+ */
+QString stripCompression(const QString &name);
+
+/**
+ * Drop trailing compression suffix and section from name
+ */
+QString stripExtension(const QString &name);
+
+/**
+ * Index of all man pages in the man directories, persisted in the user's cache
+ * directory so that finding a page does not need to list every section directory.
+ *
+ * The index keeps the modification time of every man directory and of every
+ * section directory within, and update() only lists the directories again whose
+ * modification time has changed since the index was written.
+ */
+class ManPageIndex
+{
+public:
+    struct SectionDirectory {
+        QString name; ///< "man<section>" or "sman<section>"
+        qint64 mtime = 0;
+        QStringList files; ///< in QDir::entryList() order
+        QHash<QString, QStringList> filesByTitle; ///< not stored, built from files
+
+        /** The section suffix of the directory name */
+        QString section() const;
+    };
+
+    struct ManDirectory {
+        QString path;
+        qint64 mtime = 0;
+        QList<SectionDirectory> sections; ///< in QDir::entryList() order
+
+        const SectionDirectory *section(const QString &name) const;
+    };
+
+    explicit ManPageIndex(const QString &cacheFile);
+
+    /**
+     * Makes the index cover exactly @p manDirectories, in that order, and lists
+     * again all directories that changed since they were indexed.
+     */
+    void update(const QStringList &manDirectories);
+
+    const QList<ManDirectory> &directories() const
+    {
+        return m_directories;
+    }
+
+private:
+    bool load();
+    void save() const;
+
+    static bool scanManDirectory(ManDirectory &dir);
+    static bool scanSectionDirectory(const QString &manDir, SectionDirectory &section);
+    static void buildTitleHash(SectionDirectory &section);
+
+    const QString m_cacheFile;
+    QList<ManDirectory> m_directories;
+    bool m_loaded = false;
+};
+
+/**
+ * Returns the man pages named @p title in @p section of @p directories, or in all
+ * sections if @p section is empty. A section with a letter suffix such as "3p"
+ * also finds the pages in "3". An absolute path as @p title is returned as is.
+ */
+QStringList findManPages(const QList<ManPageIndex::ManDirectory> &directories, const QString &section, const QString &title, bool fullPath = true);
+
+/**
+ * Returns the page that all of the sorted @p pages refer to, for example "foo.1"
+ * for "foo.1" and "foo.1.gz", or an empty string if they are different pages.
+ */
+QString uniqueManPage(const QStringList &pages);
+
+/**
+ * A man page file as read for converting it, see readManPageFile().
+ */
+struct ManPageFile {
+    enum Status {
+        Read,
+        NotFound,
+        NotReadable,
+    };
+
+    Status status = NotFound;
+    QByteArray fileName; ///< The file that was read, or the name that was looked up
+    QByteArray dirName; ///< The directory above the section directory, which might be a language
+    QByteArray data;
+};
+
+/**
+ * Reads the man page @p fileName, which is relative to @p lastDir if it is a relative
+ * path, and sets @p lastDir to the directory of the page. A name of a file that does
+ * not exist finds the first file of that name with a suffix, like a compression suffix.
+ */
+ManPageFile readManPageFile(const QByteArray &fileName, QByteArray &lastDir);
+
+/**
+ * The descriptions of all man pages from the whatis databases, pre-parsed for all
+ * sections at once and stored in the user's cache directory.
+ *
+ * The index is a flat binary file which is mapped into memory, so a worker loads it
+ * once and a section index page only has to walk the entry table. It is rebuilt
+ * when a whatis database changes, or when the man directories change for which
+ * the descriptions come from the output of whatis(1).
+ */
+class WhatisIndex
+{
+public:
+    explicit WhatisIndex(const QString &cacheFile);
+    ~WhatisIndex();
+
+    WhatisIndex(const WhatisIndex &) = delete;
+    WhatisIndex &operator=(const WhatisIndex &) = delete;
+
+    /**
+     * Makes the index cover the whatis databases in @p directories, in that order.
+     * Descriptions from later directories override those from earlier ones.
+     */
+    void update(const QStringList &directories);
+
+    /**
+     * Returns the descriptions of all pages in @p section, including its
+     * subsections such as "3ssl" for "3", by page name.
+     */
+    QMap<QString, QString> entries(const QString &section) const;
+
+private:
+    struct Source {
+        QString path; ///< the whatis file, or the directory passed to whatis(1)
+        bool command = false;
+        qint64 mtime = 0;
+        qint64 size = 0;
+
+        bool operator==(const Source &other) const
+        {
+            return path == other.path && command == other.command && mtime == other.mtime && size == other.size;
+        }
+    };
+
+    static QList<Source> findSources(const QStringList &directories);
+    static QByteArray build(const QList<Source> &sources);
+
+    bool map();
+    bool attach(const uchar *data, qint64 size);
+    void detach();
+    QByteArrayView string(quint32 offset, quint32 length) const;
+
+    const QString m_cacheFile;
+    QFile m_file;
+    QByteArray m_buffer; ///< the index if it could not be written to the cache
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+    QList<Source> m_sources; ///< sources of the attached index
+    bool m_loaded = false;
+};
+
+#endif // MANINDEX_H
@@ -0,0 +1,190 @@
+/*  This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "pageprefetcher.h"
+#include "kio_man_debug.h"
+#include "man2html.h"
+
+#include <QFile>
+#include <QSet>
+#include <QThread>
+
+#include <algorithm>
+#include <time.h>
+
+// Upper bound for the pages converted for one page that is viewed
+static const int s_maxPages = 64;
+
+namespace
+{
+// Collects the output of a page, and reads the pages it includes like
+// MANProtocol::readManPage() does
+class PrefetchSink : public Man2HtmlSink
+{
+public:
+    explicit PrefetchSink(const std::atomic<bool> &stopped)
+        : m_stopped(stopped)
+    {
+    }
+
+    void output(const char *insert) override
+    {
+        if (insert) {
+            html.append(insert);
+        }
+    }
+
+    char *readManPage(const char *filename) override;
+
+    bool isCancelled() const override
+    {
+        return m_stopped;
+    }
+
+    QByteArray html;
+    QByteArray lastDir;
+    bool failed = false; ///< an included page could not be read, so the output is an error
+
+private:
+    const std::atomic<bool> &m_stopped;
+};
+
+char *PrefetchSink::readManPage(const char *filename)
+{
+    const ManPageFile file = readManPageFile(filename, lastDir);
+    if (file.status != ManPageFile::Read || file.data.isEmpty()) {
+        failed = true;
+        return nullptr;
+    }
+    return manPageToUtf8(file.data, file.dirName);
+}
+
+// The CPU time used by the calling thread, in milliseconds
+qint64 threadCpuTime()
+{
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return qint64(time.tv_sec) * 1000 + time.tv_nsec / 1000000;
+}
+}
+
+PagePrefetcher::PagePrefetcher(const HtmlCache &cache)
+    : m_cache(cache)
+{
+}
+
+PagePrefetcher::~PagePrefetcher()
+{
+    stop();
+}
+
+void PagePrefetcher::start(const QString &path, const QByteArray &html, const QList<ManPageIndex::ManDirectory> &directories, int depth, int cpuTime)
+{
+    stop();
+    if (depth < 1 || cpuTime <= 0) {
+        return;
+    }
+
+    m_thread.reset(QThread::create([=, this] {
+        run(path, html, directories, depth, cpuTime);
+    }));
+    // SCHED_IDLE on Linux, so the prefetch only uses CPU time nothing else wants
+    m_thread->start(QThread::IdlePriority);
+}
+
+void PagePrefetcher::stop()
+{
+    if (m_thread) {
+        m_stopped = true;
+        m_thread->wait();
+        m_thread.reset();
+        m_stopped = false;
+    }
+}
+
+QList<PagePrefetcher::Link> PagePrefetcher::links(const QByteArray &html)
+{
+    // as generated by add_links() in man2html
+    static const QByteArray prefix = QByteArrayLiteral("<a href=\"man:/");
+    const qsizetype seeAlso = html.lastIndexOf("SEE ALSO");
+
+    QList<Link> seeAlsoLinks;
+    QList<Link> otherLinks;
+    for (qsizetype pos = html.indexOf(prefix); pos >= 0; pos = html.indexOf(prefix, pos)) {
+        pos += prefix.size();
+        const qsizetype end = html.indexOf('"', pos);
+        if (end < 0) {
+            break;
+        }
+        // name(section)
+        const QString url = QString::fromUtf8(html.constData() + pos, end - pos);
+        const qsizetype open = url.indexOf('(');
+        if (open > 0 && url.endsWith(')')) {
+            const Link link{url.left(open), url.mid(open + 1, url.size() - open - 2)};
+            (seeAlso >= 0 && pos > seeAlso ? seeAlsoLinks : otherLinks).append(link);
+        }
+        pos = end;
+    }
+    return seeAlsoLinks + otherLinks;
+}
+
+void PagePrefetcher::run(const QString &path, const QByteArray &html, const QList<ManPageIndex::ManDirectory> &directories, int depth, int cpuTime)
+{
+    struct Pending {
+        Link link;
+        int depth;
+    };
+    QList<Pending> queue;
+    for (const Link &link : links(html)) {
+        queue.append(Pending{link, 1});
+    }
+
+    QSet<QString> seen{path};
+    Man2HtmlContext context;
+    int converted = 0;
+    const qint64 deadline = threadCpuTime() + cpuTime;
+    for (qsizetype i = 0; i < queue.size() && converted < s_maxPages; ++i) {
+        if (m_stopped || threadCpuTime() >= deadline) {
+            qCDebug(KIO_MAN_LOG) << "prefetch stopped after" << converted << "pages";
+            return;
+        }
+        const Pending pending = queue.at(i);
+
+        QStringList pages = findManPages(directories, pending.link.section, pending.link.title);
+        std::sort(pages.begin(), pages.end());
+        const QString page = uniqueManPage(pages);
+        // SGML pages would need an external converter
+        if (page.isEmpty() || page.contains(QLatin1String("/sman/"), Qt::CaseInsensitive) || seen.contains(page)) {
+            continue;
+        }
+        seen.insert(page);
+
+        QByteArray pageHtml = pending.depth < depth ? m_cache.find(page) : QByteArray();
+        if (pageHtml.isNull() && !m_cache.contains(page)) {
+            PrefetchSink sink(m_stopped);
+            char *buf = sink.readManPage(QFile::encodeName(page));
+            if (!buf) {
+                continue;
+            }
+            scan_man_page(context, sink, buf);
+            delete[] buf;
+            if (sink.failed || m_stopped) {
+                // an error page, or cut off
+                continue;
+            }
+            m_cache.insert(page, sink.html);
+            pageHtml = sink.html;
+            ++converted;
+            qCDebug(KIO_MAN_LOG) << "prefetched" << page;
+        }
+
+        if (pending.depth < depth) {
+            for (const Link &link : links(pageHtml)) {
+                queue.append(Pending{link, pending.depth + 1});
+            }
+        }
+    }
+}
@@ -0,0 +1,73 @@
+/*  This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+#ifndef PAGEPREFETCHER_H
+#define PAGEPREFETCHER_H
+
+#include "htmlcache.h"
+#include "manindex.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include <atomic>
+#include <memory>
+
+class QThread;
+
+/**
+ * Converts the pages that a man page links to, those in its SEE ALSO section first,
+ * into the HTML cache in the background, so that following a link is served from
+ * the cache.
+ *
+ * The pages are converted in a thread with idle priority and a conversion context of
+ * its own. Links of the converted pages are followed up to a maximum depth, and the
+ * thread stops once it has used up its CPU time budget, or when it is told to stop.
+ */
+class PagePrefetcher
+{
+public:
+    struct Link {
+        QString title;
+        QString section;
+    };
+
+    explicit PagePrefetcher(const HtmlCache &cache);
+    ~PagePrefetcher();
+
+    PagePrefetcher(const PagePrefetcher &) = delete;
+    PagePrefetcher &operator=(const PagePrefetcher &) = delete;
+
+    /**
+     * Stops the previous prefetch and starts one for the links in @p html, the
+     * output for the man page @p path.
+     *
+     * @param directories the man directories to find the linked pages in
+     * @param depth the levels of links to follow, 1 for the links in @p html only
+     * @param cpuTime the CPU time in milliseconds that all conversions may use together
+     */
+    void start(const QString &path, const QByteArray &html, const QList<ManPageIndex::ManDirectory> &directories, int depth, int cpuTime);
+
+    /**
+     * Stops the prefetch, cutting off the conversion of the page at the end of
+     * the line being converted. That page is not stored.
+     */
+    void stop();
+
+    /**
+     * Returns the links to man pages in @p html, those after the SEE ALSO heading first.
+     */
+    static QList<Link> links(const QByteArray &html);
+
+private:
+    void run(const QString &path, const QByteArray &html, const QList<ManPageIndex::ManDirectory> &directories, int depth, int cpuTime);
+
+    HtmlCache m_cache;
+    std::unique_ptr<QThread> m_thread;
+    std::atomic<bool> m_stopped = false;
+};
+
+#endif // PAGEPREFETCHER_H
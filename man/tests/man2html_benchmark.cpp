@@ -0,0 +1,139 @@
+/*  This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+// Measures how fast man2html converts a corpus of man pages, e.g.
+// man2html_benchmark -n 5 /usr/share/man/man1 /usr/share/man/man3
+
+#include "man2html.h"
+
+#include <KCompressionDevice>
+#include <QByteArray>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+#include <QStringList>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+// Only counts the output, so that the benchmark measures the conversion alone
+class CountingSink : public Man2HtmlSink
+{
+public:
+    void output(const char *insert) override
+    {
+        if (insert) {
+            bytes += qstrlen(insert);
+        }
+    }
+
+    char *readManPage(const char *filename) override
+    {
+        // pages included with .so are not part of the corpus
+        Q_UNUSED(filename)
+        return nullptr;
+    }
+
+    qint64 bytes = 0;
+};
+
+struct Page {
+    char *source = nullptr; ///< in UTF-8, as the worker passes it to man2html
+    qint64 size = 0;
+};
+
+bool loadPage(const QString &path, Page &page)
+{
+    KCompressionDevice fd(path);
+    if (!fd.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDir dir(QFileInfo(path).dir());
+    dir.cdUp();
+    page.source = manPageToUtf8(fd.readAll(), QFile::encodeName(dir.dirName()));
+    page.size = page.source ? qstrlen(page.source) : 0;
+    return page.source != nullptr;
+}
+
+QStringList findPages(const QStringList &paths)
+{
+    QStringList files;
+    for (const QString &path : paths) {
+        if (QFileInfo(path).isDir()) {
+            QDirIterator it(path, QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                files.append(it.next());
+            }
+        } else {
+            files.append(path);
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = 3;
+    QStringList paths;
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = std::max(1, atoi(argv[++i]));
+        } else {
+            paths.append(QFile::decodeName(argv[i]));
+        }
+    }
+    if (paths.isEmpty()) {
+        paths.append(QStringLiteral("/usr/share/man"));
+    }
+
+    QList<Page> pages;
+    qint64 corpusSize = 0;
+    for (const QString &file : findPages(paths)) {
+        Page page;
+        if (loadPage(file, page)) {
+            pages.append(page);
+            corpusSize += page.size;
+        }
+    }
+    if (pages.isEmpty()) {
+        fprintf(stderr, "no man pages found\n");
+        return 1;
+    }
+
+    // one context for all pages, as the worker uses it
+    Man2HtmlContext context;
+    CountingSink sink;
+    qint64 best = -1;
+    for (int i = 0; i < iterations; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        for (const Page &page : std::as_const(pages)) {
+            scan_man_page(context, sink, page.source);
+        }
+        const qint64 elapsed = timer.nsecsElapsed();
+        best = best < 0 ? elapsed : std::min(best, elapsed);
+    }
+
+    const double seconds = best / 1e9;
+    printf("%lld pages, %.2f MB of roff source, %lld bytes of HTML per run\n",
+           qint64(pages.size()),
+           corpusSize / 1e6,
+           sink.bytes / iterations);
+    printf("best of %d runs: %.3f s, %.2f MB/s, %.0f pages/s\n", iterations, seconds, corpusSize / 1e6 / seconds, pages.size() / seconds);
+
+    for (const Page &page : std::as_const(pages)) {
+        delete[] page.source;
+    }
+    return 0;
+}
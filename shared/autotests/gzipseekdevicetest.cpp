@@ -0,0 +1,246 @@
+/*
+    SPDX-License-Identifier: LGPL-2.0-or-later
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+*/
+
+#include <KArchiveDirectory>
+#include <KArchiveFile>
+#include <KCompressionDevice>
+#include <KTar>
+
+#include <QBuffer>
+#include <QDataStream>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <algorithm>
+
+#include "gzipseekdevice.h"
+
+// Much smaller than what the workers use, for many checkpoints in a small archive
+static const qint64 s_span = 16 * 1024;
+
+static QByteArray gzip(const QByteArray &data)
+{
+    QByteArray compressed;
+    QBuffer buffer(&compressed);
+    buffer.open(QIODevice::WriteOnly);
+    KCompressionDevice device(&buffer, false, KCompressionDevice::GZip);
+    if (!device.open(QIODevice::WriteOnly) || device.write(data) != data.size()) {
+        return {};
+    }
+    device.close();
+    return compressed;
+}
+
+// Compresses well, into many deflate blocks
+static QByteArray lines(const QByteArray &prefix, int count)
+{
+    QByteArray data;
+    for (int i = 0; i < count; ++i) {
+        data += prefix + ' ' + QByteArray::number(i) + '\n';
+    }
+    return data;
+}
+
+static QByteArray randomData(qsizetype size, quint32 seed)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    QRandomGenerator generator(seed);
+    generator.fillRange(reinterpret_cast<quint32 *>(data.data()), size / sizeof(quint32));
+    return data;
+}
+
+static QByteArray readEntry(const QString &fileName, const std::shared_ptr<GzipIndex> &index, const KArchiveFile *file)
+{
+    GzipSeekDevice device(fileName, index, file->position(), file->size());
+    if (!device.open(QIODevice::ReadOnly)) {
+        return "open failed";
+    }
+    return device.readAll();
+}
+
+class GzipSeekDeviceTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(m_dir.isValid());
+
+        // a tar of files compressing well and not at all, and of small and large ones
+        QBuffer buffer(&m_tar);
+        KTar tar(&buffer);
+        QVERIFY(tar.open(QIODevice::WriteOnly));
+        for (int i = 0; i < 20; ++i) {
+            const QByteArray data = i % 3 == 0 ? randomData(i * 7000, i) : lines("file " + QByteArray::number(i), i * i * 100);
+            QVERIFY(tar.writeFile(QStringLiteral("dir%1/file%2").arg(i % 4).arg(i), data));
+        }
+        QVERIFY(tar.close());
+
+        // Compressed as several members, which end in the middle of the files,
+        // between checkpoints, as a file of gzip files joined with cat would
+        QByteArray compressed;
+        const qsizetype memberSize = m_tar.size() / 3 + 1234;
+        for (qsizetype offset = 0; offset < m_tar.size(); offset += memberSize) {
+            compressed += gzip(m_tar.mid(offset, memberSize));
+        }
+        m_fileName = m_dir.filePath(QStringLiteral("archive.tar.gz"));
+        QFile file(m_fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(compressed), compressed.size());
+    }
+
+    void testEntries()
+    {
+        QBuffer buffer(&m_tar);
+        KTar tar(&buffer);
+        QVERIFY(tar.open(QIODevice::ReadOnly));
+        const QList<const KArchiveFile *> files = archiveFiles(tar.directory());
+        QCOMPARE(files.count(), 20);
+
+        auto index = std::make_shared<GzipIndex>();
+        index->span = s_span;
+
+        // the files in a shuffled order, reading going back and forth, and ahead of what the index covers
+        QList<const KArchiveFile *> shuffled = files;
+        std::shuffle(shuffled.begin(), shuffled.end(), *QRandomGenerator::global());
+        for (const KArchiveFile *file : std::as_const(shuffled)) {
+            QCOMPARE(readEntry(m_fileName, index, file), file->data());
+        }
+        QVERIFY(index->checkpoints.count() > 10);
+        QVERIFY(index->isValid());
+
+        // backwards, restoring the checkpoints recorded on the way, also those
+        // in the members after the first one
+        for (auto it = files.crbegin(); it != files.crend(); ++it) {
+            QCOMPARE(readEntry(m_fileName, index, *it), (*it)->data());
+        }
+    }
+
+    void testSeek()
+    {
+        auto index = std::make_shared<GzipIndex>();
+        index->span = s_span;
+        GzipSeekDevice device(m_fileName, index);
+        QVERIFY(device.open(QIODevice::ReadOnly));
+        QCOMPARE(device.size(), qint64(-1));
+
+        // forward beyond the index, then backwards within it
+        const qint64 size = m_tar.size();
+        for (const qint64 offset : {size / 2, size / 4, size * 3 / 4, size / 3, qint64(0), size / 2 + 100}) {
+            QVERIFY(device.seek(offset));
+            QCOMPARE(device.read(5000), m_tar.mid(offset, 5000));
+        }
+        QCOMPARE(device.size(), qint64(-1));
+        QVERIFY(!index->isComplete());
+
+        // the end of the last member tells the size
+        QVERIFY(device.seek(size - 10));
+        QCOMPARE(device.read(100), m_tar.right(10));
+        QCOMPARE(device.size(), size);
+        QCOMPARE(index->size, size);
+        QVERIFY(index->isValid());
+        QVERIFY(device.read(100).isEmpty());
+
+        // every checkpoint restores what inflate had there
+        for (const GzipCheckpoint &checkpoint : std::as_const(index->checkpoints)) {
+            GzipSeekDevice restored(m_fileName, index, checkpoint.output);
+            QVERIFY(restored.open(QIODevice::ReadOnly));
+            QCOMPARE(restored.read(1000), m_tar.mid(checkpoint.output, 1000));
+        }
+
+        // random reads with a complete index
+        for (int i = 0; i < 100; ++i) {
+            const qint64 offset = QRandomGenerator::global()->bounded(size);
+            const qint64 length = QRandomGenerator::global()->bounded(3 * s_span);
+            QVERIFY(device.seek(offset));
+            QCOMPARE(device.read(length), m_tar.mid(offset, length));
+        }
+    }
+
+    void testStream()
+    {
+        auto index = std::make_shared<GzipIndex>();
+        index->span = s_span;
+        GzipSeekDevice device(m_fileName, index);
+        QVERIFY(device.open(QIODevice::ReadOnly));
+        QVERIFY(device.seek(m_tar.size() / 2));
+        QVERIFY(!device.read(100).isEmpty());
+
+        QByteArray stored;
+        {
+            QDataStream stream(&stored, QIODevice::WriteOnly);
+            stream << *index;
+        }
+
+        // the stored index goes on growing where it was left
+        auto loaded = std::make_shared<GzipIndex>();
+        QDataStream stream(stored);
+        stream >> *loaded;
+        QCOMPARE(stream.status(), QDataStream::Ok);
+        QVERIFY(loaded->isValid());
+        QCOMPARE(loaded->indexed, index->indexed);
+        QCOMPARE(loaded->checkpoints.count(), index->checkpoints.count());
+        GzipSeekDevice other(m_fileName, loaded);
+        QVERIFY(other.open(QIODevice::ReadOnly));
+        QVERIFY(other.seek(m_tar.size() / 3));
+        QCOMPARE(other.read(s_span), m_tar.mid(m_tar.size() / 3, s_span));
+        QVERIFY(other.seek(m_tar.size() - 1000));
+        QCOMPARE(other.read(2000), m_tar.right(1000));
+        QVERIFY(loaded->isComplete());
+
+        // out of order checkpoints are rejected
+        if (loaded->checkpoints.count() > 1) {
+            std::swap(loaded->checkpoints.first(), loaded->checkpoints.last());
+            QVERIFY(!loaded->isValid());
+        }
+    }
+
+    void testTruncated()
+    {
+        QFile file(m_fileName);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QString truncated = m_dir.filePath(QStringLiteral("truncated.tar.gz"));
+        QFile out(truncated);
+        QVERIFY(out.open(QIODevice::WriteOnly));
+        out.write(file.read(file.size() - 100));
+        out.close();
+
+        auto index = std::make_shared<GzipIndex>();
+        index->span = s_span;
+        GzipSeekDevice device(truncated, index);
+        QVERIFY(device.open(QIODevice::ReadOnly));
+        QCOMPARE(device.read(1000), m_tar.left(1000));
+        QVERIFY(device.seek(m_tar.size() - 10));
+        char data[10];
+        QCOMPARE(device.read(data, sizeof(data)), qint64(-1));
+        QVERIFY(!index->isComplete());
+    }
+
+private:
+    static QList<const KArchiveFile *> archiveFiles(const KArchiveDirectory *directory)
+    {
+        QList<const KArchiveFile *> files;
+        const QStringList names = directory->entries();
+        for (const QString &name : names) {
+            const KArchiveEntry *entry = directory->entry(name);
+            if (entry->isDirectory()) {
+                files += archiveFiles(static_cast<const KArchiveDirectory *>(entry));
+            } else {
+                files.append(static_cast<const KArchiveFile *>(entry));
+            }
+        }
+        return files;
+    }
+
+    QTemporaryDir m_dir;
+    QByteArray m_tar; ///< uncompressed
+    QString m_fileName; ///< of m_tar compressed
+};
+
+QTEST_GUILESS_MAIN(GzipSeekDeviceTest)
+
+#include "gzipseekdevicetest.moc"
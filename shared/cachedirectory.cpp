@@ -0,0 +1,47 @@
+/*  This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "cachedirectory.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+QString CacheDirectory::cacheFile(const QString &directory, const QString &fileName, const QList<QByteArray> &keys, const QString &suffix)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QFile::encodeName(QFileInfo(fileName).absoluteFilePath()));
+    for (const QByteArray &key : keys) {
+        hash.addData(key);
+    }
+    return directory + QLatin1Char('/') + QString::fromLatin1(hash.result().toHex()) + suffix;
+}
+
+void CacheDirectory::markUsed(QFile &file)
+{
+    file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+}
+
+QStringList CacheDirectory::evict(const QString &directory, const QString &suffix, qint64 maximumSize)
+{
+    QDir dir(directory);
+    dir.setFilter(QDir::Files);
+    dir.setNameFilters({QLatin1Char('*') + suffix});
+    dir.setSorting(QDir::Time); // most recently used first
+    const QFileInfoList files = dir.entryInfoList();
+
+    QStringList evicted;
+    qint64 size = 0;
+    for (const QFileInfo &info : files) {
+        size += info.size();
+        if (size > maximumSize && QFile::remove(info.filePath())) {
+            evicted.append(info.fileName());
+        }
+    }
+    return evicted;
+}
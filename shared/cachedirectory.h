@@ -0,0 +1,44 @@
+/*  This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+#ifndef CACHEDIRECTORY_H
+#define CACHEDIRECTORY_H
+
+#include <QByteArray>
+#include <QList>
+#include <QStringList>
+
+class QFile;
+
+/**
+ * The files the workers keep in the user's cache directory, like the indexes of
+ * archives and compressed files or the HTML of man pages.
+ *
+ * Every file is named after a hash of what its content was made from, so a
+ * changed source simply misses the cache. Using a file refreshes its modification
+ * time, and the least recently used files are evicted beyond a size limit.
+ */
+namespace CacheDirectory
+{
+/**
+ * Returns the file in @p directory to cache what is made from @p fileName in.
+ * @param keys whatever else the content depends on, like the size and the
+ * modification time of @p fileName
+ */
+QString cacheFile(const QString &directory, const QString &fileName, const QList<QByteArray> &keys, const QString &suffix);
+
+/**
+ * Marks the open cache file @p file as used, to keep it from being evicted.
+ */
+void markUsed(QFile &file);
+
+/**
+ * Removes the least recently used files named *@p suffix from @p directory
+ * beyond @p maximumSize bytes. Returns the names of the removed files.
+ */
+QStringList evict(const QString &directory, const QString &suffix, qint64 maximumSize);
+}
+
+#endif // CACHEDIRECTORY_H
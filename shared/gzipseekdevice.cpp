@@ -0,0 +1,356 @@
+/*  This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "gzipseekdevice.h"
+
+#include <QDataStream>
+
+#include <algorithm>
+#include <cstring>
+
+// The largest distance deflate refers back to
+static const int s_windowSize = 32768;
+static const int s_inputSize = 64 * 1024;
+// For inflateInit2(): a gzip or zlib header, and the largest window
+static const int s_gzipWindowBits = 32 + MAX_WBITS;
+// The CRC-32 and the size after a gzip member
+static const int s_gzipTrailerSize = 8;
+
+bool GzipIndex::isValid() const
+{
+    // the device looks up the checkpoints by their offsets
+    for (qsizetype i = 1; i < checkpoints.count(); ++i) {
+        if (checkpoints.at(i).output <= checkpoints.at(i - 1).output) {
+            return false;
+        }
+    }
+    return span > 0 && indexed >= 0 && (checkpoints.isEmpty() || checkpoints.last().output <= indexed) && (size < 0 || size == indexed);
+}
+
+QDataStream &operator<<(QDataStream &stream, const GzipIndex &index)
+{
+    stream << index.span << index.indexed << index.size;
+    stream << qint32(index.checkpoints.count());
+    for (const GzipCheckpoint &checkpoint : index.checkpoints) {
+        stream << checkpoint.output << checkpoint.input << checkpoint.bits << checkpoint.window;
+    }
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, GzipIndex &index)
+{
+    stream >> index.span >> index.indexed >> index.size;
+    qint32 count = 0;
+    stream >> count;
+    index.checkpoints.clear();
+    for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        GzipCheckpoint checkpoint;
+        stream >> checkpoint.output >> checkpoint.input >> checkpoint.bits >> checkpoint.window;
+        index.checkpoints.append(std::move(checkpoint));
+    }
+    return stream;
+}
+
+GzipSeekDevice::GzipSeekDevice(const QString &fileName, const std::shared_ptr<GzipIndex> &index, qint64 start, qint64 size)
+    : m_file(fileName)
+    , m_index(index)
+    , m_start(start)
+    , m_size(size)
+{
+}
+
+GzipSeekDevice::~GzipSeekDevice()
+{
+    if (m_initialized) {
+        inflateEnd(&m_stream);
+    }
+}
+
+bool GzipSeekDevice::isGzip(const QString &fileName)
+{
+    QFile file(fileName);
+    char magic[2];
+    return file.open(QIODevice::ReadOnly) && file.read(magic, 2) == 2 && uchar(magic[0]) == 0x1f && uchar(magic[1]) == 0x8b;
+}
+
+bool GzipSeekDevice::open(OpenMode mode)
+{
+    if ((mode & WriteOnly) || !m_index || m_index->span <= 0 || !m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    m_input.resize(s_inputSize);
+    m_window.resize(s_windowSize);
+    m_output = -1;
+    // readData() relies on pos(), and the data is decompressed into the caller's buffer anyway
+    return QIODevice::open(mode | Unbuffered);
+}
+
+void GzipSeekDevice::close()
+{
+    QIODevice::close();
+    m_file.close();
+    m_output = -1;
+}
+
+qint64 GzipSeekDevice::size() const
+{
+    if (m_size >= 0) {
+        return m_size;
+    }
+    return m_index->isComplete() ? m_index->size - m_start : -1;
+}
+
+qint64 GzipSeekDevice::readData(char *data, qint64 maxSize)
+{
+    // the size is not known before reading to the end, inflate tells it then
+    const qint64 size = this->size();
+    if (size >= 0) {
+        maxSize = std::min(maxSize, size - pos());
+    }
+    if (maxSize <= 0) {
+        return 0;
+    }
+
+    if (m_output != m_start + pos() && !moveTo(m_start + pos())) {
+        setErrorString(QStringLiteral("Cannot decompress %1").arg(m_file.fileName()));
+        return -1;
+    }
+
+    const qint64 read = inflateTo(data, maxSize);
+    if (read < 0 || (read == 0 && size >= 0)) {
+        m_output = -1; // start over on the next read
+        setErrorString(QStringLiteral("Cannot decompress %1").arg(m_file.fileName()));
+        return -1;
+    }
+    return read;
+}
+
+qint64 GzipSeekDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data)
+    Q_UNUSED(maxSize)
+    return -1;
+}
+
+bool GzipSeekDevice::moveTo(qint64 output)
+{
+    // the last checkpoint at or before output
+    const QList<GzipCheckpoint> &checkpoints = m_index->checkpoints;
+    auto it = std::upper_bound(checkpoints.cbegin(), checkpoints.cend(), output, [](qint64 value, const GzipCheckpoint &checkpoint) {
+        return value < checkpoint.output;
+    });
+
+    // going on from where inflate is saves the restore, unless a checkpoint is closer
+    bool ok = true;
+    if (it == checkpoints.cbegin()) {
+        // no checkpoint yet, the file is read from its start
+        if (m_output < 0 || m_output > output) {
+            ok = restart();
+        }
+    } else {
+        --it;
+        if (m_output < 0 || m_output > output || it->output > m_output) {
+            ok = restore(*it);
+        }
+    }
+    if (!ok) {
+        m_output = -1;
+        return false;
+    }
+
+    char skipped[16384];
+    while (m_output < output) {
+        const qint64 read = inflateTo(skipped, std::min<qint64>(sizeof(skipped), output - m_output));
+        if (read < 0) {
+            m_output = -1;
+            return false;
+        } else if (read == 0) {
+            break; // beyond the end, readData() returns 0 from here on
+        }
+    }
+    return true;
+}
+
+bool GzipSeekDevice::restart()
+{
+    const int ret = m_initialized ? inflateReset2(&m_stream, s_gzipWindowBits) : inflateInit2(&m_stream, s_gzipWindowBits);
+    if (ret != Z_OK) {
+        return false;
+    }
+    m_initialized = true;
+    m_raw = false;
+    m_trailerLeft = 0;
+    m_memberEnd = false;
+    m_finished = false;
+    m_stream.avail_in = 0;
+
+    if (!m_file.seek(0)) {
+        return false;
+    }
+    m_inputOffset = 0;
+    m_inputSize = 0;
+    m_window.fill('\0');
+    m_windowEnd = 0;
+    m_output = 0;
+    return true;
+}
+
+bool GzipSeekDevice::restore(const GzipCheckpoint &checkpoint)
+{
+    // The checkpoints are all within the deflate data of a member
+    const int ret = m_initialized ? inflateReset2(&m_stream, -MAX_WBITS) : inflateInit2(&m_stream, -MAX_WBITS);
+    if (ret != Z_OK) {
+        return false;
+    }
+    m_initialized = true;
+    m_raw = true;
+    m_trailerLeft = 0;
+    m_memberEnd = false;
+    m_finished = false;
+    m_stream.avail_in = 0;
+
+    if (!m_file.seek(checkpoint.input - (checkpoint.bits ? 1 : 0))) {
+        return false;
+    }
+    if (checkpoint.bits) {
+        char byte;
+        if (!m_file.getChar(&byte)) {
+            return false;
+        }
+        inflatePrime(&m_stream, checkpoint.bits, uchar(byte) >> (8 - checkpoint.bits));
+    }
+    m_inputOffset = checkpoint.input;
+    m_inputSize = 0;
+
+    const QByteArray window = qUncompress(checkpoint.window);
+    if (window.size() != s_windowSize
+        || inflateSetDictionary(&m_stream, reinterpret_cast<const Bytef *>(window.constData()), window.size()) != Z_OK) {
+        return false;
+    }
+    m_window = window;
+    m_windowEnd = 0;
+    m_output = checkpoint.output;
+    return true;
+}
+
+bool GzipSeekDevice::readInput()
+{
+    // keeps what inflate did not consume yet
+    const int left = m_stream.avail_in;
+    m_inputOffset += m_inputSize - left;
+    if (left > 0) {
+        std::memmove(m_input.data(), m_stream.next_in, left);
+    }
+    const qint64 read = m_file.read(m_input.data() + left, m_input.size() - left);
+    if (read < 0) {
+        return false;
+    }
+    m_inputSize = left + read;
+    m_stream.next_in = reinterpret_cast<Bytef *>(m_input.data());
+    m_stream.avail_in = m_inputSize;
+    return true;
+}
+
+void GzipSeekDevice::keepWindow(const char *data, qint64 size)
+{
+    if (size >= s_windowSize) {
+        std::memcpy(m_window.data(), data + size - s_windowSize, s_windowSize);
+        m_windowEnd = 0;
+        return;
+    }
+    const int first = std::min<qint64>(size, s_windowSize - m_windowEnd);
+    std::memcpy(m_window.data() + m_windowEnd, data, first);
+    std::memcpy(m_window.data(), data + first, size - first);
+    m_windowEnd = (m_windowEnd + size) % s_windowSize;
+}
+
+void GzipSeekDevice::addCheckpoint()
+{
+    GzipCheckpoint checkpoint;
+    checkpoint.output = m_output;
+    checkpoint.input = m_inputOffset + m_inputSize - m_stream.avail_in;
+    checkpoint.bits = m_stream.data_type & 7;
+    // the oldest output is right after the newest one
+    checkpoint.window = qCompress(m_window.mid(m_windowEnd) + m_window.left(m_windowEnd));
+    m_index->checkpoints.append(checkpoint);
+}
+
+qint64 GzipSeekDevice::inflateTo(char *data, qint64 size)
+{
+    qint64 done = 0;
+    while (done < size && !m_finished) {
+        if (m_stream.avail_in < 2 && (m_memberEnd || m_stream.avail_in == 0)) {
+            if (!readInput()) {
+                return -1;
+            }
+        }
+
+        if (m_memberEnd) {
+            // another member follows, or trailing data like padding that gzip ignores as well
+            if (m_stream.avail_in < 2 || m_stream.next_in[0] != 0x1f || m_stream.next_in[1] != 0x8b) {
+                m_finished = true;
+                if (!m_index->isComplete() && m_output == m_index->indexed) {
+                    m_index->size = m_output;
+                }
+                break;
+            }
+            // inflate the next member with its header
+            if (inflateReset2(&m_stream, s_gzipWindowBits) != Z_OK) {
+                return -1;
+            }
+            m_memberEnd = false;
+            continue;
+        }
+        if (m_stream.avail_in == 0) {
+            return -1; // the file ends within a member
+        }
+
+        if (m_trailerLeft > 0) {
+            const int skipped = std::min<int>(m_trailerLeft, m_stream.avail_in);
+            m_stream.next_in += skipped;
+            m_stream.avail_in -= skipped;
+            m_trailerLeft -= skipped;
+            m_memberEnd = m_trailerLeft == 0;
+            continue;
+        }
+
+        // Beyond what the index covers, inflate stops at every deflate block
+        // boundary to record checkpoints. Before, it stops where the index ends.
+        const bool indexing = !m_index->isComplete() && m_output == m_index->indexed;
+        qint64 available = std::min<qint64>(size - done, 1 << 30);
+        if (!m_index->isComplete() && m_output < m_index->indexed) {
+            available = std::min(available, m_index->indexed - m_output);
+        }
+        m_stream.next_out = reinterpret_cast<Bytef *>(data + done);
+        m_stream.avail_out = available;
+        const int ret = inflate(&m_stream, indexing ? Z_BLOCK : Z_NO_FLUSH);
+        const qint64 produced = available - m_stream.avail_out;
+        keepWindow(data + done, produced);
+        done += produced;
+        m_output += produced;
+
+        if (indexing) {
+            m_index->indexed = m_output;
+            // at a block boundary, which is not the end of the last block
+            if ((m_stream.data_type & 0xc0) == 0x80 && (m_index->checkpoints.isEmpty() || m_output - m_index->checkpoints.last().output >= m_index->span)) {
+                addCheckpoint();
+            }
+        }
+
+        if (ret == Z_STREAM_END) {
+            if (m_raw) {
+                // raw inflate leaves the trailer of the member to us
+                m_raw = false;
+                m_trailerLeft = s_gzipTrailerSize;
+            } else {
+                m_memberEnd = true;
+            }
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            return -1;
+        }
+    }
+    return done;
+}
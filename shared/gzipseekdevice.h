@@ -0,0 +1,124 @@
+/*  This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+#ifndef GZIPSEEKDEVICE_H
+#define GZIPSEEKDEVICE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QList>
+
+#include <memory>
+
+#include <zlib.h>
+
+class QDataStream;
+
+/**
+ * A point in a gzip file at which decompression can start, with the state
+ * inflate needs there.
+ */
+struct GzipCheckpoint {
+    qint64 output = 0; ///< offset in the uncompressed data
+    qint64 input = 0; ///< offset of the first byte of the compressed file that is not fully consumed
+    int bits = 0; ///< bits of the byte before input that are still to be consumed, 0 to 7
+    QByteArray window; ///< the 32 KiB of uncompressed data before output, compressed with qCompress()
+};
+
+/**
+ * The checkpoints of a gzip file. A GzipSeekDevice records them while it
+ * reads data of the file that is not covered yet, so the index grows as the
+ * file is read, and is complete once the file was read to its end.
+ */
+struct GzipIndex {
+    qint64 span = 0; ///< the distance between the checkpoints
+    QList<GzipCheckpoint> checkpoints;
+    qint64 indexed = 0; ///< the checkpoints cover the uncompressed data up to this offset
+    qint64 size = -1; ///< of the uncompressed data, -1 until the file was read to its end
+
+    bool isComplete() const
+    {
+        return size >= 0;
+    }
+
+    /**
+     * Returns whether the index is consistent, as an index read from a file
+     * may not be.
+     */
+    bool isValid() const;
+};
+
+QDataStream &operator<<(QDataStream &stream, const GzipIndex &index);
+QDataStream &operator>>(QDataStream &stream, GzipIndex &index);
+
+/**
+ * Reads a range of the uncompressed data of a gzip file, for example an entry
+ * of a compressed tar archive, with random access. Also used by kio_filter.
+ *
+ * A seek restarts decompression at the last checkpoint before the new position,
+ * so it costs the decompression of at most the distance between two checkpoints.
+ * A seek forward within that distance just decompresses up to the new position.
+ * A seek beyond the data the index covers decompresses up to the new position,
+ * recording checkpoints on the way.
+ */
+class GzipSeekDevice : public QIODevice
+{
+public:
+    /**
+     * @param fileName the gzip file
+     * @param index the index of the file, which the device extends while reading
+     * @param start the offset of the range in the uncompressed data
+     * @param size the size of the range, or -1 for the data up to the end
+     */
+    GzipSeekDevice(const QString &fileName, const std::shared_ptr<GzipIndex> &index, qint64 start = 0, qint64 size = -1);
+    ~GzipSeekDevice() override;
+
+    /**
+     * Returns whether @p fileName starts like a gzip file.
+     */
+    static bool isGzip(const QString &fileName);
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    /**
+     * Returns -1 if the range goes up to the end of the data, and the file was
+     * not read to its end yet.
+     */
+    qint64 size() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    bool moveTo(qint64 output);
+    bool restart();
+    bool restore(const GzipCheckpoint &checkpoint);
+    bool readInput();
+    void keepWindow(const char *data, qint64 size);
+    void addCheckpoint();
+    qint64 inflateTo(char *data, qint64 size);
+
+    QFile m_file;
+    const std::shared_ptr<GzipIndex> m_index;
+    const qint64 m_start;
+    const qint64 m_size;
+
+    z_stream m_stream = {};
+    bool m_initialized = false;
+    bool m_raw = false; ///< inflating raw deflate data from a checkpoint, not a whole gzip member
+    int m_trailerLeft = 0; ///< bytes of the gzip trailer to skip after a member read in raw mode
+    bool m_memberEnd = false; ///< after the end of a member, another one may follow
+    bool m_finished = false; ///< at the end of the last member
+    qint64 m_output = -1; ///< offset in the uncompressed data where inflate is, -1 if not started
+    QByteArray m_input;
+    qint64 m_inputOffset = 0; ///< of m_input in the compressed file
+    qint64 m_inputSize = 0; ///< bytes read into m_input
+    QByteArray m_window; ///< the last 32 KiB of output, going round
+    int m_windowEnd = 0; ///< where the newest output in m_window ends
+};
+
+#endif // GZIPSEEKDEVICE_H
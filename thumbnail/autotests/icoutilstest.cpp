@@ -0,0 +1,192 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+*/
+
+#include <QRandomGenerator>
+#include <QTest>
+#include <QtEndian>
+
+#include "icoutils.h"
+
+namespace
+{
+void put16(QByteArray &data, int offset, quint16 value)
+{
+    qToLittleEndian(value, data.data() + offset);
+}
+
+void put32(QByteArray &data, int offset, quint32 value)
+{
+    qToLittleEndian(value, data.data() + offset);
+}
+
+// A 16x16 32 bit icon group with a single image made of @p imageSize bytes of 0xAB
+void writeGroupIcon(QByteArray &data, int offset, quint32 imageSize)
+{
+    put16(data, offset + 2, 1); // type
+    put16(data, offset + 4, 1); // count
+    data[offset + 6] = 16; // width
+    data[offset + 7] = 16; // height
+    put16(data, offset + 10, 1); // planes
+    put16(data, offset + 12, 32); // bit count
+    put32(data, offset + 14, imageSize);
+    put16(data, offset + 18, 1); // RT_ICON id
+}
+
+const quint32 s_imageSize = 40;
+
+QByteArray peExecutable()
+{
+    QByteArray data(0x200 + 220, '\0');
+    data[0] = 'M';
+    data[1] = 'Z';
+    put32(data, 0x3c, 0x40);
+    put32(data, 0x40, 0x00004550); // PE\0\0
+    put16(data, 0x44, 0x14c); // machine
+    put16(data, 0x46, 1); // sections
+    put16(data, 0x54, 224); // optional header size
+    put16(data, 0x58, 0x10b); // PE32
+    put32(data, 0x58 + 92, 16); // data directories
+    put32(data, 0x58 + 96 + 16, 0x1000); // resource directory RVA
+    put32(data, 0x58 + 96 + 20, 220);
+
+    const int section = 0x58 + 224;
+    put32(data, section + 12, 0x1000); // virtual address
+    put32(data, section + 16, 220); // raw size
+    put32(data, section + 20, 0x200); // raw pointer
+
+    const int rsrc = 0x200;
+    // root: RT_ICON and RT_GROUP_ICON
+    put16(data, rsrc + 14, 2);
+    put32(data, rsrc + 16, 3);
+    put32(data, rsrc + 20, 0x80000000 | 32);
+    put32(data, rsrc + 24, 14);
+    put32(data, rsrc + 28, 0x80000000 | 80);
+    // RT_ICON -> id 1 -> language
+    put16(data, rsrc + 32 + 14, 1);
+    put32(data, rsrc + 32 + 16, 1);
+    put32(data, rsrc + 32 + 20, 0x80000000 | 56);
+    put16(data, rsrc + 56 + 14, 1);
+    put32(data, rsrc + 56 + 16, 0x409);
+    put32(data, rsrc + 56 + 20, 128);
+    // RT_GROUP_ICON -> id 100 -> language
+    put16(data, rsrc + 80 + 14, 1);
+    put32(data, rsrc + 80 + 16, 100);
+    put32(data, rsrc + 80 + 20, 0x80000000 | 104);
+    put16(data, rsrc + 104 + 14, 1);
+    put32(data, rsrc + 104 + 16, 0x409);
+    put32(data, rsrc + 104 + 20, 144);
+    // data entries
+    put32(data, rsrc + 128, 0x1000 + 160);
+    put32(data, rsrc + 132, s_imageSize);
+    put32(data, rsrc + 144, 0x1000 + 200);
+    put32(data, rsrc + 148, 20);
+
+    data.replace(rsrc + 160, s_imageSize, QByteArray(s_imageSize, '\xab'));
+    writeGroupIcon(data, rsrc + 200, s_imageSize);
+    return data;
+}
+
+QByteArray neExecutable()
+{
+    QByteArray data(0x150, '\0');
+    data[0] = 'M';
+    data[1] = 'Z';
+    put32(data, 0x3c, 0x40);
+    data[0x40] = 'N';
+    data[0x41] = 'E';
+    put16(data, 0x40 + 0x24, 0x40); // resource table
+    put16(data, 0x40 + 0x26, 0x80); // resident name table
+
+    const int table = 0x80;
+    put16(data, table, 4); // alignment shift
+    // RT_GROUP_ICON
+    put16(data, table + 2, 0x8000 | 14);
+    put16(data, table + 4, 1);
+    put16(data, table + 10, 0x100 >> 4);
+    put16(data, table + 12, 2);
+    put16(data, table + 16, 0x8001);
+    // RT_ICON
+    put16(data, table + 22, 0x8000 | 3);
+    put16(data, table + 24, 1);
+    put16(data, table + 30, 0x120 >> 4);
+    put16(data, table + 32, 3);
+    put16(data, table + 36, 0x8001);
+
+    writeGroupIcon(data, 0x100, s_imageSize);
+    data.replace(0x120, s_imageSize, QByteArray(s_imageSize, '\xab'));
+    return data;
+}
+}
+
+class IcoUtilsTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testPe()
+    {
+        QByteArray ico;
+        QVERIFY(IcoUtils::extractIcoFromExe(peExecutable(), ico));
+
+        QCOMPARE(ico.size(), qsizetype(6 + 16 + s_imageSize));
+        QCOMPARE(qFromLittleEndian<quint16>(ico.constData() + 2), quint16(1)); // type
+        QCOMPARE(qFromLittleEndian<quint16>(ico.constData() + 4), quint16(1)); // count
+        QCOMPARE(ico.at(6), char(16));
+        QCOMPARE(qFromLittleEndian<quint16>(ico.constData() + 12), quint16(32)); // bit count
+        QCOMPARE(qFromLittleEndian<quint32>(ico.constData() + 14), s_imageSize);
+        QCOMPARE(qFromLittleEndian<quint32>(ico.constData() + 18), quint32(22)); // image offset
+        QCOMPARE(ico.mid(22), QByteArray(s_imageSize, '\xab'));
+    }
+
+    void testNe()
+    {
+        QByteArray ico;
+        QVERIFY(IcoUtils::extractIcoFromExe(neExecutable(), ico));
+
+        // NE resources are padded to the alignment
+        QCOMPARE(qFromLittleEndian<quint16>(ico.constData() + 4), quint16(1));
+        QCOMPARE(qFromLittleEndian<quint32>(ico.constData() + 14), quint32(48));
+        QVERIFY(ico.mid(22).startsWith(QByteArray(s_imageSize, '\xab')));
+    }
+
+    void testNotAnExecutable()
+    {
+        QByteArray ico;
+        QVERIFY(!IcoUtils::extractIcoFromExe(QByteArrayView(), ico));
+        QVERIFY(!IcoUtils::extractIcoFromExe("MZ", ico));
+        QVERIFY(!IcoUtils::extractIcoFromExe(QByteArray(4096, '\xff'), ico));
+    }
+
+    // Cheap fuzzing: neither truncated nor corrupted input may read out of bounds,
+    // run with ASan to catch violations.
+    void testTruncated()
+    {
+        for (const QByteArray &exe : {peExecutable(), neExecutable()}) {
+            for (int size = 0; size < exe.size(); ++size) {
+                QByteArray ico;
+                IcoUtils::extractIcoFromExe(QByteArrayView(exe).first(size), ico);
+            }
+        }
+    }
+
+    void testCorrupted()
+    {
+        QRandomGenerator random(42);
+        for (const QByteArray &exe : {peExecutable(), neExecutable()}) {
+            for (int i = 0; i < 5000; ++i) {
+                QByteArray corrupted = exe;
+                const int flips = random.bounded(1, 8);
+                for (int j = 0; j < flips; ++j) {
+                    corrupted[random.bounded(corrupted.size())] = char(random.bounded(256));
+                }
+                QByteArray ico;
+                IcoUtils::extractIcoFromExe(corrupted, ico);
+            }
+        }
+    }
+};
+
+QTEST_GUILESS_MAIN(IcoUtilsTest)
+
+#include "icoutilstest.moc"
@@ -0,0 +1,640 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+*/
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QImageWriter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QtEndian>
+
+#include <KIO/ThumbnailCreator>
+#include <KPluginFactory>
+#include <KPluginMetaData>
+#include <KZip>
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <memory>
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define BENCHMARK_NO_MALLOC_HOOKS
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__)
+#define BENCHMARK_NO_MALLOC_HOOKS
+#endif
+
+#if defined(__GLIBC__) && !defined(BENCHMARK_NO_MALLOC_HOOKS)
+#define BENCHMARK_COUNT_ALLOCATIONS
+#endif
+
+namespace
+{
+std::atomic<quint64> s_allocations{0};
+std::atomic<quint64> s_allocatedBytes{0};
+}
+
+#ifdef BENCHMARK_COUNT_ALLOCATIONS
+// Interpose the allocator for the whole process, including the dlopen()ed
+// creator plugins, so allocations are counted wherever they happen.
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    s_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    s_allocatedBytes.fetch_add(count * size, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    s_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+}
+#endif
+
+namespace
+{
+enum Scale {
+    Small,
+    Medium,
+    Huge,
+};
+
+const char *const s_scaleNames[] = {"small", "medium", "huge"};
+
+const QSize s_targetSize(256, 256);
+
+int imageDimension(Scale scale)
+{
+    static const int dimensions[] = {64, 1024, 6000};
+    return dimensions[scale];
+}
+
+QImage testImage(int width, int height)
+{
+    QImage image(width, height, QImage::Format_RGB32);
+    for (int y = 0; y < height; ++y) {
+        auto line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            line[x] = qRgb(x * 255 / width, y * 255 / height, (x ^ y) & 0xff);
+        }
+    }
+    return image;
+}
+
+QByteArray encodeImage(const QImage &image, const char *format)
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, format, qstrcmp(format, "jpg") == 0 ? 90 : -1);
+    return data;
+}
+
+bool writeFile(const QString &path, const QByteArray &data)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+bool writeZip(const QString &path, const QList<std::pair<QString, QByteArray>> &entries)
+{
+    KZip zip(path);
+    if (!zip.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    for (const auto &[name, data] : entries) {
+        // ODF, EPUB and KRA want the mimetype entry first and uncompressed
+        zip.setCompression(name == QLatin1String("mimetype") ? KZip::NoCompression : KZip::DeflateCompression);
+        if (!zip.writeFile(name, data)) {
+            return false;
+        }
+    }
+    return zip.close();
+}
+
+bool generateImage(const QString &path, Scale scale)
+{
+    const int dimension = imageDimension(scale);
+    return testImage(dimension, dimension * 2 / 3).save(path, "PNG");
+}
+
+bool generateJpeg(const QString &path, Scale scale)
+{
+    const int dimension = imageDimension(scale);
+    return testImage(dimension, dimension * 2 / 3).save(path, "JPG", 90);
+}
+
+bool generateExr(const QString &path, Scale scale)
+{
+    if (!QImageWriter::supportedImageFormats().contains("exr")) {
+        return false;
+    }
+    const int dimension = imageDimension(scale);
+    return testImage(dimension, dimension * 2 / 3).save(path, "EXR");
+}
+
+bool generateSvg(const QString &path, Scale scale)
+{
+    static const int shapes[] = {10, 1000, 100000};
+    QByteArray svg =
+        "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"1000\" height=\"1000\">\n"
+        "<defs><linearGradient id=\"g\"><stop offset=\"0\" stop-color=\"#204a87\"/>"
+        "<stop offset=\"1\" stop-color=\"#ef2929\"/></linearGradient></defs>\n";
+    for (int i = 0; i < shapes[scale]; ++i) {
+        const int x = (i * 37) % 1000;
+        const int y = (i * 91) % 1000;
+        if (i % 2) {
+            svg += QStringLiteral("<rect x=\"%1\" y=\"%2\" width=\"40\" height=\"30\" fill=\"url(#g)\"/>\n").arg(x).arg(y).toLatin1();
+        } else {
+            svg += QStringLiteral("<circle cx=\"%1\" cy=\"%2\" r=\"15\" fill=\"#%3\" opacity=\"0.5\"/>\n").arg(x).arg(y).arg(i % 0xffffff, 6, 16, QLatin1Char('0')).toLatin1();
+        }
+    }
+    svg += "</svg>\n";
+    return writeFile(path, svg);
+}
+
+bool generateText(const QString &path, Scale scale)
+{
+    static const int lines[] = {20, 2000, 200000};
+    QByteArray text;
+    for (int i = 0; i < lines[scale]; ++i) {
+        text += "Line " + QByteArray::number(i) + ": The quick brown fox jumps over the lazy dog.\n";
+    }
+    return writeFile(path, text);
+}
+
+bool generateEbook(const QString &path, Scale scale)
+{
+    static const int chapters[] = {1, 20, 500};
+    const int dimension = imageDimension(scale);
+
+    QByteArray manifest;
+    QByteArray spine;
+    QList<std::pair<QString, QByteArray>> entries{
+        {QStringLiteral("mimetype"), "application/epub+zip"},
+        {QStringLiteral("META-INF/container.xml"),
+         "<?xml version=\"1.0\"?>\n"
+         "<container version=\"1.0\" xmlns=\"urn:oasis:names:tc:opendocument:xmlns:container\">"
+         "<rootfiles><rootfile full-path=\"OEBPS/content.opf\" media-type=\"application/oebps-package+xml\"/></rootfiles>"
+         "</container>\n"},
+    };
+    for (int i = 0; i < chapters[scale]; ++i) {
+        const QByteArray id = "chapter" + QByteArray::number(i);
+        manifest += "<item id=\"" + id + "\" href=\"" + id + ".xhtml\" media-type=\"application/xhtml+xml\"/>";
+        spine += "<itemref idref=\"" + id + "\"/>";
+        entries.append({QStringLiteral("OEBPS/%1.xhtml").arg(QString::fromLatin1(id)),
+                        "<html xmlns=\"http://www.w3.org/1999/xhtml\"><body>" + QByteArray(4096, 'x') + "</body></html>"});
+    }
+    entries.append({QStringLiteral("OEBPS/content.opf"),
+                    "<?xml version=\"1.0\"?>\n"
+                    "<package xmlns=\"http://www.idpf.org/2007/opf\" version=\"2.0\">"
+                    "<metadata><meta name=\"cover\" content=\"cover-image\"/></metadata>"
+                    "<manifest><item id=\"cover-image\" href=\"images/cover.jpg\" media-type=\"image/jpeg\"/>"
+                        + manifest + "</manifest><spine>" + spine + "</spine></package>\n"});
+    entries.append({QStringLiteral("OEBPS/images/cover.jpg"), encodeImage(testImage(dimension * 2 / 3, dimension), "jpg")});
+    return writeZip(path, entries);
+}
+
+bool generateComic(const QString &path, Scale scale)
+{
+    static const int pages[] = {4, 100, 5000};
+    const int dimension = imageDimension(scale);
+
+    // Only the cover is decoded, the remaining pages just make the archive listing more expensive
+    QList<std::pair<QString, QByteArray>> entries{{QStringLiteral("0000.jpg"), encodeImage(testImage(dimension * 2 / 3, dimension), "jpg")}};
+    const QByteArray page = encodeImage(testImage(64, 96), "jpg");
+    for (int i = 1; i < pages[scale]; ++i) {
+        entries.append({QStringLiteral("%1.jpg").arg(i, 4, 10, QLatin1Char('0')), page});
+    }
+    return writeZip(path, entries);
+}
+
+bool generateAudio(const QString &path, Scale scale)
+{
+    const int dimension = std::min(imageDimension(scale), 3000);
+    const QByteArray cover = encodeImage(testImage(dimension, dimension), "jpg");
+
+    // ID3v2.3 tag with a single APIC frame
+    QByteArray frame;
+    frame += '\0'; // ISO-8859-1
+    frame += QByteArrayLiteral("image/jpeg") + '\0';
+    frame += '\x03'; // front cover
+    frame += '\0'; // empty description
+    frame += cover;
+
+    QByteArray data("ID3\x03\x00\x00", 6);
+    const quint32 tagSize = 10 + frame.size();
+    for (int shift = 21; shift >= 0; shift -= 7) {
+        data += char((tagSize >> shift) & 0x7f);
+    }
+    data += "APIC";
+    char frameSize[4];
+    qToBigEndian(quint32(frame.size()), frameSize);
+    data += QByteArray(frameSize, 4);
+    data += QByteArray(2, '\0');
+    data += frame;
+
+    // A few silent MPEG-1 layer III frames, 128 kbit/s at 44.1 kHz
+    for (int i = 0; i < 8; ++i) {
+        data += QByteArray("\xff\xfb\x90\x64", 4);
+        data += QByteArray(417 - 4, '\0');
+    }
+    return writeFile(path, data);
+}
+
+bool generateWindowsExe(const QString &path, Scale scale)
+{
+    static const int iconSizes[] = {16, 64, 256};
+    static const int padding[] = {0, 1 << 20, 64 << 20};
+    const int iconSize = iconSizes[scale];
+    const QByteArray image = encodeImage(testImage(iconSize, iconSize), "png");
+    const quint32 imageSize = image.size();
+    const quint32 imageSpace = (imageSize + 3) & ~3u;
+
+    const quint32 rsrcOffset = 0x200 + padding[scale];
+    const quint32 rsrcSize = 160 + imageSpace + 20;
+    QByteArray data(rsrcOffset + rsrcSize, '\0');
+    auto put16 = [&data](quint32 offset, quint16 value) {
+        qToLittleEndian(value, data.data() + offset);
+    };
+    auto put32 = [&data](quint32 offset, quint32 value) {
+        qToLittleEndian(value, data.data() + offset);
+    };
+
+    data[0] = 'M';
+    data[1] = 'Z';
+    put32(0x3c, 0x40);
+    put32(0x40, 0x00004550); // PE\0\0
+    put16(0x44, 0x14c); // machine
+    put16(0x46, 1); // sections
+    put16(0x54, 224); // optional header size
+    put16(0x58, 0x10b); // PE32
+    put32(0x58 + 92, 16); // data directories
+    put32(0x58 + 96 + 16, 0x1000); // resource directory RVA
+    put32(0x58 + 96 + 20, rsrcSize);
+
+    const int section = 0x58 + 224;
+    put32(section + 12, 0x1000); // virtual address
+    put32(section + 16, rsrcSize); // raw size
+    put32(section + 20, rsrcOffset); // raw pointer
+
+    const quint32 rsrc = rsrcOffset;
+    // root: RT_ICON and RT_GROUP_ICON
+    put16(rsrc + 14, 2);
+    put32(rsrc + 16, 3);
+    put32(rsrc + 20, 0x80000000 | 32);
+    put32(rsrc + 24, 14);
+    put32(rsrc + 28, 0x80000000 | 80);
+    // RT_ICON -> id 1 -> language
+    put16(rsrc + 32 + 14, 1);
+    put32(rsrc + 32 + 16, 1);
+    put32(rsrc + 32 + 20, 0x80000000 | 56);
+    put16(rsrc + 56 + 14, 1);
+    put32(rsrc + 56 + 16, 0x409);
+    put32(rsrc + 56 + 20, 128);
+    // RT_GROUP_ICON -> id 100 -> language
+    put16(rsrc + 80 + 14, 1);
+    put32(rsrc + 80 + 16, 100);
+    put32(rsrc + 80 + 20, 0x80000000 | 104);
+    put16(rsrc + 104 + 14, 1);
+    put32(rsrc + 104 + 16, 0x409);
+    put32(rsrc + 104 + 20, 144);
+    // data entries
+    put32(rsrc + 128, 0x1000 + 160);
+    put32(rsrc + 132, imageSize);
+    put32(rsrc + 144, 0x1000 + 160 + imageSpace);
+    put32(rsrc + 148, 20);
+
+    data.replace(rsrc + 160, imageSize, image);
+
+    // group icon with a single PNG compressed image
+    const quint32 group = rsrc + 160 + imageSpace;
+    put16(group + 2, 1); // type
+    put16(group + 4, 1); // count
+    data[group + 6] = char(iconSize & 0xff); // width, 0 means 256
+    data[group + 7] = char(iconSize & 0xff); // height
+    put16(group + 10, 1); // planes
+    put16(group + 12, 32); // bit count
+    put32(group + 14, imageSize);
+    put16(group + 18, 1); // RT_ICON id
+
+    return writeFile(path, data);
+}
+
+bool generateCursor(const QString &path, Scale scale)
+{
+    static const QList<int> nominalSizes[] = {{24}, {24, 32, 48, 64, 96}, {24, 32, 48, 64, 96, 128, 192, 256}};
+    static const int frames[] = {1, 1, 24};
+
+    QList<std::pair<quint32, QImage>> images;
+    for (int size : nominalSizes[scale]) {
+        const QImage image = testImage(size, size).convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        for (int i = 0; i < frames[scale]; ++i) {
+            images.append({size, image});
+        }
+    }
+
+    QByteArray data(16 + images.size() * 12, '\0');
+    qToLittleEndian(quint32(0x72756358), data.data()); // Xcur
+    qToLittleEndian(quint32(16), data.data() + 4);
+    qToLittleEndian(quint32(0x10000), data.data() + 8);
+    qToLittleEndian(quint32(images.size()), data.data() + 12);
+
+    for (int i = 0; i < images.size(); ++i) {
+        const auto &[size, image] = images.at(i);
+        const quint32 position = data.size();
+
+        char *toc = data.data() + 16 + i * 12;
+        qToLittleEndian(quint32(0xfffd0002), toc);
+        qToLittleEndian(size, toc + 4);
+        qToLittleEndian(position, toc + 8);
+
+        const quint32 header[] = {36, 0xfffd0002, size, 1, quint32(image.width()), quint32(image.height()), 0, 0, 50};
+        for (quint32 value : header) {
+            char buffer[4];
+            qToLittleEndian(value, buffer);
+            data.append(buffer, 4);
+        }
+        for (int y = 0; y < image.height(); ++y) {
+            const auto line = reinterpret_cast<const quint32 *>(image.constScanLine(y));
+            for (int x = 0; x < image.width(); ++x) {
+                char buffer[4];
+                qToLittleEndian(line[x], buffer);
+                data.append(buffer, 4);
+            }
+        }
+    }
+    return writeFile(path, data);
+}
+
+bool generateOpenDocument(const QString &path, Scale scale)
+{
+    static const int paragraphs[] = {10, 10000, 500000};
+    QByteArray content =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<office:document-content xmlns:office=\"urn:oasis:names:tc:opendocument:xmlns:office:1.0\" "
+        "xmlns:text=\"urn:oasis:names:tc:opendocument:xmlns:text:1.0\"><office:body><office:text>";
+    for (int i = 0; i < paragraphs[scale]; ++i) {
+        content += "<text:p>Paragraph " + QByteArray::number(i) + " of the benchmark document.</text:p>";
+    }
+    content += "</office:text></office:body></office:document-content>\n";
+
+    return writeZip(path,
+                    {
+                        {QStringLiteral("mimetype"), "application/vnd.oasis.opendocument.text"},
+                        {QStringLiteral("content.xml"), content},
+                        {QStringLiteral("Thumbnails/thumbnail.png"), encodeImage(testImage(181, 256), "png")},
+                    });
+}
+
+bool generateKrita(const QString &path, Scale scale)
+{
+    const int dimension = imageDimension(scale);
+    // The preview is smaller than the requested size, so the creator has to fall back to the merged image
+    return writeZip(path,
+                    {
+                        {QStringLiteral("mimetype"), "application/x-krita"},
+                        {QStringLiteral("preview.png"), encodeImage(testImage(128, 85), "png")},
+                        {QStringLiteral("mergedimage.png"), encodeImage(testImage(dimension, dimension * 2 / 3), "png")},
+                    });
+}
+
+struct Creator {
+    const char *plugin;
+    const char *mimeType;
+    const char *suffix;
+    bool (*generate)(const QString &path, Scale scale);
+};
+
+const Creator s_creators[] = {
+    {"imagethumbnail", "image/png", "png", generateImage},
+    {"jpegthumbnail", "image/jpeg", "jpg", generateJpeg},
+    {"svgthumbnail", "image/svg+xml", "svg", generateSvg},
+    {"textthumbnail", "text/plain", "txt", generateText},
+    {"ebookthumbnail", "application/epub+zip", "epub", generateEbook},
+    {"comicbookthumbnail", "application/x-cbz", "cbz", generateComic},
+    {"exrthumbnail", "image/x-exr", "exr", generateExr},
+    {"audiothumbnail", "audio/mpeg", "mp3", generateAudio},
+    {"windowsexethumbnail", "application/x-ms-dos-executable", "exe", generateWindowsExe},
+    {"cursorthumbnail", "image/x-xcursor", "cursor", generateCursor},
+    {"opendocumentthumbnail", "application/vnd.oasis.opendocument.text", "odt", generateOpenDocument},
+    {"kraorathumbnail", "application/x-krita", "kra", generateKrita},
+};
+
+// Resets the peak resident set size of the process, see proc(5)
+bool resetPeakRss()
+{
+#ifdef Q_OS_LINUX
+    QFile clearRefs(QStringLiteral("/proc/self/clear_refs"));
+    return clearRefs.open(QIODevice::WriteOnly) && clearRefs.write("5") == 1;
+#else
+    return false;
+#endif
+}
+
+// Returns the current or peak resident set size in KiB, or -1
+qint64 readRss(const char *field)
+{
+#ifdef Q_OS_LINUX
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (!status.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    const QByteArray prefix = QByteArray(field) + ':';
+    for (const QByteArray &line : status.readAll().split('\n')) {
+        if (line.startsWith(prefix)) {
+            return line.mid(prefix.size()).trimmed().split(' ').value(0).toLongLong();
+        }
+    }
+#else
+    Q_UNUSED(field)
+#endif
+    return -1;
+}
+
+struct Sample {
+    qint64 wallTimeNs = 0;
+    qint64 rssBeforeKiB = -1;
+    qint64 peakRssKiB = -1;
+    quint64 allocations = 0;
+    quint64 allocatedBytes = 0;
+};
+}
+
+class ThumbnailBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(m_corpus.isValid());
+        m_peakRssResettable = resetPeakRss();
+    }
+
+    void benchmarkCreator_data()
+    {
+        QTest::addColumn<int>("creator");
+        QTest::addColumn<int>("scale");
+
+        for (int creator = 0; creator < int(std::size(s_creators)); ++creator) {
+            for (int scale : {Small, Medium, Huge}) {
+                QTest::addRow("%s/%s", s_creators[creator].plugin, s_scaleNames[scale]) << creator << scale;
+            }
+        }
+    }
+
+    void benchmarkCreator()
+    {
+        QFETCH(int, creator);
+        QFETCH(int, scale);
+        const Creator &info = s_creators[creator];
+
+        std::unique_ptr<KIO::ThumbnailCreator> thumbCreator = loadCreator(QString::fromLatin1(info.plugin));
+        if (!thumbCreator) {
+            QSKIP("Thumbnail plugin not available");
+        }
+
+        const QString path = m_corpus.filePath(QStringLiteral("%1-%2.%3").arg(QString::fromLatin1(info.plugin), QString::fromLatin1(s_scaleNames[scale]), QString::fromLatin1(info.suffix)));
+        if (!QFileInfo::exists(path) && !info.generate(path, Scale(scale))) {
+            QSKIP("Could not generate the input file");
+        }
+
+        const KIO::ThumbnailRequest request(QUrl::fromLocalFile(path), s_targetSize, QString::fromLatin1(info.mimeType), 1.0, 0);
+
+        // The regression part: every generated input has to produce a thumbnail
+        const KIO::ThumbnailResult result = thumbCreator->create(request);
+        QVERIFY(result.isValid());
+        QVERIFY(!result.image().isNull());
+
+        QList<Sample> samples;
+        QBENCHMARK {
+            samples.append(measure(thumbCreator.get(), request));
+        }
+
+        record(info, Scale(scale), path, samples);
+    }
+
+    void cleanupTestCase()
+    {
+        QString outputPath = qEnvironmentVariable("THUMBNAIL_BENCHMARK_OUTPUT");
+        if (outputPath.isEmpty()) {
+            outputPath = QStringLiteral("thumbnailbenchmark.json");
+        }
+
+        QJsonObject root;
+        root[QStringLiteral("targetSize")] = QJsonArray{s_targetSize.width(), s_targetSize.height()};
+        root[QStringLiteral("results")] = m_results;
+
+        QFile file(outputPath);
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        file.write(QJsonDocument(root).toJson());
+        qInfo() << "Benchmark results written to" << QFileInfo(file).absoluteFilePath();
+    }
+
+private:
+    static std::unique_ptr<KIO::ThumbnailCreator> loadCreator(const QString &pluginId)
+    {
+        // Prefer the plugins from the build tree, they end up next to the benchmark binary
+        KPluginMetaData metaData(QCoreApplication::applicationDirPath() + QLatin1Char('/') + pluginId);
+        if (!metaData.isValid()) {
+            metaData = KPluginMetaData::findPluginById(QStringLiteral("kf6/thumbcreator"), pluginId);
+        }
+        if (!metaData.isValid()) {
+            return nullptr;
+        }
+        return std::unique_ptr<KIO::ThumbnailCreator>(KPluginFactory::instantiatePlugin<KIO::ThumbnailCreator>(metaData).plugin);
+    }
+
+    Sample measure(KIO::ThumbnailCreator *creator, const KIO::ThumbnailRequest &request) const
+    {
+        Sample sample;
+        if (m_peakRssResettable) {
+            resetPeakRss();
+            sample.rssBeforeKiB = readRss("VmRSS");
+        }
+
+        const quint64 allocations = s_allocations.load(std::memory_order_relaxed);
+        const quint64 allocatedBytes = s_allocatedBytes.load(std::memory_order_relaxed);
+        QElapsedTimer timer;
+        timer.start();
+
+        const KIO::ThumbnailResult result = creator->create(request);
+
+        sample.wallTimeNs = timer.nsecsElapsed();
+        sample.allocations = s_allocations.load(std::memory_order_relaxed) - allocations;
+        sample.allocatedBytes = s_allocatedBytes.load(std::memory_order_relaxed) - allocatedBytes;
+        sample.peakRssKiB = readRss("VmHWM");
+        Q_UNUSED(result)
+        return sample;
+    }
+
+    void record(const Creator &info, Scale scale, const QString &path, QList<Sample> samples)
+    {
+        std::sort(samples.begin(), samples.end(), [](const Sample &a, const Sample &b) {
+            return a.wallTimeNs < b.wallTimeNs;
+        });
+        const Sample &median = samples.at(samples.size() / 2);
+
+        QJsonObject result;
+        result[QStringLiteral("creator")] = QString::fromLatin1(info.plugin);
+        result[QStringLiteral("input")] = QString::fromLatin1(s_scaleNames[scale]);
+        result[QStringLiteral("inputBytes")] = QFileInfo(path).size();
+        result[QStringLiteral("iterations")] = samples.size();
+        result[QStringLiteral("wallTimeMsMin")] = samples.constFirst().wallTimeNs / 1e6;
+        result[QStringLiteral("wallTimeMsMedian")] = median.wallTimeNs / 1e6;
+
+        qint64 peakRss = -1;
+        qint64 peakRssDelta = -1;
+        for (const Sample &sample : std::as_const(samples)) {
+            peakRss = std::max(peakRss, sample.peakRssKiB);
+            if (sample.rssBeforeKiB >= 0) {
+                peakRssDelta = std::max(peakRssDelta, sample.peakRssKiB - sample.rssBeforeKiB);
+            }
+        }
+        if (peakRss >= 0) {
+            result[QStringLiteral("peakRssKiB")] = peakRss;
+        }
+        if (peakRssDelta >= 0) {
+            result[QStringLiteral("peakRssDeltaKiB")] = peakRssDelta;
+        }
+#ifdef BENCHMARK_COUNT_ALLOCATIONS
+        result[QStringLiteral("allocations")] = qint64(median.allocations);
+        result[QStringLiteral("allocatedBytes")] = qint64(median.allocatedBytes);
+#endif
+        m_results.append(result);
+    }
+
+    QTemporaryDir m_corpus;
+    QJsonArray m_results;
+    bool m_peakRssResettable = false;
+};
+
+QTEST_MAIN(ThumbnailBenchmark)
+
+#include "thumbnailbenchmark.moc"
@@ -0,0 +1,76 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+*/
+
+#include <KZip>
+
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "zipreader.h"
+
+class ZipReaderTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(m_dir.isValid());
+        m_path = m_dir.filePath("test.zip");
+
+        KZip zip(m_path);
+        QVERIFY(zip.open(QIODevice::WriteOnly));
+        QVERIFY(zip.writeFile("OEBPS/images/cover.jpg", "cover"));
+        QVERIFY(zip.writeFile("docProps/thumbnail.jpeg", "thumbnail"));
+        // compresses to almost nothing, much smaller than the first buffer
+        QVERIFY(zip.writeFile("zeros", QByteArray(1024 * 1024, '\0')));
+        QVERIFY(zip.close());
+    }
+
+    void testEntry_data()
+    {
+        QTest::addColumn<QString>("name");
+        QTest::addColumn<QByteArray>("data");
+
+        QTest::newRow("plain") << "OEBPS/images/cover.jpg" << QByteArray("cover");
+        QTest::newRow("relative to the OPF") << "OEBPS/text/../images/cover.jpg" << QByteArray("cover");
+        QTest::newRow("absolute OPC target") << "/docProps/thumbnail.jpeg" << QByteArray("thumbnail");
+        QTest::newRow("missing") << "docProps/missing.jpeg" << QByteArray();
+    }
+
+    void testEntry()
+    {
+        QFETCH(QString, name);
+        QFETCH(QByteArray, data);
+
+        ZipReader zip(m_path);
+        QVERIFY(zip.open());
+        QCOMPARE(zip.entry(name).has_value(), !data.isEmpty());
+        QCOMPARE(zip.data(name), data);
+    }
+
+    void testData()
+    {
+        ZipReader zip(m_path);
+        QVERIFY(zip.open());
+        const auto entry = zip.entry("zeros");
+        QVERIFY(entry);
+        QCOMPARE(zip.data(*entry), QByteArray(1024 * 1024, '\0'));
+        QVERIFY(zip.data(*entry, 1024).isEmpty());
+
+        // a declared size smaller than the data must not cut it off, nor let it overflow
+        ZipReader::Entry lying = *entry;
+        lying.size = 10;
+        QCOMPARE(zip.data(lying).size(), 1024 * 1024);
+    }
+
+private:
+    QTemporaryDir m_dir;
+    QString m_path;
+};
+
+QTEST_GUILESS_MAIN(ZipReaderTest)
+
+#include "zipreadertest.moc"
@@ -13,14 +13,19 @@
 
 // comiccreator.cpp
 
+#include "config-thumbnail.h"
+
 #include "comiccreator.h"
+#include "memorybudget.h"
 #include "thumbnail-comic-logsettings.h"
+#include "zipreader.h"
 
 #include <K7Zip>
 #include <KPluginFactory>
 #include <KTar>
 #include <KZip>
 
+#include <algorithm>
 #include <memory>
 
 #include <QEventLoop>
@@ -29,10 +34,19 @@
 #include <QMimeType>
 #include <QProcess>
 #include <QStandardPaths>
-#include <QTemporaryDir>
+
+#if HAVE_LIBARCHIVE
+#include <archive.h>
+#include <archive_entry.h>
+#endif
 
 K_PLUGIN_CLASS_WITH_JSON(ComicCreator, "comicbookthumbnail.json")
 
+// Upper bound for a helper process, a broken archive must not block the worker
+static constexpr int s_processTimeout = 30000;
+// Upper bound for the encoded cover image, like ZipReader::data() has
+static constexpr qint64 s_maxCoverSize = 256 * 1024 * 1024;
+
 ComicCreator::ComicCreator(QObject *parent, const QVariantList &args)
     : KIO::ThumbnailCreator(parent, args)
 {
@@ -41,6 +55,7 @@ ComicCreator::ComicCreator(QObject *parent, const QVariantList &args)
 KIO::ThumbnailResult ComicCreator::create(const KIO::ThumbnailRequest &request)
 {
     const QString path = request.url().toLocalFile();
+    m_targetSize = request.targetSize();
     QImage cover;
 
     // Detect mime type.
@@ -50,7 +65,11 @@ KIO::ThumbnailResult ComicCreator::create(const KIO::ThumbnailRequest &request)
 
     if (mime.inherits("application/x-cbz") || mime.inherits("application/zip")) {
         // ZIP archive.
-        cover = extractArchiveImage(path, ZIP);
+        cover = extractZipImage(path);
+        if (cover.isNull()) {
+            // KZip copes with some broken archives (e.g. missing central directory)
+            cover = extractArchiveImage(path, ZIP);
+        }
     } else if (mime.inherits("application/x-cbt") || mime.inherits("application/x-gzip") || mime.inherits("application/x-tar")) {
         // TAR archive
         cover = extractArchiveImage(path, TAR);
@@ -135,7 +154,31 @@ QImage ComicCreator::extractArchiveImage(const QString &path, const ComicCreator
         return QImage();
     }
 
-    return QImage::fromData(coverFile->data());
+    return MemoryBudget::decode(coverFile->data(), m_targetSize);
+}
+
+QImage ComicCreator::extractZipImage(const QString &path)
+{
+    /// Extracts the cover image out of the .cbz file, without building a KArchiveDirectory tree.
+    ZipReader zip(path);
+    if (!zip.open()) {
+        return QImage();
+    }
+
+    QStringList entries;
+    zip.forEachEntry([&entries](const ZipReader::Entry &entry) {
+        if (!entry.isDirectory()) {
+            entries.append(entry.fileName());
+        }
+        return true;
+    });
+
+    filterImages(entries);
+    if (entries.isEmpty()) {
+        return QImage();
+    }
+
+    return MemoryBudget::decode(zip.data(entries[0]), m_targetSize);
 }
 
 void ComicCreator::getArchiveFileList(QStringList &entries, const QString &prefix, const KArchiveDirectory *dir)
@@ -156,6 +199,13 @@ QImage ComicCreator::extractRARImage(const QString &path)
 {
     /// Extracts the cover image out of the .cbr file.
 
+#if HAVE_LIBARCHIVE
+    // libarchive reads most RAR files in process, only fall back to unrar if it can't
+    if (QImage cover = extractLibArchiveImage(path); !cover.isNull()) {
+        return cover;
+    }
+#endif
+
     // Check if unrar is available. Get its path in 'unrarPath'.
     static const QString unrar = unrarPath();
     if (unrar.isEmpty()) {
@@ -169,17 +219,92 @@ QImage ComicCreator::extractRARImage(const QString &path)
         return QImage();
     }
 
-    // Extract the cover file alone. Use verbose paths.
-    // unrar x -n<file> path/to/archive /path/to/temp
-    QTemporaryDir cUnrarTempDir;
-    runProcess(unrar, {"x", "-n" + entries[0], path, cUnrarTempDir.path()});
+    // Print the cover file alone to stdout, no need for a temporary directory.
+    // unrar p -inul path/to/archive <file>
+    if (!runProcess(unrar, {"p", "-inul", path, entries[0]})) {
+        return QImage();
+    }
 
     // Load cover file data into image.
-    QImage cover;
-    cover.load(cUnrarTempDir.path() + QDir::separator() + entries[0]);
+    return MemoryBudget::decode(m_stdOut, m_targetSize);
+}
+
+#if HAVE_LIBARCHIVE
+QImage ComicCreator::extractLibArchiveImage(const QString &path)
+{
+    /// Lists the archive without decompressing anything, then extracts only the cover.
+    const QByteArray encodedPath = QFile::encodeName(path);
+    auto openArchive = [&encodedPath]() {
+        std::unique_ptr<struct archive, decltype(&archive_read_free)> archive(archive_read_new(), &archive_read_free);
+        archive_read_support_filter_all(archive.get());
+        archive_read_support_format_all(archive.get());
+        if (archive_read_open_filename(archive.get(), encodedPath.constData(), 64 * 1024) != ARCHIVE_OK) {
+            archive.reset();
+        }
+        return archive;
+    };
+
+    QStringList entries;
+    {
+        auto archive = openArchive();
+        if (!archive) {
+            return QImage();
+        }
+        struct archive_entry *entry;
+        while (archive_read_next_header(archive.get(), &entry) == ARCHIVE_OK) {
+            if (archive_entry_filetype(entry) == AE_IFREG) {
+                entries.append(QString::fromUtf8(archive_entry_pathname_utf8(entry)));
+            }
+            archive_read_data_skip(archive.get());
+        }
+    }
+
+    filterImages(entries);
+    if (entries.isEmpty()) {
+        return QImage();
+    }
+
+    auto archive = openArchive();
+    if (!archive) {
+        return QImage();
+    }
+    struct archive_entry *entry;
+    while (archive_read_next_header(archive.get(), &entry) == ARCHIVE_OK) {
+        if (QString::fromUtf8(archive_entry_pathname_utf8(entry)) != entries[0]) {
+            archive_read_data_skip(archive.get());
+            continue;
+        }
 
-    return cover;
+        // the declared size is not trusted beyond the limit, and no more than it is read
+        const qint64 maxSize = archive_entry_size_is_set(entry) ? std::clamp<qint64>(archive_entry_size(entry), 0, s_maxCoverSize) : s_maxCoverSize;
+        const MemoryBudget::Reservation reservation(maxSize);
+        if (!reservation.isValid()) {
+            return QImage();
+        }
+
+        QByteArray data;
+        if (archive_entry_size_is_set(entry)) {
+            data.reserve(maxSize);
+        }
+        char buffer[64 * 1024];
+        la_ssize_t read;
+        while ((read = archive_read_data(archive.get(), buffer, sizeof(buffer))) > 0) {
+            if (data.size() + read > maxSize) {
+                qCDebug(KIO_THUMBNAIL_COMIC_LOG) << "Cover entry" << entries[0] << "is larger than" << maxSize << "bytes";
+                return QImage();
+            }
+            data.append(buffer, read);
+        }
+        if (read < 0) {
+            qCDebug(KIO_THUMBNAIL_COMIC_LOG) << archive_error_string(archive.get());
+            return QImage();
+        }
+        return MemoryBudget::decode(data, m_targetSize);
+    }
+
+    return QImage();
 }
+#endif
 
 QStringList ComicCreator::getRARFileList(const QString &path, const QString &unrarPath)
 {
@@ -216,7 +341,7 @@ QString ComicCreator::unrarPath() const
     return QString();
 }
 
-int ComicCreator::runProcess(const QString &processPath, const QStringList &args)
+bool ComicCreator::runProcess(const QString &processPath, const QStringList &args)
 {
     /// Run a process and store stdout data in a buffer.
 
@@ -227,10 +352,14 @@ int ComicCreator::runProcess(const QString &processPath, const QStringList &args
     process.setArguments(args);
     process.start(QIODevice::ReadWrite | QIODevice::Unbuffered);
 
-    auto ret = process.waitForFinished(-1);
+    auto ret = process.waitForFinished(s_processTimeout);
+    if (!ret) {
+        process.kill();
+        process.waitForFinished();
+    }
     m_stdOut = process.readAllStandardOutput();
 
-    return ret;
+    return ret && process.exitStatus() == QProcess::NormalExit && process.exitCode() == 0;
 }
 
 #include "comiccreator.moc"
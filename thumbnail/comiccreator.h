@@ -16,6 +16,8 @@
 #ifndef COMIC_CREATOR_H
 #define COMIC_CREATOR_H
 
+#include "config-thumbnail.h"
+
 #include <KIO/ThumbnailCreator>
 
 #include <QByteArray>
@@ -36,7 +38,11 @@ public:
 private:
     enum Type { ZIP, TAR, RAR, SEVENZIP };
     void filterImages(QStringList &entries);
-    int runProcess(const QString &processPath, const QStringList &args);
+    bool runProcess(const QString &processPath, const QStringList &args);
+
+    // For "zip" type files.
+    // Only reads the central directory and the cover entry.
+    QImage extractZipImage(const QString &path);
 
     // For "zip" and "tar" type files.
     // Uses KDE's internal archive classes.
@@ -49,8 +55,14 @@ private:
     QString unrarPath() const;
     QStringList getRARFileList(const QString &path, const QString &unrarPath);
 
+#if HAVE_LIBARCHIVE
+    // For "rar" type files, if libarchive is available.
+    QImage extractLibArchiveImage(const QString &path);
+#endif
+
 private:
     QByteArray m_stdOut;
+    QSize m_targetSize;
 };
 
 #endif
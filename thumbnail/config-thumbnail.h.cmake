@@ -4,3 +4,5 @@
 */
 
 #cmakedefine01 HAVE_KEXIV2
+#cmakedefine01 HAVE_DJVULIBRE
+#cmakedefine01 HAVE_LIBARCHIVE
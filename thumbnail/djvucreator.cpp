@@ -3,24 +3,59 @@
     SPDX-FileCopyrightText: 2020 Stefan Brüns <stefan.bruens@rwth-aachen.de>
 */
 
+#include "config-thumbnail.h"
+
 #include "djvucreator.h"
 #include "thumbnail-djvu-logsettings.h"
 
+#include <QDeadlineTimer>
 #include <QImage>
 #include <QProcess>
 #include <QString>
+#include <QThread>
 
 #include <KPluginFactory>
 
+#if HAVE_DJVULIBRE
+#include <libdjvu/ddjvuapi.h>
+#endif
+
 K_PLUGIN_CLASS_WITH_JSON(DjVuCreator, "djvuthumbnail.json")
 
+// Upper bound for rendering a single page, a broken file must not block the worker
+static constexpr int s_renderTimeout = 30000;
+// How long to sleep while the decoder threads have not posted a message
+static constexpr int s_pollInterval = 10;
+
 DjVuCreator::DjVuCreator(QObject *parent, const QVariantList &args)
     : KIO::ThumbnailCreator(parent, args)
 {
 }
 
+DjVuCreator::~DjVuCreator()
+{
+#if HAVE_DJVULIBRE
+    if (m_context) {
+        ddjvu_context_release(m_context);
+    }
+#endif
+}
+
 KIO::ThumbnailResult DjVuCreator::create(const KIO::ThumbnailRequest &request)
 {
+    // Shared by libdjvu and the ddjvu fallback, which only gets what is left
+    const QDeadlineTimer deadline(s_renderTimeout);
+
+#if HAVE_DJVULIBRE
+    QImage img = renderFirstPage(request.url().toLocalFile(), request.targetSize(), deadline);
+    if (!img.isNull()) {
+        return KIO::ThumbnailResult::pass(img);
+    }
+    if (deadline.hasExpired()) {
+        return KIO::ThumbnailResult::fail();
+    }
+#endif
+
     QProcess ddjvu;
 
     const QStringList args{QStringLiteral("-page=1"),
@@ -30,10 +65,13 @@ KIO::ThumbnailResult DjVuCreator::create(const KIO::ThumbnailRequest &request)
                            request.url().toLocalFile()};
 
     ddjvu.start(QStringLiteral("ddjvu"), args);
-    ddjvu.waitForFinished();
+    if (!ddjvu.waitForFinished(int(deadline.remainingTime()))) {
+        ddjvu.kill();
+        ddjvu.waitForFinished();
+    }
 
     static bool warnOnce = true;
-    if (ddjvu.exitCode() != 0) {
+    if (ddjvu.exitStatus() != QProcess::NormalExit || ddjvu.exitCode() != 0) {
         if (warnOnce) {
             qCWarning(KIO_THUMBNAIL_DJVU_LOG) << ddjvu.error() << ddjvu.readAllStandardError();
             warnOnce = false;
@@ -46,5 +84,91 @@ KIO::ThumbnailResult DjVuCreator::create(const KIO::ThumbnailRequest &request)
     return okay ? KIO::ThumbnailResult::pass(img) : KIO::ThumbnailResult::fail();
 }
 
+#if HAVE_DJVULIBRE
+// Dispatches libdjvu messages until @p done returns true, the job failed or the deadline expired.
+// ddjvu_message_wait() has no timeout, a decoder that never posts a message would block forever.
+template<typename Done>
+static bool waitForJob(ddjvu_context_t *context, const QDeadlineTimer &deadline, Done done)
+{
+    while (!done()) {
+        if (deadline.hasExpired()) {
+            return false;
+        }
+        if (!ddjvu_message_peek(context)) {
+            QThread::msleep(qMin<qint64>(s_pollInterval, deadline.remainingTime()));
+            continue;
+        }
+        while (ddjvu_message_peek(context)) {
+            ddjvu_message_pop(context);
+        }
+    }
+    return true;
+}
+
+QImage DjVuCreator::renderFirstPage(const QString &path, QSize targetSize, const QDeadlineTimer &deadline)
+{
+    // The context owns the decoder threads and caches, keep it for the lifetime of the worker
+    if (!m_context) {
+        m_context = ddjvu_context_create("kio_thumbnail");
+        if (!m_context) {
+            return QImage();
+        }
+    }
+
+    QImage img;
+
+    ddjvu_document_t *document = ddjvu_document_create_by_filename_utf8(m_context, path.toUtf8().constData(), false);
+    if (!document) {
+        return img;
+    }
+
+    if (waitForJob(m_context, deadline, [document] {
+            return ddjvu_document_decoding_done(document);
+        })
+        && !ddjvu_document_decoding_error(document)) {
+        ddjvu_page_t *page = ddjvu_page_create_by_pageno(document, 0);
+        if (page) {
+            if (waitForJob(m_context, deadline, [page] {
+                    return ddjvu_page_decoding_done(page);
+                })
+                && !ddjvu_page_decoding_error(page)) {
+                img = renderPage(page, targetSize);
+            } else {
+                ddjvu_job_stop(ddjvu_page_job(page));
+            }
+            ddjvu_page_release(page);
+        }
+    } else {
+        ddjvu_job_stop(ddjvu_document_job(document));
+    }
+
+    ddjvu_document_release(document);
+    return img;
+}
+
+QImage DjVuCreator::renderPage(ddjvu_page_t *page, QSize targetSize)
+{
+    const QSize pageSize(ddjvu_page_get_width(page), ddjvu_page_get_height(page));
+    if (pageSize.isEmpty()) {
+        return QImage();
+    }
+
+    // Let the decoder subsample the page to the thumbnail size instead of scaling afterwards
+    const QSize size = pageSize.scaled(targetSize, Qt::KeepAspectRatio).boundedTo(pageSize);
+    QImage img(size, QImage::Format_RGB32);
+
+    unsigned int masks[4] = {0xff0000, 0x00ff00, 0x0000ff, 0xff000000};
+    ddjvu_format_t *format = ddjvu_format_create(DDJVU_FORMAT_RGBMASK32, 4, masks);
+    ddjvu_format_set_row_order(format, 1);
+    ddjvu_format_set_y_direction(format, 1);
+
+    ddjvu_rect_t rect = {0, 0, static_cast<unsigned int>(size.width()), static_cast<unsigned int>(size.height())};
+    const bool rendered = ddjvu_page_render(page, DDJVU_RENDER_COLOR, &rect, &rect, format, img.bytesPerLine(), reinterpret_cast<char *>(img.bits()));
+    ddjvu_format_release(format);
+
+    return rendered ? img : QImage();
+}
+#endif
+
 #include "djvucreator.moc"
 #include "moc_djvucreator.cpp"
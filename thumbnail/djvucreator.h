@@ -6,15 +6,33 @@
 #ifndef DJVUCREATOR_H__
 #define DJVUCREATOR_H__
 
+#include "config-thumbnail.h"
+
 #include <KIO/ThumbnailCreator>
 
+#include <QDeadlineTimer>
+
+#if HAVE_DJVULIBRE
+struct ddjvu_context_s;
+struct ddjvu_page_s;
+#endif
+
 class DjVuCreator : public KIO::ThumbnailCreator
 {
     Q_OBJECT
 public:
     DjVuCreator(QObject *parent, const QVariantList &args);
+    ~DjVuCreator() override;
 
     KIO::ThumbnailResult create(const KIO::ThumbnailRequest &request) override;
+
+private:
+#if HAVE_DJVULIBRE
+    QImage renderFirstPage(const QString &path, QSize targetSize, const QDeadlineTimer &deadline);
+    QImage renderPage(ddjvu_page_s *page, QSize targetSize);
+
+    ddjvu_context_s *m_context = nullptr;
+#endif
 };
 
 #endif
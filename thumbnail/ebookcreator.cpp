@@ -5,7 +5,10 @@
  */
 
 #include "ebookcreator.h"
+#include "memorybudget.h"
+#include "zipreader.h"
 
+#include <QBuffer>
 #include <QFile>
 #include <QImage>
 #include <QMap>
@@ -14,7 +17,6 @@
 #include <QXmlStreamReader>
 
 #include <KPluginFactory>
-#include <KZip>
 
 K_PLUGIN_CLASS_WITH_JSON(EbookCreator, "ebookthumbnail.json")
 
@@ -30,7 +32,7 @@ KIO::ThumbnailResult EbookCreator::create(const KIO::ThumbnailRequest &request)
     const QString path = request.url().toLocalFile();
 
     if (request.mimeType() == QLatin1String("application/epub+zip")) {
-        return createEpub(path);
+        return createEpub(path, request.targetSize());
 
     } else if (request.mimeType() == QLatin1String("application/x-fictionbook+xml")) {
         QFile file(path);
@@ -38,57 +40,61 @@ KIO::ThumbnailResult EbookCreator::create(const KIO::ThumbnailRequest &request)
             return KIO::ThumbnailResult::fail();
         }
 
-        return createFb2(&file);
+        return createFb2(&file, request.targetSize());
 
     } else if (request.mimeType() == QLatin1String("application/x-zip-compressed-fb2")) {
-        KZip zip(path);
-        if (!zip.open(QIODevice::ReadOnly)) {
+        ZipReader zip(path);
+        if (!zip.open()) {
             return KIO::ThumbnailResult::fail();
         }
 
-        QScopedPointer<QIODevice> zipDevice;
-
-        const auto entries = zip.directory()->entries();
-        for (const QString &entryPath : entries) {
-            if (entries.count() > 1 && !entryPath.endsWith(QLatin1String(".fb2"))) { // can this done a bit more cleverly?
-                continue;
+        int fileCount = 0;
+        std::optional<ZipReader::Entry> fb2Entry;
+        zip.forEachEntry([&fileCount, &fb2Entry](const ZipReader::Entry &entry) {
+            if (entry.isDirectory()) {
+                return true;
             }
-
-            const auto *entry = zip.directory()->file(entryPath);
-            if (!entry) {
-                return KIO::ThumbnailResult::fail();
+            ++fileCount;
+            if (!fb2Entry || entry.name.endsWith(".fb2")) { // can this done a bit more cleverly?
+                fb2Entry = entry;
             }
+            return true;
+        });
 
-            zipDevice.reset(entry->createDevice());
+        if (!fb2Entry || (fileCount > 1 && !fb2Entry->name.endsWith(".fb2"))) {
+            return KIO::ThumbnailResult::fail();
         }
 
-        return createFb2(zipDevice.data());
+        QByteArray fb2Data = zip.data(*fb2Entry);
+        QBuffer buffer(&fb2Data);
+        if (!buffer.open(QIODevice::ReadOnly)) {
+            return KIO::ThumbnailResult::fail();
+        }
+
+        return createFb2(&buffer, request.targetSize());
     }
 
     return KIO::ThumbnailResult::fail();
 }
 
-KIO::ThumbnailResult EbookCreator::createEpub(const QString &path)
+KIO::ThumbnailResult EbookCreator::createEpub(const QString &path, QSize targetSize)
 {
-    KZip zip(path);
-    if (!zip.open(QIODevice::ReadOnly)) {
+    ZipReader zip(path);
+    if (!zip.open()) {
         return KIO::ThumbnailResult::fail();
     }
 
-    QScopedPointer<QIODevice> zipDevice;
     QString opfPath;
     QString coverHref;
 
     // First figure out where the OPF file with metadata is
-    const auto *entry = zip.directory()->file(QStringLiteral("META-INF/container.xml"));
+    const QByteArray containerData = zip.data(QStringLiteral("META-INF/container.xml"));
 
-    if (!entry) {
+    if (containerData.isEmpty()) {
         return KIO::ThumbnailResult::fail();
     }
 
-    zipDevice.reset(entry->createDevice());
-
-    QXmlStreamReader xml(zipDevice.data());
+    QXmlStreamReader xml(containerData);
     while (!xml.atEnd() && !xml.hasError()) {
         xml.readNext();
 
@@ -103,14 +109,13 @@ KIO::ThumbnailResult EbookCreator::createEpub(const QString &path)
     }
 
     // Now read the OPF file and look for a <meta name="cover" content="...">
-    entry = zip.directory()->file(opfPath);
-    if (!entry) {
+    const QByteArray opfData = zip.data(opfPath);
+    if (opfData.isEmpty()) {
         return KIO::ThumbnailResult::fail();
     }
 
-    zipDevice.reset(entry->createDevice());
-
-    xml.setDevice(zipDevice.data());
+    xml.clear();
+    xml.addData(opfData);
 
     bool inMetadata = false;
     bool inManifest = false;
@@ -171,39 +176,24 @@ KIO::ThumbnailResult EbookCreator::createEpub(const QString &path)
 
     if (coverHref.isEmpty()) {
         // Maybe we're lucky and the archive contains an iTunesArtwork file from iBooks
-        entry = zip.directory()->file(QStringLiteral("iTunesArtwork"));
-        if (entry) {
-            zipDevice.reset(entry->createDevice());
+        if (const auto artwork = zip.entry(QStringLiteral("iTunesArtwork"))) {
+            const QImage image = MemoryBudget::decode(zip.data(*artwork), targetSize);
 
-            QImage image;
-            bool okay = image.load(zipDevice.data(), "");
-
-            return okay ? KIO::ThumbnailResult::pass(image) : KIO::ThumbnailResult::fail();
+            return !image.isNull() ? KIO::ThumbnailResult::pass(image) : KIO::ThumbnailResult::fail();
         }
 
         // Maybe there's a file called "cover" somewhere
-        const QStringList entries = getEntryList(zip.directory(), QString());
-
-        for (const QString &name : entries) {
-            if (!name.contains(QLatin1String("cover"), Qt::CaseInsensitive)) {
-                continue;
-            }
-
-            entry = zip.directory()->file(name);
-            if (!entry) {
-                continue;
+        QImage image;
+        zip.forEachEntry([&zip, &image, targetSize](const ZipReader::Entry &entry) {
+            if (entry.isDirectory() || !entry.fileName().contains(QLatin1String("cover"), Qt::CaseInsensitive)) {
+                return true;
             }
+            // keep looking until one of them loads
+            image = MemoryBudget::decode(zip.data(entry), targetSize);
+            return image.isNull();
+        });
 
-            zipDevice.reset(entry->createDevice());
-
-            QImage image;
-            bool success = image.load(zipDevice.data(), "");
-
-            if (success) {
-                return KIO::ThumbnailResult::pass(image);
-            }
-        }
-        return KIO::ThumbnailResult::fail();
+        return !image.isNull() ? KIO::ThumbnailResult::pass(image) : KIO::ThumbnailResult::fail();
     }
 
     // Decode percent encoded URL
@@ -218,19 +208,14 @@ KIO::ThumbnailResult EbookCreator::createEpub(const QString &path)
     }
 
     // Finally, just load the cover image file
-    entry = zip.directory()->file(coverHref);
-    if (entry) {
-        zipDevice.reset(entry->createDevice());
-        QImage image;
-        image.load(zipDevice.data(), "");
-
-        return KIO::ThumbnailResult::pass(image);
+    if (const auto cover = zip.entry(coverHref)) {
+        return KIO::ThumbnailResult::pass(MemoryBudget::decode(zip.data(*cover), targetSize));
     }
 
     return KIO::ThumbnailResult::fail();
 }
 
-KIO::ThumbnailResult EbookCreator::createFb2(QIODevice *device)
+KIO::ThumbnailResult EbookCreator::createFb2(QIODevice *device, QSize targetSize)
 {
     QString coverId;
 
@@ -293,9 +278,7 @@ KIO::ThumbnailResult EbookCreator::createFb2(QIODevice *device)
         } else {
             if (!coverId.isEmpty() && xml.isStartElement() && xml.name() == QLatin1String("binary")) {
                 if (xml.attributes().value(QStringLiteral("id")) == coverId) {
-                    QImage image;
-                    image.loadFromData(QByteArray::fromBase64(xml.readElementText().toLatin1()));
-                    return KIO::ThumbnailResult::pass(image);
+                    return KIO::ThumbnailResult::pass(MemoryBudget::decode(QByteArray::fromBase64(xml.readElementText().toLatin1()), targetSize));
                 }
             }
         }
@@ -304,30 +287,5 @@ KIO::ThumbnailResult EbookCreator::createFb2(QIODevice *device)
     return KIO::ThumbnailResult::fail();
 }
 
-QStringList EbookCreator::getEntryList(const KArchiveDirectory *dir, const QString &path)
-{
-    QStringList list;
-
-    const QStringList entries = dir->entries();
-    for (const QString &name : entries) {
-        const KArchiveEntry *entry = dir->entry(name);
-
-        QString fullPath = name;
-
-        if (!path.isEmpty()) {
-            fullPath.prepend(QLatin1Char('/'));
-            fullPath.prepend(path);
-        }
-
-        if (entry->isFile()) {
-            list << fullPath;
-        } else {
-            list << getEntryList(static_cast<const KArchiveDirectory *>(entry), fullPath);
-        }
-    }
-
-    return list;
-}
-
 #include "ebookcreator.moc"
 #include "moc_ebookcreator.cpp"
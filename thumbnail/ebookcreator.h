@@ -12,8 +12,6 @@
 
 class QIODevice;
 
-class KArchiveDirectory;
-
 class EbookCreator : public KIO::ThumbnailCreator
 {
     Q_OBJECT
@@ -23,9 +21,7 @@ public:
 
     KIO::ThumbnailResult create(const KIO::ThumbnailRequest &request) override;
 
-    KIO::ThumbnailResult createEpub(const QString &path);
-    // either a QFile or a KZipFileEntry
-    KIO::ThumbnailResult createFb2(QIODevice *device);
-
-    static QStringList getEntryList(const KArchiveDirectory *dir, const QString &path);
+    KIO::ThumbnailResult createEpub(const QString &path, QSize targetSize);
+    // either a QFile or a QBuffer holding the unpacked zip entry
+    KIO::ThumbnailResult createFb2(QIODevice *device, QSize targetSize);
 };
@@ -0,0 +1,55 @@
+/*  This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "embeddedpreview.h"
+
+#include <QImage>
+#include <QString>
+
+#include <KExiv2/KExiv2>
+#include <KExiv2/KExiv2Previews>
+
+bool EmbeddedPreview::load(const QString &filePath, QSize targetSize, bool autoRotate, QImage &image)
+{
+    KExiv2Iface::KExiv2Previews previews(filePath);
+    if (previews.isEmpty()) {
+        return false;
+    }
+
+    // Pick the smallest preview that is not strictly smaller than the
+    // requested size, decoding a larger one would only waste time.
+    int best = -1;
+    qint64 bestArea = 0;
+    for (int i = 0; i < previews.count(); ++i) {
+        const int width = previews.width(i);
+        const int height = previews.height(i);
+        if (width < targetSize.width() && height < targetSize.height()) {
+            continue;
+        }
+        const qint64 area = qint64(width) * height;
+        if (best < 0 || area < bestArea) {
+            best = i;
+            bestArea = area;
+        }
+    }
+
+    if (best < 0) {
+        return false;
+    }
+
+    QImage preview = previews.image(best);
+    if (preview.isNull()) {
+        return false;
+    }
+
+    if (autoRotate) {
+        KExiv2Iface::KExiv2 exiv2Image(filePath);
+        KExiv2Iface::KExiv2::rotateExifQImage(preview, exiv2Image.getImageOrientation());
+    }
+
+    image = preview;
+    return true;
+}
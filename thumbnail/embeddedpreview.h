@@ -0,0 +1,32 @@
+/*  This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef EMBEDDED_PREVIEW_H
+#define EMBEDDED_PREVIEW_H
+
+#include <QSize>
+
+class QImage;
+class QString;
+
+namespace EmbeddedPreview
+{
+
+/**
+ * Loads the best preview image embedded in the metadata of @p filePath.
+ *
+ * All previews known to Exiv2 are considered (the EXIF IFD1 thumbnail as well as
+ * the larger JPEG previews stored in MakerNotes and RAW containers). The smallest
+ * one covering @p targetSize is chosen; if none is large enough, @p image is left
+ * untouched and false is returned so that the caller can decode the image itself.
+ *
+ * If @p autoRotate is set, the EXIF orientation of the main image is applied.
+ */
+bool load(const QString &filePath, QSize targetSize, bool autoRotate, QImage &image);
+
+}
+
+#endif // EMBEDDED_PREVIEW_H
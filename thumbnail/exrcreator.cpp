@@ -5,6 +5,7 @@
 */
 
 #include "exrcreator.h"
+#include "memorybudget.h"
 #include "thumbnail-exr-logsettings.h"
 
 #include <QFile>
@@ -13,17 +14,149 @@
 #include <ImfHeader.h>
 #include <ImfInputFile.h>
 #include <ImfPreviewImage.h>
+#include <ImfRgbaFile.h>
+#include <ImfTestFile.h>
+#include <ImfTiledRgbaFile.h>
 
-#include <KConfigGroup>
 #include <KPluginFactory>
-#include <KSharedConfig>
 
-#include <KIO/Global>
-
-#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 K_PLUGIN_CLASS_WITH_JSON(EXRCreator, "exrthumbnail.json")
 
+namespace
+{
+// Lookup tables mapping every possible half value to an 8 bit channel value,
+// so converting a pixel is three table loads instead of three pow() calls.
+struct HalfToByteTable {
+    HalfToByteTable()
+    {
+        for (int i = 0; i < 65536; ++i) {
+            half h;
+            h.setBits(i);
+            // negative values, NaN and infinity end up clamped to [0, 1]
+            float v = float(h);
+            v = (v > 0.0f) ? std::min(v, 1.0f) : 0.0f;
+            const float s = v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+            srgb[i] = uchar(s * 255.0f + 0.5f);
+            linear[i] = uchar(v * 255.0f + 0.5f);
+        }
+    }
+
+    uchar srgb[65536];
+    uchar linear[65536];
+};
+
+const HalfToByteTable &halfToByte()
+{
+    static const HalfToByteTable table;
+    return table;
+}
+
+// Converts @p count pixels, taking every @p step th one from @p src
+void convertRow(const Imf::Rgba *src, int count, int step, QRgb *dst)
+{
+    const HalfToByteTable &table = halfToByte();
+    const unsigned short opaque = half(1.0f).bits();
+    for (int x = 0; x < count; ++x, src += step) {
+        if (src->a.bits() == opaque) {
+            dst[x] = qRgb(table.srgb[src->r.bits()], table.srgb[src->g.bits()], table.srgb[src->b.bits()]);
+            continue;
+        }
+        // The colors of an Imf::Rgba are premultiplied with alpha, the transfer
+        // curve applies to the colors themselves, as does Format_ARGB32
+        const float a = src->a;
+        if (!(a > 0.0f)) {
+            dst[x] = qRgba(0, 0, 0, 0);
+            continue;
+        }
+        const half r(float(src->r) / a);
+        const half g(float(src->g) / a);
+        const half b(float(src->b) / a);
+        dst[x] = qRgba(table.srgb[r.bits()], table.srgb[g.bits()], table.srgb[b.bits()], table.linear[src->a.bits()]);
+    }
+}
+
+// Reads the smallest mip or rip level that still covers @p targetSize
+QImage readTiledLevel(const char *path, QSize targetSize)
+{
+    Imf::TiledRgbaInputFile in(path);
+
+    int levelX = 0;
+    int levelY = 0;
+    switch (in.levelMode()) {
+    case Imf::MIPMAP_LEVELS:
+        while (levelX + 1 < in.numLevels() && in.levelWidth(levelX + 1) >= targetSize.width() && in.levelHeight(levelX + 1) >= targetSize.height()) {
+            ++levelX;
+        }
+        levelY = levelX;
+        break;
+    case Imf::RIPMAP_LEVELS:
+        while (levelX + 1 < in.numXLevels() && in.levelWidth(levelX + 1) >= targetSize.width()) {
+            ++levelX;
+        }
+        while (levelY + 1 < in.numYLevels() && in.levelHeight(levelY + 1) >= targetSize.height()) {
+            ++levelY;
+        }
+        break;
+    default:
+        // a single full resolution level, the scanline path subsamples that better
+        return QImage();
+    }
+
+    const Imath::Box2i dw = in.dataWindowForLevel(levelX, levelY);
+    const int width = dw.max.x - dw.min.x + 1;
+    const int height = dw.max.y - dw.min.y + 1;
+
+    // the whole level is read into half float pixels before conversion
+    const MemoryBudget::Reservation reservation(qint64(width) * height * qint64(sizeof(Imf::Rgba)) + MemoryBudget::imageBytes(QSize(width, height)));
+    if (!reservation.isValid()) {
+        return QImage();
+    }
+
+    std::vector<Imf::Rgba> pixels(size_t(width) * height);
+    in.setFrameBuffer(pixels.data() - dw.min.x - ptrdiff_t(dw.min.y) * width, 1, width);
+    in.readTiles(0, in.numXTiles(levelX) - 1, 0, in.numYTiles(levelY) - 1, levelX, levelY);
+
+    QImage img(width, height, QImage::Format_ARGB32);
+    for (int y = 0; y < height; ++y) {
+        convertRow(pixels.data() + size_t(y) * width, width, 1, reinterpret_cast<QRgb *>(img.scanLine(y)));
+    }
+    return img;
+}
+
+// Reads only every n-th scanline and pixel, so that the result is not smaller than @p targetSize
+QImage readSubsampled(const char *path, QSize targetSize)
+{
+    Imf::RgbaInputFile in(path);
+
+    const Imath::Box2i dw = in.dataWindow();
+    const int width = dw.max.x - dw.min.x + 1;
+    const int height = dw.max.y - dw.min.y + 1;
+    const int step = std::max(1, std::min(width / std::max(1, targetSize.width()), height / std::max(1, targetSize.height())));
+    const int outWidth = (width + step - 1) / step;
+    const int outHeight = (height + step - 1) / step;
+
+    const MemoryBudget::Reservation reservation(qint64(width) * qint64(sizeof(Imf::Rgba)) + MemoryBudget::imageBytes(QSize(outWidth, outHeight)));
+    if (!reservation.isValid()) {
+        return QImage();
+    }
+
+    // a y stride of zero maps every scanline onto the same row buffer
+    std::vector<Imf::Rgba> row(width);
+    in.setFrameBuffer(row.data() - dw.min.x, 1, 0);
+
+    QImage img(outWidth, outHeight, QImage::Format_ARGB32);
+    for (int y = 0; y < outHeight; ++y) {
+        in.readPixels(dw.min.y + y * step);
+        convertRow(row.data(), outWidth, step, reinterpret_cast<QRgb *>(img.scanLine(y)));
+    }
+    return img;
+}
+}
+
 EXRCreator::EXRCreator(QObject *parent, const QVariantList &args)
     : KIO::ThumbnailCreator(parent, args)
 {
@@ -31,18 +164,20 @@ EXRCreator::EXRCreator(QObject *parent, const QVariantList &args)
 
 KIO::ThumbnailResult EXRCreator::create(const KIO::ThumbnailRequest &request)
 {
+    const QByteArray encodedPath = QFile::encodeName(request.url().toLocalFile());
+
     try {
-        const QByteArray encodedPath = QFile::encodeName(request.url().toLocalFile());
         Imf::InputFile in(encodedPath.constData());
         const Imf::Header &h = in.header();
         if (h.hasPreviewImage()) {
             qCDebug(KIO_THUMBNAIL_EXR_LOG) << "EXRcreator - using preview";
             const Imf::PreviewImage &preview = h.previewImage();
             QImage qpreview(preview.width(), preview.height(), QImage::Format_RGB32);
+            const Imf::PreviewRgba *pixels = preview.pixels();
             for (unsigned int y = 0; y < preview.height(); y++) {
-                for (unsigned int x = 0; x < preview.width(); x++) {
-                    const Imf::PreviewRgba &q = preview.pixels()[x + (y * preview.width())];
-                    qpreview.setPixel(x, y, qRgba(q.r, q.g, q.b, q.a));
+                QRgb *line = reinterpret_cast<QRgb *>(qpreview.scanLine(y));
+                for (unsigned int x = 0; x < preview.width(); x++, pixels++) {
+                    line[x] = qRgba(pixels->r, pixels->g, pixels->b, pixels->a);
                 }
             }
             return KIO::ThumbnailResult::pass(qpreview);
@@ -52,23 +187,24 @@ KIO::ThumbnailResult EXRCreator::create(const KIO::ThumbnailRequest &request)
         return KIO::ThumbnailResult::fail();
     }
 
-    // do it the hard way
-    // We ignore maximum size when just extracting the thumbnail
-    // from the header, but it is very expensive to render large
-    // EXR images just to turn it into an icon, so we go back
-    // to honoring it in here.
-    qCDebug(KIO_THUMBNAIL_EXR_LOG) << "EXRcreator - using original image";
-    KSharedConfig::Ptr config = KSharedConfig::openConfig();
-    KConfigGroup configGroup(config, "PreviewSettings");
-    const KIO::filesize_t maxSize = configGroup.readEntry("MaximumSize", std::numeric_limits<KIO::filesize_t>::max());
-    const KIO::filesize_t fileSize = QFile(request.url().toLocalFile()).size();
-    if ((fileSize > 0) && (fileSize < maxSize)) {
+    // do it the hard way, but only read as much of the image as the thumbnail needs:
+    // the closest mip/rip level of tiled files, or every n-th scanline otherwise
+    try {
         QImage img;
-        if (!img.load(request.url().toLocalFile())) {
+        if (Imf::isTiledOpenExrFile(encodedPath.constData())) {
+            qCDebug(KIO_THUMBNAIL_EXR_LOG) << "EXRcreator - using tiled level";
+            img = readTiledLevel(encodedPath.constData(), request.targetSize());
+        }
+        if (img.isNull()) {
+            qCDebug(KIO_THUMBNAIL_EXR_LOG) << "EXRcreator - using subsampled scanlines";
+            img = readSubsampled(encodedPath.constData(), request.targetSize());
+        }
+        if (img.isNull()) {
             return KIO::ThumbnailResult::fail();
         }
         return KIO::ThumbnailResult::pass(img);
-    } else {
+    } catch (const std::exception &e) {
+        qCDebug(KIO_THUMBNAIL_EXR_LOG) << e.what();
         return KIO::ThumbnailResult::fail();
     }
 }
@@ -12,6 +12,8 @@
 
 #include <QtGlobal>
 
+class QByteArray;
+class QByteArrayView;
 class QString;
 class QIODevice;
 class QImage;
@@ -20,6 +22,13 @@ class QImageReader;
 namespace IcoUtils
 {
 
+/**
+ * Builds an .ico file from the first icon group found in the resources of the
+ * PE (32 or 64 bit) or NE (16 bit) executable @p exeData.
+ * All offsets read from @p exeData are bounds checked, so it is safe to call on untrusted input.
+ */
+bool extractIcoFromExe(QByteArrayView exeData, QByteArray &icoData);
+
 bool loadIcoImageFromExe(QIODevice *inputDevice, QImage &image, int needWidth = 512, int needHeight = 512);
 bool loadIcoImageFromExe(const QString &inputPath, QImage &image, int needWidth = 512, int needHeight = 512);
 bool loadIcoImageFromExe(const QString &inputFileName, QIODevice *outputDevice);
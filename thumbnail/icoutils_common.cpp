@@ -13,7 +13,6 @@
 #include <QImageReader>
 #include <QList>
 #include <QString>
-#include <QTemporaryFile>
 
 #include <algorithm>
 
@@ -40,17 +39,16 @@ qreal distance(int width, int height, int desiredWidth, int desiredHeight, int d
 
 bool IcoUtils::loadIcoImageFromExe(QIODevice *inputDevice, QImage &image, int needWidth, int needHeight)
 {
-    QTemporaryFile inputFile;
-
-    if (!inputFile.open())
+    QBuffer iconData;
+    if (!IcoUtils::extractIcoFromExe(inputDevice->readAll(), iconData.buffer())) {
         return false;
+    }
 
-    QByteArray data = inputDevice->readAll();
-
-    if (inputFile.write(data) == -1)
+    if (!iconData.open(QIODevice::ReadOnly)) {
         return false;
+    }
 
-    return IcoUtils::loadIcoImageFromExe(inputFile.fileName(), image, needWidth, needHeight);
+    return IcoUtils::loadIcoImage(&iconData, image, needWidth, needHeight);
 }
 
 bool IcoUtils::loadIcoImageFromExe(const QString &inputFileName, QImage &image, int needWidth, int needHeight)
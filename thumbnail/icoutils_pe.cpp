@@ -0,0 +1,384 @@
+/*
+    icoutils_pe.cpp - Extract Microsoft Window icons from PE and NE executables
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "icoutils.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QtEndian>
+
+#include <optional>
+
+namespace
+{
+// https://learn.microsoft.com/en-us/windows/win32/menurc/resource-types
+constexpr quint16 RT_ICON = 3;
+constexpr quint16 RT_GROUP_ICON = 14;
+
+constexpr quint32 PE_RESOURCE_DIRECTORY_INDEX = 2;
+constexpr quint32 PE_HIGH_BIT = 0x80000000;
+constexpr quint16 NE_INTEGER_ID = 0x8000;
+
+// Bounds checked little endian accessors, every offset read from the file goes through these
+class Reader
+{
+public:
+    explicit Reader(QByteArrayView data)
+        : m_data(data)
+    {
+    }
+
+    bool contains(quint64 offset, quint64 length) const
+    {
+        return offset <= quint64(m_data.size()) && length <= quint64(m_data.size()) - offset;
+    }
+
+    bool u16(quint64 offset, quint16 &value) const
+    {
+        if (!contains(offset, sizeof(value))) {
+            return false;
+        }
+        value = qFromLittleEndian<quint16>(m_data.data() + offset);
+        return true;
+    }
+
+    bool u32(quint64 offset, quint32 &value) const
+    {
+        if (!contains(offset, sizeof(value))) {
+            return false;
+        }
+        value = qFromLittleEndian<quint32>(m_data.data() + offset);
+        return true;
+    }
+
+    QByteArrayView slice(quint64 offset, quint64 length) const
+    {
+        if (!contains(offset, length)) {
+            return QByteArrayView();
+        }
+        return m_data.sliced(offset, length);
+    }
+
+private:
+    QByteArrayView m_data;
+};
+
+// Resource section of a 32 or 64 bit Portable Executable
+class PeResources
+{
+public:
+    explicit PeResources(const Reader &reader)
+        : m_reader(reader)
+    {
+    }
+
+    bool init(quint32 peOffset)
+    {
+        const quint64 coffHeader = quint64(peOffset) + 4;
+        quint16 optionalHeaderSize;
+        quint16 magic;
+        if (!m_reader.u16(coffHeader + 2, m_sectionCount) || !m_reader.u16(coffHeader + 16, optionalHeaderSize)) {
+            return false;
+        }
+
+        const quint64 optionalHeader = coffHeader + 20;
+        if (!m_reader.u16(optionalHeader, magic)) {
+            return false;
+        }
+
+        quint64 dataDirectories;
+        quint32 dataDirectoryCount;
+        if (magic == 0x10b) { // PE32
+            dataDirectories = optionalHeader + 96;
+            if (!m_reader.u32(optionalHeader + 92, dataDirectoryCount)) {
+                return false;
+            }
+        } else if (magic == 0x20b) { // PE32+
+            dataDirectories = optionalHeader + 112;
+            if (!m_reader.u32(optionalHeader + 108, dataDirectoryCount)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+
+        quint32 resourceRva;
+        if (dataDirectoryCount <= PE_RESOURCE_DIRECTORY_INDEX || !m_reader.u32(dataDirectories + PE_RESOURCE_DIRECTORY_INDEX * 8, resourceRva)
+            || resourceRva == 0) {
+            return false;
+        }
+
+        m_sectionTable = optionalHeader + optionalHeaderSize;
+        return rvaToOffset(resourceRva, m_resourceBase);
+    }
+
+    /**
+     * Returns the data of the first language of resource @p id of type @p type,
+     * or of the first resource of that type if no @p id is given.
+     */
+    QByteArrayView find(quint16 type, std::optional<quint16> id) const
+    {
+        quint32 typeDirectory;
+        quint32 nameDirectory;
+        quint32 dataEntry;
+        if (!findEntry(0, type, typeDirectory) || !(typeDirectory & PE_HIGH_BIT)) {
+            return QByteArrayView();
+        }
+        if (!findEntry(typeDirectory & ~PE_HIGH_BIT, id, nameDirectory) || !(nameDirectory & PE_HIGH_BIT)) {
+            return QByteArrayView();
+        }
+        if (!findEntry(nameDirectory & ~PE_HIGH_BIT, std::nullopt, dataEntry) || (dataEntry & PE_HIGH_BIT)) {
+            return QByteArrayView();
+        }
+
+        quint32 dataRva;
+        quint32 dataSize;
+        quint64 dataOffset;
+        if (!m_reader.u32(m_resourceBase + dataEntry, dataRva) || !m_reader.u32(m_resourceBase + dataEntry + 4, dataSize)
+            || !rvaToOffset(dataRva, dataOffset)) {
+            return QByteArrayView();
+        }
+        return m_reader.slice(dataOffset, dataSize);
+    }
+
+private:
+    bool rvaToOffset(quint32 rva, quint64 &offset) const
+    {
+        for (quint16 i = 0; i < m_sectionCount; ++i) {
+            const quint64 section = m_sectionTable + quint64(i) * 40;
+            quint32 virtualAddress;
+            quint32 rawSize;
+            quint32 rawPointer;
+            if (!m_reader.u32(section + 12, virtualAddress) || !m_reader.u32(section + 16, rawSize) || !m_reader.u32(section + 20, rawPointer)) {
+                return false;
+            }
+            if (rva >= virtualAddress && rva - virtualAddress < rawSize) {
+                offset = quint64(rawPointer) + (rva - virtualAddress);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool findEntry(quint32 directory, std::optional<quint16> id, quint32 &target) const
+    {
+        const quint64 directoryOffset = m_resourceBase + directory;
+        quint16 namedEntries;
+        quint16 idEntries;
+        if (!m_reader.u16(directoryOffset + 12, namedEntries) || !m_reader.u16(directoryOffset + 14, idEntries)) {
+            return false;
+        }
+
+        const int entryCount = namedEntries + idEntries;
+        for (int i = 0; i < entryCount; ++i) {
+            const quint64 entry = directoryOffset + 16 + quint64(i) * 8;
+            quint32 name;
+            if (!m_reader.u32(entry, name) || !m_reader.u32(entry + 4, target)) {
+                return false;
+            }
+            if (!id || (!(name & PE_HIGH_BIT) && name == *id)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const Reader &m_reader;
+    quint64 m_sectionTable = 0;
+    quint16 m_sectionCount = 0;
+    quint64 m_resourceBase = 0;
+};
+
+// Resource table of a 16 bit New Executable
+class NeResources
+{
+public:
+    explicit NeResources(const Reader &reader)
+        : m_reader(reader)
+    {
+    }
+
+    bool init(quint32 neOffset)
+    {
+        quint16 resourceTable;
+        quint16 residentNameTable;
+        if (!m_reader.u16(quint64(neOffset) + 0x24, resourceTable) || !m_reader.u16(quint64(neOffset) + 0x26, residentNameTable)) {
+            return false;
+        }
+        // an empty resource table has the same offset as the table following it
+        if (resourceTable == residentNameTable) {
+            return false;
+        }
+        m_resourceTable = quint64(neOffset) + resourceTable;
+        return m_reader.u16(m_resourceTable, m_alignmentShift) && m_alignmentShift < 32;
+    }
+
+    QByteArrayView find(quint16 type, std::optional<quint16> id) const
+    {
+        quint64 typeInfo = m_resourceTable + 2;
+        quint16 typeId;
+        while (m_reader.u16(typeInfo, typeId) && typeId != 0) {
+            quint16 count;
+            if (!m_reader.u16(typeInfo + 2, count)) {
+                break;
+            }
+            if (typeId == (NE_INTEGER_ID | type)) {
+                for (quint16 i = 0; i < count; ++i) {
+                    const quint64 nameInfo = typeInfo + 8 + quint64(i) * 12;
+                    quint16 offset;
+                    quint16 length;
+                    quint16 resourceId;
+                    if (!m_reader.u16(nameInfo, offset) || !m_reader.u16(nameInfo + 2, length) || !m_reader.u16(nameInfo + 6, resourceId)) {
+                        return QByteArrayView();
+                    }
+                    if (!id || resourceId == (NE_INTEGER_ID | *id)) {
+                        return m_reader.slice(quint64(offset) << m_alignmentShift, quint64(length) << m_alignmentShift);
+                    }
+                }
+                return QByteArrayView();
+            }
+            typeInfo += 8 + quint64(count) * 12;
+        }
+        return QByteArrayView();
+    }
+
+private:
+    const Reader &m_reader;
+    quint64 m_resourceTable = 0;
+    quint16 m_alignmentShift = 0;
+};
+
+void appendLittleEndian16(QByteArray &data, quint16 value)
+{
+    char buffer[sizeof(value)];
+    qToLittleEndian(value, buffer);
+    data.append(buffer, sizeof(buffer));
+}
+
+void appendLittleEndian32(QByteArray &data, quint32 value)
+{
+    char buffer[sizeof(value)];
+    qToLittleEndian(value, buffer);
+    data.append(buffer, sizeof(buffer));
+}
+
+// Turns the first RT_GROUP_ICON of @p resources and the RT_ICONs it references into an .ico file
+template<typename Resources>
+bool buildIco(const Resources &resources, QByteArray &icoData)
+{
+    // https://docs.microsoft.com/en-us/windows/win32/menurc/about-icons#icon-display
+    // "Select the RT_GROUP_ICON resource. If more than one such resource exists,
+    // the system uses the first resource listed in the resource scrip."
+    const QByteArrayView group = resources.find(RT_GROUP_ICON, std::nullopt);
+    const Reader groupReader(group);
+
+    // GRPICONDIR is a 6 byte header followed by 14 byte GRPICONDIRENTRY records
+    quint16 type;
+    quint16 count;
+    if (!groupReader.u16(2, type) || type != 1 || !groupReader.u16(4, count) || !groupReader.contains(6, quint64(count) * 14)) {
+        return false;
+    }
+
+    struct Icon {
+        QByteArrayView entry;
+        QByteArrayView image;
+    };
+    QList<Icon> icons;
+    icons.reserve(count);
+    quint64 imagesSize = 0;
+    for (quint16 i = 0; i < count; ++i) {
+        const quint64 entry = 6 + quint64(i) * 14;
+        quint16 id;
+        groupReader.u16(entry + 12, id);
+        const QByteArrayView image = resources.find(RT_ICON, id);
+        if (image.isEmpty()) {
+            continue;
+        }
+        icons.append(Icon{group.sliced(entry, 8), image});
+        imagesSize += image.size();
+    }
+
+    if (icons.isEmpty()) {
+        return false;
+    }
+
+    // ICONDIR is the same header followed by 16 byte ICONDIRENTRY records,
+    // which store the image offset in the file instead of the resource id
+    const quint32 headerSize = 6 + icons.size() * 16;
+    icoData.clear();
+    icoData.reserve(headerSize + imagesSize);
+    appendLittleEndian16(icoData, 0);
+    appendLittleEndian16(icoData, 1);
+    appendLittleEndian16(icoData, icons.size());
+
+    quint32 imageOffset = headerSize;
+    for (const Icon &icon : std::as_const(icons)) {
+        icoData.append(icon.entry);
+        appendLittleEndian32(icoData, icon.image.size());
+        appendLittleEndian32(icoData, imageOffset);
+        imageOffset += icon.image.size();
+    }
+    for (const Icon &icon : std::as_const(icons)) {
+        icoData.append(icon.image);
+    }
+
+    return true;
+}
+}
+
+bool IcoUtils::extractIcoFromExe(QByteArrayView exeData, QByteArray &icoData)
+{
+    const Reader reader(exeData);
+
+    quint16 dosMagic;
+    quint32 headerOffset;
+    if (!reader.u16(0, dosMagic) || dosMagic != 0x5a4d /* MZ */ || !reader.u32(0x3c, headerOffset)) {
+        return false;
+    }
+
+    quint32 peSignature;
+    if (reader.u32(headerOffset, peSignature) && peSignature == 0x00004550 /* PE\0\0 */) {
+        PeResources resources(reader);
+        return resources.init(headerOffset) && buildIco(resources, icoData);
+    }
+
+    quint16 neSignature;
+    if (reader.u16(headerOffset, neSignature) && neSignature == 0x454e /* NE */) {
+        NeResources resources(reader);
+        return resources.init(headerOffset) && buildIco(resources, icoData);
+    }
+
+    return false;
+}
+
+bool IcoUtils::loadIcoImageFromExe(const QString &inputFileName, QIODevice *outputDevice)
+{
+    QFile file(inputFileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // only the headers and the icon resources are touched, so map the file instead of reading it
+    QByteArray contents;
+    QByteArrayView exeData;
+    if (const uchar *map = file.map(0, file.size())) {
+        exeData = QByteArrayView(map, file.size());
+    } else {
+        contents = file.readAll();
+        exeData = contents;
+    }
+
+    QByteArray icoData;
+    if (!IcoUtils::extractIcoFromExe(exeData, icoData)) {
+        return false;
+    }
+
+    return outputDevice->write(icoData) == icoData.size();
+}
@@ -18,7 +18,7 @@
 #include <KPluginFactory>
 
 #if HAVE_KEXIV2
-#include <KExiv2/KExiv2>
+#include "embeddedpreview.h"
 #endif
 
 K_PLUGIN_CLASS_WITH_JSON(JpegCreator, "jpegthumbnail.json")
@@ -31,15 +31,10 @@ JpegCreator::JpegCreator(QObject *parent, const QVariantList &args)
 KIO::ThumbnailResult JpegCreator::exifThumbnail(const KIO::ThumbnailRequest &request) const
 {
 #if HAVE_KEXIV2
-    KExiv2Iface::KExiv2 exiv2Image(request.url().toLocalFile());
-    QImage image = exiv2Image.getExifThumbnail(JpegCreatorSettings::self()->rotate());
-
-    if (image.isNull()) {
-        return KIO::ThumbnailResult::fail();
-    }
-
-    // skip embedded thumbnail if strictly smaller
-    if (image.size().width() < request.targetSize().width() && image.size().height() < request.targetSize().height()) {
+    // considers the EXIF thumbnail and the larger MakerNote previews,
+    // embedded thumbnails strictly smaller than requested are skipped
+    QImage image;
+    if (!EmbeddedPreview::load(request.url().toLocalFile(), request.targetSize(), JpegCreatorSettings::self()->rotate(), image)) {
         return KIO::ThumbnailResult::fail();
     }
 
@@ -56,7 +51,7 @@ KIO::ThumbnailResult JpegCreator::imageReaderThumbnail(const KIO::ThumbnailReque
     const QSize imageSize = imageReader.size();
     if (imageSize.isValid() && (imageSize.width() > request.targetSize().width() || imageSize.height() > request.targetSize().height())) {
         const QSize thumbnailSize = imageSize.scaled(request.targetSize(), Qt::KeepAspectRatio);
-        imageReader.setScaledSize(thumbnailSize); // fast downscaling
+        imageReader.setScaledSize(thumbnailSize); // fast downscaling, libjpeg decodes at 1/2, 1/4 or 1/8 in the DCT domain
     }
     imageReader.setQuality(75); // set quality so that the jpeg handler will use a high quality downscaler
 
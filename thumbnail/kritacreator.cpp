@@ -5,13 +5,12 @@
 */
 
 #include "kritacreator.h"
+#include "memorybudget.h"
+#include "zipreader.h"
 
 #include <KPluginFactory>
-#include <KZip>
 
-#include <QIODevice>
 #include <QImage>
-#include <memory>
 
 K_PLUGIN_CLASS_WITH_JSON(KritaCreator, "kraorathumbnail.json")
 
@@ -29,37 +28,34 @@ KIO::ThumbnailResult KritaCreator::create(const KIO::ThumbnailRequest &request)
     // for now just rely on the rendered data inside the file,
     // do not load Krita code for rendering ourselves, as that currently (2.9)
     // means loading all plugins, resources etc.
-    KZip zip(request.url().toLocalFile());
-    if (!zip.open(QIODevice::ReadOnly)) {
+    ZipReader zip(request.url().toLocalFile());
+    if (!zip.open()) {
         return KIO::ThumbnailResult::fail();
     }
 
     // first check if normal thumbnail is good enough
     // ORA thumbnail?
-    const KArchiveFile *entry = zip.directory()->file(QLatin1String("Thumbnails/thumbnail.png"));
+    auto entry = zip.entry(QStringLiteral("Thumbnails/thumbnail.png"));
     if (!entry) {
         // KRA thumbnail
-        entry = zip.directory()->file(QLatin1String("preview.png"));
+        entry = zip.entry(QStringLiteral("preview.png"));
     }
 
     if (!entry) {
         return KIO::ThumbnailResult::fail();
     }
 
-    std::unique_ptr<QIODevice> fileDevice{entry->createDevice()};
-    QImage image;
-    bool thumbLoaded = image.load(fileDevice.get(), "PNG");
+    const QImage image = MemoryBudget::decode(zip.data(*entry), request.targetSize(), "PNG");
     // The requested size is a boundingbox, so meeting one size is sufficient
-    if (thumbLoaded && ((image.width() >= request.targetSize().width()) || (image.height() >= request.targetSize().height()))) {
+    if (!image.isNull() && ((image.width() >= request.targetSize().width()) || (image.height() >= request.targetSize().height()))) {
         return KIO::ThumbnailResult::pass(image);
     }
 
-    entry = zip.directory()->file(QLatin1String("mergedimage.png"));
+    entry = zip.entry(QStringLiteral("mergedimage.png"));
     if (entry) {
-        QImage thumbnail;
-        fileDevice.reset(entry->createDevice());
-        thumbLoaded = thumbnail.load(fileDevice.get(), "PNG");
-        if (thumbLoaded) {
+        // the merged image is the full size canvas, which may not fit into the memory budget
+        const QImage thumbnail = MemoryBudget::decode(zip.data(*entry), request.targetSize(), "PNG");
+        if (!thumbnail.isNull()) {
             return KIO::ThumbnailResult::pass(thumbnail);
         }
     }
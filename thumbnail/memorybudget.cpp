@@ -0,0 +1,249 @@
+/*  This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2000 Carsten Pfeiffer <pfeiffer@kde.org>
+    SPDX-FileCopyrightText: 2000 Malte Starostik <malte@kde.org>
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "memorybudget.h"
+
+#include <QBuffer>
+#include <QImageReader>
+
+#include <KMemoryInfo>
+
+#include <algorithm>
+#include <atomic>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define MiB(bytes) ((bytes)*1024ll * 1024ll)
+#define GiB(bytes) (MiB(bytes) * 1024ll)
+
+// When the ram check is disabled or not available, this is the expected default value of free RAM
+#define DEFAULT_FREE_RAM GiB(2)
+
+// The maximum usable RAM is the free RAM is divided by this number:
+// if the calculated image size is greater than this value, the preview is skipped.
+#define RAM_DIVISOR 3
+
+// An image smaller than 64 MiB will be loaded even if the usable RAM check fails.
+#define MINIMUM_GUARANTEED_SIZE MiB(64)
+
+namespace
+{
+// One slot per running decode: the owning process and the reserved bytes.
+// Slots of processes that died without releasing them are reclaimed lazily.
+struct Slot {
+    std::atomic<qint32> pid;
+    std::atomic<qint64> bytes;
+};
+
+struct ReservationTable {
+    static constexpr int SlotCount = 64;
+    Slot slots[SlotCount];
+};
+
+static_assert(std::atomic<qint32>::is_always_lock_free && std::atomic<qint64>::is_always_lock_free,
+              "the reservation table is shared between processes and must not contain locks");
+
+ReservationTable *reservationTable()
+{
+    static ReservationTable *const table = []() -> ReservationTable * {
+#ifdef Q_OS_UNIX
+        // Shared by all thumbnail workers of this user, zero initialized on creation
+        const QByteArray name = "/kio_thumbnail_budget_" + QByteArray::number(getuid());
+        const int fd = shm_open(name.constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd >= 0) {
+            void *address = MAP_FAILED;
+            if (ftruncate(fd, sizeof(ReservationTable)) == 0) {
+                address = mmap(nullptr, sizeof(ReservationTable), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            close(fd);
+            if (address != MAP_FAILED) {
+                return static_cast<ReservationTable *>(address);
+            }
+        }
+#endif
+        // fall back to only accounting for the decodes of this process
+        static ReservationTable localTable;
+        return &localTable;
+    }();
+    return table;
+}
+
+qint32 currentPid()
+{
+#ifdef Q_OS_UNIX
+    return getpid();
+#else
+    return 1;
+#endif
+}
+
+bool isAlive(qint32 pid)
+{
+#ifdef Q_OS_UNIX
+    return kill(pid, 0) == 0 || errno == EPERM;
+#else
+    Q_UNUSED(pid)
+    return true;
+#endif
+}
+
+qint64 reservedBytes()
+{
+    qint64 reserved = 0;
+    for (Slot &slot : reservationTable()->slots) {
+        // the bytes first, they are what claimSlot() publishes last
+        const qint64 bytes = slot.bytes.load(std::memory_order_seq_cst);
+        qint32 pid = slot.pid.load(std::memory_order_acquire);
+        if (bytes == 0 || pid == 0) {
+            continue;
+        }
+        if (!isAlive(pid)) {
+            slot.pid.compare_exchange_strong(pid, 0, std::memory_order_acq_rel);
+            continue;
+        }
+        reserved += bytes;
+    }
+    return reserved;
+}
+
+int claimSlot(qint64 bytes)
+{
+    const qint32 pid = currentPid();
+    ReservationTable *table = reservationTable();
+    for (int i = 0; i < ReservationTable::SlotCount; ++i) {
+        Slot &slot = table->slots[i];
+        qint32 expected = 0;
+        if (slot.pid.compare_exchange_strong(expected, pid, std::memory_order_acq_rel)) {
+            // sequentially consistent with the loads in reservedBytes(), see Reservation
+            slot.bytes.store(bytes, std::memory_order_seq_cst);
+            return i;
+        }
+    }
+    return -1;
+}
+
+void releaseSlot(int index)
+{
+    Slot &slot = reservationTable()->slots[index];
+    slot.bytes.store(0, std::memory_order_relaxed);
+    slot.pid.store(0, std::memory_order_release);
+}
+}
+
+namespace MemoryBudget
+{
+
+qint64 maximumThumbnailRam()
+{
+    // read available RAM (physical free ram only)
+    auto freeRam = DEFAULT_FREE_RAM;
+
+    KMemoryInfo m;
+    if (!m.isNull()) {
+        freeRam = qint64(m.availablePhysical());
+    }
+
+    /*
+     * NOTE 1: a minimal 64MiB image is always guaranteed (this small size should never cause OS thrashing).
+     * NOTE 2: the freeRam is divided by 3 for the following reasons:
+     *         - the image could be converted (e.g. when depth() != 32)
+     *         - we don't want to use all free ram for a thumbnail :)
+     */
+    return std::max(MINIMUM_GUARANTEED_SIZE, freeRam / RAM_DIVISOR);
+}
+
+qint64 imageBytes(QSize size, QImage::Format format)
+{
+    if (!size.isValid()) {
+        return 0;
+    }
+    const int bitsPerPixel = format != QImage::Format_Invalid ? QImage::toPixelFormat(format).bitsPerPixel() : 32;
+    return qint64(size.width()) * size.height() * std::max(bitsPerPixel, 8) / 8;
+}
+
+Reservation::Reservation(qint64 bytes)
+{
+    if (bytes <= 0) {
+        // nothing to reserve, the budget bounds decodes of an unknown size
+        m_budget = maximumThumbnailRam() - reservedBytes();
+        m_valid = true;
+        return;
+    }
+
+    // Claiming first means that of two decodes starting at once, at least one
+    // sees the other's reservation, so they cannot both take the same budget.
+    m_slot = claimSlot(bytes);
+    if (m_slot < 0) {
+        return;
+    }
+    m_budget = maximumThumbnailRam() - (reservedBytes() - bytes);
+    m_valid = bytes <= MINIMUM_GUARANTEED_SIZE || bytes <= m_budget;
+    if (!m_valid) {
+        releaseSlot(m_slot);
+        m_slot = -1;
+    }
+}
+
+Reservation::~Reservation()
+{
+    if (m_slot >= 0) {
+        releaseSlot(m_slot);
+    }
+}
+
+bool Reservation::isValid() const
+{
+    return m_valid;
+}
+
+qint64 Reservation::budget() const
+{
+    return std::max<qint64>(0, m_budget);
+}
+
+bool read(QImageReader &reader, QSize targetSize, QImage &image)
+{
+    QSize size = reader.scaledSize();
+    if (!size.isValid()) {
+        size = reader.size();
+        if (size.isValid() && targetSize.isValid() && reader.supportsOption(QImageIOHandler::ScaledSize)
+            && (size.width() > targetSize.width() || size.height() > targetSize.height())) {
+            size = size.scaled(targetSize, Qt::KeepAspectRatio);
+            reader.setScaledSize(size);
+        }
+    }
+
+    const Reservation reservation(imageBytes(size, reader.imageFormat()));
+    if (!reservation.isValid()) {
+        return false;
+    }
+
+    // handlers that don't know the size up front are stopped by the allocation limit
+    QImageReader::setAllocationLimit(int(std::max(reservation.budget(), MINIMUM_GUARANTEED_SIZE) / MiB(1)));
+    return reader.read(&image);
+}
+
+QImage decode(const QByteArray &data, QSize targetSize, const char *format)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+
+    QImageReader reader(&buffer, format);
+    QImage image;
+    read(reader, targetSize, image);
+    return image;
+}
+
+}
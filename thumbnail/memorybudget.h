@@ -0,0 +1,82 @@
+/*  This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <QImage>
+#include <QSize>
+
+class QImageReader;
+
+/**
+ * The memory all thumbnail creators may use for decoding.
+ *
+ * The budget is a third of the available physical memory, minus what other
+ * decodes currently have reserved. Reservations are shared between all
+ * thumbnail workers of the user, so that several workers each decoding a
+ * huge image at once cannot push the system into swap.
+ */
+namespace MemoryBudget
+{
+
+/**
+ * Calculates the maximum RAM that can be used to generate a thumbnail,
+ * before taking reservations of concurrent decodes into account.
+ */
+qint64 maximumThumbnailRam();
+
+/**
+ * Returns the memory needed for an image of @p size in @p format.
+ */
+qint64 imageBytes(QSize size, QImage::Format format = QImage::Format_ARGB32);
+
+/**
+ * Reserves memory for a decode for as long as the object lives.
+ *
+ * A reservation is invalid if the memory does not fit into the budget left
+ * by other decodes, or if too many decodes are running to account for another
+ * one; the caller should then use a cheaper way to decode or give up.
+ */
+class Reservation
+{
+public:
+    explicit Reservation(qint64 bytes);
+    ~Reservation();
+
+    Reservation(const Reservation &) = delete;
+    Reservation &operator=(const Reservation &) = delete;
+
+    bool isValid() const;
+
+    /**
+     * The budget that was left for this decode, in bytes.
+     */
+    qint64 budget() const;
+
+private:
+    int m_slot = -1;
+    qint64 m_budget = 0;
+    bool m_valid = false;
+};
+
+/**
+ * Reads @p reader into @p image within the budget.
+ *
+ * If the handler supports QImageIOHandler::ScaledSize and no scaled size was set
+ * yet, the image is decoded straight at @p targetSize. Images whose size is unknown
+ * up front are bounded by QImageReader::setAllocationLimit().
+ */
+bool read(QImageReader &reader, QSize targetSize, QImage &image);
+
+/**
+ * Convenience overload decoding the encoded image @p data.
+ */
+QImage decode(const QByteArray &data, QSize targetSize, const char *format = nullptr);
+
+}
+
+#endif // MEMORY_BUDGET_H
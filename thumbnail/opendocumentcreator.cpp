@@ -5,13 +5,13 @@
  */
 
 #include "opendocumentcreator.h"
+#include "memorybudget.h"
+#include "zipreader.h"
 
 #include <QImage>
-#include <QScopedPointer>
 #include <QXmlStreamReader>
 
 #include <KPluginFactory>
-#include <KZip>
 
 K_PLUGIN_CLASS_WITH_JSON(OpenDocumentCreator, "opendocumentthumbnail.json")
 
@@ -24,32 +24,25 @@ OpenDocumentCreator::~OpenDocumentCreator() = default;
 
 KIO::ThumbnailResult OpenDocumentCreator::create(const KIO::ThumbnailRequest &request)
 {
-    KZip zip(request.url().toLocalFile());
-    if (!zip.open(QIODevice::ReadOnly)) {
+    ZipReader zip(request.url().toLocalFile());
+    if (!zip.open()) {
         return KIO::ThumbnailResult::fail();
     }
 
     // Open Document
-    const KArchiveEntry *entry = zip.directory()->entry(QStringLiteral("Thumbnails/thumbnail.png"));
-
-    if (entry && entry->isFile()) {
-        const KZipFileEntry *zipFileEntry = static_cast<const KZipFileEntry *>(entry);
-        QImage image;
-        if (image.loadFromData(zipFileEntry->data(), "PNG")) {
+    if (const auto entry = zip.entry(QStringLiteral("Thumbnails/thumbnail.png"))) {
+        const QImage image = MemoryBudget::decode(zip.data(*entry), request.targetSize(), "PNG");
+        if (!image.isNull()) {
             return KIO::ThumbnailResult::pass(image);
         }
     }
 
     // Open Packaging Conventions (e.g. Office "Open" XML)
-    const KArchiveEntry *relsEntry = zip.directory()->entry(QStringLiteral("_rels/.rels"));
-    if (relsEntry && relsEntry->isFile()) {
-        const auto *relsFileEntry = static_cast<const KZipFileEntry *>(relsEntry);
-
-        QScopedPointer<QIODevice> relsDevice(relsFileEntry->createDevice());
-
+    const QByteArray relsData = zip.data(QStringLiteral("_rels/.rels"));
+    if (!relsData.isEmpty()) {
         QString thumbnailPath;
 
-        QXmlStreamReader xml(relsDevice.data());
+        QXmlStreamReader xml(relsData);
         while (!xml.atEnd() && !xml.hasError()) {
             xml.readNext();
             if (xml.isStartElement() && xml.name() == QLatin1String("Relationship")) {
@@ -63,11 +56,8 @@ KIO::ThumbnailResult OpenDocumentCreator::create(const KIO::ThumbnailRequest &re
         }
 
         if (!thumbnailPath.isEmpty()) {
-            const auto *thumbnailEntry = zip.directory()->entry(thumbnailPath);
-            if (thumbnailEntry && thumbnailEntry->isFile()) {
-                QImage image;
-                image.loadFromData(static_cast<const KZipFileEntry *>(thumbnailEntry)->data());
-                return KIO::ThumbnailResult::pass(image);
+            if (const auto thumbnailEntry = zip.entry(thumbnailPath)) {
+                return KIO::ThumbnailResult::pass(MemoryBudget::decode(zip.data(*thumbnailEntry), request.targetSize()));
             }
         }
     }
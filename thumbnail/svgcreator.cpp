@@ -5,15 +5,310 @@
 */
 
 #include "svgcreator.h"
+#include "memorybudget.h"
 
+#include <QDeadlineTimer>
+#include <QFile>
 #include <QImage>
+#include <QPaintEngine>
 #include <QPainter>
 #include <QSvgRenderer>
+#include <QXmlStreamReader>
 
+#include <KCompressionDevice>
+#include <KConfigGroup>
 #include <KPluginFactory>
+#include <KSharedConfig>
+
+#include <algorithm>
 
 K_PLUGIN_CLASS_WITH_JSON(SvgCreator, "svgthumbnail.json")
 
+namespace
+{
+// Upper bound for the uncompressed size of .svgz files
+constexpr qint64 s_maxUncompressedSize = 256 * 1024 * 1024;
+
+// QtSvg draws nested groups recursively, don't let a crafted file exhaust the stack
+constexpr int s_maxDepth = 256;
+
+struct SvgComplexity {
+    qint64 elements = 0;
+    qint64 filterPrimitives = 0;
+    int depth = 0;
+};
+
+// Streams through the document and stops as soon as the element budget is exceeded,
+// so that the cost of the check is bounded as well
+SvgComplexity measureComplexity(const QByteArray &data, qint64 maxElements)
+{
+    SvgComplexity complexity;
+    QXmlStreamReader xml(data);
+    int depth = 0;
+    int filterDepth = 0;
+    while (!xml.atEnd() && complexity.elements <= maxElements && complexity.depth <= s_maxDepth) {
+        switch (xml.readNext()) {
+        case QXmlStreamReader::StartElement:
+            ++complexity.elements;
+            complexity.depth = std::max(complexity.depth, ++depth);
+            if (filterDepth) {
+                ++complexity.filterPrimitives;
+            } else if (xml.name() == QLatin1String("filter")) {
+                filterDepth = depth;
+            }
+            break;
+        case QXmlStreamReader::EndElement:
+            if (depth == filterDepth) {
+                filterDepth = 0;
+            }
+            --depth;
+            break;
+        default:
+            break;
+        }
+    }
+    return complexity;
+}
+
+QByteArray readSvg(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    if (file.peek(2) != QByteArrayLiteral("\x1f\x8b")) {
+        // rejected before reading it, like a compressed one larger than the limit
+        return file.size() <= s_maxUncompressedSize ? file.readAll() : QByteArray();
+    }
+
+    KCompressionDevice device(&file, false, KCompressionDevice::GZip);
+    if (!device.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    const QByteArray data = device.read(s_maxUncompressedSize + 1);
+    return data.size() <= s_maxUncompressedSize ? data : QByteArray();
+}
+
+// Forwards what QSvgRenderer paints to a QPainter on the thumbnail image until the
+// deadline has passed. All later drawing commands are dropped, so the renderer runs
+// through the rest of the document without rasterizing anything.
+class DeadlinePaintEngine : public QPaintEngine
+{
+public:
+    DeadlinePaintEngine(QImage *image, QDeadlineTimer deadline)
+        : QPaintEngine(QPaintEngine::AllFeatures)
+        , m_image(image)
+        , m_deadline(deadline)
+    {
+    }
+
+    bool hasExpired() const
+    {
+        if (!m_expired && m_deadline.hasExpired()) {
+            m_expired = true;
+        }
+        return m_expired;
+    }
+
+    bool begin(QPaintDevice *) override
+    {
+        return m_painter.begin(m_image);
+    }
+
+    bool end() override
+    {
+        return m_painter.end();
+    }
+
+    Type type() const override
+    {
+        return QPaintEngine::User;
+    }
+
+    void updateState(const QPaintEngineState &state) override
+    {
+        const DirtyFlags flags = state.state();
+        // the transform has to be in place before a clip given in logical coordinates
+        if (flags & DirtyTransform) {
+            m_painter.setTransform(state.transform());
+        }
+        if (flags & DirtyPen) {
+            m_painter.setPen(state.pen());
+        }
+        if (flags & DirtyBrush) {
+            m_painter.setBrush(state.brush());
+        }
+        if (flags & DirtyBrushOrigin) {
+            m_painter.setBrushOrigin(state.brushOrigin());
+        }
+        if (flags & DirtyFont) {
+            m_painter.setFont(state.font());
+        }
+        if (flags & DirtyBackground) {
+            m_painter.setBackground(state.backgroundBrush());
+        }
+        if (flags & DirtyBackgroundMode) {
+            m_painter.setBackgroundMode(state.backgroundMode());
+        }
+        if (flags & DirtyHints) {
+            m_painter.setRenderHints(state.renderHints());
+        }
+        if (flags & DirtyCompositionMode) {
+            m_painter.setCompositionMode(state.compositionMode());
+        }
+        if (flags & DirtyOpacity) {
+            m_painter.setOpacity(state.opacity());
+        }
+        if (flags & DirtyClipRegion) {
+            m_painter.setClipRegion(state.clipRegion(), state.clipOperation());
+        }
+        if (flags & DirtyClipPath) {
+            m_painter.setClipPath(state.clipPath(), state.clipOperation());
+        }
+        if (flags & DirtyClipEnabled) {
+            m_painter.setClipping(state.isClipEnabled());
+        }
+    }
+
+    void drawPath(const QPainterPath &path) override
+    {
+        if (!hasExpired()) {
+            m_painter.drawPath(path);
+        }
+    }
+
+    void drawPolygon(const QPointF *points, int pointCount, PolygonDrawMode mode) override
+    {
+        if (hasExpired()) {
+            return;
+        }
+        switch (mode) {
+        case PolylineMode:
+            m_painter.drawPolyline(points, pointCount);
+            break;
+        case WindingMode:
+            m_painter.drawPolygon(points, pointCount, Qt::WindingFill);
+            break;
+        default:
+            m_painter.drawPolygon(points, pointCount, Qt::OddEvenFill);
+            break;
+        }
+    }
+
+    void drawRects(const QRectF *rects, int rectCount) override
+    {
+        if (!hasExpired()) {
+            m_painter.drawRects(rects, rectCount);
+        }
+    }
+
+    void drawLines(const QLineF *lines, int lineCount) override
+    {
+        if (!hasExpired()) {
+            m_painter.drawLines(lines, lineCount);
+        }
+    }
+
+    void drawEllipse(const QRectF &rect) override
+    {
+        if (!hasExpired()) {
+            m_painter.drawEllipse(rect);
+        }
+    }
+
+    void drawPoints(const QPointF *points, int pointCount) override
+    {
+        if (!hasExpired()) {
+            m_painter.drawPoints(points, pointCount);
+        }
+    }
+
+    void drawPixmap(const QRectF &rect, const QPixmap &pixmap, const QRectF &sourceRect) override
+    {
+        if (!hasExpired()) {
+            m_painter.drawPixmap(rect, pixmap, sourceRect);
+        }
+    }
+
+    void drawTiledPixmap(const QRectF &rect, const QPixmap &pixmap, const QPointF &offset) override
+    {
+        if (!hasExpired()) {
+            m_painter.drawTiledPixmap(rect, pixmap, offset);
+        }
+    }
+
+    void drawImage(const QRectF &rect, const QImage &image, const QRectF &sourceRect, Qt::ImageConversionFlags flags) override
+    {
+        if (!hasExpired()) {
+            m_painter.drawImage(rect, image, sourceRect, flags);
+        }
+    }
+
+private:
+    QImage *const m_image;
+    const QDeadlineTimer m_deadline;
+    QPainter m_painter;
+    mutable bool m_expired = false;
+};
+
+class DeadlinePaintDevice : public QPaintDevice
+{
+public:
+    DeadlinePaintDevice(QImage *image, QDeadlineTimer deadline)
+        : m_image(image)
+        , m_engine(image, deadline)
+    {
+    }
+
+    QPaintEngine *paintEngine() const override
+    {
+        return &m_engine;
+    }
+
+    bool hasExpired() const
+    {
+        return m_engine.hasExpired();
+    }
+
+protected:
+    int metric(PaintDeviceMetric metric) const override
+    {
+        switch (metric) {
+        case PdmWidth:
+            return m_image->width();
+        case PdmHeight:
+            return m_image->height();
+        case PdmWidthMM:
+            return m_image->widthMM();
+        case PdmHeightMM:
+            return m_image->heightMM();
+        case PdmNumColors:
+            return m_image->colorCount();
+        case PdmDepth:
+            return m_image->depth();
+        case PdmDpiX:
+            return m_image->logicalDpiX();
+        case PdmDpiY:
+            return m_image->logicalDpiY();
+        case PdmPhysicalDpiX:
+            return m_image->physicalDpiX();
+        case PdmPhysicalDpiY:
+            return m_image->physicalDpiY();
+        case PdmDevicePixelRatio:
+            return int(m_image->devicePixelRatio());
+        case PdmDevicePixelRatioScaled:
+            return int(m_image->devicePixelRatio() * devicePixelRatioFScale());
+        default:
+            return QPaintDevice::metric(metric);
+        }
+    }
+
+private:
+    QImage *const m_image;
+    mutable DeadlinePaintEngine m_engine;
+};
+}
+
 SvgCreator::SvgCreator(QObject *parent, const QVariantList &args)
     : KIO::ThumbnailCreator(parent, args)
 {
@@ -21,8 +316,32 @@ SvgCreator::SvgCreator(QObject *parent, const QVariantList &args)
 
 KIO::ThumbnailResult SvgCreator::create(const KIO::ThumbnailRequest &request)
 {
-    QSvgRenderer r(request.url().toLocalFile());
-    if (!r.isValid())
+    const KConfigGroup config(KSharedConfig::openConfig(), QStringLiteral("PreviewSettings"));
+    const qint64 maxElements = config.readEntry("MaximumSvgElements", 250000);
+    const qint64 maxFilterPrimitives = config.readEntry("MaximumSvgFilterPrimitives", 64);
+    const int renderTimeout = config.readEntry("SvgRenderTimeout", 5000);
+
+    const QByteArray data = readSvg(request.url().toLocalFile());
+    if (data.isEmpty()) {
+        return KIO::ThumbnailResult::fail();
+    }
+
+    // check the cost before QSvgRenderer builds its DOM for the whole file
+    const SvgComplexity complexity = measureComplexity(data, maxElements);
+    if (complexity.elements > maxElements || complexity.depth > s_maxDepth) {
+        return KIO::ThumbnailResult::fail();
+    }
+
+    QSvgRenderer r;
+    if (complexity.filterPrimitives > maxFilterPrimitives) {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+        // render a simplified version without filters, masks and the like
+        r.setOptions(QtSvg::Tiny12FeaturesOnly);
+#else
+        return KIO::ThumbnailResult::fail();
+#endif
+    }
+    if (!r.load(data) || !r.isValid())
         return KIO::ThumbnailResult::fail();
 
     // render using the correct ratio
@@ -43,10 +362,22 @@ KIO::ThumbnailResult SvgCreator::create(const KIO::ThumbnailRequest &request)
     else
         width = qRound(height / ratio);
 
+    const MemoryBudget::Reservation reservation(MemoryBudget::imageBytes(QSize(width, height), QImage::Format_ARGB32_Premultiplied));
+    if (!reservation.isValid()) {
+        return KIO::ThumbnailResult::fail();
+    }
+
     QImage i(width, height, QImage::Format_ARGB32_Premultiplied);
     i.fill(0);
-    QPainter p(&i);
+    DeadlinePaintDevice device(&i, QDeadlineTimer(renderTimeout));
+    QPainter p(&device);
     r.render(&p, QRectF(QPointF(0, 0), QSizeF(width, height)));
+    p.end();
+
+    // a partially rendered image would end up in the thumbnail cache
+    if (device.hasExpired()) {
+        return KIO::ThumbnailResult::fail();
+    }
 
     return KIO::ThumbnailResult::pass(i);
 }
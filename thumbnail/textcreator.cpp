@@ -8,24 +8,80 @@
 #include "textcreator.h"
 
 #include <QFile>
+#include <QFileInfo>
 #include <QFontDatabase>
 #include <QImage>
 #include <QPainter>
-#include <QPalette>
 #include <QStringDecoder>
-#include <QTextDocument>
+#include <QTextLayout>
 
 #include <KDesktopFile>
 #include <KPluginFactory>
-#include <KSyntaxHighlighting/Definition>
-#include <KSyntaxHighlighting/SyntaxHighlighter>
+#include <KSyntaxHighlighting/AbstractHighlighter>
+#include <KSyntaxHighlighting/Format>
+#include <KSyntaxHighlighting/State>
 #include <KSyntaxHighlighting/Theme>
 
+#include <algorithm>
+
 // TODO Fix or remove kencodingprober code
 // #include <kencodingprober.h>
 
 K_PLUGIN_CLASS_WITH_JSON(TextCreator, "textthumbnail.json")
 
+/**
+ * Highlights one line at a time and hands out the formats for a QTextLayout,
+ * so only the lines that end up in the thumbnail are ever highlighted.
+ */
+class LineHighlighter : public KSyntaxHighlighting::AbstractHighlighter
+{
+public:
+    void reset()
+    {
+        m_state = KSyntaxHighlighting::State();
+    }
+
+    QList<QTextLayout::FormatRange> highlight(QStringView line)
+    {
+        m_formats.clear();
+        m_state = highlightLine(line, m_state);
+        return m_formats;
+    }
+
+protected:
+    void applyFormat(int offset, int length, const KSyntaxHighlighting::Format &format) override
+    {
+        if (length == 0 || format.isDefaultTextStyle(theme())) {
+            return;
+        }
+
+        QTextCharFormat charFormat;
+        if (format.hasTextColor(theme())) {
+            charFormat.setForeground(format.textColor(theme()));
+        }
+        if (format.hasBackgroundColor(theme())) {
+            charFormat.setBackground(format.backgroundColor(theme()));
+        }
+        if (format.isBold(theme())) {
+            charFormat.setFontWeight(QFont::Bold);
+        }
+        if (format.isItalic(theme())) {
+            charFormat.setFontItalic(true);
+        }
+        if (format.isUnderline(theme())) {
+            charFormat.setFontUnderline(true);
+        }
+        if (format.isStrikeThrough(theme())) {
+            charFormat.setFontStrikeOut(true);
+        }
+        m_formats.append({offset, length, charFormat});
+    }
+
+private:
+    KSyntaxHighlighting::State m_state;
+    QList<QTextLayout::FormatRange> m_formats;
+};
+
 TextCreator::TextCreator(QObject *parent, const QVariantList &args)
     : KIO::ThumbnailCreator(parent, args)
     , m_data(nullptr)
@@ -38,6 +94,49 @@ TextCreator::~TextCreator()
     delete[] m_data;
 }
 
+// Whether @p pattern is "*.<suffix>", like "*.cpp" but not "*.tar.gz" or "*.[ch]"
+static bool isSuffixPattern(const QString &pattern)
+{
+    if (pattern.size() <= 2 || !pattern.startsWith(QLatin1String("*."))) {
+        return false;
+    }
+    return std::none_of(pattern.cbegin() + 2, pattern.cend(), [](QChar c) {
+        return c == QLatin1Char('.') || c == QLatin1Char('*') || c == QLatin1Char('?') || c == QLatin1Char('[');
+    });
+}
+
+KSyntaxHighlighting::Definition TextCreator::definitionForFile(const QString &path)
+{
+    // Matching the file name against the patterns of all definitions is expensive,
+    // so resolve each suffix only once. Files matched by their whole name
+    // (CMakeLists.txt, .bashrc, PKGBUILD, ...) and files without suffix are
+    // looked up by name.
+    if (m_namePatterns.pattern().isEmpty()) {
+        QStringList patterns;
+        const auto definitions = m_highlightingRepository.definitions();
+        for (const KSyntaxHighlighting::Definition &definition : definitions) {
+            const QStringList extensions = definition.extensions();
+            for (const QString &pattern : extensions) {
+                if (!isSuffixPattern(pattern)) {
+                    patterns.append(QRegularExpression::wildcardToRegularExpression(pattern, QRegularExpression::UnanchoredWildcardConversion));
+                }
+            }
+        }
+        m_namePatterns.setPattern(QStringLiteral("^(?:%1)$").arg(patterns.join(QLatin1Char('|'))));
+    }
+
+    const QFileInfo info(path);
+    const QString fileName = info.fileName();
+    const bool byName = info.suffix().isEmpty() || m_namePatterns.match(fileName).hasMatch();
+    const QString key = byName ? fileName : QStringLiteral("thumbnail.") + info.suffix();
+
+    auto it = m_definitions.constFind(key);
+    if (it == m_definitions.constEnd()) {
+        it = m_definitions.insert(key, m_highlightingRepository.definitionForFileName(key));
+    }
+    return *it;
+}
+
 static QStringDecoder codecFromContent(const char *data, int dataSize)
 {
 #if 0 // ### Use this when KEncodingProber does not return junk encoding for UTF-8 data)
@@ -125,34 +224,57 @@ KIO::ThumbnailResult TextCreator::create(const KIO::ThumbnailRequest &request)
                 }
             }
 
+            if (!m_highlighter) {
+                m_highlighter = std::make_unique<LineHighlighter>();
+                m_highlighter->setTheme(m_highlightingRepository.defaultTheme(KSyntaxHighlighting::Repository::LightTheme));
+            }
+            m_highlighter->setDefinition(definitionForFile(path));
+            m_highlighter->reset();
+
             QColor bgColor = QColor(245, 245, 245); // light-grey background
             m_pixmap.fill(bgColor);
 
             QPainter painter(&m_pixmap);
-
-            QTextDocument textDocument(text);
-
-            // QTextDocument only supports one margin value for all borders,
-            // so we do a page-in-page behind its back, and do our own borders
-            textDocument.setDocumentMargin(0);
-            textDocument.setPageSize(canvasSize);
-            textDocument.setDefaultFont(font);
+            painter.setPen(QColor::fromRgba(m_highlighter->theme().textColor(KSyntaxHighlighting::Theme::Normal)));
 
             QTextOption textOption(Qt::AlignTop | Qt::AlignLeft);
-            textOption.setTabStopDistance(8 * painter.fontMetrics().horizontalAdvance(QLatin1Char(' ')));
+            textOption.setTabStopDistance(8 * QFontMetricsF(font).horizontalAdvance(QLatin1Char(' ')));
             textOption.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
-            textDocument.setDefaultTextOption(textOption);
-
-            KSyntaxHighlighting::SyntaxHighlighter syntaxHighlighter;
-            syntaxHighlighter.setDefinition(m_highlightingRepository.definitionForFileName(path));
-            const auto highlightingTheme = m_highlightingRepository.defaultTheme(KSyntaxHighlighting::Repository::LightTheme);
-            syntaxHighlighter.setTheme(highlightingTheme);
-            syntaxHighlighter.setDocument(&textDocument);
-            syntaxHighlighter.rehighlight();
 
             // draw page-in-page, with clipping as needed
             painter.translate(xborder, yborder);
-            textDocument.drawContents(&painter, QRectF(QPointF(0, 0), canvasSize));
+            painter.setClipRect(QRectF(QPointF(0, 0), canvasSize));
+
+            // Lay out and highlight line by line, and stop as soon as the canvas is full
+            qreal y = 0;
+            for (auto line : textLines) {
+                if (y >= canvasSize.height()) {
+                    break;
+                }
+                if (line.endsWith(QLatin1Char('\r'))) {
+                    line.chop(1);
+                }
+
+                QTextLayout layout(line.toString(), font, &m_pixmap);
+                layout.setTextOption(textOption);
+                layout.setFormats(m_highlighter->highlight(line));
+
+                qreal height = 0;
+                layout.beginLayout();
+                while (y + height < canvasSize.height()) {
+                    QTextLine textLine = layout.createLine();
+                    if (!textLine.isValid()) {
+                        break;
+                    }
+                    textLine.setLineWidth(canvasSize.width());
+                    textLine.setPosition(QPointF(0, height));
+                    height += textLine.height();
+                }
+                layout.endLayout();
+
+                layout.draw(&painter, QPointF(0, y));
+                y += height;
+            }
 
             painter.end();
 
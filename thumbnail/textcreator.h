@@ -8,9 +8,16 @@
 #define _TEXTCREATOR_H_
 
 #include <KIO/ThumbnailCreator>
+#include <KSyntaxHighlighting/Definition>
 #include <KSyntaxHighlighting/Repository>
 
+#include <QHash>
 #include <QPixmap>
+#include <QRegularExpression>
+
+#include <memory>
+
+class LineHighlighter;
 
 class TextCreator : public KIO::ThumbnailCreator
 {
@@ -21,11 +28,18 @@ public:
     KIO::ThumbnailResult create(const KIO::ThumbnailRequest &request) override;
 
 private:
+    KSyntaxHighlighting::Definition definitionForFile(const QString &path);
+
     char *m_data;
     int m_dataSize;
     QPixmap m_pixmap;
 
     KSyntaxHighlighting::Repository m_highlightingRepository;
+    // kept across calls, looking up definitions and themes is not free
+    std::unique_ptr<LineHighlighter> m_highlighter;
+    QHash<QString, KSyntaxHighlighting::Definition> m_definitions;
+    // the file name patterns that are not just a suffix, built on first use
+    QRegularExpression m_namePatterns;
 };
 
 #endif
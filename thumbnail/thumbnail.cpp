@@ -77,6 +77,11 @@
 
 using namespace KIO;
 
+#ifndef Q_OS_WIN
+// Seconds without a request after which the shared memory segment is detached
+static const int s_sharedMemoryIdleTimeout = 10;
+#endif
+
 // Pseudo plugin class to embed meta data
 class KIOPluginForMetaData : public QObject
 {
@@ -129,6 +134,75 @@ ThumbnailProtocol::ThumbnailProtocol(const QByteArray &pool, const QByteArray &a
 ThumbnailProtocol::~ThumbnailProtocol()
 {
     qDeleteAll(m_creators);
+#ifndef Q_OS_WIN
+    detachSharedMemory();
+#endif
+}
+
+#ifndef Q_OS_WIN
+void ThumbnailProtocol::detachSharedMemory()
+{
+    if (m_shmAddress) {
+        shmdt(m_shmAddress);
+    }
+    m_shmAddress = nullptr;
+    m_shmId = -1;
+}
+
+ThumbnailProtocol::SharedMemoryResult ThumbnailProtocol::writeToSharedMemory(int shmid, const QImage &img)
+{
+    // PreviewJob allocates one segment per job and passes the same id for
+    // every item, so keep it attached across requests instead of paying for
+    // an shmat()/shmdt() pair per thumbnail.
+    struct shmid_ds shmStat;
+    const bool statOk = shmctl(shmid, IPC_STAT, &shmStat) != -1;
+
+    if (m_shmAddress && (m_shmId != shmid || !statOk)) {
+        detachSharedMemory();
+    }
+    if (!statOk) {
+        return SharedMemoryNotAttached;
+    }
+
+    if (!m_shmAddress) {
+        void *shmaddr = shmat(shmid, nullptr, 0);
+        if (shmaddr == (void *)-1) {
+            return SharedMemoryNotAttached;
+        }
+        m_shmAddress = shmaddr;
+        m_shmId = shmid;
+    }
+
+    if (shmStat.shm_segsz < size_t(img.sizeInBytes())) {
+        detachSharedMemory();
+        return SharedMemoryTooSmall;
+    }
+
+    memcpy(m_shmAddress, img.constBits(), img.sizeInBytes());
+
+#ifdef SHM_DEST
+    // The owner already removed the segment, it only lives on through our
+    // attachment, so let it go once this last image has been written.
+    if (shmStat.shm_perm.mode & SHM_DEST) {
+        detachSharedMemory();
+        return SharedMemoryWritten;
+    }
+#endif
+    // Nothing tells the worker that the job is over, so the segment would stay
+    // attached, and alive, for as long as the idle worker. special() lets it go
+    // unless another request comes first.
+    setTimeoutSpecialCommand(s_sharedMemoryIdleTimeout);
+    return SharedMemoryWritten;
+}
+#endif
+
+KIO::WorkerResult ThumbnailProtocol::special(const QByteArray &data)
+{
+    Q_UNUSED(data)
+#ifndef Q_OS_WIN
+    detachSharedMemory();
+#endif
+    return KIO::WorkerResult::pass();
 }
 
 /**
@@ -266,7 +340,7 @@ KIO::WorkerResult ThumbnailProtocol::get(const QUrl &url)
         // images using indexed color format, are not loaded properly by QImage ctor using in shm code path
         // convert the format to regular RGB
         // Also limit the bits per pixel to 32 since PreviewJob only allocates as much shared memory
-        img = img.convertToFormat(img.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+        img.convertTo(img.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
     }
 
     if (direct) {
@@ -286,33 +360,31 @@ KIO::WorkerResult ThumbnailProtocol::get(const QUrl &url)
     QByteArray imgData;
     QDataStream stream(&imgData, QIODevice::WriteOnly);
 
+#ifndef Q_OS_WIN
+    const QString shmid = metaData("shmid");
+    if (!shmid.isEmpty()) {
+        // qDebug() << "IMAGE TO SHMID";
+        switch (writeToSharedMemory(shmid.toInt(), img)) {
+        case SharedMemoryWritten:
+            break;
+        case SharedMemoryNotAttached:
+            return KIO::WorkerResult::fail(KIO::ERR_INTERNAL, i18n("Could not attach to the shared memory segment"));
+        case SharedMemoryTooSmall:
+            return KIO::WorkerResult::fail(KIO::ERR_INTERNAL, i18n("Image is too big for the shared memory segment"));
+        }
+    }
+#endif
+
     // Keep in sync with kio/src/previewjob.cpp
     stream << img.width() << img.height() << img.format() << img.devicePixelRatio();
 
 #ifndef Q_OS_WIN
-    const QString shmid = metaData("shmid");
     if (shmid.isEmpty())
 #endif
     {
         // qDebug() << "IMAGE TO STREAM";
         stream << img;
     }
-#ifndef Q_OS_WIN
-    else {
-        // qDebug() << "IMAGE TO SHMID";
-        void *shmaddr = shmat(shmid.toInt(), nullptr, 0);
-        if (shmaddr == (void *)-1) {
-            return KIO::WorkerResult::fail(KIO::ERR_INTERNAL, i18n("Failed to attach to shared memory segment %1", shmid));
-        }
-        struct shmid_ds shmStat;
-        if (shmctl(shmid.toInt(), IPC_STAT, &shmStat) == -1 || shmStat.shm_segsz < (uint)img.sizeInBytes()) {
-            return KIO::WorkerResult::fail(KIO::ERR_INTERNAL, i18n("Image is too big for the shared memory segment"));
-            shmdt((char *)shmaddr);
-        }
-        memcpy(shmaddr, img.constBits(), img.sizeInBytes());
-        shmdt((char *)shmaddr);
-    }
-#endif
     mimeType("application/octet-stream");
     data(imgData);
 
@@ -33,6 +33,7 @@ public:
     ~ThumbnailProtocol() override;
 
     KIO::WorkerResult get(const QUrl &url) override;
+    KIO::WorkerResult special(const QByteArray &data) override;
 
 protected:
     ThumbCreatorWithMetadata *getThumbCreator(const QString &plugin);
@@ -59,6 +60,21 @@ private:
 
 private:
     void ensureDirsCreated();
+#ifndef Q_OS_WIN
+    enum SharedMemoryResult {
+        SharedMemoryWritten,
+        SharedMemoryNotAttached,
+        SharedMemoryTooSmall,
+    };
+
+    /**
+     * Copies the pixels of @p img into the SysV shared memory segment @p shmid,
+     * keeping the segment attached for subsequent requests of the same job.
+     * special() detaches it once no request came for a while.
+     */
+    SharedMemoryResult writeToSharedMemory(int shmid, const QImage &img);
+    void detachSharedMemory();
+#endif
     bool createThumbnail(ThumbCreatorWithMetadata *subCreator, const QString &filePath, int width, int height, QImage &thumbnail);
 
     QString m_mimeType;
@@ -73,6 +89,10 @@ private:
     KIO::filesize_t m_maxFileSize;
     QRandomGenerator m_randomGenerator;
     float m_sequenceIndexWrapAroundPoint = -1;
+#ifndef Q_OS_WIN
+    void *m_shmAddress = nullptr;
+    int m_shmId = -1;
+#endif
 };
 
 #endif
@@ -0,0 +1,253 @@
+/*
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "zipreader.h"
+
+#include <QDir>
+#include <QtEndian>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+// https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT
+constexpr quint32 LOCAL_HEADER_SIGNATURE = 0x04034b50;
+constexpr quint32 CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+constexpr quint32 END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06054b50;
+constexpr quint32 ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06064b50;
+constexpr quint32 ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+constexpr quint16 ZIP64_EXTRA_FIELD = 0x0001;
+
+constexpr quint16 METHOD_STORED = 0;
+constexpr quint16 METHOD_DEFLATED = 8;
+constexpr quint16 FLAG_ENCRYPTED = 0x0001;
+
+template<typename T>
+bool readLittleEndian(QByteArrayView data, quint64 offset, T &value)
+{
+    if (offset > quint64(data.size()) || sizeof(T) > quint64(data.size()) - offset) {
+        return false;
+    }
+    value = qFromLittleEndian<T>(data.data() + offset);
+    return true;
+}
+}
+
+ZipReader::ZipReader(const QString &path)
+    : m_file(path)
+{
+}
+
+bool ZipReader::open()
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const uchar *map = m_file.map(0, m_file.size());
+    if (!map) {
+        return false;
+    }
+    m_data = QByteArrayView(map, m_file.size());
+
+    // The end of central directory record is at the very end, followed only by a comment of at most 64 KiB
+    constexpr quint64 endRecordSize = 22;
+    if (quint64(m_data.size()) < endRecordSize) {
+        return false;
+    }
+    const quint64 searchEnd = quint64(m_data.size()) - endRecordSize;
+    const quint64 searchStart = searchEnd > 0xffff ? searchEnd - 0xffff : 0;
+    std::optional<quint64> endRecord;
+    for (quint64 offset = searchEnd + 1; offset-- > searchStart;) {
+        quint32 signature;
+        if (readLittleEndian(m_data, offset, signature) && signature == END_OF_CENTRAL_DIRECTORY_SIGNATURE) {
+            endRecord = offset;
+            break;
+        }
+    }
+    if (!endRecord) {
+        return false;
+    }
+
+    quint16 entryCount;
+    quint32 centralDirectory;
+    if (!readLittleEndian(m_data, *endRecord + 10, entryCount) || !readLittleEndian(m_data, *endRecord + 16, centralDirectory)) {
+        return false;
+    }
+    m_entryCount = entryCount;
+    m_centralDirectory = centralDirectory;
+
+    // ZIP64 archives store the real values in a separate record, found through a locator right before
+    if (entryCount == 0xffff || centralDirectory == 0xffffffff) {
+        quint32 signature;
+        quint64 zip64Record;
+        if (*endRecord < 20 || !readLittleEndian(m_data, *endRecord - 20, signature) || signature != ZIP64_LOCATOR_SIGNATURE
+            || !readLittleEndian(m_data, *endRecord - 20 + 8, zip64Record)) {
+            return false;
+        }
+        if (!readLittleEndian(m_data, zip64Record, signature) || signature != ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE
+            || !readLittleEndian(m_data, zip64Record + 32, m_entryCount) || !readLittleEndian(m_data, zip64Record + 48, m_centralDirectory)) {
+            return false;
+        }
+    }
+
+    return m_centralDirectory < quint64(m_data.size());
+}
+
+bool ZipReader::readEntry(quint64 &offset, Entry &entry) const
+{
+    quint32 signature;
+    quint32 compressedSize;
+    quint32 size;
+    quint32 localHeaderOffset;
+    quint16 nameLength;
+    quint16 extraLength;
+    quint16 commentLength;
+    if (!readLittleEndian(m_data, offset, signature) || signature != CENTRAL_HEADER_SIGNATURE || !readLittleEndian(m_data, offset + 8, entry.flags)
+        || !readLittleEndian(m_data, offset + 10, entry.method) || !readLittleEndian(m_data, offset + 20, compressedSize)
+        || !readLittleEndian(m_data, offset + 24, size) || !readLittleEndian(m_data, offset + 28, nameLength)
+        || !readLittleEndian(m_data, offset + 30, extraLength) || !readLittleEndian(m_data, offset + 32, commentLength)
+        || !readLittleEndian(m_data, offset + 42, localHeaderOffset)) {
+        return false;
+    }
+
+    const quint64 nameOffset = offset + 46;
+    const quint64 extraOffset = nameOffset + nameLength;
+    const quint64 next = extraOffset + extraLength + commentLength;
+    if (next > quint64(m_data.size())) {
+        return false;
+    }
+
+    entry.name = m_data.sliced(nameOffset, nameLength);
+    entry.compressedSize = compressedSize;
+    entry.size = size;
+    entry.localHeaderOffset = localHeaderOffset;
+
+    // 0xffffffff means the value is in the ZIP64 extra field, in this order
+    if (compressedSize == 0xffffffff || size == 0xffffffff || localHeaderOffset == 0xffffffff) {
+        quint64 field = extraOffset;
+        while (field + 4 <= extraOffset + extraLength) {
+            quint16 id;
+            quint16 length;
+            readLittleEndian(m_data, field, id);
+            readLittleEndian(m_data, field + 2, length);
+            if (id == ZIP64_EXTRA_FIELD) {
+                quint64 value = field + 4;
+                if (size == 0xffffffff && readLittleEndian(m_data, value, entry.size)) {
+                    value += 8;
+                }
+                if (compressedSize == 0xffffffff && readLittleEndian(m_data, value, entry.compressedSize)) {
+                    value += 8;
+                }
+                if (localHeaderOffset == 0xffffffff) {
+                    readLittleEndian(m_data, value, entry.localHeaderOffset);
+                }
+                break;
+            }
+            field += 4 + length;
+        }
+    }
+
+    offset = next;
+    return true;
+}
+
+std::optional<ZipReader::Entry> ZipReader::entry(const QString &name) const
+{
+    // Resolve the name like KArchiveDirectory::entry() does, EPUB covers are
+    // often referred to with "../" and OPC relationships with absolute paths
+    QString cleanName = QDir::cleanPath(name);
+    while (cleanName.startsWith(QLatin1Char('/'))) {
+        cleanName.remove(0, 1);
+    }
+    const QByteArray encodedName = cleanName.toUtf8();
+    std::optional<Entry> result;
+    forEachEntry([&encodedName, &result](const Entry &entry) {
+        QByteArrayView entryName = entry.name;
+        while (entryName.startsWith('/')) {
+            entryName = entryName.sliced(1);
+        }
+        if (entryName == encodedName) {
+            result = entry;
+            return false;
+        }
+        return true;
+    });
+    return result;
+}
+
+QByteArray ZipReader::data(const Entry &entry, qint64 maxSize) const
+{
+    if ((entry.flags & FLAG_ENCRYPTED) || entry.size > quint64(maxSize)) {
+        return QByteArray();
+    }
+
+    // The local header repeats name and extra field, with possibly different lengths
+    quint32 signature;
+    quint16 nameLength;
+    quint16 extraLength;
+    if (!readLittleEndian(m_data, entry.localHeaderOffset, signature) || signature != LOCAL_HEADER_SIGNATURE
+        || !readLittleEndian(m_data, entry.localHeaderOffset + 26, nameLength) || !readLittleEndian(m_data, entry.localHeaderOffset + 28, extraLength)) {
+        return QByteArray();
+    }
+    const quint64 dataOffset = entry.localHeaderOffset + 30 + nameLength + extraLength;
+    if (dataOffset > quint64(m_data.size()) || entry.compressedSize > quint64(m_data.size()) - dataOffset) {
+        return QByteArray();
+    }
+    const QByteArrayView compressed = m_data.sliced(dataOffset, entry.compressedSize);
+
+    if (entry.method == METHOD_STORED) {
+        return compressed.first(std::min<quint64>(compressed.size(), entry.size)).toByteArray();
+    }
+    if (entry.method != METHOD_DEFLATED || compressed.size() > std::numeric_limits<uInt>::max()) {
+        return QByteArray();
+    }
+
+    z_stream stream = {};
+    // negative window bits: raw deflate data without zlib header
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        return QByteArray();
+    }
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(compressed.data()));
+    stream.avail_in = compressed.size();
+
+    // Don't allocate the declared size up front, it may not be true: start
+    // with at most 64 KiB and grow the buffer as the data comes, up to maxSize
+    constexpr qint64 initialSize = 64 * 1024;
+    QByteArray result(std::clamp<qint64>(entry.size, 1, std::min<qint64>(initialSize, maxSize)), Qt::Uninitialized);
+    qint64 done = 0;
+    int status = Z_OK;
+    while (status == Z_OK) {
+        if (done == result.size()) {
+            if (result.size() >= maxSize) {
+                break;
+            }
+            result.resize(std::min<qint64>(2 * result.size(), maxSize));
+        }
+        const uInt available = std::min<qint64>(result.size() - done, std::numeric_limits<uInt>::max());
+        stream.next_out = reinterpret_cast<Bytef *>(result.data() + done);
+        stream.avail_out = available;
+        status = inflate(&stream, Z_NO_FLUSH);
+        done += available - stream.avail_out;
+        // Z_BUF_ERROR: the data ends before the deflate stream does
+    }
+    inflateEnd(&stream);
+
+    if (status != Z_STREAM_END) {
+        return QByteArray();
+    }
+    result.truncate(done);
+    return result;
+}
+
+QByteArray ZipReader::data(const QString &name) const
+{
+    const std::optional<Entry> found = entry(name);
+    return found ? data(*found) : QByteArray();
+}
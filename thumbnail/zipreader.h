@@ -0,0 +1,89 @@
+/*
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef ZIPREADER_H
+#define ZIPREADER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QFile>
+#include <QString>
+
+#include <optional>
+
+/**
+ * Minimal read-only ZIP access for thumbnailers that only need one or two entries.
+ *
+ * Unlike KZip, opening the archive does not build a KArchiveDirectory tree: the file
+ * is mapped and the central directory is scanned on demand. Only the requested entry
+ * is decompressed (stored and deflate methods are supported).
+ */
+class ZipReader
+{
+public:
+    struct Entry {
+        // raw name as stored in the central directory, points into the mapped file
+        QByteArrayView name;
+        quint64 compressedSize = 0;
+        quint64 size = 0;
+        quint64 localHeaderOffset = 0;
+        quint16 method = 0;
+        quint16 flags = 0;
+
+        QString fileName() const
+        {
+            return QString::fromUtf8(name);
+        }
+
+        bool isDirectory() const
+        {
+            return name.endsWith('/');
+        }
+    };
+
+    explicit ZipReader(const QString &path);
+
+    bool open();
+
+    /**
+     * Calls @p visitor with every entry of the central directory, in archive order,
+     * until it returns false.
+     */
+    template<typename Visitor>
+    void forEachEntry(Visitor visitor) const
+    {
+        quint64 offset = m_centralDirectory;
+        Entry entry;
+        for (quint64 i = 0; i < m_entryCount && readEntry(offset, entry); ++i) {
+            if (!visitor(entry)) {
+                return;
+            }
+        }
+    }
+
+    /**
+     * Returns the entry at @p name. The name is resolved like KArchiveDirectory::entry()
+     * does, so "a/../b" and "/b" both find "b".
+     */
+    std::optional<Entry> entry(const QString &name) const;
+
+    /**
+     * Decompresses @p entry. Returns an empty array on error or if the
+     * entry is larger than @p maxSize bytes.
+     */
+    QByteArray data(const Entry &entry, qint64 maxSize = 256 * 1024 * 1024) const;
+    QByteArray data(const QString &name) const;
+
+private:
+    bool readEntry(quint64 &offset, Entry &entry) const;
+
+    QFile m_file;
+    QByteArrayView m_data;
+    quint64 m_centralDirectory = 0;
+    quint64 m_entryCount = 0;
+};
+
+#endif